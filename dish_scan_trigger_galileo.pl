@@ -93,9 +93,28 @@ sub scan_velocity
    return $velocity;
 }
 
+# pass a command to the resident recorder (radar-galileo-rec -daemon)
+sub send_control
+{
+   $control = IO::Socket::UNIX->new (
+                Type => SOCK_DGRAM,
+                Peer => $control_path);
+   if (!$control) {
+	print "Could not reach the recorder on $control_path: $!\n";
+	return;
+   }
+   $control->send ($_[0]);
+   close ($control);
+   print "Sent to the recorder : $_[0]\n";
+}
+
 MAIN:
 {
 
+# if the recorder is up as a daemon the scans go to its socket, and it
+# ends the scan it is recording when the next one comes
+$control_path = "/var/run/radar-galileo/control";
+
 $sock = IO::Socket::INET->new (
                 LocalPort => 50000,
                 Type => SOCK_DGRAM,
@@ -174,6 +193,21 @@ while(1)
 	print "SCAN VELOCITY       : $velocity degrees/s\n";
 	print "------------------------------------\n\n";
 
+	if (-S $control_path)
+	{
+		if ($scan_type eq "FIX")
+		{
+			$options = "-fix 3600 ".$scan_angle." ".$min_angle;
+		} elsif ($scan_type ne "NOT_KNOWN") {
+			$options = "-".lc($scan_type)." ".$min_angle." ".$max_angle." -scan_angle ".$scan_angle." -sv ".$velocity;
+		}
+		if ($scan_type ne "NOT_KNOWN")
+		{
+			send_control ($options." -op ".$operator." -id $experiment_id -file $file -scan $raster -date $yyyymmddhhmmss");
+		}
+		next;
+	}
+
 	$child = fork;
 
 	if ($child != 0)
@@ -240,6 +274,7 @@ while(1)
         	print "GALILEO RECORDING   : OFF\n";
 		print "------------------------------------\n";
 		print "Do you to GALILEO ON on shadowfax?\n";
+		if (-S $control_path) { send_control ("stop"); }
 	}
 	
 # end of while loop
@@ -1,9 +0,0 @@
-#ifndef __MEDIAN_H
-#define __MEDIAN_H
-
-
-typedef float elem_type ;
-
-elem_type median(elem_type m[], int n);
-
-#endif
@@ -0,0 +1,644 @@
+/*****************************************************************
+ * radar-galileo-accuracy.c
+ * ---------------------------------------------------------------
+ * Accuracy test of radar-galileo-rec against the ground truth of
+ * the synthetic acquisition backend.
+ *
+ * For every PulseMode_en the recorder is run on -daq synthetic
+ * for a single ray, with a private copy of the config file that
+ * sets the mode, the size of the ray, the noise gates and the
+ * moments recorded, and a calibration file of zeros. The moments
+ * file is read back and every gate of the weather layer of
+ * RDQ_SyntheticProfile is compared with what the truth gives in
+ * the conventions of the recorder:
+ *
+ *   ZED    signal power (counts^2) * nfft * prf, range corrected:
+ *          the raw Z of a zero z-calibration
+ *   VEL    the velocity, folded into the Nyquist interval of the
+ *          estimate: one PRT for the spectra, the pulses of
+ *          alternate polarisation for _FD, pulse_offset for _VD
+ *   SPW    the width
+ *   ZDR    zdr
+ *   LDR    ldr, ldr + zdr when V is transmitted
+ *   PHIDP  the phase of H less V, once phidp_offset is removed
+ *   RHO    rho_hv, decorrelated by the Doppler spread over the lag
+ *          and by the noise, as neither is corrected for
+ *
+ * The second pulse of the dual pulse modes follows by more than
+ * the weather layer, so that its echoes do not mix with those of
+ * the first and every mode is checked over the same gates. The
+ * _VD moments are checked in Double_HV_VH alone: the pairs of
+ * Double_HV_HV are all H then V, and their phase holds phidp as
+ * well as the velocity.
+ *
+ * A check passes when all the gates with enough signal are within
+ * its bound. The bias and the largest error are printed, with the
+ * gate of the largest. The exit status is 1 if any check failed
+ * (make accuracy).
+ *
+ * ---------------------------------------------------------------
+ * REVISION HISTORY
+ * ---------------------------------------------------------------
+ *
+ * 20261019     First version
+ *****************************************************************/
+
+#define _GNU_SOURCE /* nftw */
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include <netcdf.h>
+
+#include <radar.h> // Master header file for the Universal Radar Code
+#include <RDQ.h>   // Include file for the RDQ package
+#include <RSP.h>   // Include file for the RSP package
+
+#include "radar-galileo-rec.h"
+
+#define PULSES        256   /* per spectrum */
+#define SAMPLES       250
+#define PULSE_OFFSET  50    /* us, second pulse of the dual pulse modes */
+#define NOISE_GATES   15    /* the last, beyond every echo */
+#define MIN_SNR       10.0  /* dB, gates checked */
+#define MIN_XSNR      3.0   /* dB, cross-polar, gates checked for LDR */
+
+#define STR(x)   #x
+#define XSTR(x)  STR (x)
+
+#define MODE(m)   (1u << (m))
+#define TX_H      (MODE (PM_Single_H) | MODE (PM_Single_HV) | MODE (PM_Double_H) | \
+		   MODE (PM_Double_HV_VH) | MODE (PM_Double_HV_HV))
+#define TX_V      (MODE (PM_Single_V) | MODE (PM_Single_HV) | MODE (PM_Double_V) | \
+		   MODE (PM_Double_HV_VH) | MODE (PM_Double_HV_HV))
+#define TX_HV     (TX_H & TX_V)
+#define TX_FD     (MODE (PM_Single_HV) | MODE (PM_Double_HV_VH))
+#define TX_VD     (MODE (PM_Double_HV_VH))
+
+enum Kind_en { K_ZED, K_VEL, K_SPW, K_LDR, K_ZDR, K_PHIDP, K_RHO };
+enum Lag_en  { LAG_PRT, LAG_FD, LAG_VD };
+
+typedef struct Check_st
+{
+    const char * name;
+    unsigned     modes;     /* MODE () of the modes that estimate it */
+    int          kind;
+    int          v;         /* of the V transmitted pulses */
+    int          lag;
+    double       bound;
+    const char * unit;
+} Check_st;
+
+static const Check_st checks[] =
+{
+    { "ZED_HC",   TX_H,  K_ZED,   0, LAG_PRT, 1.0,  "dB"  },
+    { "ZED_VC",   TX_V,  K_ZED,   1, LAG_PRT, 1.0,  "dB"  },
+    { "VEL_HC",   TX_H,  K_VEL,   0, LAG_PRT, 0.2,  "m/s" },
+    { "VEL_VC",   TX_V,  K_VEL,   1, LAG_PRT, 0.2,  "m/s" },
+    { "SPW_HC",   TX_H,  K_SPW,   0, LAG_PRT, 0.15, "m/s" },
+    { "SPW_VC",   TX_V,  K_SPW,   1, LAG_PRT, 0.15, "m/s" },
+    { "LDR_HC",   TX_H,  K_LDR,   0, LAG_PRT, 1.5,  "dB"  },
+    { "LDR_VC",   TX_V,  K_LDR,   1, LAG_PRT, 1.5,  "dB"  },
+    { "ZDR_C",    TX_HV, K_ZDR,   0, LAG_PRT, 0.5,  "dB"  },
+    { "VEL_FD",   TX_FD, K_VEL,   0, LAG_FD,  0.2,  "m/s" },
+    { "PHIDP_FD", TX_FD, K_PHIDP, 0, LAG_FD,  3.0,  "deg" },
+    { "RHO_FD",   TX_FD, K_RHO,   0, LAG_FD,  0.03, ""    },
+    { "VEL_VD",   TX_VD, K_VEL,   0, LAG_VD,  0.3,  "m/s" },
+    { "PHIDP_VD", TX_VD, K_PHIDP, 0, LAG_VD,  3.0,  "deg" },
+    { "RHO_VD",   TX_VD, K_RHO,   0, LAG_VD,  0.03, ""    },
+};
+#define NCHECKS ((int)(sizeof (checks) / sizeof (checks[0])))
+
+/* the keys replaced in the copy of the config file */
+typedef struct Setting_st
+{
+    const char * key;
+    const char * value;
+} Setting_st;
+
+static char noise_gates[32], process_gates[32];
+
+static const Setting_st settings[] =
+{
+    { "pulses",             XSTR (PULSES) },
+    { "samples",            XSTR (SAMPLES) },
+    { "num-coh-avg",        "1" },
+    { "num-spec-avg",       "4" },
+    { "num-moments-avg",    "4" },
+    { "num-interleave",     "1" },
+    { "num-peaks",          "1" },
+    { "pulse_offset",       XSTR (PULSE_OFFSET) },
+    { "long_pulse_mode",    "0" },
+    { "alternate_modes",    "0" },
+    { "noise-gates",        noise_gates },
+    { "process-gates",      process_gates },
+    { "dump_spectra",       "0" },
+    { "dump_spectra_rapid", "0" },
+    { "rt-priority",        "0" },
+    { "rt-lock-memory",     "0" },
+    { "rt-pages",           "normal" },
+};
+#define NSETTINGS ((int)(sizeof (settings) / sizeof (settings[0])))
+
+/* what the ray of the moments file was made with */
+typedef struct Ray_st
+{
+    int     gates;
+    int     records;
+    int     nfft;
+    double  prf;         /* Hz, of each polarisation */
+    double  wavelength;  /* m */
+    float * range;
+    RDQ_GateTruthStruct * truth;
+} Ray_st;
+
+static const char * const mode_names[8] =
+{
+    "Undefined0", "Single_H", "Single_V", "Single_HV",
+    "Double_H", "Double_V", "Double_HV_VH", "Double_HV_HV"
+};
+
+static bool verbose = false;
+static char found[PATH_MAX];
+
+
+static inline void
+disp_help (const char * prog)
+{
+    const char * pt = strrchr (prog, '/');
+
+    if (pt++ != NULL)
+	prog = pt;
+
+    printf ("Usage: %s [options]\n\n", prog);
+    printf ("Options:\n");
+    printf ("--------\n");
+    printf (" -config filename      Base config file (default %s)\n", CONFIG_FILE);
+    printf (" -rec path             radar-galileo-rec to run (default: next to this program)\n");
+    printf (" -mode <n>             Only test PulseMode_en n (default: 1 to 7)\n");
+    printf (" -keep                 Keep the files of the recorder\n");
+    printf (" -v                    Show the output of the recorder\n");
+    printf ("\n");
+}
+
+/*
+ * Copy the base config file to dir, with the keys of settings[]
+ * replaced and the moments checked recorded, and write a calibration
+ * file of zeros next to it.
+ */
+static int
+write_config (const char * base, const char * dir, char * config, char * calfile)
+{
+    char   line[1024];
+    FILE * in;
+    FILE * out;
+    int    i;
+
+    snprintf (config,  PATH_MAX, "%s/radar-galileo.conf", dir);
+    snprintf (calfile, PATH_MAX, "%s/radar-galileo.cal",  dir);
+
+    in = fopen (base, "r");
+    if (in == NULL)
+    {
+	printf ("Cannot open %s: %m\n", base);
+	return -1;
+    }
+    out = fopen (config, "w");
+    if (out == NULL)
+    {
+	printf ("Cannot create %s: %m\n", config);
+	fclose (in);
+	return -1;
+    }
+    while (fgets (line, sizeof (line), in) != NULL)
+    {
+	size_t len = strcspn (line, " \t\r\n");
+
+	for (i = 0; i < NSETTINGS + NCHECKS; i++)
+	{
+	    const char * key = (i < NSETTINGS) ? settings[i].key : checks[i - NSETTINGS].name;
+
+	    if (line[0] != '#' && len == strlen (key) && !strncmp (line, key, len))
+		break;
+	}
+	if (i == NSETTINGS + NCHECKS)
+	    fputs (line, out);
+    }
+    fprintf (out, "\n# set by radar-galileo-accuracy\n");
+    for (i = 0; i < NSETTINGS; i++)
+	fprintf (out, "%s %s\n", settings[i].key, settings[i].value);
+    for (i = 0; i < NCHECKS; i++)
+	fprintf (out, "%s 1\n", checks[i].name);
+    fclose (in);
+    if (fclose (out) != 0)
+    {
+	printf ("Cannot write %s: %m\n", config);
+	return -1;
+    }
+
+    out = fopen (calfile, "w");
+    if (out == NULL)
+    {
+	printf ("Cannot create %s: %m\n", calfile);
+	return -1;
+    }
+    fprintf (out, "z-calibration 0\n"
+		  "z-incoherent-calibration 0\n"
+		  "z-incoherent-noise 0\n"
+		  "zdr-calibration 0\n"
+		  "ldr-calibration 0\n"
+		  "range-offset 0\n");
+    if (fclose (out) != 0)
+    {
+	printf ("Cannot write %s: %m\n", calfile);
+	return -1;
+    }
+    return 0;
+}
+
+/* Record a single ray of the synthetic backend in mode */
+static int
+run_recorder (const char * rec, const char * config, const char * calfile,
+	      const char * outdir, int mode)
+{
+    char         mode_arg[8];
+    const char * argv[20];
+    int          argc = 0;
+    int          status;
+    pid_t        pid;
+
+    snprintf (mode_arg, sizeof (mode_arg), "%d", mode);
+
+    argv[argc++] = rec;
+    argv[argc++] = "-daq";
+    argv[argc++] = "synthetic";
+    argv[argc++] = "-config";
+    argv[argc++] = config;
+    argv[argc++] = "-calfile";
+    argv[argc++] = calfile;
+    argv[argc++] = "-outdir";
+    argv[argc++] = outdir;
+    argv[argc++] = "-mode0";
+    argv[argc++] = mode_arg;
+    argv[argc++] = "-single";
+    argv[argc++] = "0";
+    argv[argc++] = "90";
+    argv[argc] = NULL;
+
+    fflush (stdout);
+    pid = fork ();
+    if (pid == 0)
+    {
+	if (!verbose)
+	{
+	    int fd = open ("/dev/null", O_WRONLY);
+
+	    if (fd >= 0)
+	    {
+		dup2 (fd, STDOUT_FILENO);
+		close (fd);
+	    }
+	}
+	execv (rec, (char * const *) argv);
+	fprintf (stderr, "Cannot run %s: %m\n", rec);
+	_exit (127);
+    }
+    if (pid < 0)
+    {
+	printf ("Cannot fork: %m\n");
+	return -1;
+    }
+    if (waitpid (pid, &status, 0) != pid || !WIFEXITED (status) || WEXITSTATUS (status) != 0)
+    {
+	printf ("%s failed in mode %d\n", rec, mode);
+	return -1;
+    }
+    return 0;
+}
+
+/* nftw: the moments file, the one with ZED_HC */
+static int
+find_moments (const char * path, const struct stat * sb __attribute__ ((__unused__)),
+	      int type, struct FTW * ftw __attribute__ ((__unused__)))
+{
+    size_t len = strlen (path);
+    int    ncid, varid;
+
+    if (type != FTW_F || len < 3 || strcmp (path + len - 3, ".nc"))
+	return 0;
+    if (nc_open (path, NC_NOWRITE, &ncid) != NC_NOERR)
+	return 0;
+    if (nc_inq_varid (ncid, "ZED_HC", &varid) == NC_NOERR)
+	snprintf (found, sizeof (found), "%s", path);
+    nc_close (ncid);
+    return found[0] != '\0';
+}
+
+/* nftw: rm -r */
+static int
+remove_file (const char * path, const struct stat * sb __attribute__ ((__unused__)),
+	     int type __attribute__ ((__unused__)), struct FTW * ftw __attribute__ ((__unused__)))
+{
+    remove (path);
+    return 0;
+}
+
+/* The size of the ray, its radar and the truth of its gates */
+static int
+read_ray (int ncid, int mode, Ray_st * ray)
+{
+    RDQ_ConfigStruct cfg;
+    size_t           len;
+    float            value;
+    int              dimid, varid, pulses;
+
+    memset (ray, 0, sizeof (*ray));
+    if (nc_inq_dimid (ncid, "range", &dimid) != NC_NOERR ||
+	nc_inq_dimlen (ncid, dimid, &len) != NC_NOERR || len < 2)
+	return -1;
+    ray->gates = (int) len;
+    if (nc_inq_dimid (ncid, "time", &dimid) != NC_NOERR ||
+	nc_inq_dimlen (ncid, dimid, &len) != NC_NOERR || len < 1)
+	return -1;
+    ray->records = (int) len;
+
+    if (nc_get_att_int (ncid, NC_GLOBAL, "pulses_per_daq_cycle", &pulses) != NC_NOERR)
+	return -1;
+    ray->nfft = pulses / ((MODE (mode) & TX_HV) ? 2 : 1);
+
+    if (nc_inq_varid (ncid, "prf", &varid) != NC_NOERR ||
+	nc_get_var_float (ncid, varid, &value) != NC_NOERR)
+	return -1;
+    ray->prf = value;
+    if (nc_inq_varid (ncid, "frequency", &varid) != NC_NOERR ||
+	nc_get_var_float (ncid, varid, &value) != NC_NOERR)
+	return -1;
+    ray->wavelength = SPEED_LIGHT / (value * 1e9);
+
+    ray->range = malloc (ray->gates * sizeof (float));
+    ray->truth = malloc (ray->gates * sizeof (RDQ_GateTruthStruct));
+    if (ray->range == NULL || ray->truth == NULL)
+	return -1;
+    if (nc_inq_varid (ncid, "range", &varid) != NC_NOERR ||
+	nc_get_var_float (ncid, varid, ray->range) != NC_NOERR)
+	return -1;
+
+    /* the profile of the backend, which ends before the second pulse
+       echoes leave the gates: all of them are processed */
+    memset (&cfg, 0, sizeof (cfg));
+    cfg.samples_per_pulse = ray->gates;
+    cfg.delay_gates       = (int) (0.5 + PULSE_OFFSET * 1e-6 * SPEED_LIGHT /
+				   (2.0 * (ray->range[1] - ray->range[0])));
+    RDQ_SyntheticProfile (ray->truth, &cfg);
+    return 0;
+}
+
+/*
+ * The value of a check at a gate, and the period of its errors (0
+ * for none). False if the gate has too little signal to check.
+ */
+static bool
+expected (const Check_st * c, const Ray_st * ray, int gate, double * value, double * period)
+{
+    const RDQ_GateTruthStruct * t = &ray->truth[gate];
+    const double snr_h  = t->snr;
+    const double snr_v  = t->snr - t->zdr;
+    const double snr    = c->v ? snr_v : snr_h;
+    const double snr_hv = fmin (snr_h, snr_v);
+    double       lag;
+
+    if (t->snr <= RDQ_NO_SIGNAL || t->cnr > RDQ_NO_SIGNAL)
+	return false;
+
+    switch (c->lag)
+    {
+    case LAG_FD:
+	lag = 0.5 / ray->prf;
+	break;
+    case LAG_VD:
+	lag = PULSE_OFFSET * 1e-6;
+	break;
+    default:
+	lag = 1.0 / ray->prf;
+	break;
+    }
+
+    *period = 0.0;
+    switch (c->kind)
+    {
+    case K_ZED:
+	*value = snr + 10.0 * log10 (RDQ_SYNTHETIC_NOISE * ray->nfft * ray->prf) +
+	    20.0 * log10 (ray->range[gate]);
+	return snr >= MIN_SNR;
+    case K_VEL:
+	*value  = t->velocity;
+	*period = ray->wavelength / (2.0 * lag);
+	return (c->lag == LAG_PRT ? snr : snr_hv) >= MIN_SNR;
+    case K_SPW:
+	*value = t->width;
+	return snr >= MIN_SNR;
+    case K_LDR:
+	*value = t->ldr + (c->v ? t->zdr : 0.0);
+	return t->snr + t->ldr >= MIN_XSNR;
+    case K_ZDR:
+	*value = t->zdr;
+	return snr_hv >= MIN_SNR;
+    case K_PHIDP:
+	*value  = t->phidp;
+	*period = 180.0;
+	return snr_hv >= MIN_SNR;
+    case K_RHO:
+    {
+	const double spread = M_PI * t->width * 2.0 / ray->wavelength * lag;
+
+	*value = t->rhohv * exp (-2.0 * spread * spread) /
+	    sqrt ((1.0 + pow (10.0, -0.1 * snr_h)) * (1.0 + pow (10.0, -0.1 * snr_v)));
+	return snr_hv >= MIN_SNR;
+    }
+    }
+    return false;
+}
+
+/* Compare the moments of a mode with the truth; the failures */
+static int
+check_mode (int ncid, int mode)
+{
+    Ray_st  ray;
+    float * data = NULL;
+    int     failures = 0;
+    int     i;
+
+    if (read_ray (ncid, mode, &ray) != 0 ||
+	(data = malloc ((size_t) ray.records * ray.gates * sizeof (float))) == NULL)
+    {
+	printf ("%-12s cannot read the moments file\n", mode_names[mode]);
+	free (ray.range);
+	free (ray.truth);
+	return 1;
+    }
+
+    for (i = 0; i < NCHECKS; i++)
+    {
+	const Check_st * c = &checks[i];
+	double bias = 0.0, worst = 0.0;
+	int    n = 0, outside = 0, worst_gate = -1;
+	int    varid, rec, g;
+
+	if (!(c->modes & MODE (mode)))
+	    continue;
+
+	if (nc_inq_varid (ncid, c->name, &varid) != NC_NOERR ||
+	    nc_get_var_float (ncid, varid, data) != NC_NOERR)
+	{
+	    printf ("%-12s %-9s not written  FAIL\n", mode_names[mode], c->name);
+	    failures++;
+	    continue;
+	}
+
+	for (rec = 0; rec < ray.records; rec++)
+	{
+	    for (g = 0; g < ray.gates; g++)
+	    {
+		const double x = data[(size_t) rec * ray.gates + g];
+		double       value, period, error;
+
+		if (!expected (c, &ray, g, &value, &period))
+		    continue;
+		error = x - value;
+		if (period > 0.0)
+		    error = remainder (error, period);
+		if (!isfinite (error))
+		    error = INFINITY;
+
+		n++;
+		bias += error;
+		if (!(fabs (error) <= c->bound))
+		    outside++;
+		if (!(fabs (error) <= fabs (worst)))
+		{
+		    worst      = error;
+		    worst_gate = g;
+		}
+	    }
+	}
+
+	if (n == 0 || outside > 0)
+	    failures++;
+	printf ("%-12s %-9s %4d gates  bias %8.3f  max %8.3f %-3s at gate %3d  (bound %g)  %s\n",
+		mode_names[mode], c->name, n, n ? bias / n : 0.0, worst, c->unit,
+		worst_gate, c->bound, (n == 0 || outside > 0) ? "FAIL" : "ok");
+    }
+
+    free (data);
+    free (ray.range);
+    free (ray.truth);
+    return failures;
+}
+
+int
+main (int argc, char * argv[])
+{
+    const char * config_file = CONFIG_FILE;
+    char         rec[PATH_MAX] = "";
+    bool         keep = false;
+    int          first = PM_Single_H, last = PM_Double_HV_HV;
+    int          failures = 0;
+    int          i, mode;
+
+    for (i = 1; i < argc; i++)
+    {
+	if (!strcmp (argv[i], "-config") && i + 1 < argc)
+	    config_file = argv[++i];
+	else if (!strcmp (argv[i], "-rec") && i + 1 < argc)
+	    snprintf (rec, sizeof (rec), "%s", argv[++i]);
+	else if (!strcmp (argv[i], "-mode") && i + 1 < argc)
+	{
+	    first = last = atoi (argv[++i]);
+	    if (first < PM_Single_H || first > PM_Double_HV_HV)
+	    {
+		disp_help (argv[0]);
+		return 1;
+	    }
+	}
+	else if (!strcmp (argv[i], "-keep"))
+	    keep = true;
+	else if (!strcmp (argv[i], "-v"))
+	    verbose = true;
+	else
+	{
+	    disp_help (argv[0]);
+	    return 1;
+	}
+    }
+
+    /* by default the recorder installed with this program */
+    if (rec[0] == '\0')
+    {
+	ssize_t len = readlink ("/proc/self/exe", rec, sizeof (rec) - 1);
+	char *  pt;
+
+	rec[len > 0 ? len : 0] = '\0';
+	pt = strrchr (rec, '/');
+	snprintf (pt != NULL ? pt + 1 : rec, sizeof (rec) - (pt != NULL ? pt + 1 - rec : 0),
+		  "radar-galileo-rec");
+    }
+    if (access (rec, X_OK) != 0)
+    {
+	printf ("Cannot run %s: %m\n", rec);
+	return 1;
+    }
+
+    /* the last gates hold noise alone, in every mode */
+    snprintf (noise_gates,   sizeof (noise_gates),   "%d %d", SAMPLES - NOISE_GATES, SAMPLES - 1);
+    snprintf (process_gates, sizeof (process_gates), "%d %d", 0, SAMPLES - 1);
+
+    printf ("%d pulses, %d gates, pulse offset %d us, gates of SNR >= %g dB\n\n",
+	    PULSES, SAMPLES, PULSE_OFFSET, MIN_SNR);
+
+    for (mode = first; mode <= last; mode++)
+    {
+	char dir[] = "/tmp/radar-galileo-accuracy.XXXXXX";
+	char config[PATH_MAX], calfile[PATH_MAX];
+	int  ncid;
+
+	if (mkdtemp (dir) == NULL)
+	{
+	    printf ("Cannot create a directory: %m\n");
+	    return 1;
+	}
+
+	found[0] = '\0';
+	if (write_config (config_file, dir, config, calfile) != 0 ||
+	    run_recorder (rec, config, calfile, dir, mode) != 0)
+	    failures++;
+	else if (nftw (dir, find_moments, 16, FTW_PHYS) <= 0 ||
+		 nc_open (found, NC_NOWRITE, &ncid) != NC_NOERR)
+	{
+	    printf ("%-12s no moments file under %s\n", mode_names[mode], dir);
+	    failures++;
+	}
+	else
+	{
+	    failures += check_mode (ncid, mode);
+	    nc_close (ncid);
+	}
+
+	if (keep)
+	    printf ("%-12s files in %s\n", mode_names[mode], dir);
+	else
+	    nftw (dir, remove_file, 16, FTW_DEPTH | FTW_PHYS);
+	printf ("\n");
+    }
+
+    printf ("%s: %d failure(s)\n", failures ? "FAILED" : "PASSED", failures);
+    return failures ? 1 : 0;
+}
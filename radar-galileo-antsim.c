@@ -0,0 +1,705 @@
+/*****************************************************************
+ * radar-galileo-antsim.c
+ * ---------------------------------------------------------------
+ * Antenna controller simulator, to run radar-galileo-rec with
+ * -position-msg without the dish.
+ *
+ * The dish follows a script of PPI, RHI and general moves at
+ * given rates, with an optional acceleration, slewing to the start
+ * of each scan from wherever the last one left it. Every tick (50
+ * Hz by default) the position is multicast as the 20ms network
+ * message of the controller, and optionally written as the 13 byte
+ * serial message to a pseudo terminal. The messages can be made
+ * late, with jitter, and stamped by a controller clock that is off
+ * from ours.
+ *
+ * The true position at every tick, and the start and end of every
+ * move, are written to the -truth file, to be set against the
+ * positions the recorder tags its rays with and the scan start and
+ * end times it logs.
+ *
+ * ---------------------------------------------------------------
+ * REVISION HISTORY
+ * ---------------------------------------------------------------
+ *
+ * 20261019     First version
+ *****************************************************************/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <signal.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <RSM_NetworkMessage.h>
+
+#define MAX_MOVES      256
+#define SERIAL_LENGTH  13
+#define FOOTER_LENGTH  3
+
+/* one move of the dish, at most rate deg/s on the axis that moves most */
+typedef struct Move_st
+{
+    char   what[64];    /* as written to the truth file */
+    double az0, el0;
+    double az1, el1;
+    double rate;
+    double distance;    /* deg on the axis that moves most */
+    double seconds;     /* the whole move, dwells too */
+} Move_st;
+
+/* where the dish is */
+typedef struct Position_st
+{
+    double az, el;
+    double vel_az, vel_el;
+    int    move;        /* index of the move, -1 once the script is done */
+} Position_st;
+
+static Move_st moves[MAX_MOVES];
+static int     nmoves  = 0;
+static int     lead    = 0;     /* moves played once, before the script */
+static double  accel   = 0.0;   /* deg/s/s, 0 to reach the rate at once */
+static double  cur_az  = NAN;   /* end of the last move added */
+static double  cur_el  = NAN;
+
+static volatile sig_atomic_t exit_now = 0;
+
+static const unsigned char footer[ FOOTER_LENGTH ] = { 0xFF, 0xFF, 0xFF };
+
+
+static inline void
+disp_help (const char * prog)
+{
+    const char * pt = strrchr (prog, '/');
+
+    if (pt++ != NULL)
+	prog = pt;
+
+    printf ("Usage: %s [options] scan ...\n\n", prog);
+    printf ("Scans, played in order (angles as the recorder has them):\n");
+    printf ("--------\n");
+    printf (" -ppi el az1 az2 rate  Scan the azimuth from az1 to az2 at rate deg/s\n");
+    printf (" -rhi az el1 el2 rate  Scan the elevation from el1 to el2 at rate deg/s\n");
+    printf (" -move az1 el1 az2 el2 rate\n");
+    printf ("                       Move both axes at once, as for a CSP\n");
+    printf (" -point az el seconds  Slew to az, el and stay there\n");
+    printf (" -script filename      Read scans, one per line, without the '-'\n");
+    printf ("\n");
+    printf ("Options:\n");
+    printf ("--------\n");
+    printf (" -start az el          Start here and slew to the first scan (default: at it)\n");
+    printf (" -repeat <n>           Play the scans n times, 0 for ever (default 1)\n");
+    printf (" -accel a              Accelerate at a deg/s/s (default: at once)\n");
+    printf (" -hz <n>               Messages per second (default 50)\n");
+    printf (" -latency ms           Send each message ms after its sample (default 0)\n");
+    printf (" -jitter ms            Send up to ms later again, at random\n");
+    printf (" -skew s               Controller clock s ahead of ours\n");
+    printf (" -serial               Also write the serial message to a pseudo terminal\n");
+    printf (" -link path            Link path to the pseudo terminal, as %s\n", "/dev/ttyS1");
+    printf (" -no-network           Do not multicast the network message\n");
+    printf (" -truth filename       Write the true positions and moves\n");
+    printf (" -v                    Print every message\n");
+    printf ("\n");
+}
+
+static void
+signal_handler (int sig)
+{
+    (void)sig;
+    exit_now = 1;
+}
+
+static int64_t
+now_ns (clockid_t clock)
+{
+    struct timespec ts;
+
+    clock_gettime (clock, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* an angle in [-90, 270), as the controller gives the azimuth */
+static double
+wrap_az (double az)
+{
+    az = fmod (az + 90.0, 360.0);
+    return (az < 0.0 ? az + 360.0 : az) - 90.0;
+}
+
+/*--------------------------------------------------------------------*
+ * Building the script                                                *
+ *--------------------------------------------------------------------*/
+
+static int
+add_move (const char * what,
+	  double       az0,
+	  double       el0,
+	  double       az1,
+	  double       el1,
+	  double       rate,
+	  double       seconds)
+{
+    Move_st * m;
+
+    if (nmoves == MAX_MOVES)
+    {
+	printf ("Too many moves\n");
+	return -1;
+    }
+    m = &moves[nmoves++];
+    snprintf (m->what, sizeof (m->what), "%s", what);
+    m->az0 = az0;
+    m->el0 = el0;
+    m->az1 = az1;
+    m->el1 = el1;
+    m->rate     = fabs (rate);
+    m->distance = fmax (fabs (az1 - az0), fabs (el1 - el0));
+    m->seconds  = seconds;      /* the dwell, made the whole by move_time */
+    cur_az = az1;
+    cur_el = el1;
+    return 0;
+}
+
+/* a scan from az0, el0 to az1, el1, slewing to its start first */
+static int
+add_scan (const char * what,
+	  double       az0,
+	  double       el0,
+	  double       az1,
+	  double       el1,
+	  double       rate,
+	  double       seconds)
+{
+    if (rate <= 0.0 && (az0 != az1 || el0 != el1))
+    {
+	printf ("%s: the rate must be positive\n", what);
+	return -1;
+    }
+    if (!isnan (cur_az) && (cur_az != az0 || cur_el != el0) &&
+	add_move ("slew", cur_az, cur_el, az0, el0, (rate > 0.0) ? rate : 10.0, 0.0) != 0)
+	return -1;
+    return add_move (what, az0, el0, az1, el1, rate, seconds);
+}
+
+/*
+ * Add the scan named by word, with its numbers in args.
+ * Returns the number of args used, -1 if it is not understood.
+ */
+static int
+add_keyword (const char * word,
+	     char *       args[],
+	     int          nargs)
+{
+    double a[5];
+    char   what[64];
+    int    need, i;
+
+    if      (!strcmp (word, "ppi"))   need = 4;
+    else if (!strcmp (word, "rhi"))   need = 4;
+    else if (!strcmp (word, "move"))  need = 5;
+    else if (!strcmp (word, "point")) need = 3;
+    else
+	return -1;
+
+    if (nargs < need)
+    {
+	printf ("%s needs %d numbers\n", word, need);
+	return -1;
+    }
+    for (i = 0; i < need; i++)
+	a[i] = atof (args[i]);
+
+    if (!strcmp (word, "ppi"))
+    {
+	snprintf (what, sizeof (what), "ppi el %g az %g to %g", a[0], a[1], a[2]);
+	return add_scan (what, a[1], a[0], a[2], a[0], a[3], 0.0) ? -1 : need;
+    }
+    if (!strcmp (word, "rhi"))
+    {
+	snprintf (what, sizeof (what), "rhi az %g el %g to %g", a[0], a[1], a[2]);
+	return add_scan (what, a[0], a[1], a[0], a[2], a[3], 0.0) ? -1 : need;
+    }
+    if (!strcmp (word, "move"))
+    {
+	snprintf (what, sizeof (what), "move %g %g to %g %g", a[0], a[1], a[2], a[3]);
+	return add_scan (what, a[0], a[1], a[2], a[3], a[4], 0.0) ? -1 : need;
+    }
+    snprintf (what, sizeof (what), "point az %g el %g", a[0], a[1]);
+    return add_scan (what, a[0], a[1], a[0], a[1], 0.0, a[2]) ? -1 : need;
+}
+
+static int
+read_script (const char * file)
+{
+    char   line[256];
+    char * args[8];
+    FILE * fp;
+    int    n, lineno = 0;
+
+    fp = fopen (file, "r");
+    if (fp == NULL)
+    {
+	printf ("Cannot open %s: %m\n", file);
+	return -1;
+    }
+    while (fgets (line, sizeof (line), fp) != NULL)
+    {
+	char * word, * save;
+
+	lineno++;
+	line[strcspn (line, "#\r\n")] = '\0';
+	word = strtok_r (line, " \t", &save);
+	if (word == NULL)
+	    continue;
+	for (n = 0; n < 8 && (args[n] = strtok_r (NULL, " \t", &save)) != NULL; n++)
+	    ;
+	if (add_keyword (word, args, n) < 0)
+	{
+	    printf ("%s:%d: not a scan\n", file, lineno);
+	    fclose (fp);
+	    return -1;
+	}
+    }
+    fclose (fp);
+    return 0;
+}
+
+/*--------------------------------------------------------------------*
+ * The dish                                                           *
+ *--------------------------------------------------------------------*/
+
+/* the distance along a move at t, and the speed */
+static double
+travel (const Move_st * m,
+	double          t,
+	double *        speed)
+{
+    const double d = m->distance, v = m->rate;
+    double       ta, tm;
+
+    *speed = 0.0;
+    if (d <= 0.0 || v <= 0.0)
+	return 0.0;
+    if (accel <= 0.0)
+    {
+	if (t >= d / v)
+	    return d;
+	*speed = v;
+	return v * t;
+    }
+
+    /* up to speed, at speed, and down; or up and down when short */
+    ta = v / accel;
+    if (d < v * ta)
+	ta = sqrt (d / accel);
+    tm = (d - accel * ta * ta) / (accel * ta);     /* at the top speed */
+    if (t < ta)
+    {
+	*speed = accel * t;
+	return 0.5 * accel * t * t;
+    }
+    if (t < ta + tm)
+    {
+	*speed = accel * ta;
+	return 0.5 * accel * ta * ta + accel * ta * (t - ta);
+    }
+    if (t < 2.0 * ta + tm)
+    {
+	t = 2.0 * ta + tm - t;
+	*speed = accel * t;
+	return d - 0.5 * accel * t * t;
+    }
+    return d;
+}
+
+/* the time a move takes, at least its dwell, once accel is known */
+static void
+move_time (Move_st * m)
+{
+    const double d = m->distance, v = m->rate;
+
+    if (d <= 0.0 || v <= 0.0)
+	return;
+    if (accel <= 0.0)
+	m->seconds = fmax (m->seconds, d / v);
+    else if (d >= v * v / accel)
+	m->seconds = fmax (m->seconds, d / v + v / accel);
+    else
+	m->seconds = fmax (m->seconds, 2.0 * sqrt (d / accel));
+}
+
+/* where the dish is t s into the script, played repeat times */
+static void
+position (double        t,
+	  int           repeat,
+	  Position_st * p)
+{
+    const Move_st * m;
+    double          once = 0.0, lead_time = 0.0, s, speed, f;
+    int             i, pass;
+
+    for (i = 0; i < nmoves; i++)
+	*((i < lead) ? &lead_time : &once) += moves[i].seconds;
+
+    i = 0;
+    if (t >= lead_time && once > 0.0)
+    {
+	t   -= lead_time;
+	pass = (int)floor (t / once);
+	if (repeat > 0 && pass >= repeat)
+	{
+	    m = &moves[nmoves - 1];
+	    p->az   = m->az1;
+	    p->el   = m->el1;
+	    p->vel_az = p->vel_el = 0.0;
+	    p->move = -1;
+	    return;
+	}
+	t -= pass * once;
+	i  = lead;
+    }
+    for (; i < nmoves - 1 && t >= moves[i].seconds; i++)
+	t -= moves[i].seconds;
+
+    m = &moves[i];
+    s = travel (m, t, &speed);
+    f = (m->distance > 0.0) ? s / m->distance : 1.0;
+    p->az     = m->az0 + f * (m->az1 - m->az0);
+    p->el     = m->el0 + f * (m->el1 - m->el0);
+    p->vel_az = (m->distance > 0.0) ? speed * (m->az1 - m->az0) / m->distance : 0.0;
+    p->vel_el = (m->distance > 0.0) ? speed * (m->el1 - m->el0) / m->distance : 0.0;
+    p->move   = i;
+}
+
+/*--------------------------------------------------------------------*
+ * The messages                                                       *
+ *--------------------------------------------------------------------*/
+
+static void
+encode_network (RSM_NetworkPacketStruct * msg,
+		const Position_st *       p,
+		int64_t                   ctrl_ns)
+{
+    const time_t sec = ctrl_ns / 1000000000;
+    struct tm    tm;
+
+    gmtime_r (&sec, &tm);
+    memset (msg, 0, sizeof (*msg));
+    strcpy (msg->header, "POSITION");
+    msg->year     = tm.tm_year + 1900;
+    msg->month    = tm.tm_mon + 1;
+    msg->day      = tm.tm_mday;
+    msg->hour     = tm.tm_hour;
+    msg->min      = tm.tm_min;
+    msg->sec      = tm.tm_sec;
+    msg->millisec = ctrl_ns % 1000000000 / 1000000;
+    msg->az       = wrap_az (p->az) + 90.0;    /* Chobs coordinates */
+    msg->el       = p->el;
+    msg->vel_az   = p->vel_az;
+    msg->vel_el   = p->vel_el;
+}
+
+/* the 13 bytes of the serial message and the footer after them */
+static void
+encode_serial (unsigned char *     m,
+	       const Position_st * p,
+	       int64_t             ctrl_ns)
+{
+    const time_t       sec = ctrl_ns / 1000000000;
+    const unsigned int az  = (unsigned int)((wrap_az (p->az) + 90.0) * 480.0 + 0.5);
+    const unsigned int el  = (unsigned int)(fabs (p->el) * 480.0 + 0.5);
+    struct tm          tm;
+
+    gmtime_r (&sec, &tm);
+    m[ 0 ]  = (az >> 16) & 0x03;
+    m[ 1 ]  = (az >> 8) & 0xFF;
+    m[ 2 ]  = az & 0xFF;
+    m[ 3 ]  = ((el >> 16) & 0x03) | ((p->el < 0.0) ? 0x04 : 0);
+    m[ 4 ]  = (el >> 8) & 0xFF;
+    m[ 5 ]  = el & 0xFF;
+    m[ 6 ]  = tm.tm_year % 100;
+    m[ 7 ]  = tm.tm_mon + 1;
+    m[ 8 ]  = tm.tm_mday;
+    m[ 9 ]  = tm.tm_hour;
+    m[ 10 ] = tm.tm_min;
+    m[ 11 ] = tm.tm_sec;
+    m[ 12 ] = ctrl_ns % 1000000000 / 10000000;
+    memcpy (m + SERIAL_LENGTH, footer, FOOTER_LENGTH);
+}
+
+/* a raw pseudo terminal, the name of its slave in name */
+static int
+open_serial (char * name)
+{
+    struct termios attributes;
+    int            fd, slave;
+
+    fd = posix_openpt (O_RDWR | O_NOCTTY);
+    if (fd < 0 || grantpt (fd) != 0 || unlockpt (fd) != 0)
+	return -1;
+    strcpy (name, ptsname (fd));
+
+    /* raw on the slave, which the reader will have too */
+    slave = open (name, O_RDWR | O_NOCTTY);
+    if (slave < 0 || tcgetattr (slave, &attributes) != 0)
+	return -1;
+    cfmakeraw (&attributes);
+    tcsetattr (slave, TCSANOW, &attributes);
+    close (slave);
+
+    /* a reader that is late must not stop the clock */
+    fcntl (fd, F_SETFL, fcntl (fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+static int
+open_network (struct sockaddr_in * addr)
+{
+    unsigned char ttl = 1, loop = 1;
+    int           fd;
+
+    fd = socket (AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0)
+	return -1;
+    setsockopt (fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof (ttl));
+    setsockopt (fd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof (loop));
+    memset (addr, 0, sizeof (*addr));
+    addr->sin_family      = AF_INET;
+    addr->sin_addr.s_addr = inet_addr (RSM_NETWORK_GROUP);
+    addr->sin_port        = htons (RSM_NETWORK_PORT);
+    return fd;
+}
+
+/* UTC to the ms, as the recorder logs its times */
+static const char *
+utc (int64_t real_ns)
+{
+    static char  text[32];
+    const time_t sec = real_ns / 1000000000;
+    struct tm    tm;
+
+    gmtime_r (&sec, &tm);
+    snprintf (text, sizeof (text), "%02d:%02d:%02d.%03d", tm.tm_hour, tm.tm_min,
+	      tm.tm_sec, (int)(real_ns % 1000000000 / 1000000));
+    return text;
+}
+
+int
+main (int argc, char * argv[])
+{
+    RSM_NetworkPacketStruct netmsg;
+    struct sockaddr_in      addr;
+    struct sigaction        action;
+    struct timespec         tick;
+    unsigned char           sermsg[ SERIAL_LENGTH + FOOTER_LENGTH ];
+    const char *            truth_file = NULL;
+    const char *            link_path  = NULL;
+    FILE *                  truth = NULL;
+    Position_st             p;
+    char                    name[64];
+    double                  start_az = NAN, start_el = NAN;
+    double                  hz = 50.0, latency = 0.0, jitter = 0.0, skew = 0.0;
+    int64_t                 period, start_mono, mono_to_real, sample, late, last_real = 0;
+    unsigned long           sent = 0, dropped = 0;
+    unsigned int            seed = 1;
+    bool                    serial = false, network = true, verbose = false;
+    int                     net_fd = -1, ser_fd = -1;
+    int                     repeat = 1, last_move = -2, k, n, i;
+
+    for (i = 1; i < argc; i++)
+    {
+	if (argv[i][0] == '-' && (n = add_keyword (argv[i] + 1, argv + i + 1, argc - i - 1)) >= 0)
+	    i += n;
+	else if (!strcmp (argv[i], "-script") && i + 1 < argc)
+	{
+	    if (read_script (argv[++i]) != 0)
+		return 1;
+	}
+	else if (!strcmp (argv[i], "-start") && i + 2 < argc)
+	{
+	    start_az = atof (argv[++i]);
+	    start_el = atof (argv[++i]);
+	}
+	else if (!strcmp (argv[i], "-repeat") && i + 1 < argc)
+	    repeat = atoi (argv[++i]);
+	else if (!strcmp (argv[i], "-accel") && i + 1 < argc)
+	    accel = atof (argv[++i]);
+	else if (!strcmp (argv[i], "-hz") && i + 1 < argc)
+	    hz = atof (argv[++i]);
+	else if (!strcmp (argv[i], "-latency") && i + 1 < argc)
+	    latency = 1e-3 * atof (argv[++i]);
+	else if (!strcmp (argv[i], "-jitter") && i + 1 < argc)
+	    jitter = 1e-3 * atof (argv[++i]);
+	else if (!strcmp (argv[i], "-skew") && i + 1 < argc)
+	    skew = atof (argv[++i]);
+	else if (!strcmp (argv[i], "-serial"))
+	    serial = true;
+	else if (!strcmp (argv[i], "-link") && i + 1 < argc)
+	    link_path = argv[++i];
+	else if (!strcmp (argv[i], "-no-network"))
+	    network = false;
+	else if (!strcmp (argv[i], "-truth") && i + 1 < argc)
+	    truth_file = argv[++i];
+	else if (!strcmp (argv[i], "-v"))
+	    verbose = true;
+	else
+	{
+	    disp_help (argv[0]);
+	    return 1;
+	}
+    }
+    if (nmoves == 0 || hz <= 0.0 || (!serial && !network))
+    {
+	disp_help (argv[0]);
+	return 1;
+    }
+
+    /* the scans repeat from the end of the last to the start of the first */
+    if (repeat != 1 && (cur_az != moves[0].az0 || cur_el != moves[0].el0) &&
+	add_move ("slew", cur_az, cur_el, moves[0].az0, moves[0].el0,
+		  (moves[0].rate > 0.0) ? moves[0].rate : 10.0, 0.0) != 0)
+	return 1;
+
+    /* and once from -start to the first */
+    if (!isnan (start_az) && (start_az != moves[0].az0 || start_el != moves[0].el0))
+    {
+	Move_st slew;
+
+	if (add_move ("slew", start_az, start_el, moves[0].az0, moves[0].el0,
+		      (moves[0].rate > 0.0) ? moves[0].rate : 10.0, 0.0) != 0)
+	    return 1;
+	slew = moves[--nmoves];
+	memmove (&moves[1], &moves[0], nmoves * sizeof (Move_st));
+	moves[0] = slew;
+	nmoves++;
+	lead = 1;
+    }
+
+    if (network && (net_fd = open_network (&addr)) < 0)
+    {
+	printf ("Cannot open the network socket: %m\n");
+	return 1;
+    }
+    if (serial)
+    {
+	if ((ser_fd = open_serial (name)) < 0)
+	{
+	    printf ("Cannot open a pseudo terminal: %m\n");
+	    return 1;
+	}
+	if (link_path != NULL)
+	{
+	    unlink (link_path);
+	    if (symlink (name, link_path) != 0)
+	    {
+		printf ("Cannot link %s to %s: %m\n", link_path, name);
+		return 1;
+	    }
+	}
+	printf ("Serial message on %s\n", (link_path != NULL) ? link_path : name);
+    }
+    if (network)
+	printf ("Network message to %s:%d\n", RSM_NETWORK_GROUP, RSM_NETWORK_PORT);
+
+    if (truth_file != NULL && (truth = fopen (truth_file, "w")) == NULL)
+    {
+	printf ("Cannot open %s: %m\n", truth_file);
+	return 1;
+    }
+    if (truth != NULL)
+	fprintf (truth, "# time_s az el vel_az vel_el, true, on our clock\n");
+
+    memset (&action, 0, sizeof (action));
+    action.sa_handler = signal_handler;
+    sigaction (SIGINT, &action, NULL);
+    sigaction (SIGTERM, &action, NULL);
+
+    for (i = 0; i < nmoves; i++)
+    {
+	move_time (&moves[i]);
+	printf ("%3d %-40s %8.2f s\n", i, moves[i].what, moves[i].seconds);
+    }
+
+    /* the messages are sent on the ticks of the monotonic clock, each of
+     * the position latency and jitter before */
+    period       = (int64_t)(1e9 / hz + 0.5);
+    start_mono   = now_ns (CLOCK_MONOTONIC);
+    mono_to_real = now_ns (CLOCK_REALTIME) - start_mono;
+    for (k = 0; !exit_now; k++)
+    {
+	const int64_t due = start_mono + (int64_t)k * period;
+
+	tick.tv_sec  = due / 1000000000;
+	tick.tv_nsec = due % 1000000000;
+	while (clock_nanosleep (CLOCK_MONOTONIC, TIMER_ABSTIME, &tick, NULL) == EINTR && !exit_now)
+	    ;
+	if (exit_now)
+	    break;
+
+	late   = (int64_t)(1e9 * (latency + jitter * rand_r (&seed) / RAND_MAX));
+	sample = due - late;
+	position (1e-9 * (sample - start_mono), repeat, &p);
+	last_real = sample + mono_to_real;
+
+	if (truth != NULL && p.move != last_move)
+	{
+	    if (last_move >= 0)
+		fprintf (truth, "# end   %-40s %s\n", moves[last_move].what, utc (last_real));
+	    if (p.move >= 0)
+		fprintf (truth, "# start %-40s %s\n", moves[p.move].what, utc (last_real));
+	}
+	last_move = p.move;
+	if (p.move < 0)
+	    break;
+	if (truth != NULL)
+	    fprintf (truth, "%.3f %.4f %.4f %.4f %.4f\n", 1e-9 * last_real,
+		     wrap_az (p.az), p.el, p.vel_az, p.vel_el);
+
+	if (network)
+	{
+	    encode_network (&netmsg, &p, last_real + (int64_t)(1e9 * skew));
+	    if (sendto (net_fd, &netmsg, sizeof (netmsg), 0,
+			(struct sockaddr *)&addr, sizeof (addr)) != sizeof (netmsg))
+		dropped++;
+	}
+	if (serial)
+	{
+	    if (k == 0 && write (ser_fd, footer, FOOTER_LENGTH) != FOOTER_LENGTH)
+		dropped++;
+	    encode_serial (sermsg, &p, last_real + (int64_t)(1e9 * skew));
+	    if (write (ser_fd, sermsg, sizeof (sermsg)) != sizeof (sermsg))
+		dropped++;
+	}
+	sent++;
+
+	if (verbose)
+	    printf ("%s az %8.3f el %7.3f  %-40s\n", utc (last_real),
+		    wrap_az (p.az), p.el, moves[p.move].what);
+    }
+
+    if (truth != NULL)
+    {
+	if (last_move >= 0)
+	    fprintf (truth, "# end   %-40s %s stopped\n", moves[last_move].what, utc (last_real));
+	fclose (truth);
+    }
+    printf ("%lu messages, %lu not sent\n", sent, dropped);
+    if (link_path != NULL)
+	unlink (link_path);
+    if (ser_fd >= 0)
+	close (ser_fd);
+    if (net_fd >= 0)
+	close (net_fd);
+    return 0;
+}
@@ -0,0 +1,585 @@
+/*****************************************************************
+ * radar-galileo-bench.c
+ * ---------------------------------------------------------------
+ * Micro-benchmarks of the processing kernels of radar-galileo-rec
+ * on synthetic data at the sizes used on the radar: 350 gates and
+ * spectra of 64 to 1024 points.
+ *
+ * Every kernel is called in batches until -time seconds have
+ * passed, cycling through the gates of a synthetic ray, and the
+ * best of REPEATS runs is reported as ns per call and gates per
+ * second. The gates of a call are one spectrum for the spectral
+ * kernels, a pulse for RSP_Correlate and a ray for the RNC writer.
+ * RSM_LatestLoad is timed as the main thread reads the latest position
+ * message, with a thread storing at the 20 ms of the messages, and
+ * storing as fast as it can to show the cost of a read that retries.
+ * -json writes the results for regression tracking (make bench).
+ *
+ * The kernel variant is chosen as in the recorder: the widest the
+ * CPU runs, or RSP_KERNELS.
+ *
+ * ---------------------------------------------------------------
+ * REVISION HISTORY
+ * ---------------------------------------------------------------
+ *
+ * 20261019     First version
+ *****************************************************************/
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/utsname.h>
+
+#include <complex.h>
+#include <fftw3.h>
+
+#include <netcdf.h>
+
+#include <radar.h> // Master header file for the Universal Radar Code
+#include <RSP.h>   // Include file for the RSP package
+#include <RNC.h>   // Include file for the RNC package
+#include <RSM.h>   // Include file for the RSM package
+
+#define GATES       350
+#define CODE_BITS   16     /* chips of the pulse code correlated against */
+#define CLUTTER     3      /* bins interpolated over around zero Doppler */
+#define REPEATS     5
+#define MAX_RESULTS 128
+#define RNC_RAYS    200    /* rays written per run, to bound the file size */
+
+typedef struct Result_st
+{
+    const char * name;
+    int          nfft;
+    int          gates;        /* gates per call */
+    long         calls;
+    double       ns_per_call;
+} Result_st;
+
+/* the synthetic ray, for one nfft */
+typedef struct Bench_st
+{
+    RSP_ParamStruct   param;
+    int               nfft;
+    fftw_complex *    iq;      /* GATES x nfft time series */
+    fftw_complex *    in;      /* FFT buffer, as in the recorder */
+    fftw_plan         plan;
+    float *           psd;     /* GATES x nfft spectra */
+    RSP_ComplexType * iq_rsp;  /* the time series for RSP_CalcPhase */
+    RSP_PeakStruct *  peaks;   /* the peak of every spectrum */
+    float *           noise;   /* noise level of every spectrum */
+    float             phi[GATES], sdphi[GATES];
+    uint16_t          pulse[GATES + CODE_BITS - 1];
+    short             code[CODE_BITS];
+    long int          corr[GATES];
+    float             moments[3];
+
+    /* RNC writer */
+    int                   ncid;
+    RSP_ObservablesStruct obs;
+} Bench_st;
+
+typedef void (*Kernel_fn) (Bench_st * b, long n);
+
+static Result_st    results[MAX_RESULTS];
+static int          nresults  = 0;
+static double       min_time  = 0.1;
+static const char * filter    = NULL;
+static volatile float sink;
+
+/* position message cell, with a writer that stores az == el */
+static RSM_LatestStruct latest;
+static volatile int     writer_stop;
+static long             torn;
+
+
+static double
+now (void)
+{
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+/* normally distributed random number */
+static double
+gauss (void)
+{
+    double u = (rand () + 1.0) / (RAND_MAX + 2.0);
+    double v = rand () / (RAND_MAX + 1.0);
+
+    return sqrt (-2.0 * log (u)) * cos (2.0 * M_PI * v);
+}
+
+/*--------------------------------------------------------------------*
+ * The kernels, called on gate n % GATES                              *
+ *--------------------------------------------------------------------*/
+static void
+bench_calc_psd (Bench_st * b, long n)
+{
+    const int g = n % GATES;
+
+    /* the recorder fills the FFT buffer from the demultiplexed samples */
+    memcpy (b->in, b->iq + (size_t)g * b->nfft, b->nfft * sizeof (fftw_complex));
+    RSP_CalcPSD_FFTW (b->in, b->nfft, b->plan, b->param.window,
+		      b->psd + (size_t)g * b->nfft, 1.0f / b->param.Wss);
+}
+
+static void
+bench_subtract_offset (Bench_st * b, long n)
+{
+    RSP_SubtractOffset_FFTW (b->iq + (size_t)(n % GATES) * b->nfft, b->nfft);
+}
+
+static void
+bench_find_peaks (Bench_st * b, long n)
+{
+    const int      g = n % GATES;
+    RSP_PeakStruct peak;
+
+    /* one peak, as configured on the radar, leaves the spectrum intact */
+    RSP_FindPeaksMulti_Destructive (b->psd + (size_t)g * b->nfft, b->nfft, 1, b->noise[g], &peak);
+    sink = peak.peakPSD;
+}
+
+static void
+bench_find_edges (Bench_st * b, long n)
+{
+    const int      g    = n % GATES;
+    RSP_PeakStruct peak = b->peaks[g];
+
+    RSP_FindEdges (b->psd + (size_t)g * b->nfft, b->nfft, b->noise[g], &peak);
+    sink = peak.leftBin;
+}
+
+static void
+bench_spec_mom (Bench_st * b, long n)
+{
+    const int g = n % GATES;
+
+    RSP_CalcSpecMom (b->psd + (size_t)g * b->nfft, b->nfft, &b->peaks[g], b->noise[g], b->moments, 3);
+}
+
+static void
+bench_clutter_interp (Bench_st * b, long n)
+{
+    RSP_ClutterInterp (b->psd + (size_t)(n % GATES) * b->nfft, b->nfft, CLUTTER);
+}
+
+static void
+bench_calc_phase (Bench_st * b, long n)
+{
+    const int g = n % GATES;
+
+    RSP_CalcPhase (b->iq_rsp + (size_t)g * b->nfft, &b->phi[g], &b->sdphi[g], b->nfft);
+}
+
+static void
+bench_median (Bench_st * b, long n)
+{
+    sink = RSP_Median (b->psd + (size_t)(n % GATES) * b->nfft, b->nfft);
+}
+
+static void
+bench_correlate (Bench_st * b, long n)
+{
+    RSP_Correlate (b->pulse, b->code, GATES + CODE_BITS - 1, CODE_BITS, b->corr);
+}
+
+static void
+bench_rnc_write (Bench_st * b, long n)
+{
+    RNC_WriteDynamicVariables (b->ncid, &b->param, &b->obs);
+}
+
+static void
+bench_rnc_write_sync (Bench_st * b, long n)
+{
+    int status;
+
+    RNC_WriteDynamicVariables (b->ncid, &b->param, &b->obs);
+    status = nc_sync (b->ncid);
+    if (status != NC_NOERR) check_netcdf_handle_error (status);
+}
+
+static void
+bench_latest_load (Bench_st * b, long n)
+{
+    RSM_PositionMessageStruct msg;
+
+    RSM_LatestLoad (&latest, &msg);
+    if (msg.az != msg.el)
+	torn++;
+    sink = msg.az;
+}
+
+static void *
+latest_writer (void * arg)
+{
+    const long                period_us = *(long *)arg;
+    RSM_PositionMessageStruct msg;
+    long                      n = 0;
+
+    memset (&msg, 0, sizeof (msg));
+    while (!writer_stop)
+    {
+	msg.az = msg.el = (double)n++;
+	RSM_LatestStore (&latest, &msg, 1);
+	if (period_us > 0)
+	    usleep (period_us);
+    }
+    return NULL;
+}
+
+/*--------------------------------------------------------------------*
+ * Time a kernel: batches doubling until min_time, best of REPEATS    *
+ *--------------------------------------------------------------------*/
+static void
+run (const char * name, Kernel_fn fn, Bench_st * b, int gates, long max_calls)
+{
+    Result_st * r;
+    double      best = HUGE_VAL;
+    long        calls = 0;
+    int         rep;
+
+    if (filter != NULL && strstr (name, filter) == NULL)
+	return;
+    if (nresults == MAX_RESULTS)
+	return;
+
+    for (rep = 0; rep < REPEATS; rep++)
+    {
+	long   batch = 1, n = 0, i;
+	double t0    = now (), t = 0.0;
+
+	while (t < min_time && (max_calls == 0 || n < max_calls))
+	{
+	    if (max_calls != 0 && n + batch > max_calls)
+		batch = max_calls - n;
+	    for (i = 0; i < batch; i++)
+		fn (b, n + i);
+	    n += batch;
+	    batch <<= 1;
+	    t = now () - t0;
+	}
+	if (t / n < best)
+	    best = t / n;
+	calls += n;
+    }
+
+    r              = &results[nresults++];
+    r->name        = name;
+    r->nfft        = b->nfft;
+    r->gates       = gates;
+    r->calls       = calls;
+    r->ns_per_call = best * 1e9;
+
+    printf ("%-34s %5d %12.1f %14.4g %10ld\n", name, b->nfft, r->ns_per_call,
+	    gates / best, calls);
+}
+
+/* RSM_LatestLoad while a thread stores every period_us, 0 for flat out */
+static void
+run_latest (const char * name, Bench_st * b, long period_us)
+{
+    pthread_t thread;
+
+    if (filter != NULL && strstr (name, filter) == NULL)
+	return;
+    writer_stop = 0;
+    if (pthread_create (&thread, NULL, latest_writer, &period_us) != 0)
+    {
+	printf ("Could not start the %s writer\n", name);
+	return;
+    }
+    run (name, bench_latest_load, b, 1, 0);
+    writer_stop = 1;
+    pthread_join (thread, NULL);
+}
+
+/*--------------------------------------------------------------------*
+ * Synthetic ray: a Doppler line in noise at every fourth gate and    *
+ * noise alone at the others, and a pulse of ADC samples             *
+ *--------------------------------------------------------------------*/
+static int
+setup (Bench_st * b, int nfft)
+{
+    int g, k;
+
+    memset (b, 0, sizeof (*b));
+    b->nfft = nfft;
+
+    b->param.frequency                  = 94.0;
+    b->param.prf                        = 6250.0;
+    b->param.pulse_period               = 200.0;
+    b->param.pulses_per_daq_cycle       = nfft;
+    b->param.samples_per_pulse          = GATES;
+    b->param.clock_divfactor            = 2;
+    b->param.clock                      = 50e6;
+    b->param.pulses_coherently_averaged = 1;
+    b->param.spectra_averaged           = 1;
+    b->param.moments_averaged           = 1;
+    b->param.code_length                = 1;
+    b->param.number_of_codes            = 1;
+    b->param.num_interleave             = 1;
+    b->param.num_tx_pol                 = 1;
+    b->param.num_peaks                  = 1;
+    RSP_InitialiseParams (&b->param);
+
+    b->iq     = fftw_malloc ((size_t)GATES * nfft * sizeof (fftw_complex));
+    b->in     = fftw_malloc (nfft * sizeof (fftw_complex));
+    b->psd    = malloc ((size_t)GATES * nfft * sizeof (float));
+    b->iq_rsp = malloc ((size_t)GATES * nfft * sizeof (RSP_ComplexType));
+    b->peaks  = calloc (GATES, sizeof (RSP_PeakStruct));
+    b->noise  = malloc (GATES * sizeof (float));
+    if (b->iq == NULL || b->in == NULL || b->psd == NULL || b->iq_rsp == NULL ||
+	b->peaks == NULL || b->noise == NULL)
+	return -1;
+    b->plan = fftw_plan_dft_1d (nfft, b->in, b->in, FFTW_FORWARD, FFTW_ESTIMATE);
+
+    for (g = 0; g < GATES; g++)
+    {
+	const double amplitude = (g % 4 == 0) ? 10.0 : 0.0;
+	const double doppler   = 2.0 * M_PI * (0.05 + 0.4 * g / GATES);
+
+	for (k = 0; k < nfft; k++)
+	{
+	    const size_t i = (size_t)g * nfft + k;
+
+	    b->iq[i] = 2048.0 + amplitude * cexp (I * doppler * k) + gauss () + I * gauss ();
+	    b->iq_rsp[i].real = creal (b->iq[i]);
+	    b->iq_rsp[i].imag = cimag (b->iq[i]);
+	}
+	RSP_SubtractOffset_FFTW (b->iq + (size_t)g * nfft, nfft);
+	bench_calc_psd (b, g);
+	b->noise[g] = RSP_Median (b->psd + (size_t)g * nfft, nfft);
+	RSP_FindPeaksMulti_Destructive (b->psd + (size_t)g * nfft, nfft, 1, b->noise[g], &b->peaks[g]);
+    }
+
+    for (k = 0; k < GATES + CODE_BITS - 1; k++)
+	b->pulse[k] = 2048 + (int)(100.0 * gauss ());
+    for (k = 0; k < CODE_BITS; k++)
+	b->code[k] = (rand () & 1) ? 1 : -1;
+    return 0;
+}
+
+static void
+cleanup (Bench_st * b)
+{
+    fftw_destroy_plan (b->plan);
+    fftw_free (b->iq);
+    fftw_free (b->in);
+    free (b->psd);
+    free (b->iq_rsp);
+    free (b->peaks);
+    free (b->noise);
+    RSP_FreeMemory (&b->param);
+}
+
+/*--------------------------------------------------------------------*
+ * A moments file with the observables of the recorder, in a         *
+ * temporary data tree                                               *
+ *--------------------------------------------------------------------*/
+static const char * const observables[] =
+{
+    "ZED_HC", "SNR_HC", "POW_H", "POW_HX", "POW_V", "POW_VX", "ZED_VC",
+    "SNR_VC", "VEL_HC", "VEL_VC", "SPW_HC", "SPW_VC", "SNR_XHC", "ZED_XHC",
+    "SNR_XVC", "ZED_XVC", "LDR_HC", "LDR_VC", "NPC_H", "NPC_V", "VEL_VD",
+    "VEL_FD", "PHIDP_FD", "PHIDP_VD", "ZDR_C", "RHO_FD", "RHO_VD",
+    "RHO_FDS", "RHO_VDS"
+};
+
+static int
+setup_rnc (Bench_st * b, char * dir, URC_ScanStruct * scan)
+{
+    RNC_DimensionStruct dimensions;
+    int                 i, g, status;
+
+    if (mkdtemp (dir) == NULL)
+	return -1;
+    strcat (dir, "/");
+    RNC_SetDataPath (dir);
+
+    if (RSP_ObsInit (&b->obs, GATES) != 0)
+	return -1;
+    for (i = 0; i < (int)(sizeof (observables) / sizeof (observables[0])); i++)
+    {
+	float * data = RSP_ObsNew (&b->obs, observables[i], GATES, 1);
+
+	if (data == NULL)
+	    return -1;
+	for (g = 0; g < GATES; g++)
+	    data[g] = gauss ();
+    }
+
+    memset (scan, 0, sizeof (*scan));
+    strcpy (scan->date, "20261019000000");
+    b->ncid = RNC_OpenNetcdfFile ("radar-galileo", "raw", scan->date, NULL,
+				  "bench", NULL, "raw");
+    RNC_SetupDimensions (b->ncid, &b->param, &dimensions);
+    RNC_SetupDynamicVariables (b->ncid, GALILEO, scan, &b->param, &dimensions, &b->obs);
+    status = nc_enddef (b->ncid);
+    if (status != NC_NOERR) check_netcdf_handle_error (status);
+    return 0;
+}
+
+static void
+cleanup_rnc (Bench_st * b, const char * dir)
+{
+    char command[256];
+
+    nc_close (b->ncid);
+    RSP_ObsFree (&b->obs);
+    snprintf (command, sizeof (command), "rm -rf '%s'", dir);
+    if (system (command) != 0)
+	printf ("Could not remove %s\n", dir);
+}
+
+static int
+write_json (const char * filename, const char * kernels)
+{
+    struct utsname host;
+    FILE *         fp;
+    int            i;
+
+    fp = fopen (filename, "w");
+    if (fp == NULL)
+    {
+	printf ("Cannot open %s: %m\n", filename);
+	return -1;
+    }
+    uname (&host);
+    fprintf (fp, "{\n  \"host\": \"%s\",\n  \"machine\": \"%s\",\n", host.nodename, host.machine);
+    fprintf (fp, "  \"kernels\": \"%s\",\n  \"gates\": %d,\n  \"min_time\": %g,\n",
+	     kernels, GATES, min_time);
+    fprintf (fp, "  \"results\": [\n");
+    for (i = 0; i < nresults; i++)
+    {
+	const Result_st * r = &results[i];
+
+	fprintf (fp, "    {\"name\": \"%s\", \"nfft\": %d, \"gates_per_call\": %d, "
+		 "\"calls\": %ld, \"ns_per_call\": %.2f, \"gates_per_s\": %.6g}%s\n",
+		 r->name, r->nfft, r->gates, r->calls, r->ns_per_call,
+		 r->gates * 1e9 / r->ns_per_call, (i + 1 < nresults) ? "," : "");
+    }
+    fprintf (fp, "  ]\n}\n");
+    return fclose (fp);
+}
+
+static inline void
+disp_help (const char * prog)
+{
+    const char * pt = strrchr (prog, '/');
+
+    if (pt++ != NULL)
+	prog = pt;
+
+    printf ("Usage: %s [options]\n\n", prog);
+    printf ("Options:\n");
+    printf ("--------\n");
+    printf (" -json filename        Write the results as JSON\n");
+    printf (" -time <s>             Time each kernel for at least s seconds (default %g)\n", min_time);
+    printf (" -nfft <n>             Only spectra of n points (default 64 to 1024)\n");
+    printf (" -filter <name>        Only kernels whose name contains name\n");
+    printf ("\n");
+}
+
+int
+main (int argc, char * argv[])
+{
+    static const int sizes[] = { 64, 128, 256, 512, 1024 };
+    const char *     json = NULL;
+    const char *     kernels;
+    char             dir[] = "/tmp/radar-galileo-bench.XXXXXX";
+    URC_ScanStruct   scan;
+    Bench_st *       b;
+    int              only_nfft = 0;
+    int              i;
+
+    for (i = 1; i < argc; i++)
+    {
+	if (!strcmp (argv[i], "-json") && i + 1 < argc)
+	    json = argv[++i];
+	else if (!strcmp (argv[i], "-time") && i + 1 < argc)
+	    min_time = atof (argv[++i]);
+	else if (!strcmp (argv[i], "-nfft") && i + 1 < argc)
+	    only_nfft = atoi (argv[++i]);
+	else if (!strcmp (argv[i], "-filter") && i + 1 < argc)
+	    filter = argv[++i];
+	else
+	{
+	    disp_help (argv[0]);
+	    return 1;
+	}
+    }
+
+    b = malloc (sizeof (Bench_st));
+    if (b == NULL)
+    {
+	printf ("Memory allocation error: %m\n");
+	return 3;
+    }
+    srand (1);
+    kernels = RSP_SelectKernels (getenv ("RSP_KERNELS"));
+    printf ("RSP kernels: %s, %d gates\n\n", kernels, GATES);
+    printf ("%-34s %5s %12s %14s %10s\n", "kernel", "nfft", "ns/call", "gates/s", "calls");
+
+    for (i = 0; i < (int)(sizeof (sizes) / sizeof (sizes[0])); i++)
+    {
+	if (only_nfft != 0 && sizes[i] != only_nfft)
+	    continue;
+	if (setup (b, sizes[i]) != 0)
+	{
+	    printf ("Memory allocation error: %m\n");
+	    return 3;
+	}
+	run ("RSP_CalcPSD_FFTW",               bench_calc_psd,        b, 1, 0);
+	run ("RSP_SubtractOffset_FFTW",        bench_subtract_offset, b, 1, 0);
+	run ("RSP_FindPeaksMulti_Destructive", bench_find_peaks,      b, 1, 0);
+	run ("RSP_FindEdges",                  bench_find_edges,      b, 1, 0);
+	run ("RSP_CalcSpecMom",                bench_spec_mom,        b, 1, 0);
+	run ("RSP_ClutterInterp",              bench_clutter_interp,  b, 1, 0);
+	run ("RSP_CalcPhase",                  bench_calc_phase,      b, 1, 0);
+	run ("RSP_Median",                     bench_median,          b, 1, 0);
+	cleanup (b);
+    }
+
+    /* kernels that do not depend on nfft */
+    if (setup (b, 256) != 0)
+    {
+	printf ("Memory allocation error: %m\n");
+	return 3;
+    }
+    b->nfft = 0;
+    run ("RSP_Correlate", bench_correlate, b, GATES, 0);
+    run_latest ("RSM_LatestLoad",             b, 20000);
+    run_latest ("RSM_LatestLoad+busy writer", b, 0);
+    if (torn != 0)
+    {
+	printf ("RSM_LatestLoad returned %ld torn messages\n", torn);
+	return 1;
+    }
+    if (filter == NULL || strstr ("RNC_WriteDynamicVariables", filter) != NULL)
+    {
+	if (setup_rnc (b, dir, &scan) != 0)
+	{
+	    printf ("Could not set up the RNC benchmark\n");
+	    return 3;
+	}
+	run ("RNC_WriteDynamicVariables",         bench_rnc_write,      b, GATES, RNC_RAYS);
+	run ("RNC_WriteDynamicVariables+nc_sync", bench_rnc_write_sync, b, GATES, RNC_RAYS);
+	cleanup_rnc (b, dir);
+    }
+    cleanup (b);
+    free (b);
+
+    if (json != NULL && write_json (json, kernels) != 0)
+	return 1;
+    return 0;
+}
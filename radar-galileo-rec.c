@@ -56,8 +56,9 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <signal.h>
+#include <errno.h>
+#include <pthread.h>
 
-#include "median.h"
 #include <complex.h>
 //#define FFTW_NO_Complex
 #include <fftw3.h>
@@ -71,6 +72,11 @@
 #include <stdint.h>
 #include <sys/ioctl.h>
 
+/* -daemon control socket */
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
 #include "ixpio.h"
 
 char *device = "/dev/ixpio1";
@@ -84,6 +90,9 @@ char *device = "/dev/ixpio1";
 #include <RNC.h>   // Include file for the RNC package
 #include <RSM.h>   // Include file for the RSM package
 #include <RTS.h>   // Include file for the RTS package
+#include <RST.h>   // Include file for the RST package
+#include <RLG.h>   // Include file for the RLG package
+#include <RRT.h>   // Include file for the RRT package
 
 /* header file */
 #include "radar-galileo-rec.h"
@@ -121,6 +130,18 @@ typedef struct TimeSeriesObs_st
     uint16_t * RawLog;
 } TimeSeriesObs_t;
 
+/* A WIVERN mode: what is written to DIO bank C to select it, and how its
+ * banks are processed. Worked out for mode0 and mode1 before the ray loop,
+ * so that alternating between them recomputes nothing. */
+typedef struct
+{
+    uint8_t dio;          /* bank C value */
+    int     mode;         /* PulseMode_en */
+    int     num_tx_pol;
+    int     gate_offset;  /* mode_gate_offset */
+    int     v_delay;      /* mode_v_delay: gates from the H to the V echoes */
+} ModeSetup_t;
+
 /* function prototype declaration */
 static void sig_handler (int sig);
 static void SetupTimeSeriesVariables (TimeSeriesObs_t *          obs,
@@ -160,6 +181,95 @@ static bool     TextTimeSeries   = false;
 /* Disable position message for fixed position operation */
 static bool positionMessageAct = false;	// default is OFF
 
+/* Acquisition backend (see RDQ.h), the AMCC card unless -daq is given */
+static const char * daq_name   = NULL;
+static const char * daq_source = NULL;
+
+/* Offline reprocessing of a time series file (-offline, -records) */
+static bool offline        = false;
+static int  replay_first   = 0;
+static int  replay_records = 0;
+
+/*------------------------------------------------------------------------*
+ * -daemon: the recorder stays up between scans, with the acquisition,    *
+ * buffers and FFT plan set up once, and records the scans it is sent as  *
+ * commands on a local datagram socket (see control_poll).                *
+ *------------------------------------------------------------------------*/
+static const char * control_path = NULL;
+static int          control_fd   = -1;
+static char         control_line[1024];        /* command waiting, "" if none */
+static char         control_state[160] = "idle";
+
+/* Configuration, calibration and output locations */
+static const char * config_file = CONFIG_FILE;
+static const char * cal_file    = CAL_FILE;
+static char         data_path[256];
+
+/* Log messages of the ray loop (see RLG.h), stdout unless log_file is set */
+static char log_file[256];
+static int  log_level = RLG_INFO;
+static int  log_rate  = RLG_RATE;
+
+/* Cores, priority and memory of the ray loop (see RRT.h), from the rt- keys */
+static RRT_ConfigStruct rt_config = RRT_CONFIG_NONE;
+static RRT_ReportStruct rt_report;
+
+/*------------------------------------------------------------------------*
+ * The working buffers of a run, in one prefaulted mapping (see RRT.h).   *
+ * run_arena_size lists them in the groups main () carves them in, so    *
+ * the two must be changed together.                                      *
+ *------------------------------------------------------------------------*/
+static RRT_ArenaStruct run_arena;
+
+#define ARENA(n, type) RRT_ArenaAlloc (&run_arena, (n), sizeof (type))
+
+static size_t
+run_arena_size (const RSP_ParamStruct * param)
+{
+    const size_t gates = param->samples_per_pulse;
+    const size_t bank  = (size_t)param->pulses_per_daq_cycle * gates;
+    const size_t ray   = gates * param->nfft * param->num_tx_pol * param->spectra_averaged;
+
+    return 8 * RRT_ARENA_BYTES (bank, sizeof (uint16_t))                              // bank streams
+	 + 4 * RRT_ARENA_BYTES (bank, sizeof (float))                                 // echoes
+	 + 4 * RRT_ARENA_BYTES (ray, sizeof (uint16_t))                               // IQStruct
+	 +     RRT_ARENA_BYTES (8 * bank * param->spectra_averaged, sizeof (uint16_t)) // tsobs
+	 +     RRT_ARENA_BYTES (param->nfft, sizeof (fftw_complex))                    // FFT
+	 + 6 * RRT_ARENA_BYTES (param->nfft, sizeof (fftw_complex))                    // pulse pairs
+	 +     RRT_ARENA_BYTES (param->npsd, sizeof (float))
+	 +     RRT_ARENA_BYTES (gates, sizeof (PolPSDStruct))                          // spectra
+	 + 4 * RRT_ARENA_BYTES (gates * param->npsd, sizeof (float))
+	 + 37 * RRT_ARENA_BYTES (gates, sizeof (float))                                // gate sums
+	 + 4 * RRT_ARENA_BYTES (param->num_peaks, sizeof (RSP_PeakStruct));           // peaks
+}
+
+/*-----------------------------------------------------------*
+ * Stages of the ray loop, timed per ray (see RST.h). The    *
+ * histograms go to the stats file every timing_interval s,  *
+ * on SIGUSR1 and at exit.                                   *
+ *-----------------------------------------------------------*/
+enum
+{
+    ST_SETUP, ST_WAIT_BANK, ST_RETRIGGER, ST_POSITION, ST_DEMUX,
+    ST_PULSE_COMPRESS, ST_PULSE_PAIR, ST_COHERENT, ST_FFT, ST_TS_WRITE,
+    ST_SPECTRA_WRITE, ST_NOISE, ST_MOMENTS, ST_FINALISE, ST_NC_WRITE,
+    ST_NC_SYNC, ST_OTHER, N_STAGES
+};
+
+#ifndef RST_NO_TIMING
+static const char * const stage_names[N_STAGES] =
+{
+    "setup", "wait_bank", "retrigger", "position", "demux",
+    "pulse_compress", "pulse_pair", "coherent", "fft", "ts_write",
+    "spectra_write", "noise", "moments", "finalise", "nc_write",
+    "nc_sync", "other"
+};
+
+static RST_TimingStruct timing;
+static char             timing_file[512];
+static int              timing_interval = 60;
+#endif /* RST_NO_TIMING */
+
 // Displays a welcome message with version information
 static inline void
 disp_welcome_message (void)
@@ -181,6 +291,69 @@ sig_handler (int sig)
 }
 
 
+/* Banks waited for, and those that missed their deadline or failed, */
+/* over the whole run                                                */
+static unsigned long banks_waited;
+static unsigned long banks_missed;
+static unsigned long bank_errors[RSP_DAQ_ERRORS];
+
+/* Add a completed bank to the acquisition quality of the ray */
+static void
+note_bank (RSP_ObservablesStruct *    obs,
+	   const RDQ_BankInfoStruct * info)
+{
+    banks_waited++;
+    if (info->slack < obs->min_slack)
+	obs->min_slack = info->slack;
+    if (info->slack < 0.0)
+    {
+	RLG_LOG (RLG_WARN, "Processing overran the bank deadline by %.1f ms\n", -1e3 * info->slack);
+	obs->missed_deadlines++;
+	banks_missed++;
+    }
+    if (info->status >= RDQ_STATUS_DMA_TIMEOUT && info->status <= RDQ_STATUS_HV_TIMEOUT)
+    {
+	obs->daq_errors[info->status - RDQ_STATUS_DMA_TIMEOUT]++;
+	bank_errors[info->status - RDQ_STATUS_DMA_TIMEOUT]++;
+    }
+}
+
+/* How late the retrigger woke up after its target, in ns */
+static RST_HistStruct retrigger_jitter;
+
+/*------------------------------------------------------------------------*
+ * Wait until just before the next H pulse to retrigger the card. The    *
+ * pulse train runs on from the completion of the bank with a period of  *
+ * two PRTs, so sleep to delay_us after the completion on an absolute    *
+ * deadline: a relative sleep would add the time already spent since.    *
+ * If that time has passed, wait for the same point of a later period.   *
+ *------------------------------------------------------------------------*/
+static void
+retrigger_wait (const RDQ_BankInfoStruct * info,
+		long                       delay_us,
+		double                     prt)
+{
+    const int64_t   period = (int64_t)(2.0 * prt * 1e9);
+    struct timespec now, target;
+    int64_t         t, n;
+
+    t = (int64_t)info->completed.tv_sec * 1000000000 + info->completed.tv_nsec
+	+ (int64_t)delay_us * 1000;
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    n = (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+    if (t <= n && period > 0)
+	t += ((n - t) / period + 1) * period;
+
+    target.tv_sec  = t / 1000000000;
+    target.tv_nsec = t % 1000000000;
+    while (clock_nanosleep (CLOCK_MONOTONIC, TIMER_ABSTIME, &target, NULL) == EINTR)
+	;
+
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    n = (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+    RST_Add (&retrigger_jitter, (n > t) ? (uint64_t)(n - t) : 0);
+}
+
 // Displays help on command-line arguments
 static inline void
 disp_help (const char * prog)
@@ -195,7 +368,9 @@ disp_help (const char * prog)
     printf ("--------\n");
     //printf ("\n Configuration options (how to record the data)\n");
     //printf (" ----------------------------------------------\n");
-    //printf (" -config filename      Specify alternative config file\n");
+    printf (" -config filename      Specify alternative config file\n");
+    printf (" -calfile filename     Specify alternative calibration file\n");
+    printf (" -outdir path          Write the data tree under path instead of %s\n", RADAR_DATA_PATH);
     //printf (" -phase                Record absolute phase and std. dev. of phase\n");
     //printf (" -rawzed               Switch off range normalisation and calibration for Z\n");
     //printf (" -spec                 Record power spectra\n");
@@ -212,9 +387,22 @@ disp_help (const char * prog)
     printf (" -nrays_mode1 <rays>   Set number of rays in mode1 for alternating modes\n");
     printf (" -pulses <num>         Set number of pulses per ray: New not implemented yet\n");
     printf (" -cellwidth <range>    Set cell size (m)           : New not implemented yet\n");
-    printf (" -range <min> <max>    Set min/max range (km)\n");
+    printf (" -range <min> <max>    Process only the gates from min to max range (km)\n");
+    printf (" -noise-range <min> <max>\n");
+    printf ("                       Estimate the noise from min to max range (km),\n");
+    printf ("                       within the gates processed\n");
     printf (" -debug                Enable extra output during acquisition\n");
+    printf (" -log <file>           Append log messages to file (- for stdout)\n");
+    printf (" -log-level <level>    Log error, warn, info (default) or debug messages\n");
     printf (" -swap                 Swap Co/Cross I/Q ADC data\n");
+    printf (" -daq <backend>        Acquire from amcc (default), replay or synthetic\n");
+    printf (" -replay <tsfile>      Replay banks from a time series file (-daq replay)\n");
+    printf (" -records <first> <n>  Replay only n records from first (n = 0: to the end)\n");
+    printf (" -offline              Replay once with the recorded times and positions,\n");
+    printf ("                       as fast as possible (see radar-galileo-reprocess)\n");
+    printf (" -daemon <socket>      Stay up and record the scans sent to the socket,\n");
+    printf ("                       the scanning and control block options of each\n");
+    printf ("                       scan as one datagram, or stop, quit or status\n");
     //printf (" -quiet                Do not generate lots of text output\n");
     printf ("\n Scanning options (what scan to expect)\n");
     printf (" --------------------------------------\n");
@@ -240,31 +428,37 @@ disp_help (const char * prog)
     printf ("\n");
 }
 
-static inline int
-parseargs (int               argc,
-	   char *            argv[],
-	   RSP_ParamStruct * param,
-	   URC_ScanStruct *  scan,
-	   int *             start_day)
+/* Where the antenna points when a scan does not say: from the config */
+static struct
+{
+    float elevation;
+    float azimuth;
+} config_pointing;
+
+/*
+ * Defaults of the scan, for the command line and for each command of
+ * -daemon: a fixed dwell by the user running the recorder, dated now,
+ * at the pointing of the config. Every command starts from these, not
+ * from the angles of the scan before, which scan_from_chilbolton has
+ * already turned.
+ */
+static void
+scan_defaults (URC_ScanStruct * scan,
+	       int *            start_day)
 {
-    /* Parse command line args */
-
     time_t       system_time;
     struct tm    tm;
     const char * operator;
-    int          i;
 
-    /*-------------------------------------*
-     * Initialise defaults for scan params *
-     *-------------------------------------*/
     scan->scanType      = SCAN_FIX;
     scan->file_number   = 0;
     scan->scan_number   = 0;
     scan->experiment_id = 0;
     scan->scan_velocity = -9999;
     scan->dwelltime     = -1;
-
-    param->samples_per_pulse_ts = param->samples_per_pulse;
+    scan->min_angle     = config_pointing.elevation;
+    scan->max_angle     = config_pointing.elevation;
+    scan->scan_angle    = config_pointing.azimuth;
 
     operator = getenv ("USER");
     if (operator == NULL) operator = getenv ("USERNAME");
@@ -277,6 +471,339 @@ parseargs (int               argc,
     gmtime_r (&system_time, &tm);
     strftime (scan->date, sizeof (scan->date),"%Y%m%d%H%M%S", &tm);
     *start_day = tm.tm_mday;
+}
+
+/* -------------------------------------------------------------*
+ * This is to remove the effect of Chilbolton azimuths          *
+ * care may have to be taken when the radar is not on the dish  *
+ * since this may cause an error in the metadata                *
+ * -------------------------------------------------------------*/
+static void
+scan_from_chilbolton (URC_ScanStruct * scan)
+{
+    if (scan->scanType == SCAN_PPI)
+    {
+	scan->min_angle -= 90.0;
+	scan->max_angle -= 90.0;
+    }
+    else
+    {
+	scan->scan_angle -= 90.0;
+    }
+}
+
+/* The options of a scan, from the command line or in a command of
+ * -daemon, and the number of arguments of each */
+static const struct
+{
+    const char * name;
+    int          nargs;
+} scan_options[] =
+{
+    { "-ppi",         2 }, { "-rhi",         2 }, { "-csp",        2 },
+    { "-fix",         3 }, { "-single",      2 }, { "-man",        2 },
+    { "-track",       2 }, { "-cal",         2 }, { "-c",          2 },
+    { "-sv",          1 }, { "-file",        1 }, { "-scan",       1 },
+    { "-id",          1 }, { "-scan_angle",  1 }, { "-date",       1 },
+    { "-op",          1 }, { "-long_pulse",  0 }, { "-alt_modes",  0 },
+    { "-mode0",       1 }, { "-mode1",       1 }, { "-nrays_mode0", 1 },
+    { "-nrays_mode1", 1 }
+};
+
+/* The number of arguments of a scan option, -1 if name is not one */
+static int
+scan_option_nargs (const char * name)
+{
+    size_t k;
+
+    for (k = 0; k < sizeof (scan_options) / sizeof (scan_options[0]); k++)
+    {
+	if (!strcmp (name, scan_options[k].name))
+	    return scan_options[k].nargs;
+    }
+    return -1;
+}
+
+/*
+ * Parse the scan option at argv[i].
+ * Returns the index of its last argument, -1 if argv[i] is not a scan
+ * option, or -2 if its arguments are missing.
+ */
+static int
+parse_scan_option (int               argc,
+		   char *            argv[],
+		   int               i,
+		   RSP_ParamStruct * param,
+		   URC_ScanStruct *  scan)
+{
+    const int nargs = scan_option_nargs (argv[i]);
+
+    if (nargs < 0)
+	return -1;
+    if (i + nargs >= argc)
+    {
+	printf ("%s needs %d argument(s)\n", argv[i], nargs);
+	return -2;
+    }
+
+    if (!strcmp (argv[i],"-ppi"))
+    {
+	/* -------- *
+	 * PPI SCAN *
+	 * -------- */
+	scan->min_angle = atof (argv[++i]);
+	scan->max_angle = atof (argv[++i]);
+	printf ("PPI Scan %f-%f deg\n", scan->min_angle, scan->max_angle);
+	scan->scanType = SCAN_PPI;
+    }
+    else if (!strcmp (argv[i],"-rhi"))
+    {
+	/* -------- *
+	 * RHI SCAN *
+	 * -------- */
+	scan->min_angle = atof (argv[++i]);
+	scan->max_angle = atof (argv[++i]);
+	printf ("RHI Scan %f-%f deg\n", scan->min_angle, scan->max_angle);
+	scan->scanType = SCAN_RHI;
+    }
+    else if (!strcmp (argv[i],"-csp"))
+    {
+	/* ---------------- *
+	 * SLANT PLANE SCAN *
+	 * ---------------- */
+	scan->min_angle = atof (argv[++i]);
+	scan->max_angle = atof (argv[++i]);
+	printf ("CSP Scan %f-%f deg\n", scan->min_angle, scan->max_angle);
+	scan->scanType = SCAN_CSP;
+    }
+    else if (!strcmp (argv[i],"-fix"))
+    {
+	/* ----------- *
+	 * FIXED DWELL *
+	 * ----------- */
+	scan->dwelltime  = atof (argv[++i]);
+	scan->scan_angle = atof (argv[++i]);
+	scan->min_angle  = atof (argv[++i]);
+	printf ("Fixed dwell for %f seconds\n", scan->dwelltime);
+	printf ("Position Az: %f, El: %f deg\n",
+		scan->scan_angle, scan->min_angle);
+	scan->scanType      = SCAN_FIX;
+	scan->max_angle     = scan->min_angle;
+	scan->scan_velocity = 0;
+    }
+    else if (!strcmp (argv[i], "-single"))
+    {
+	/* ---------------- *
+	 * FIXED SINGLE RAY *
+	 * ---------------- */
+	scan->scan_angle = atof (argv[++i]);
+	scan->min_angle  = atof (argv[++i]);
+	printf ("Fixed single ray\n");
+	printf ("Position Az: %f, El: %f deg\n", scan->scan_angle, scan->min_angle);
+	scan->scanType      = SCAN_SGL;
+	scan->max_angle     = scan->min_angle; /* Make weird semantics consistant */
+	scan->scan_velocity = 0;
+    }
+    else if (!strcmp (argv[i], "-man"  ) ||
+	     !strcmp (argv[i], "-track"))
+    {
+	/* ------------- *
+	 * TRACKING SCAN *
+	 * ------------- */
+	scan->scan_angle = atof (argv[++i]);
+	scan->min_angle  = atof (argv[++i]);
+	printf ("Track Scan %f-%f deg\n", scan->scan_angle, scan->min_angle);
+	scan->scanType  = SCAN_MAN;
+	scan->max_angle = scan->min_angle; /* Make weird semantics consistant */
+    }
+    else if (!strcmp (argv[i], "-cal") ||
+	     !strcmp (argv[i], "-c"  ))
+    {
+	/* ---------------- *
+	 * CALIBRATION SCAN *
+	 * ---------------- */
+	scan->scan_angle = atof (argv[++i]);
+	scan->min_angle  = atof (argv[++i]);
+	printf ("Calibration Scan %f-%f deg\n", scan->scan_angle, scan->min_angle);
+	scan->scanType  = SCAN_CAL;
+	scan->max_angle = scan->min_angle; /* Make weird semantics consistant */
+    }
+    else if (!strcmp (argv[i],"-sv"))
+    {
+	/* ------------- *
+	 * SCAN VELOCITY *
+	 * ------------- */
+	scan->scan_velocity = atof (argv[++i]);
+    }
+    else if (!strcmp (argv[i],"-file"))
+    {
+	/* ----------- *
+	 * FILE NUMBER *
+	 * ----------- */
+	printf ("%s %s is obsolete\n", argv[i], argv[i+1]);
+	scan->file_number = atoi (argv[++i]);
+	printf ("File number   : %04d\n", scan->file_number);
+    }
+    else if (!strcmp (argv[i],"-scan"))
+    {
+	/* ----------- *
+	 * SCAN NUMBER *
+	 * ----------- */
+	scan->scan_number = atoi (argv[++i]);
+	printf ("Scan number   : %04d\n", scan->scan_number);
+    }
+    else if (!strcmp (argv[i],"-id"))
+    {
+	/* ------------- *
+	 * EXPERIMENT ID *
+	 * ------------- */
+	scan->experiment_id = atoi (argv[++i]);
+	printf ("Experiment id : %d\n", scan->experiment_id);
+    }
+    else if (!strcmp (argv[i],"-scan_angle"))
+    {
+	/* ---------- *
+	 * SCAN ANGLE *
+	 * ---------- */
+	scan->scan_angle = atof (argv[++i]);
+	printf ("Scan angle : %f\n", scan->scan_angle);
+    }
+    else if (!strcmp (argv[i],"-date"))
+    {
+	/* ---- *
+	 * DATE *
+	 * ---- */
+	/* MTF: Fix buffer overrun when date is too big */
+	strncpy (scan->date, argv[++i], sizeof (scan->date) - 1);
+	scan->date[sizeof (scan->date) - 1] = '\0';
+    }
+    else if (!strcmp (argv[i],"-op"))
+    {
+	/* -------- *
+	 * OPERATOR *
+	 * -------- */
+	/* MTF: Fix buffer overrun when operator id is too big */
+	strncpy (scan->operator, argv[++i], sizeof (scan->operator) - 1);
+	scan->operator[sizeof (scan->operator) - 1] = '\0';
+    }
+    else if (!strcmp (argv[i],"-long_pulse"))
+    {
+	/* -------------------- *
+	 * LONG PULSE Selection *
+	 * -------------------- */
+	param->long_pulse_mode = 1; /* Changed to boolena arg */
+    }
+    else if (!strcmp (argv[i],"-alt_modes"))
+    {
+	/* --------------------- *
+	 * ALTERNATE PULSE modes *
+	 * --------------------- */
+	param->alternate_modes = 1; /* Changed to boolena arg */
+    }
+    else if (!strcmp (argv[i],"-mode0"))
+    {
+	/* ----------------- *
+	 * MODE 0 Pulse Mode *
+	 * ----------------- */
+	param->mode0 = atoi (argv[++i]);
+    }
+    else if (!strcmp (argv[i],"-mode1"))
+    {
+	/* ----------------- *
+	 * MODE 1 Pulse Mode *
+	 * ----------------- */
+	param->mode1 = atoi (argv[++i]);
+    }
+    else if (!strcmp (argv[i],"-nrays_mode0"))
+    {
+	/* ---------------------- *
+	 * MODE 0 Pulse Ray count *
+	 * ---------------------- */
+	param->nrays_mode0 = atoi (argv[++i]);
+    }
+    else if (!strcmp (argv[i],"-nrays_mode1"))
+    {
+	/* ---------------------- *
+	 * MODE 1 Pulse Ray count *
+	 * ---------------------- */
+	param->nrays_mode1 = atoi (argv[++i]);
+    }
+
+    return i;
+}
+
+/*--------------------------------------------------------------------*
+ * range_window: process only the gates acquired from scan->min_gate  *
+ * up to scan->max_gate, counted from the transmit pulse; all of      *
+ * them if none are set. The TX monitor channels are taken from the   *
+ * start of the pulse whatever the window.                            *
+ *--------------------------------------------------------------------*/
+static int
+range_window (RSP_ParamStruct * param,
+	      URC_ScanStruct *  scan)
+{
+    const double gate_width = (double)param->clock_divfactor * (SPEED_LIGHT / 2.0) / param->clock;
+    const int    delay      = param->delay_clocks / param->clock_divfactor;
+    int          first, last;
+
+    param->samples_per_pulse_acquired = param->samples_per_pulse;
+    param->first_gate                 = 0;
+    first                             = 0;
+    last                              = param->samples_per_pulse;
+    if (scan->max_gate <= scan->min_gate)
+	goto noise_window;
+
+    first = (scan->min_gate > delay) ? scan->min_gate - delay : 0;
+    last  = scan->max_gate - delay;
+    if (last > param->samples_per_pulse)
+	last = param->samples_per_pulse;
+    if (last - first < NoiseGates)
+    {
+	printf ("The range window must hold at least %d of the %d gates acquired\n",
+		NoiseGates, param->samples_per_pulse);
+	return -1;
+    }
+
+    param->first_gate        = first;
+    param->samples_per_pulse = last - first;
+    scan->min_gate           = first + delay;
+    scan->max_gate           = last + delay;
+    printf ("Range: %8.3f to %8.3f km, gates %d to %d of %d\n",
+	    scan->min_gate * gate_width / 1000.0,
+	    scan->max_gate * gate_width / 1000.0,
+	    first, last - 1, param->samples_per_pulse_acquired);
+
+noise_window:
+    /* the configured noise gates are counted from the first acquired */
+    if (param->noise_gate_start >= 0 &&
+	(param->noise_gate_start < first || param->noise_gate_end >= last ||
+	 param->noise_gate_end < param->noise_gate_start))
+    {
+	printf ("Noise gates %d to %d not processed: the last %d are used\n",
+		param->noise_gate_start, param->noise_gate_end, NoiseGates);
+	param->noise_gate_start = -1;
+	param->noise_gate_end   = -1;
+    }
+    return 0;
+}
+
+static inline int
+parseargs (int               argc,
+	   char *            argv[],
+	   RSP_ParamStruct * param,
+	   URC_ScanStruct *  scan,
+	   int *             start_day)
+{
+    /* Parse command line args */
+
+    int i, next;
+
+    /*-------------------------------------*
+     * Initialise defaults for scan params *
+     *-------------------------------------*/
+    scan_defaults (scan, start_day);
+
+    param->samples_per_pulse_ts = param->samples_per_pulse;
 
     /* by default real_time_spectra_display is off */
     param->real_time_spectra_display = 0;
@@ -286,7 +813,14 @@ parseargs (int               argc,
      *--------------------------------------*/
     for (i = 1; i < argc; i++)
     {
-	if (!strcmp (argv[i],"-real_time_spectra_display"))
+	/* the options of the scan, shared with the commands of -daemon */
+	if ((next = parse_scan_option (argc, argv, i, param, scan)) != -1)
+	{
+	    if (next < 0)
+		return -1;
+	    i = next;
+	}
+	else if (!strcmp (argv[i],"-real_time_spectra_display"))
 	{
 #ifdef HAVE_DISLIN
 	    printf ("Real time spectra display enabled\n");
@@ -295,88 +829,6 @@ parseargs (int               argc,
 	    printf ("Real time spectra display not available\n");
 #endif /* HAVE_DISLIN */
 	}
-	else if (!strcmp (argv[i],"-ppi"))
-	{
-	    /* -------- *
-	     * PPI SCAN *
-	     * -------- */
-	    scan->min_angle = atof (argv[++i]);
-	    scan->max_angle = atof (argv[++i]);
-	    printf ("PPI Scan %f-%f deg\n", scan->min_angle, scan->max_angle);
-	    scan->scanType = SCAN_PPI;
-	}
-	else if (!strcmp (argv[i],"-rhi"))
-	{
-	    /* -------- *
-	     * RHI SCAN *
-	     * -------- */
-	    scan->min_angle = atof (argv[++i]);
-	    scan->max_angle = atof (argv[++i]);
-	    printf ("RHI Scan %f-%f deg\n", scan->min_angle, scan->max_angle);
-	    scan->scanType = SCAN_RHI;
-	}
-	else if (!strcmp (argv[i],"-csp"))
-	{
-	    /* ---------------- *
-	     * SLANT PLANE SCAN *
-	     * ---------------- */
-	    scan->min_angle = atof (argv[++i]);
-	    scan->max_angle = atof (argv[++i]);
-	    printf ("CSP Scan %f-%f deg\n", scan->min_angle, scan->max_angle);
-	    scan->scanType = SCAN_CSP;
-	}
-	else if (!strcmp (argv[i],"-fix"))
-	{
-	    /* ----------- *
-	     * FIXED DWELL *
-	     * ----------- */
-	    scan->dwelltime  = atof (argv[++i]);
-	    scan->scan_angle = atof (argv[++i]);
-	    scan->min_angle  = atof (argv[++i]);
-	    printf ("Fixed dwell for %f seconds\n", scan->dwelltime);
-	    printf ("Position Az: %f, El: %f deg\n",
-		    scan->scan_angle, scan->min_angle);
-	    scan->scanType      = SCAN_FIX;
-	    scan->max_angle     = scan->min_angle;
-	    scan->scan_velocity = 0;
-	}
-	else if (!strcmp (argv[i], "-single"))
-	{
-	    /* ---------------- *
-	     * FIXED SINGLE RAY *
-	     * ---------------- */
-	    scan->scan_angle = atof (argv[++i]);
-	    scan->min_angle  = atof (argv[++i]);
-	    printf ("Fixed single ray\n");
-	    printf ("Position Az: %f, El: %f deg\n", scan->scan_angle, scan->min_angle);
-	    scan->scanType      = SCAN_SGL;
-	    scan->max_angle     = scan->min_angle; /* Make weird semantics consistant */
-	    scan->scan_velocity = 0;
-	}
-	else if (!strcmp (argv[i], "-man"  ) ||
-		 !strcmp (argv[i], "-track"))
-	{
-	    /* ------------- *
-	     * TRACKING SCAN *
-	     * ------------- */
-	    scan->scan_angle = atof (argv[++i]);
-	    scan->min_angle  = atof (argv[++i]);
-	    printf ("Track Scan %f-%f deg\n", scan->scan_angle, scan->min_angle);
-	    scan->scanType  = SCAN_MAN;
-	    scan->max_angle = scan->min_angle; /* Make weird semantics consistant */
-	}
-	else if (!strcmp (argv[i], "-cal") ||
-		 !strcmp (argv[i], "-c"  ))
-	{
-	    /* ---------------- *
-	     * CALIBRATION SCAN *
-	     * ---------------- */
-	    scan->scan_angle = atof (argv[++i]);
-	    scan->min_angle  = atof (argv[++i]);
-	    printf ("Calibration Scan %f-%f deg\n", scan->scan_angle, scan->min_angle);
-	    scan->scanType  = SCAN_CAL;
-	    scan->max_angle = scan->min_angle; /* Make weird semantics consistant */
-	}
 	else if (!strcmp (argv[i],"-position-msg"))
 	{
 	    /* ---------------------------- *
@@ -385,119 +837,89 @@ parseargs (int               argc,
 	    positionMessageAct = true;
 	    printf ("25m Antenna position message enabled\n");
 	}
-	else if (!strcmp (argv[i],"-sv"))
-	{
-	    /* ------------- *
-	     * SCAN VELOCITY *
-	     * ------------- */
-	    scan->scan_velocity = atof (argv[++i]);
-	}
-	else if (!strcmp (argv[i],"-file"))
-	{
-	    /* ----------- *
-	     * FILE NUMBER *
-	     * ----------- */
-	    printf ("%s %s is obsolete\n", argv[i], argv[i+1]);
-	    scan->file_number = atoi (argv[++i]);
-	    printf ("File number   : %04d\n", scan->file_number);
-	}
-	else if (!strcmp (argv[i],"-scan"))
+	else if (!strcmp (argv[i],"-debug"))
 	{
-	    /* ----------- *
-	     * SCAN NUMBER *
-	     * ----------- */
-	    scan->scan_number = atoi (argv[++i]);
-	    printf ("Scan number   : %04d\n", scan->scan_number);
+	    /* ---------------------------- *
+	     * Output Debugging information *
+	     * ---------------------------- */
+	    debug     = true;
+	    log_level = RLG_DEBUG;
 	}
-	else if (!strcmp (argv[i],"-id"))
+	else if (!strcmp (argv[i],"-log"))
 	{
-	    /* ------------- *
-	     * EXPERIMENT ID *
-	     * ------------- */
-	    scan->experiment_id = atoi (argv[++i]);
-	    printf ("Experiment id : %d\n", scan->experiment_id);
+	    snprintf (log_file, sizeof (log_file), "%s", argv[++i]);
 	}
-	else if (!strcmp (argv[i],"-scan_angle"))
+	else if (!strcmp (argv[i],"-log-level"))
 	{
-	    /* ---------- *
-	     * SCAN ANGLE *
-	     * ---------- */
-	    scan->scan_angle = atof (argv[++i]);
-	    printf ("Scan angle : %f\n", scan->scan_angle);
+	    log_level = RLG_ParseLevel (argv[++i]);
+	    if (log_level < 0)
+	    {
+		printf ("Unknown log level %s\n", argv[i]);
+		return 1;
+	    }
 	}
-	else if (!strcmp (argv[i],"-date"))
+	else if (!strcmp (argv[i],"-swap"))
 	{
-	    /* ---- *
-	     * DATE *
-	     * ---- */
-	    /* MTF: Fix buffer overrun when date is too big */
-	    strncpy (scan->date, argv[++i], sizeof (scan->date) - 1);
-	    scan->date[sizeof (scan->date) - 1] = '\0';
+	    /* ---------------------------------- *
+	     * Swap Co/Cross polar ADC I/Q inputs *
+	     * ---------------------------------- */
+	    swap_iq_channels = true;
 	}
-	else if (!strcmp (argv[i],"-op"))
+	else if (!strcmp (argv[i],"-daq"))
 	{
-	    /* -------- *
-	     * OPERATOR *
-	     * -------- */
-	    /* MTF: Fix buffer overrun when operator id is too big */
-	    strncpy (scan->operator, argv[++i], sizeof (scan->operator) - 1);
-	    scan->operator[sizeof (scan->operator) - 1] = '\0';
+	    /* ------------------- *
+	     * ACQUISITION BACKEND *
+	     * ------------------- */
+	    daq_name = argv[++i];
 	}
-	else if (!strcmp (argv[i],"-long_pulse"))
+	else if (!strcmp (argv[i],"-replay"))
 	{
-	    /* -------------------- *
-	     * LONG PULSE Selection *
-	     * -------------------- */
-	    param->long_pulse_mode = 1; /* Changed to boolena arg */
+	    /* ------------------------ *
+	     * REPLAY TIME SERIES FILE  *
+	     * ------------------------ */
+	    daq_name   = "replay";
+	    daq_source = argv[++i];
 	}
-	else if (!strcmp (argv[i],"-alt_modes"))
+	else if (!strcmp (argv[i],"-records"))
 	{
 	    /* --------------------- *
-	     * ALTERNATE PULSE modes *
+	     * REPLAY RECORD RANGE   *
 	     * --------------------- */
-	    param->alternate_modes = 1; /* Changed to boolena arg */
-	}
-	else if (!strcmp (argv[i],"-mode0"))
-	{
-	    /* ----------------- *
-	     * MODE 0 Pulse Mode *
-	     * ----------------- */
-	    param->mode0 = atoi (argv[++i]);
+	    replay_first   = atoi (argv[++i]);
+	    replay_records = atoi (argv[++i]);
 	}
-	else if (!strcmp (argv[i],"-mode1"))
+	else if (!strcmp (argv[i],"-offline"))
 	{
-	    /* ----------------- *
-	     * MODE 1 Pulse Mode *
-	     * ----------------- */
-	    param->mode1 = atoi (argv[++i]);
+	    /* ----------------------- *
+	     * OFFLINE REPROCESSING    *
+	     * ----------------------- */
+	    offline = true;
 	}
-	else if (!strcmp (argv[i],"-nrays_mode0"))
+	else if (!strcmp (argv[i],"-daemon"))
 	{
-	    /* ---------------------- *
-	     * MODE 0 Pulse Ray count *
-	     * ---------------------- */
-	    param->nrays_mode0 = atoi (argv[++i]);
+	    /* ------------------------------ *
+	     * STAY UP, SCANS FROM THE SOCKET *
+	     * ------------------------------ */
+	    control_path = argv[++i];
 	}
-	else if (!strcmp (argv[i],"-nrays_mode1"))
+	else if (!strcmp (argv[i],"-config"))
 	{
-	    /* ---------------------- *
-	     * MODE 1 Pulse Ray count *
-	     * ---------------------- */
-	    param->nrays_mode1 = atoi (argv[++i]);
+	    /* read before the other arguments, see main () */
+	    i++;
 	}
-	else if (!strcmp (argv[i],"-debug"))
+	else if (!strcmp (argv[i],"-calfile"))
 	{
-	    /* ---------------------------- *
-	     * Output Debugging information *
-	     * ---------------------------- */
-	    debug = true;
+	    cal_file = argv[++i];
 	}
-	else if (!strcmp (argv[i],"-swap"))
+	else if (!strcmp (argv[i],"-outdir"))
 	{
-	    /* ---------------------------------- *
-	     * Swap Co/Cross polar ADC I/Q inputs *
-	     * ---------------------------------- */
-	    swap_iq_channels = true;
+	    /* ---------------- *
+	     * OUTPUT DATA TREE *
+	     * ---------------- */
+	    snprintf (data_path, sizeof (data_path) - 1, "%s", argv[++i]);
+	    if (data_path[0] != '\0' && data_path[strlen (data_path) - 1] != '/')
+		strcat (data_path, "/");
+	    RNC_SetDataPath (data_path);
 	}
 	else if (!strcmp (argv[i], "-tsdump"))
 	{
@@ -545,34 +967,31 @@ parseargs (int               argc,
 	else if (!strcmp (argv[i], "-range"))
 	{
 	    const double gate_width = (double)param->clock_divfactor * (SPEED_LIGHT / 2.0) / param->clock;
-	    int          min_gate;
-	    int          max_gate;
 
-	    /* ------------------------ *
-	     * SELECT MIN AND MAX GATES *
-	     * ------------------------ */
-	    min_gate = (int) (atof (argv[++i]) * 1000.0 / gate_width);
-	    max_gate = (int)((atof (argv[++i]) * 1000.0 / gate_width) + 0.5);
-	    if (min_gate < 2)
-		min_gate = 2;
-
-	    /*
-	     * For Galileo this is currently fixed in config file
-	     * so override any value entered.
-	     */
-	    min_gate = (param->delay_clocks / param->clock_divfactor) + 1;
-
-	    if (max_gate <= min_gate)
-		max_gate = min_gate + 1;
-
-	    scan->min_gate = min_gate;
-	    scan->max_gate = max_gate;
-	    printf ("Range: %8.3f to %8.3f km\n",
-		    scan->min_gate * gate_width / 1000.0,
-		    scan->max_gate * gate_width / 1000.0);
-
-	    param->delay_clocks      = (scan->min_gate - 1) * param->clock_divfactor;
-	    param->samples_per_pulse = scan->max_gate - scan->min_gate;
+	    /* ------------------------------------------------------ *
+	     * SELECT MIN AND MAX GATES: all the gates are acquired,  *
+	     * those between are processed (see range_window)         *
+	     * ------------------------------------------------------ */
+	    scan->min_gate = (int) (atof (argv[++i]) * 1000.0 / gate_width);
+	    scan->max_gate = (int)((atof (argv[++i]) * 1000.0 / gate_width) + 0.5);
+	    if (scan->max_gate <= scan->min_gate)
+	    {
+		printf ("Invalid range window\n");
+		return -1;
+	    }
+	}
+	else if (!strcmp (argv[i], "-noise-range"))
+	{
+	    const double gate_width = (double)param->clock_divfactor * (SPEED_LIGHT / 2.0) / param->clock;
+	    const int    delay      = param->delay_clocks / param->clock_divfactor;
+
+	    param->noise_gate_start = (int) (atof (argv[++i]) * 1000.0 / gate_width) - delay;
+	    param->noise_gate_end   = (int)((atof (argv[++i]) * 1000.0 / gate_width) + 0.5) - delay - 1;
+	    if (param->noise_gate_start < 0 || param->noise_gate_end < param->noise_gate_start)
+	    {
+		printf ("Invalid noise range\n");
+		return -1;
+	    }
 	}
 	else if (!strcmp (argv[i], "-help"))
 	{
@@ -590,26 +1009,16 @@ parseargs (int               argc,
 	}
     }
 
+    if (range_window (param, scan) != 0)
+	return -1;
+
     /* Make sure time series samples <= samples */
     if (param->samples_per_pulse_ts > param->samples_per_pulse)
     {
 	param->samples_per_pulse_ts = param->samples_per_pulse;
     }
 
-    /* -------------------------------------------------------------*
-     * This is to remove the effect of Chilbolton azimuths          *
-     * care may have to be taken when the radar is not on the dish  *
-     * since this may cause an error in the metadata                *
-     * -------------------------------------------------------------*/
-    if (scan->scanType == SCAN_PPI)
-    {
-	scan->min_angle -= 90.0;
-	scan->max_angle -= 90.0;
-    }
-    else
-    {
-	scan->scan_angle -= 90.0;
-    }
+    scan_from_chilbolton (scan);
     return 0;
 }
 
@@ -624,6 +1033,7 @@ get_config (const char *      filename,
 	    int               is_coded)
 {
     char codefile[255];
+    char valuestr[80];
 
     printf ("Accessing config file: %s\n", filename);
 
@@ -660,32 +1070,116 @@ get_config (const char *      filename,
     param->nrays_mode0                = (int)RNC_GetConfigFloat (filename, "nrays_mode0");
     param->nrays_mode1                = (int)RNC_GetConfigFloat (filename, "nrays_mode1");
 
-    /* -----------------------------------------------------------*
-     * this is for when the radar is fixed pointing in the cradle *
-     * please take care when the radar is tilted                  *
-     * -----------------------------------------------------------*/
-    scan->min_angle  = RNC_GetConfigFloat (filename, "antenna_elevation");
-    scan->max_angle  = RNC_GetConfigFloat (filename, "antenna_elevation");
-    scan->scan_angle = RNC_GetConfigFloat (filename, "antenna_azimuth");
-
-    RNC_GetConfig (filename,"code-file", codefile, sizeof (codefile));
+    /* Noise estimated from the last 50 gates unless "noise-gates first last" */
+    param->noise_gate_start = -1;
+    param->noise_gate_end   = -1;
+    if (RNC_GetConfig (filename, "noise-gates", valuestr, sizeof (valuestr)) == 0)
+    {
+	sscanf (valuestr, "%d %d", &param->noise_gate_start, &param->noise_gate_end);
+    }
 
-    strcpy (param->code_name, "NOT YET IMPLEMENTED\0");
+    /* All the gates acquired are processed unless "process-gates first last" */
+    scan->min_gate = 0;
+    scan->max_gate = 0;
+    if (RNC_GetConfig (filename, "process-gates", valuestr, sizeof (valuestr)) == 0)
+    {
+	int first, last;
 
-    /* For non-coded pulses */
-    param->code_length     = 1;
-    param->number_of_codes = 1;
+	if (sscanf (valuestr, "%d %d", &first, &last) == 2 && last >= first)
+	{
+	    scan->min_gate = first + param->delay_clocks / param->clock_divfactor;
+	    scan->max_gate = last  + param->delay_clocks / param->clock_divfactor + 1;
+	}
+    }
 
-    // param->alternate_modes = 0;
-    // param->mode0           = PM_Single_H;
-    // param->mode1           = PM_Single_H;
-}
+    /* Where and what to log, and how many messages a second from each call */
+    if (RNC_GetConfig (filename, "log-file", valuestr, sizeof (valuestr)) == 0)
+    {
+	valuestr [strcspn (valuestr, " \t\r\n")] = '\0';
+	snprintf (log_file, sizeof (log_file), "%s", valuestr);
+    }
+    if (RNC_GetConfig (filename, "log-level", valuestr, sizeof (valuestr)) == 0)
+    {
+	valuestr [strcspn (valuestr, " \t\r\n")] = '\0';
+	if (RLG_ParseLevel (valuestr) >= 0)
+	    log_level = RLG_ParseLevel (valuestr);
+    }
+    if (RNC_GetConfig (filename, "log-rate", valuestr, sizeof (valuestr)) == 0)
+    {
+	log_rate = atoi (valuestr);
+    }
 
-/* Loads calibration information from *.cal file */
-static inline void
-get_cal (RSP_ParamStruct * param,
-	 const char *      calfile)
-{
+    /* Real-time setup of the ray loop */
+    if (RNC_GetConfig (filename, "rt-cpu", valuestr, sizeof (valuestr)) == 0)
+    {
+	rt_config.cpu = atoi (valuestr);
+    }
+    if (RNC_GetConfig (filename, "rt-aux-cpus", valuestr, sizeof (valuestr)) == 0)
+    {
+	valuestr [strcspn (valuestr, " \t\r\n")] = '\0';
+	snprintf (rt_config.aux_cpus, sizeof (rt_config.aux_cpus), "%s", valuestr);
+    }
+    if (RNC_GetConfig (filename, "rt-priority", valuestr, sizeof (valuestr)) == 0)
+    {
+	rt_config.priority = atoi (valuestr);
+    }
+    if (RNC_GetConfig (filename, "rt-lock-memory", valuestr, sizeof (valuestr)) == 0)
+    {
+	rt_config.lock_memory = atoi (valuestr);
+    }
+    if (RNC_GetConfig (filename, "rt-pages", valuestr, sizeof (valuestr)) == 0)
+    {
+	valuestr [strcspn (valuestr, " \t\r\n")] = '\0';
+	if (RRT_ParsePages (valuestr) >= 0)
+	    rt_config.pages = RRT_ParsePages (valuestr);
+    }
+
+#ifndef RST_NO_TIMING
+    /* Seconds between writes of the stage timing stats file */
+    if (RNC_GetConfig (filename, "timing-interval", valuestr, sizeof (valuestr)) == 0)
+    {
+	timing_interval = atoi (valuestr);
+    }
+#endif /* RST_NO_TIMING */
+
+    /* Fast approximate maths for the moments, on unless disabled */
+    param->fast_math = 1;
+    if (RNC_GetConfig (filename, "fast-math", valuestr, sizeof (valuestr)) == 0)
+    {
+	param->fast_math = atoi (valuestr);
+    }
+
+    /* -----------------------------------------------------------*
+     * this is for when the radar is fixed pointing in the cradle *
+     * please take care when the radar is tilted                  *
+     * -----------------------------------------------------------*/
+    config_pointing.elevation = RNC_GetConfigFloat (filename, "antenna_elevation");
+    config_pointing.azimuth   = RNC_GetConfigFloat (filename, "antenna_azimuth");
+    scan->min_angle  = config_pointing.elevation;
+    scan->max_angle  = config_pointing.elevation;
+    scan->scan_angle = config_pointing.azimuth;
+
+    /* For non-coded pulses the code file holds a single 1-bit code */
+    param->code_length     = 1;
+    param->number_of_codes = 1;
+    strcpy (param->code_name, "none");
+
+    if (RNC_GetConfig (filename,"code-file", codefile, sizeof (codefile)) == 0)
+    {
+	codefile [strcspn (codefile, " \t\r\n")] = '\0';
+	RNC_ReadCodeFile (codefile, param);
+    }
+
+    // param->alternate_modes = 0;
+    // param->mode0           = PM_Single_H;
+    // param->mode1           = PM_Single_H;
+}
+
+/* Loads calibration information from *.cal file */
+static inline void
+get_cal (RSP_ParamStruct * param,
+	 const char *      calfile)
+{
     param->ZED_calibration_offset            = RNC_GetConfigDouble (calfile,"z-calibration");
     param->ZDR_calibration_offset            = RNC_GetConfigDouble (calfile,"zdr-calibration");
     param->LDR_calibration_offset            = RNC_GetConfigDouble (calfile,"ldr-calibration");
@@ -736,141 +1230,840 @@ make_dmux_table (int channels,
 }
 
 
-/* Routine to wait for start of scan */
+/* Axis of the scan window, or -1 for scans without one */
+static inline int
+scan_axis (int scantype)
+{
+    switch (scantype)
+    {
+    case SCAN_PPI: return RSM_AXIS_AZ;
+    case SCAN_RHI: return RSM_AXIS_EL;
+    case SCAN_CSP: return RSM_AXIS_EL;
+    default:       return -1;
+    }
+}
+
+/* Log a time of the position history, CLOCK_MONOTONIC in ns, as UTC */
+static void
+log_crossing (const char * what,
+	      uint64_t     t_ns)
+{
+    struct timespec mono, real;
+    struct tm       tm;
+    int64_t         ns;
+
+    clock_gettime (CLOCK_MONOTONIC, &mono);
+    clock_gettime (CLOCK_REALTIME, &real);
+    ns = (int64_t)real.tv_sec * 1000000000 + real.tv_nsec
+	- ((int64_t)mono.tv_sec * 1000000000 + mono.tv_nsec - (int64_t)t_ns);
+    real.tv_sec = ns / 1000000000;
+    gmtime_r (&real.tv_sec, &tm);
+    RLG_LOG (RLG_INFO, "%s at %02d:%02d:%02d.%03d\n", what,
+	     tm.tm_hour, tm.tm_min, tm.tm_sec, (int)(ns % 1000000000 / 1000000));
+}
+
+/*------------------------------------------------------------------------*
+ * -daemon control socket. A command is one datagram of text:             *
+ *   the options of a scan, as on the command line, e.g.                  *
+ *     -ppi 0 90 -scan_angle 1 -sv 6 -op abc -id 3 -scan 17 -date ...     *
+ *     which ends the scan being recorded at the next bank (the ray in   *
+ *     hand is trimmed) and starts recording the new one                  *
+ *   stop    end the scan and wait for the next command                   *
+ *   quit    end the scan and exit                                        *
+ *   status  what the recorder is doing                                   *
+ * A datagram from a bound socket is answered with "ok", "error ..." or  *
+ * the status, so a client can tell that its scan was taken.             *
+ *------------------------------------------------------------------------*/
+
+/* The modes a command starts from: those of the command line */
+static struct
+{
+    int long_pulse_mode;
+    int alternate_modes;
+    int mode0;
+    int mode1;
+    int nrays_mode0;
+    int nrays_mode1;
+} run_modes;
+
+/* Split line into at most max words, in place; returns how many */
+static int
+control_split (char * line,
+	       char * words[],
+	       int    max)
+{
+    char * save;
+    char * word;
+    int    n = 0;
+
+    for (word = strtok_r (line, " \t\r\n", &save); word != NULL && n < max;
+	 word = strtok_r (NULL, " \t\r\n", &save))
+	words[n++] = word;
+    return n;
+}
+
+/* Is line a scan command: 0, or -1 with the reason in error */
+static int
+control_check (const char * line,
+	       char *       error,
+	       size_t       size)
+{
+    char   copy[sizeof (control_line)];
+    char * words[64];
+    int    n, i, nargs;
+
+    snprintf (copy, sizeof (copy), "%s", line);
+    n = control_split (copy, words, 64);
+    if (n == 0)
+    {
+	snprintf (error, size, "error empty command\n");
+	return -1;
+    }
+    for (i = 0; i < n; i += 1 + nargs)
+    {
+	nargs = scan_option_nargs (words[i]);
+	if (nargs < 0)
+	{
+	    snprintf (error, size, "error unknown option %s\n", words[i]);
+	    return -1;
+	}
+	if (i + nargs >= n)
+	{
+	    snprintf (error, size, "error %s needs %d argument(s)\n", words[i], nargs);
+	    return -1;
+	}
+    }
+    return 0;
+}
+
+static int
+control_open (const char * path)
+{
+    struct sockaddr_un addr;
+
+    memset (&addr, 0, sizeof (addr));
+    if (strlen (path) >= sizeof (addr.sun_path))
+    {
+	printf ("Control socket path too long: %s\n", path);
+	return -1;
+    }
+    addr.sun_family = AF_UNIX;
+    strcpy (addr.sun_path, path);
+
+    control_fd = socket (AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (control_fd < 0)
+    {
+	printf ("Cannot open the control socket: %m\n");
+	return -1;
+    }
+    unlink (path);
+    if (bind (control_fd, (struct sockaddr *)&addr, sizeof (addr)) != 0)
+    {
+	printf ("Cannot bind the control socket %s: %m\n", path);
+	close (control_fd);
+	control_fd = -1;
+	return -1;
+    }
+    chmod (path, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP);
+    printf ("Waiting for scans on %s\n", path);
+    return 0;
+}
+
+static void
+control_close (void)
+{
+    if (control_fd < 0)
+	return;
+    close (control_fd);
+    unlink (control_path);
+    control_fd = -1;
+}
+
+/*
+ * Take the datagrams waiting on the control socket, waiting up to
+ * timeout_ms for the first. A later scan replaces one still waiting.
+ * Returns true if a command is waiting to be applied.
+ */
+static bool
+control_poll (int timeout_ms)
+{
+    struct sockaddr_un from;
+    socklen_t          fromlen;
+    struct pollfd      pfd;
+    char               line[sizeof (control_line)];
+    char               reply[256];
+    ssize_t            n;
+
+    if (control_fd < 0)
+	return false;
+
+    pfd.fd     = control_fd;
+    pfd.events = POLLIN;
+    while (poll (&pfd, 1, timeout_ms) > 0)
+    {
+	timeout_ms = 0;
+	fromlen    = sizeof (from);
+	n = recvfrom (control_fd, line, sizeof (line) - 1, MSG_DONTWAIT,
+		      (struct sockaddr *)&from, &fromlen);
+	if (n < 0)
+	    break;
+	line[n] = '\0';
+	line[strcspn (line, "\r\n")] = '\0';
+
+	if (!strcmp (line, "status"))
+	{
+	    snprintf (reply, sizeof (reply), "%s%s\n", control_state,
+		      (control_line[0] != '\0') ? ", next scan waiting" : "");
+	}
+	else if (!strcmp (line, "quit"))
+	{
+	    exit_now = true;
+	    snprintf (reply, sizeof (reply), "ok\n");
+	}
+	else if (!strcmp (line, "stop") || control_check (line, reply, sizeof (reply)) == 0)
+	{
+	    snprintf (control_line, sizeof (control_line), "%s", line);
+	    snprintf (reply, sizeof (reply), "ok\n");
+	}
+	RLG_LOG (RLG_INFO, "Command %s: %s", line, reply);
+
+	/* only a bound sender has an address to answer */
+	if (fromlen > sizeof (sa_family_t))
+	    sendto (control_fd, reply, strlen (reply), MSG_DONTWAIT,
+		    (struct sockaddr *)&from, fromlen);
+    }
+    return control_line[0] != '\0';
+}
+
+/*
+ * Set the scan and the modes from the command waiting, as parseargs does
+ * from the command line. The history of the files is program and the
+ * words of the command, in argc, argv.
+ * Returns 0, or -1 for "stop".
+ */
+static int
+control_apply (char *            program,
+	       RSP_ParamStruct * param,
+	       URC_ScanStruct *  scan,
+	       int *             start_day,
+	       int *             argc,
+	       char ***          argv)
+{
+    static char   line[sizeof (control_line)];
+    static char * words[65];
+    int           n, i;
+
+    snprintf (line, sizeof (line), "%s", control_line);
+    control_line[0] = '\0';
+    if (!strcmp (line, "stop"))
+	return -1;
+
+    words[0] = program;
+    n = 1 + control_split (line, words + 1, 64);
+
+    scan_defaults (scan, start_day);
+    param->long_pulse_mode = run_modes.long_pulse_mode;
+    param->alternate_modes = run_modes.alternate_modes;
+    param->mode0           = run_modes.mode0;
+    param->mode1           = run_modes.mode1;
+    param->nrays_mode0     = run_modes.nrays_mode0;
+    param->nrays_mode1     = run_modes.nrays_mode1;
+
+    /* checked by control_check as it came in */
+    for (i = 1; i < n; i++)
+	i = parse_scan_option (n, words, i, param, scan);
+    scan_from_chilbolton (scan);
+
+    *argc = n;
+    *argv = words;
+    return 0;
+}
+
+/* Routine to wait for start of scan: the read thread watches the scan
+ * window, and wakes us as the dish leaves it and comes back in. With
+ * -daemon a new command stops the wait. */
 static inline void
 wait_scan_start (int                         scantype,
 		 RSM_PositionMessageStruct * position_msg,
 		 float                       min_angle,
-		 float                       max_angle)
+		 float                       max_angle,
+		 RSM_WindowStateStruct *     window)
+{
+    const int axis = scan_axis (scantype);
+
+    if (axis < 0)
+	return;
+
+    RSM_WindowWatch (axis, min_angle, max_angle);
+    printf ("Waiting to get outside scan range...\n");
+    while (!exit_now && !control_poll (0) && RSM_WindowWait (0, 100, window) == 0)
+	;
+
+    if (exit_now || control_line[0] != '\0')
+    {
+	return;
+    }
+
+    printf ("Waiting to get within scan range...\n");
+    printf ("min_angle: %.1f degrees  max_angle: %.1f\n",
+	    min_angle, max_angle);
+    while (!exit_now && !control_poll (0) && RSM_WindowWait (1, 100, window) == 0)
+	;
+    if (window->entries > 0)
+	log_crossing ("Scan start", window->entered_ns);
+    RSM_ReadPositionMessage (position_msg);
+}
+
+/* Routine to wait for end of scan */
+static inline bool
+scanEnd_test (int                         scantype,
+	      RSM_PositionMessageStruct * position_msg,
+	      float                       min_angle,
+	      float                       max_angle)
 {
     float angle;
 
     switch (scantype)
     {
-    case SCAN_PPI:
-    case SCAN_RHI:
-    case SCAN_CSP:
-	break;
+    case SCAN_PPI: angle = position_msg->az; break;
+    case SCAN_RHI: angle = position_msg->el; break;
+    case SCAN_CSP: angle = position_msg->el; break;
+    case SCAN_SGL: return true;
+    default:       return false;
+    }
+
+    return (angle > max_angle || angle < min_angle);
+}
+
+#ifndef RST_NO_TIMING
+/*------------------------------------------------------------------------*
+ * Stage timing stats file, next to the data of the day:                  *
+ * <data>/radar-galileo/stats/YYYYMMDD/radar-galileo_<date>_<scan>-timing  *
+ *------------------------------------------------------------------------*/
+static void
+timing_open (const char * date,
+	     const char * scan_name)
+{
+    const char * root = (data_path[0] != '\0') ? data_path : RADAR_DATA_PATH;
+    char         dir[384];
+
+    snprintf (dir, sizeof (dir), "%sradar-galileo/stats", root);
+    mkdir (dir, (S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH));
+    snprintf (dir, sizeof (dir), "%sradar-galileo/stats/%.8s", root, date);
+    mkdir (dir, (S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH));
+    snprintf (timing_file, sizeof (timing_file), "%s/radar-galileo_%s_%s-timing.txt",
+	      dir, date, scan_name);
+
+    RST_Init (&timing, stage_names, N_STAGES);
+    memset (&retrigger_jitter, 0, sizeof (retrigger_jitter));
+    RST_Attach (&timing, "retrigger-late", &retrigger_jitter);
+}
+
+/* Write the stats file when it is due, or asked for with SIGUSR1 */
+static void
+timing_check (bool now)
+{
+    static time_t         last = 0;
+    const time_t          t    = time (NULL);
+    const struct timespec zero = { 0, 0 };
+    sigset_t              set;
+
+    sigemptyset (&set);
+    sigaddset (&set, SIGUSR1);
+    if (sigtimedwait (&set, NULL, &zero) == SIGUSR1)
+	now = true;
+
+    if (last == 0)
+	last = t;
+    if (now || (timing_interval > 0 && t - last >= timing_interval))
+    {
+	if (RST_Write (&timing, timing_file) != 0)
+	    printf ("Could not write %s: %m\n", timing_file);
+	last = t;
+    }
+}
+#endif /* RST_NO_TIMING */
+
+
+/*------------------------------------------------------------------------*
+ * Routines for mode-switching bitmask                                    *
+ * -----------------------------------------------------------------------*/
+static uint16_t
+dec2bcd_r (uint16_t dec)
+{
+    return (dec) ? ((dec2bcd_r (dec / 10) << 4) + (dec % 10)) : 0;
+}
+
+/* The DIO bank C values of mode0 and mode1 */
+static void
+set_wivern_modes (const RSP_ParamStruct * param,
+		  uint8_t                 chip_length_n100ns,
+		  uint8_t                 wivern_mode[2])
+{
+    uint8_t mode0, mode1;
+
+    if (param->long_pulse_mode == 0)
+    {
+	/*----------------------------------------------------------*
+	 * Short pulses                                             *
+	 * Set mode0 and mode1 - radar will alternate between these *
+	 * if param.alternate_modes==1                              *
+	 *----------------------------------------------------------*/
+	mode0          = (uint8_t) (param->mode0 | 0x08); // Most significant bit 1 to select short pulses
+	wivern_mode[0] = (mode0 << 4) | chip_length_n100ns;
+
+	mode1          = (uint8_t) (param->mode1 | 0x08); // Most significant bit 1 to select short pulses
+	wivern_mode[1] = (mode1 << 4) | chip_length_n100ns;
+    }
+    else
+    {
+	/*--------------*
+	 * Long pulses  *
+	 *--------------*/
+	// Need to double check effect of chip_length parameter here (CJW 20161216)
+	mode0          = (uint8_t)param->mode0; // Most significant bit 0
+	wivern_mode[0] = (mode0 << 4) | chip_length_n100ns;
+	mode1          = (uint8_t)param->mode1; // Most significant bit 0
+	wivern_mode[1] = (mode1 << 4) | chip_length_n100ns;
+    }
+}
+
+/* The polarisations transmitted in a mode */
+static int
+mode_tx_pol (int mode)
+{
+    switch (mode & 0x07)
+    {
+    case PM_Single_HV:
+    case PM_Double_HV_VH:
+    case PM_Double_HV_HV:
+	return 2;
     default:
-	return;
+	return 1;
     }
+}
+
+/* The second pulse of the double pulse modes is outside a range window */
+static bool
+window_fits_modes (const RSP_ParamStruct * param)
+{
+    if (param->samples_per_pulse == param->samples_per_pulse_acquired)
+	return true;
+    return (param->mode0 & 0x07) < PM_Double_H &&
+	(param->alternate_modes == 0 || (param->mode1 & 0x07) < PM_Double_H);
+}
+
+/* The modes of the run, from set_wivern_modes and the masked param modes */
+static void
+setup_modes (const RSP_ParamStruct * param,
+	     const uint8_t           wivern_mode[2],
+	     int                     gate_offset,
+	     ModeSetup_t             modes[2])
+{
+    int m;
+
+    for (m = 0; m < 2; m++)
+    {
+	modes[m].dio         = wivern_mode[m];
+	modes[m].mode        = ((m == 1) ? param->mode1 : param->mode0) & 0x07;
+	modes[m].num_tx_pol  = mode_tx_pol (modes[m].mode);
+	modes[m].gate_offset = (modes[m].mode < PM_Double_H) ? param->samples_per_pulse : gate_offset;
+	modes[m].v_delay     = (modes[m].mode == PM_Double_HV_HV) ? gate_offset : 0;
+    }
+}
+
+/* The mode of the ray after ray_count rays of the mode0/mode1 cycle */
+static inline int
+next_ray_mode (const RSP_ParamStruct * param,
+	       int                     ray_count)
+{
+    if (param->alternate_modes == 0 || param->long_pulse_mode != 0)
+	return 0;
+    return (ray_count % (param->nrays_mode0 + param->nrays_mode1) < param->nrays_mode0) ? 0 : 1;
+}
+
+/* Select a mode for the banks started from now on: DIO bank C for the
+ * radar, and the acquisition for a synthetic source */
+static void
+switch_mode (int                 fd,
+	     ixpio_reg_t *       bank_C,
+	     RDQ_DeviceStruct *  daq,
+	     const ModeSetup_t * m)
+{
+    bank_C->id    = IXPIO_P2;
+    bank_C->value = m->dio;
+    RDQ_SetMode (daq, m->mode);
+
+#ifndef NO_DIO
+    if (fd >= 0)
+    {
+	if (ioctl (fd, IXPIO_WRITE_REG, bank_C))
+	{
+	    RLG_LOG (RLG_ERROR, "Can't write bank_C value 0x%x: %s\n",
+		     bank_C->value, strerror (errno));
+	}
+	else
+	{
+	    RLG_LOG (RLG_INFO, "Writing 0x%x to bank_C\n", bank_C->value);
+	}
+    }
+#else
+    (void)fd;
+#endif /* NO_DIO */
+}
+
+#if 0
+static inline char *
+ul16toBinary (uint16_t a)
+{
+    char bitmask[] = "0000000000000000";
+    uint16_t i;
+
+    int j = 0;
+    for (i = 0x8000; i != 0; i >>= 1)
+    {
+        bitmask[j]= (a & i) ? '1' : '0';
+        j++;
+    }
+    return strdup (bitmask);
+}
+
+static inline char *
+ul8toBinary (uint8_t a)
+{
+    char bitmask[] = "00000000";
+    uint8_t i;
+
+    int j = 0;
+    for (i = 0x80; i != 0; i >>= 1)
+    {
+        bitmask[j]= (a & i) ? '1' : '0';
+        j++;
+    }
+    return strdup (bitmask);
+}
+#endif
+
+/* Routine to calculate incoherent power */
+static inline float
+calc_incoherent_power (fftw_complex * in, int nfft)
+{
+    double power = 0.0;
+    register int i;
+
+    for (i = 0; i < nfft; i++)
+    {
+	/* cabs (in[i]) * cabs (in[i]) only doing it directly avoids 2*sqrt() */
+        power += (fftw_real (in[i]) * fftw_real (in[i]) +
+		  fftw_imag (in[i]) * fftw_imag (in[i]));
+    }
+    power /= nfft;
+    return power;
+}
+
+/*--------------------------------------------------------------------*
+ * half_angle_sincos: cos and sin of atan2 (im, re) / 2 without any  *
+ * transcendental functions. The half angle points along the         *
+ * bisector of (re, im) and the positive real axis, (r + re, im), or  *
+ * for re < 0 along the equivalent (|im|, sign (im) (r - re)), which  *
+ * avoids the cancellation in r + re.                                 *
+ *--------------------------------------------------------------------*/
+static inline void
+half_angle_sincos (float   re,
+		   float   im,
+		   float * c,
+		   float * s)
+{
+    const float r = sqrtf (re * re + im * im);
+    float norm;
+
+    if (r == 0.0)
+    {
+	*c = 1.0;
+	*s = 0.0;
+    }
+    else if (re >= 0.0)
+    {
+	norm = 1.0 / sqrtf (2.0 * r * (r + re));
+	*c   = (r + re) * norm;
+	*s   = im * norm;
+    }
+    else
+    {
+	norm = 1.0 / sqrtf (2.0 * r * (r - re));
+	*c   = fabsf (im) * norm;
+	*s   = copysignf (r - re, im) * norm;
+    }
+}
+
+/* sin and cos of a Doppler phase, using RSP_FastMath.h if selected */
+static inline void
+vel_sincos (float   angle,
+	    int     fast,
+	    float * s,
+	    float * c)
+{
+    if (fast)
+    {
+	RSP_FastSincosf (angle, s, c);
+    }
+    else
+    {
+	*s = sin (angle);
+	*c = cos (angle);
+    }
+}
+
+/*------------------------------------------------------------------*
+ * The files of a scan are made by a thread of their own, started    *
+ * with the other threads on the rt-aux-cpus. With -daemon the bank  *
+ * carried over from the last scan is collected, and the next one    *
+ * started, while the netCDF headers are written: the ray loop waits *
+ * for the files (scan_files_wait) only after it has restarted the   *
+ * acquisition.                                                      *
+ *------------------------------------------------------------------*/
+typedef struct
+{
+    /* the scan, copied as the ray loop changes param.num_tx_pol */
+    RSP_ParamStruct         param;
+    URC_ScanStruct          scan;
+    const char *            host_ext;
+    int                     argc;
+    char **                 argv;
+    int                     num_pulses;
+    RSP_ObservablesStruct * obs;
+    RSP_ObservablesStruct * PSD_obs;
+    RSP_ObservablesStruct * PSD_RAPID_obs;
+    TimeSeriesObs_t *       tsobs;
+    /* the files, as the ray loop uses them */
+    int *                   ncid;
+    int *                   file_stateid;
+    int *                   spectra_ncid;
+    int *                   spectra_rapid_ncid;
+    int *                   PSD_varid;
+    int *                   PSD_rapid_varid;
+    time_t *                spectra_time;
+    time_t *                spectra_rapid_time;
+    FILE **                 tsfid;
+    int *                   ncidts;
+} ScanFilesStruct;
+
+static ScanFilesStruct scan_files;
+static pthread_t       scan_files_thread;
+static bool            scan_files_threaded = false;
+static bool            scan_files_asked    = false;
+static pthread_mutex_t scan_files_lock     = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  scan_files_cond     = PTHREAD_COND_INITIALIZER;
+
+/* Open the files of the scan and write their headers */
+static void
+make_scan_files (ScanFilesStruct * f)
+{
+    RSP_ParamStruct *       param         = &f->param;
+    URC_ScanStruct *        scan          = &f->scan;
+    const char *            host_ext      = f->host_ext;
+    const int               argc          = f->argc;
+    char **                 argv          = f->argv;
+    const int               num_pulses    = f->num_pulses;
+    RSP_ObservablesStruct * obs           = f->obs;
+    RSP_ObservablesStruct * PSD_obs       = f->PSD_obs;
+    RSP_ObservablesStruct * PSD_RAPID_obs = f->PSD_RAPID_obs;
+    TimeSeriesObs_t *       tsobs         = f->tsobs;
+    int *                   PSD_varid       = f->PSD_varid;
+    int *                   PSD_rapid_varid = f->PSD_rapid_varid;
+    RNC_DimensionStruct     dimensions;
+    time_t                  temp_time_t;
+    time_t                  spectra_time       = 0;
+    time_t                  spectra_rapid_time = 0;
+    FILE *                  tsfid              = NULL;
+    int                     ncid, file_stateid, status;
+    int                     spectra_ncid       = -1;
+    int                     spectra_rapid_ncid = -1;
+    int                     ncidts             = -1;
+
+    /* setup the netCDF file */
+    ncid = RNC_OpenNetcdfFile (GetRadarName (GALILEO),
+			       GetSpectraName (GALILEO),
+			       scan->date, host_ext,
+			       GetScanTypeName (scan->scanType),
+			       GetSpectraExtension (GALILEO), "raw");
+    printf ("Check 2\n");
+    RNC_SetupDimensions (ncid, param, &dimensions);
+    printf ("Check 3\n");
+    RNC_SetupGlobalAttributes (ncid, GALILEO, scan, param, argc, argv);
+    file_stateid = RNC_SetupFile_State (ncid);
+    RNC_SetupStaticVariables (ncid, GALILEO, param);
+    if (param->code_length > 1)
+    {
+	RNC_SetupPulse_Compression_Code (ncid, param);
+    }
+    printf ("Check 4\n");
+    RNC_SetupRange (ncid, param, &dimensions);
+    printf ("Check 5\n");
+    RNC_SetupDynamicVariables (ncid, GALILEO, scan, param, &dimensions, obs);
+
+    /* change the mode of netCDF from define to data */
+    status = nc_enddef (ncid);
+    if (status != NC_NOERR) check_netcdf_handle_error (status);
+
+    /* Set up spectral dump file */
+    if (param->dump_spectra != 0)
+    {
+	spectra_ncid = RNC_OpenNetcdfFile
+	    (GetRadarName (GALILEO_SPECTRA), GetSpectraName (GALILEO_SPECTRA),
+	     scan->date, host_ext, GetScanTypeName (scan->scanType),
+	     GetSpectraExtension (GALILEO_SPECTRA), "raw");
+	RNC_SetupDimensions (spectra_ncid, param, &dimensions);
+	RNC_SetupGlobalAttributes (spectra_ncid, GALILEO, scan, param, argc, argv);
+	RNC_SetupStaticVariables (spectra_ncid, GALILEO, param);
+	RNC_SetupRange (spectra_ncid, param, &dimensions);
+	RNC_SetupDynamicVariables (spectra_ncid, GALILEO_SPECTRA, scan, param, &dimensions, PSD_obs);
+	RNC_SetupLogPSDVariables (spectra_ncid, GALILEO_SPECTRA, param, &dimensions, PSD_varid);
 
-    printf ("Waiting to get outside scan range...\n");
-    do
-    {
-	RSM_ReadPositionMessage (position_msg);
-	switch (scantype)
-	{
-	case SCAN_PPI: angle = position_msg->az; break;
-	case SCAN_RHI: angle = position_msg->el; break;
-	case SCAN_CSP: angle = position_msg->el; break;
-	default:       angle = 0.0;              break;
-	}
+	/* change the mode of netCDF from define to data */
+	status = nc_enddef (spectra_ncid);
+	if (status != NC_NOERR) check_netcdf_handle_error (status);
+
+	/* set the time at which a spectra will be dumped */
+	time (&temp_time_t);
+	spectra_time = param->dump_spectra * (floorl (temp_time_t / param->dump_spectra) + 1.0);
     }
-    while (angle >= min_angle && angle <= max_angle &&
-	   !exit_now);
 
-    if (exit_now)
+    if (param->dump_spectra_rapid != 0)
     {
-	return;
+	/* make sure bin_ray_number is 0 */
+	PSD_RAPID_obs->bin_ray_number = 0;
+	PSD_RAPID_obs->ray_number = 0;
+
+	spectra_rapid_ncid = RNC_OpenNetcdfFile
+	    (GetRadarName (GALILEO_SPECTRA_RAPID),
+	     GetSpectraName (GALILEO_SPECTRA_RAPID),
+	     scan->date, host_ext, GetScanTypeName (scan->scanType),
+	     GetSpectraExtension (GALILEO_SPECTRA_RAPID), "raw");
+	RNC_SetupRapidLogPSDDimensions (spectra_rapid_ncid, GALILEO_SPECTRA_RAPID, param, &dimensions);
+	RNC_SetupGlobalAttributes (spectra_rapid_ncid, GALILEO, scan, param, argc, argv);
+	RNC_SetupStaticVariables (spectra_rapid_ncid, GALILEO, param);
+	RNC_SetupRange (spectra_rapid_ncid, param, &dimensions);
+	RNC_SetupDynamicVariables (spectra_rapid_ncid, GALILEO_SPECTRA_RAPID, scan, param, &dimensions, PSD_RAPID_obs);
+	RNC_SetupLogPSDVariables (spectra_rapid_ncid, GALILEO_SPECTRA_RAPID, param, &dimensions, PSD_rapid_varid);
+
+	/* change the mode of netCDF from define to data */
+	status = nc_enddef (spectra_rapid_ncid);
+	if (status != NC_NOERR) check_netcdf_handle_error (status);
+
+	/* set the time at which a spectra will be dumped */
+	time (&temp_time_t);
+	spectra_rapid_time = param->dump_spectra_rapid * (floorl (temp_time_t / param->dump_spectra_rapid) + 1.0);
     }
 
-    printf ("Waiting to get within scan range...\n");
-    printf ("min_angle: %.1f degrees  max_angle: %.1f\n",
-	    min_angle, max_angle);
-    do
+    if (tsdump)
     {
-	RSM_ReadPositionMessage (position_msg);
-	switch (scantype)
+	if (TextTimeSeries)
 	{
-	case SCAN_PPI: angle = position_msg->az; break;
-	case SCAN_RHI: angle = position_msg->el; break;
-	case SCAN_CSP: angle = position_msg->el; break;
-	default:       angle = 0.0;              break;
+	    /* Setup the time-series dump file */
+	    tsfid = RTS_OpenTSFile (GetRadarName (GALILEO), scan->date, host_ext,
+				    GetScanTypeName (scan->scanType));
+
+	    if (tsfid == NULL)
+	    {
+		tsdump = false;
+		printf ("**** Can't open time series file: %m ****\n");
+		printf ("**** Time series recording off ****\n");
+	    }
+	    else
+	    {
+		fprintf (tsfid, "npulse: %d\n", num_pulses * param->spectra_averaged);
+		fprintf (tsfid, "nsample: %d\n", param->samples_per_pulse_ts);
+		fprintf (tsfid, "divfactor: %d\n", param->clock_divfactor);
+		fprintf (tsfid, "delayclocks: %d\n", param->delay_clocks);
+		fprintf (tsfid, "ADC_channels: %d\n", param->ADC_channels);
+	    }
 	}
-    }
-    while ((angle < min_angle || angle > max_angle) &&
-	   !exit_now);
-}
+	else
+	{
+	    /* NetCDF Time series */
+	    RNC_DimensionStruct dimensionsts;
 
-/* Routine to wait for end of scan */
-static inline bool
-scanEnd_test (int                         scantype,
-	      RSM_PositionMessageStruct * position_msg,
-	      float                       min_angle,
-	      float                       max_angle)
-{
-    float angle;
+	    memset (&dimensionsts, 0, sizeof (dimensionsts));
+	    ncidts = RNC_OpenNetcdfFile (GetRadarName (GALILEO), "ts",
+					 scan->date, host_ext,
+					 GetScanTypeName (scan->scanType),
+					 "", "ts");
+	    RNC_SetupDimensions (ncidts, param, &dimensionsts);
+	    RNC_SetupGlobalAttributes (ncidts, GALILEO, scan, param, argc, argv);
+	    RNC_SetupStaticVariables (ncidts, GALILEO, param);
+	    RNC_SetupRange (ncidts, param, &dimensionsts);
+	    SetupTimeSeriesVariables (tsobs, ncidts, param, scan, &dimensionsts, obs);
 
-    switch (scantype)
-    {
-    case SCAN_PPI: angle = position_msg->az; break;
-    case SCAN_RHI: angle = position_msg->el; break;
-    case SCAN_CSP: angle = position_msg->el; break;
-    case SCAN_SGL: return true;
-    default:       return false;
+	    status = nc_enddef (ncidts);
+	    if (status != NC_NOERR) check_netcdf_handle_error (status);
+	}
     }
 
-    return (angle > max_angle || angle < min_angle);
-}
-
 
-/*------------------------------------------------------------------------*
- * Routines for mode-switching bitmask                                    *
- * -----------------------------------------------------------------------*/
-static uint16_t
-dec2bcd_r (uint16_t dec)
-{
-    return (dec) ? ((dec2bcd_r (dec / 10) << 4) + (dec % 10)) : 0;
+    *f->ncid               = ncid;
+    *f->file_stateid       = file_stateid;
+    *f->spectra_ncid       = spectra_ncid;
+    *f->spectra_rapid_ncid = spectra_rapid_ncid;
+    *f->spectra_time       = spectra_time;
+    *f->spectra_rapid_time = spectra_rapid_time;
+    *f->tsfid              = tsfid;
+    *f->ncidts             = ncidts;
 }
 
-#if 0
-static inline char *
-ul16toBinary (uint16_t a)
+static void *
+scan_files_thread_main (void * arg)
 {
-    char bitmask[] = "0000000000000000";
-    uint16_t i;
-
-    int j = 0;
-    for (i = 0x8000; i != 0; i >>= 1)
+    (void)arg;
+    pthread_mutex_lock (&scan_files_lock);
+    while (1)
     {
-        bitmask[j]= (a & i) ? '1' : '0';
-        j++;
+	while (!scan_files_asked)
+	    pthread_cond_wait (&scan_files_cond, &scan_files_lock);
+	pthread_mutex_unlock (&scan_files_lock);
+
+	make_scan_files (&scan_files);
+
+	pthread_mutex_lock (&scan_files_lock);
+	scan_files_asked = false;
+	pthread_cond_broadcast (&scan_files_cond);
     }
-    return strdup (bitmask);
+    return NULL;
 }
 
-static inline char *
-ul8toBinary (uint8_t a)
+/* Start the thread, with the others, before RRT_Setup */
+static void
+scan_files_start (void)
 {
-    char bitmask[] = "00000000";
-    uint8_t i;
+    scan_files_threaded = (pthread_create (&scan_files_thread, NULL,
+					   scan_files_thread_main, NULL) == 0);
+    if (!scan_files_threaded)
+	RLG_LOG (RLG_WARN, "No thread for the scan files: they are made before each scan\n");
+}
 
-    int j = 0;
-    for (i = 0x80; i != 0; i >>= 1)
+/* Ask for the files of scan_files, made here if there is no thread */
+static void
+scan_files_ask (void)
+{
+    if (!scan_files_threaded)
     {
-        bitmask[j]= (a & i) ? '1' : '0';
-        j++;
+	make_scan_files (&scan_files);
+	return;
     }
-    return strdup (bitmask);
+    pthread_mutex_lock (&scan_files_lock);
+    scan_files_asked = true;
+    pthread_cond_broadcast (&scan_files_cond);
+    pthread_mutex_unlock (&scan_files_lock);
 }
-#endif
 
-/* Routine to calculate incoherent power */
-static inline float
-calc_incoherent_power (fftw_complex * in, int nfft)
+/* Wait until the files asked for are made */
+static void
+scan_files_wait (void)
 {
-    double power = 0.0;
-    register int i;
-
-    for (i = 0; i < nfft; i++)
-    {
-	/* cabs (in[i]) * cabs (in[i]) only doing it directly avoids 2*sqrt() */
-        power += (fftw_real (in[i]) * fftw_real (in[i]) +
-		  fftw_imag (in[i]) * fftw_imag (in[i]));
-    }
-    power /= nfft;
-    return power;
+    pthread_mutex_lock (&scan_files_lock);
+    while (scan_files_asked)
+	pthread_cond_wait (&scan_files_cond, &scan_files_lock);
+    pthread_mutex_unlock (&scan_files_lock);
 }
 
 /*========================= M A I N   C O D E ======================*
@@ -891,23 +2084,26 @@ main (int    argc,
     ixpio_reg_t bank_A, bank_B, bank_C, bank_0;
 
     int        num_pulses;
-    int        amcc_fd = 0;        // file descriptor for the PCICARD
-    caddr_t    dma_buffer = NULL;  // size of dma buffer
-    uint16_t * dma_banks[2];      // pointers to the dma banks
+    const RDQ_BackendStruct * daq_backend;
+    RDQ_ConfigStruct   daq_config;
+    RDQ_DeviceStruct   daq;        // acquisition (AMCC card, replay or synthetic)
+    RDQ_BankInfoStruct bank_info;  // metadata of the last completed bank
     int        dma_bank = 0;
     int        proc_bank = 1;
-    int        tcount;             // number of bytes to be transferred during the DMA
     uint16_t * data;
     int        count, sample;
     int        start_day = 0;
     int        nspectra;
     int        status;
     long       num_data;
+    int        bank_samples;       // samples per channel in one DAQ cycle
+    int        channel_offset[8];  // position of each channel in a DMA sample
+    int        channel_first[8];   // first gate of each channel taken from a pulse
+    uint16_t * channel_data[8];    // where each channel is demultiplexed to
     long       RetriggerDelayTime;
     float *    current_PSD;
     register   int  i, j;
     int        temp_int = 0;
-    float      tmpRHO = 0.0;
     float      HH_moments[RSP_MOMENTS];
     float      HV_moments[RSP_MOMENTS];
     float      HH_noise_level;
@@ -919,21 +2115,19 @@ main (int    argc,
     int        noisegate1, noisegate2;
     int        gate_offset;
     int        mode_gate_offset;
+    int        mode_v_delay;
     time_t     system_time;
     time_t     spectra_time = 0;
     time_t     spectra_rapid_time = 0;
-    time_t     temp_time_t;
     char       datestring[25];  /* MTF: 15 -> 25 to fix buffer overrun */
     float * uncoded_mean_vsq; // Used in sigma vbar calculation
     float * uncoded_mean_Zsq; // Used in sigma Zbar calculation
 
     /* time variables */
-    struct timeval tv;
     struct tm      tm;
 
     PolPSDStruct * PSD;
     URC_ScanStruct scan;
-    RNC_DimensionStruct dimensions;
 
     /* netCDF file pointer */
     int ncid;
@@ -955,6 +2149,18 @@ main (int    argc,
     struct      sigaction sig_struct;
 
     int nm;
+    uint64_t ray_start_ns = 0;  // CLOCK_MONOTONIC start of the first bank of the ray
+
+    /* The scan window, watched from wait_scan_start: the scan ends as the
+     * dish leaves it, at scan_window.exits > scan_exits */
+    RSM_WindowStateStruct scan_window;
+    int                   scan_exits = -1;
+
+    /* -daemon: the history of the files is the command of the scan, and
+     * the bank acquiring as a scan ends can be the first of the next */
+    int     scan_argc    = argc;
+    char ** scan_argv    = argv;
+    bool    bank_running = false;
 
     /*--------------------------------------------------------*
      * The following are shortcut pointers to the elements of *
@@ -999,10 +2205,12 @@ main (int    argc,
     float * RHO_FD, * RHO_VD;
     float * RHO_FDS, * RHO_VDS;
     float * POW_H, * POW_HX, * POW_V, * POW_VX;
+    RSP_RayStruct ray;
     float wi;     // Individual weighting value
     float * uncoded_sum_wi; // Sum of weighting values
     float tempI_odd, tempI_even, tempQ_odd, tempQ_even;
-    float phidp, tempI, tempQ, tempI_vel, tempQ_vel;
+    float tempI, tempQ, tempI_vel, tempQ_vel;
+    RSP_PulsePairStruct pp;
 
     uint16_t * I_uncoded_copolar_H;
     uint16_t * Q_uncoded_copolar_H;
@@ -1013,14 +2221,20 @@ main (int    argc,
     uint16_t * TX2data;
     uint16_t * V_not_H;
 
+    /* the echo channels as processed: floats, without the ADC offset */
+    float * I_copolar;
+    float * Q_copolar;
+    float * I_crosspolar;
+    float * Q_crosspolar;
+
     int horizontal_first = 1;
 
     RSP_ParamStruct       param;
-    RSP_ComplexType      * timeseries;
     RSP_ObservablesStruct obs;
     RSP_ObservablesStruct PSD_obs;
     RSP_ObservablesStruct PSD_RAPID_obs;
     TimeSeriesObs_t       tsobs;
+    RSP_PulseCompressStruct pulse_compress;
 
     RSP_PeakStruct * HH_peaks;
     RSP_PeakStruct * HV_peaks;
@@ -1059,8 +2273,28 @@ main (int    argc,
 	return 1;
     }
 
+#ifndef RST_NO_TIMING
+    /* SIGUSR1 asks for the stage timing. It is blocked here, before any
+     * thread starts, and polled at the end of each ray so that it never
+     * cuts short the retrigger delay or an acquisition wait. */
+    {
+	sigset_t set;
+
+	sigemptyset (&set);
+	sigaddset (&set, SIGUSR1);
+	sigprocmask (SIG_BLOCK, &set, NULL);
+    }
+#endif /* RST_NO_TIMING */
+
+    /* An alternative config file has to be known before it is read */
+    for (i = 1; i < argc - 1; i++)
+    {
+	if (!strcmp (argv[i], "-config"))
+	    config_file = argv[++i];
+    }
+
     /* Read radar config file */
-    get_config (CONFIG_FILE, &param, &scan, 0);  // Do it for coded pulses
+    get_config (config_file, &param, &scan, 0);  // Do it for coded pulses
 
     /* Parse command line arguments */
     /* overwrite config with command line parameters */
@@ -1069,8 +2303,58 @@ main (int    argc,
 	return 1;
     }
 
+    /* Offline runs are the parallel workers of radar-galileo-reprocess: */
+    /* none of them takes the ray loop core, SCHED_FIFO or locked memory */
+    if (offline)
+    {
+	rt_config.cpu         = -1;
+	rt_config.aux_cpus[0] = '\0';
+	rt_config.priority    = 0;
+	rt_config.lock_memory = 0;
+    }
+
+    /* Threads started from here on (logging, position messages) */
+    /* run on the rt-aux-cpus, away from the ray loop              */
+    RRT_SetAuxCpus (&rt_config, &rt_report);
+
+    /* From here on the ray loop logs through the RLG thread */
+    if (RLG_Open (log_file[0] != '\0' ? log_file : NULL, log_level, log_rate) == 0)
+	atexit (RLG_Close);
+    scan_files_start ();
+
+    daq_backend = RDQ_FindBackend (daq_name);
+    if (daq_backend == NULL)
+    {
+	printf ("Unknown acquisition backend %s\n", daq_name);
+	return 1;
+    }
+    printf ("Acquisition   : %s\n", daq_backend->name);
+    if (offline && daq_backend != &RDQ_Backend_replay)
+    {
+	printf ("-offline needs -replay <tsfile>\n");
+	return 1;
+    }
+    if (control_path != NULL)
+    {
+	if (offline)
+	{
+	    printf ("-daemon cannot be used with -offline\n");
+	    return 1;
+	}
+	if (control_open (control_path) != 0)
+	    return 1;
+
+	/* each command starts from the modes of the command line */
+	run_modes.long_pulse_mode = param.long_pulse_mode;
+	run_modes.alternate_modes = param.alternate_modes;
+	run_modes.mode0           = param.mode0;
+	run_modes.mode1           = param.mode1;
+	run_modes.nrays_mode0     = param.nrays_mode0;
+	run_modes.nrays_mode1     = param.nrays_mode1;
+    }
+
     /* Read calibration file */
-    get_cal (&param, CAL_FILE);
+    get_cal (&param, cal_file);
 
     /*-----------------------------------------------------*
      * PCI DIO Card stuff - for setting radar mode       *
@@ -1083,33 +2367,9 @@ main (int    argc,
     /* Set bits for chip length (number of 100ns units) */
     uint8_t chip_length_n100ns = (uint8_t) (param.pulse_period / 100 + 0.5f);
 
-    uint8_t mode, mode0, mode1, wivern_mode[2];
-
-    if (param.long_pulse_mode == 0)
-    {
-	/*----------------------------------------------------------*
-	 * Short pulses                                             *
-	 * Set mode0 and mode1 - radar will alternate between these *
-	 * if param.alternate_modes==1                              *
-	 *----------------------------------------------------------*/
-	mode0          = (uint8_t) (param.mode0 | 0x08); // Most significant bit 1 to select short pulses
-	wivern_mode[0] = (mode0 << 4) | chip_length_n100ns;
+    uint8_t mode, wivern_mode[2];
 
-	mode1          = (uint8_t) (param.mode1 | 0x08); // Most significant bit 1 to select short pulses
-	wivern_mode[1] = (mode1 << 4) | chip_length_n100ns;
-    }
-    else
-    {
-	/*--------------*
-	 * Long pulses  *
-	 *--------------*/
-	// Need to double check effect of chip_length parameter here (CJW 20161216)
-	mode0          = (uint8_t)param.mode0; // Most significant bit 0
-	wivern_mode[0] = (mode0 << 4) | chip_length_n100ns;
-	mode1          = (uint8_t)param.mode1; // Most significant bit 0
-	wivern_mode[1] = (mode1 << 4) | chip_length_n100ns;
-    }
-    mode = mode0;
+    set_wivern_modes (&param, chip_length_n100ns, wivern_mode);
 
     /*--------------------------------------*
      * Open up the route to the serial port *
@@ -1128,7 +2388,9 @@ main (int    argc,
 	/* wait for valid dish position */
 	do
 	{
-	    RSM_ReadPositionMessage (&position_msg);
+	    /* a message every 20 ms: no need to spin */
+	    if (RSM_ReadPositionMessage (&position_msg) == 0)
+		usleep (20000);
 	    /* MTF: Add in breakout on Ctrl-C */
 	}
 	while (!exit_now && position_msg.month == 0); // Check msg is valid
@@ -1183,16 +2445,26 @@ main (int    argc,
     // /* Hard code to 2 as using 1 breaks ffts */
     // param.num_tx_pol = 2;
 
+    /* what the buffers are allocated for, that a -daemon scan must fit */
+    const int run_tx_pol = param.num_tx_pol;
+
+    if (!window_fits_modes (&param))
+    {
+	printf ("-range cannot be used with the double pulse modes\n");
+	return 1;
+    }
+
     /*------------------------------------*
      * Initialise RSP parameter structure *
      *------------------------------------*/
     RSP_InitialiseParams (&param); // This param is used for uncoded pulses
 
-    gate_offset = (int) (0.5+ (param.pulse_offset * 1e-6) / param.sample_period);
+    gate_offset = param.pulse_offset_gates;
 
     printf ("Pulse offset: %f\n", param.pulse_offset);
     printf ("Sample_period: %f\n", param.sample_period * 1e9);
     printf ("Gate offset: %d\n",gate_offset);
+    printf ("RSP kernels: %s\n", param.kernel_isa);
     printf ("nfft: %d\n", param.nfft);
     printf ("npsd: %d\n", param.npsd);
     printf ("frequency: %f\n", param.frequency);
@@ -1217,39 +2489,58 @@ main (int    argc,
 
     /* Sample extra pulses at end so that we have entire code sequence */
     num_pulses = (int) (param.pulses_per_daq_cycle);
-    tcount     = num_pulses * param.spectra_averaged * param.samples_per_pulse * param.ADC_channels * sizeof (uint16_t);
 
     printf ("Num pulses: %d\n",num_pulses);
 
+    /* Decoder for coded pulses, working on a bank at a time */
+    if (param.code_length > 1)
+    {
+	if (RSP_PulseCompressInit (&pulse_compress, &param,
+				   param.samples_per_pulse, num_pulses))
+	{
+	    fprintf (stderr, "Memory allocation error: %m\n");
+	    return 3;
+	}
+	printf ("Pulse compression: %s, %d samples, %s\n",
+		param.code_name, pulse_compress.code_length,
+		pulse_compress.use_fft ? "overlap-save FFT" : "direct");
+    }
+
     // Number of data points to allocate per data stream
     num_data = param.pulses_per_daq_cycle * param.samples_per_pulse;
 
-    // Allocate memory for coded and uncoded data streams
-    I_uncoded_copolar_H             = calloc (num_data, sizeof (uint16_t));
-    Q_uncoded_copolar_H             = calloc (num_data, sizeof (uint16_t));
-    IQStruct.I_uncoded_copolar_H    = calloc (param.samples_per_pulse * param.nfft * param.num_tx_pol * param.spectra_averaged, sizeof (uint16_t));
-    IQStruct.Q_uncoded_copolar_H    = calloc (param.samples_per_pulse * param.nfft * param.num_tx_pol * param.spectra_averaged, sizeof (uint16_t));
-    I_uncoded_crosspolar_H          = calloc (num_data, sizeof (uint16_t));
-    Q_uncoded_crosspolar_H          = calloc (num_data, sizeof (uint16_t));
-    IQStruct.I_uncoded_crosspolar_H = calloc (param.samples_per_pulse * param.nfft * param.num_tx_pol * param.spectra_averaged, sizeof (uint16_t));
-    IQStruct.Q_uncoded_crosspolar_H = calloc (param.samples_per_pulse * param.nfft * param.num_tx_pol * param.spectra_averaged, sizeof (uint16_t));
-
-    if (I_uncoded_copolar_H == NULL || Q_uncoded_copolar_H == NULL ||
-	I_uncoded_crosspolar_H == NULL || Q_uncoded_crosspolar_H == NULL ||
-	IQStruct.I_uncoded_copolar_H == NULL || IQStruct.Q_uncoded_copolar_H == NULL ||
-	IQStruct.I_uncoded_crosspolar_H == NULL || IQStruct.Q_uncoded_crosspolar_H == NULL)
+    /*------------------------------------------------------------------*
+     * All the working buffers of the run come from one arena, carved  *
+     * in the groups of run_arena_size                                 *
+     *------------------------------------------------------------------*/
+    if (RRT_ArenaOpen (&run_arena, run_arena_size (&param), &rt_config, &rt_report) != 0)
     {
 	fprintf (stderr, "Memory allocation error: %m\n");
 	return 3;
     }
 
-    log_raw = calloc (num_data, sizeof (uint16_t));
-    TX1data = calloc (num_data, sizeof (uint16_t));
-    TX2data = calloc (num_data, sizeof (uint16_t));
-    V_not_H = calloc (num_data, sizeof (uint16_t));
+    // Streams demultiplexed from a bank
+    I_uncoded_copolar_H    = ARENA (num_data, uint16_t);
+    Q_uncoded_copolar_H    = ARENA (num_data, uint16_t);
+    I_uncoded_crosspolar_H = ARENA (num_data, uint16_t);
+    Q_uncoded_crosspolar_H = ARENA (num_data, uint16_t);
+    log_raw                = ARENA (num_data, uint16_t);
+    TX1data                = ARENA (num_data, uint16_t);
+    TX2data                = ARENA (num_data, uint16_t);
+    V_not_H                = ARENA (num_data, uint16_t);
+    I_copolar              = ARENA (num_data, float);
+    Q_copolar              = ARENA (num_data, float);
+    I_crosspolar           = ARENA (num_data, float);
+    Q_crosspolar           = ARENA (num_data, float);
+
+    // Samples of a ray: for the spectra, and for the time series file
+    IQStruct.I_uncoded_copolar_H    = ARENA (param.samples_per_pulse * param.nfft * param.num_tx_pol * param.spectra_averaged, uint16_t);
+    IQStruct.Q_uncoded_copolar_H    = ARENA (param.samples_per_pulse * param.nfft * param.num_tx_pol * param.spectra_averaged, uint16_t);
+    IQStruct.I_uncoded_crosspolar_H = ARENA (param.samples_per_pulse * param.nfft * param.num_tx_pol * param.spectra_averaged, uint16_t);
+    IQStruct.Q_uncoded_crosspolar_H = ARENA (param.samples_per_pulse * param.nfft * param.num_tx_pol * param.spectra_averaged, uint16_t);
 
     num_data      *= param.spectra_averaged;
-    tsobs.ICOH     = malloc (num_data * 8 * sizeof (uint16_t));
+    tsobs.ICOH     = ARENA (num_data * 8, uint16_t);
     tsobs.QCOH     = tsobs.ICOH     + num_data;
     tsobs.ICXH     = tsobs.QCOH     + num_data;
     tsobs.QCXH     = tsobs.ICXH     + num_data;
@@ -1258,205 +2549,170 @@ main (int    argc,
     tsobs.VnotH    = tsobs.TxPower2 + num_data;
     tsobs.RawLog   = tsobs.VnotH    + num_data;
 
-    if (tsobs.VnotH == NULL ||
-	log_raw == NULL ||
-	TX1data == NULL ||
-	TX2data == NULL ||
-	V_not_H == NULL)
-    {
-	fprintf (stderr, "Memory allocation error: %m\n");
-	return 3;
-    }
-
-    //printf ("FFTW Version: %s\n", fftw_version);
-    //exit (100);
-
-    HH_peaks = calloc (param.num_peaks, sizeof (RSP_PeakStruct));
-    HV_peaks = calloc (param.num_peaks, sizeof (RSP_PeakStruct));
-    VV_peaks = calloc (param.num_peaks, sizeof (RSP_PeakStruct));
-    VH_peaks = calloc (param.num_peaks, sizeof (RSP_PeakStruct));
-
-    if (HH_peaks == NULL || HV_peaks == NULL || VV_peaks == NULL || VH_peaks == NULL)
-    {
-	fprintf (stderr, "Memory allocation error: %m\n");
-	return 3;
-    }
-
-    in        = fftw_malloc (sizeof (fftw_complex) * param.nfft);
-    H_odd     = fftw_malloc (sizeof (fftw_complex) * (param.nfft * param.num_tx_pol + 1) >> 1);
-    V_odd     = fftw_malloc (sizeof (fftw_complex) * (param.nfft * param.num_tx_pol + 1) >> 1);
-    H_even    = fftw_malloc (sizeof (fftw_complex) * (param.nfft * param.num_tx_pol + 1) >> 1);
-    V_even    = fftw_malloc (sizeof (fftw_complex) * (param.nfft * param.num_tx_pol + 1) >> 1);
-    H0_even   = fftw_malloc (sizeof (fftw_complex) * (param.nfft * param.num_tx_pol + 1) >> 1);
-    V0_odd    = fftw_malloc (sizeof (fftw_complex) * (param.nfft * param.num_tx_pol + 1) >> 1);
-    p_uncoded = fftw_plan_dft_1d (param.nfft, in, in, FFTW_FORWARD, FFTW_ESTIMATE);
-    if (in == NULL ||
-	H_odd == NULL || V_odd == NULL || H_even == NULL || V_even == NULL ||
-	H0_even == NULL || V0_odd == NULL || p_uncoded == NULL)
-    {
-	fprintf (stderr, "Memory allocation error: %m\n");
-	return 3;
-    }
-
-    timeseries  = calloc (param.nfft, sizeof (RSP_ComplexType));
-    current_PSD = calloc (param.npsd, sizeof (float));
-    PSD         = calloc (param.samples_per_pulse, sizeof (PolPSDStruct));
-
-    if (timeseries == NULL || current_PSD == NULL || PSD == NULL)
-    {
-	fprintf (stderr, "Memory allocation error: %m\n");
-	return 3;
-    }
-	
-    for (j = 0; j < param.samples_per_pulse; j++)
+    // FFT of a gate: input, odd and even pulses, and the spectrum. The
+    // pulse pair buffers take nfft pulses: every pulse in the single
+    // polarisation modes, every other of 2 nfft in the HV modes
+    in          = ARENA (param.nfft, fftw_complex);
+    H_odd       = ARENA (param.nfft, fftw_complex);
+    V_odd       = ARENA (param.nfft, fftw_complex);
+    H_even      = ARENA (param.nfft, fftw_complex);
+    V_even      = ARENA (param.nfft, fftw_complex);
+    H0_even     = ARENA (param.nfft, fftw_complex);
+    V0_odd      = ARENA (param.nfft, fftw_complex);
+    current_PSD = ARENA (param.npsd, float);
+    p_uncoded   = fftw_plan_dft_1d (param.nfft, in, in, FFTW_FORWARD, FFTW_ESTIMATE);
+
+    // Averaged spectra, one block per polarisation
+    PSD = ARENA (param.samples_per_pulse, PolPSDStruct);
+    if (PSD != NULL)
     {
-	PSD[j].HH = calloc (param.npsd, sizeof (float));   // not coded
-	PSD[j].HV = calloc (param.npsd, sizeof (float));   // not coded
-	PSD[j].VV = calloc (param.npsd, sizeof (float));   // not coded
-	PSD[j].VH = calloc (param.npsd, sizeof (float));   // not coded
+	float * HH = ARENA (param.samples_per_pulse * param.npsd, float);
+	float * HV = ARENA (param.samples_per_pulse * param.npsd, float);
+	float * VV = ARENA (param.samples_per_pulse * param.npsd, float);
+	float * VH = ARENA (param.samples_per_pulse * param.npsd, float);
 
-	if (PSD[j].HH == NULL || PSD[j].HV == NULL ||
-	    PSD[j].VV == NULL || PSD[j].VH == NULL)
+	for (j = 0; j < param.samples_per_pulse; j++)
 	{
-	    fprintf (stderr, "Memory allocation error: %m\n");
-	    return 3;
+	    PSD[j].HH = (HH != NULL) ? HH + j * param.npsd : NULL;   // not coded
+	    PSD[j].HV = (HV != NULL) ? HV + j * param.npsd : NULL;   // not coded
+	    PSD[j].VV = (VV != NULL) ? VV + j * param.npsd : NULL;   // not coded
+	    PSD[j].VH = (VH != NULL) ? VH + j * param.npsd : NULL;   // not coded
 	}
     }
 
-    uncoded_mean_vsq = calloc (param.samples_per_pulse, sizeof (float));
-    uncoded_mean_Zsq = calloc (param.samples_per_pulse, sizeof (float));
-    uncoded_sum_wi   = calloc (param.samples_per_pulse, sizeof (float));
-
-    if (uncoded_mean_vsq == NULL || uncoded_mean_Zsq == NULL ||
-	uncoded_sum_wi == NULL)
-    {
-	fprintf (stderr, "Memory allocation error: %m\n");
-	return 3;
-    }
-
-    VEL_HC_COS      = calloc (param.samples_per_pulse, sizeof (float));
-    VEL_HC_SIN      = calloc (param.samples_per_pulse, sizeof (float));
-    VEL_VC_COS      = calloc (param.samples_per_pulse, sizeof (float));
-    VEL_VC_SIN      = calloc (param.samples_per_pulse, sizeof (float));
-    VEL_VD_COS      = calloc (param.samples_per_pulse, sizeof (float));
-    VEL_VD_SIN      = calloc (param.samples_per_pulse, sizeof (float));
-    VEL_FD_COS      = calloc (param.samples_per_pulse, sizeof (float));
-    VEL_FD_SIN      = calloc (param.samples_per_pulse, sizeof (float));
-    VEL_VD_COS_even = calloc (param.samples_per_pulse, sizeof (float));
-    VEL_VD_SIN_even = calloc (param.samples_per_pulse, sizeof (float));
-    VEL_FD_COS_even = calloc (param.samples_per_pulse, sizeof (float));
-    VEL_FD_SIN_even = calloc (param.samples_per_pulse, sizeof (float));
-    VEL_VD_COS_odd  = calloc (param.samples_per_pulse, sizeof (float));
-    VEL_VD_SIN_odd  = calloc (param.samples_per_pulse, sizeof (float));
-    VEL_FD_COS_odd  = calloc (param.samples_per_pulse, sizeof (float));
-    VEL_FD_SIN_odd  = calloc (param.samples_per_pulse, sizeof (float));
-    PHIDP_FD_COS    = calloc (param.samples_per_pulse, sizeof (float));
-    PHIDP_FD_SIN    = calloc (param.samples_per_pulse, sizeof (float));
-    PHIDP_VD_COS    = calloc (param.samples_per_pulse, sizeof (float));
-    PHIDP_VD_SIN    = calloc (param.samples_per_pulse, sizeof (float));
-    PH_FD           = calloc (param.samples_per_pulse, sizeof (float));
-    PV_FD           = calloc (param.samples_per_pulse, sizeof (float));
-    PH_VD           = calloc (param.samples_per_pulse, sizeof (float));
-    PV_VD           = calloc (param.samples_per_pulse, sizeof (float));
-    PH_FD_even      = calloc (param.samples_per_pulse, sizeof (float));
-    PV_FD_even      = calloc (param.samples_per_pulse, sizeof (float));
-    PH_VD_even      = calloc (param.samples_per_pulse, sizeof (float));
-    PV_VD_even      = calloc (param.samples_per_pulse, sizeof (float));
-    PH_FD_odd       = calloc (param.samples_per_pulse, sizeof (float));
-    PV_FD_odd       = calloc (param.samples_per_pulse, sizeof (float));
-    PH_VD_odd       = calloc (param.samples_per_pulse, sizeof (float));
-    PV_VD_odd       = calloc (param.samples_per_pulse, sizeof (float));
-    PH0_FD_even     = calloc (param.samples_per_pulse, sizeof (float));
-    PV0_FD_odd      = calloc (param.samples_per_pulse, sizeof (float));
-
-    if (VEL_HC_COS == NULL || VEL_HC_SIN == NULL || VEL_VC_COS == NULL || VEL_VC_SIN == NULL ||
-	VEL_VD_COS == NULL || VEL_VD_SIN == NULL || VEL_FD_COS == NULL || VEL_FD_SIN == NULL ||
-	VEL_VD_COS_even == NULL || VEL_VD_SIN_even == NULL || VEL_FD_COS_even == NULL || VEL_FD_SIN_even == NULL ||
-	VEL_VD_COS_odd == NULL || VEL_VD_SIN_odd == NULL || VEL_FD_COS_odd == NULL || VEL_FD_SIN_odd == NULL ||
-	PHIDP_FD_COS == NULL || PHIDP_FD_SIN == NULL ||	PHIDP_VD_COS == NULL ||	PHIDP_VD_SIN == NULL ||
-	PH_FD == NULL || PV_FD == NULL || PH_VD == NULL || PV_VD == NULL ||
-	PH_FD_even == NULL || PV_FD_even == NULL || PH_VD_even == NULL || PV_VD_even == NULL ||
-	PH_FD_odd == NULL || PV_FD_odd == NULL || PH_VD_odd == NULL || PV_VD_odd == NULL ||
-	PH0_FD_even == NULL || PV0_FD_odd == NULL)
+    // Per gate sums over the pulses of a ray
+    uncoded_mean_vsq = ARENA (param.samples_per_pulse, float);
+    uncoded_mean_Zsq = ARENA (param.samples_per_pulse, float);
+    uncoded_sum_wi   = ARENA (param.samples_per_pulse, float);
+    VEL_HC_COS       = ARENA (param.samples_per_pulse, float);
+    VEL_HC_SIN       = ARENA (param.samples_per_pulse, float);
+    VEL_VC_COS       = ARENA (param.samples_per_pulse, float);
+    VEL_VC_SIN       = ARENA (param.samples_per_pulse, float);
+    VEL_VD_COS       = ARENA (param.samples_per_pulse, float);
+    VEL_VD_SIN       = ARENA (param.samples_per_pulse, float);
+    VEL_FD_COS       = ARENA (param.samples_per_pulse, float);
+    VEL_FD_SIN       = ARENA (param.samples_per_pulse, float);
+    VEL_VD_COS_even  = ARENA (param.samples_per_pulse, float);
+    VEL_VD_SIN_even  = ARENA (param.samples_per_pulse, float);
+    VEL_FD_COS_even  = ARENA (param.samples_per_pulse, float);
+    VEL_FD_SIN_even  = ARENA (param.samples_per_pulse, float);
+    VEL_VD_COS_odd   = ARENA (param.samples_per_pulse, float);
+    VEL_VD_SIN_odd   = ARENA (param.samples_per_pulse, float);
+    VEL_FD_COS_odd   = ARENA (param.samples_per_pulse, float);
+    VEL_FD_SIN_odd   = ARENA (param.samples_per_pulse, float);
+    PHIDP_FD_COS     = ARENA (param.samples_per_pulse, float);
+    PHIDP_FD_SIN     = ARENA (param.samples_per_pulse, float);
+    PHIDP_VD_COS     = ARENA (param.samples_per_pulse, float);
+    PHIDP_VD_SIN     = ARENA (param.samples_per_pulse, float);
+    PH_FD            = ARENA (param.samples_per_pulse, float);
+    PV_FD            = ARENA (param.samples_per_pulse, float);
+    PH_VD            = ARENA (param.samples_per_pulse, float);
+    PV_VD            = ARENA (param.samples_per_pulse, float);
+    PH_FD_even       = ARENA (param.samples_per_pulse, float);
+    PV_FD_even       = ARENA (param.samples_per_pulse, float);
+    PH_VD_even       = ARENA (param.samples_per_pulse, float);
+    PV_VD_even       = ARENA (param.samples_per_pulse, float);
+    PH_FD_odd        = ARENA (param.samples_per_pulse, float);
+    PV_FD_odd        = ARENA (param.samples_per_pulse, float);
+    PH_VD_odd        = ARENA (param.samples_per_pulse, float);
+    PV_VD_odd        = ARENA (param.samples_per_pulse, float);
+    PH0_FD_even      = ARENA (param.samples_per_pulse, float);
+    PV0_FD_odd       = ARENA (param.samples_per_pulse, float);
+
+    // Spectral peaks of a gate
+    HH_peaks = ARENA (param.num_peaks, RSP_PeakStruct);
+    HV_peaks = ARENA (param.num_peaks, RSP_PeakStruct);
+    VV_peaks = ARENA (param.num_peaks, RSP_PeakStruct);
+    VH_peaks = ARENA (param.num_peaks, RSP_PeakStruct);
+
+    /* The groups are carved in order, so the last one tells all did */
+    if (HH_peaks == NULL || HV_peaks == NULL || VV_peaks == NULL || VH_peaks == NULL ||
+	p_uncoded == NULL)
     {
-	fprintf (stderr, "Memory allocation error: %m\n");
+	fprintf (stderr, "Memory allocation error: run arena of %zu bytes too small\n",
+		 run_arena.size);
 	return 3;
     }
+    printf ("Run arena: %.1f MiB\n", run_arena.size / 1048576.0);
 
     norm_uncoded = 1.0 / param.Wss;
 
     /*----------------------------*
      * Initialise RSP Observables *
      *----------------------------*/
-    RSP_ObsInit (&obs);
-    RSP_ObsInit (&PSD_obs);
+    if (RSP_ObsInit (&obs, param.samples_per_pulse) != 0)
+    {
+	fprintf (stderr, "Memory allocation error: %m\n");
+	return 3;
+    }
+    RSP_ObsInit (&PSD_obs, 0);
     /* Last argument determines whether the parameter will be recorded or not */
-    temp_int = (int)RNC_GetConfigDouble (CONFIG_FILE,"TX_1A");
+    temp_int = (int)RNC_GetConfigDouble (config_file,"TX_1A");
     TX_1A    = RSP_ObsNew (&obs, "TX_1A", 1, temp_int);
-    temp_int = (int)RNC_GetConfigDouble (CONFIG_FILE,"TX_2A");
+    temp_int = (int)RNC_GetConfigDouble (config_file,"TX_2A");
     TX_2A    = RSP_ObsNew (&obs, "TX_2A", 1, temp_int);
-    temp_int = (int)RNC_GetConfigDouble (CONFIG_FILE,"TX_1B");
+    temp_int = (int)RNC_GetConfigDouble (config_file,"TX_1B");
     TX_1B    = RSP_ObsNew (&obs, "TX_1B", 1, temp_int);
-    temp_int = (int)RNC_GetConfigDouble (CONFIG_FILE,"TX_2B");
+    temp_int = (int)RNC_GetConfigDouble (config_file,"TX_2B");
     TX_2B    = RSP_ObsNew (&obs, "TX_2B", 1, temp_int);
 
-    temp_int = (int)RNC_GetConfigDouble (CONFIG_FILE,"ZED_HC");
+    temp_int = (int)RNC_GetConfigDouble (config_file,"ZED_HC");
     ZED_HC   = RSP_ObsNew (&obs, "ZED_HC",   param.samples_per_pulse, temp_int);
-    temp_int = (int)RNC_GetConfigDouble (CONFIG_FILE,"SNR_HC");
+    temp_int = (int)RNC_GetConfigDouble (config_file,"SNR_HC");
     SNR_HC   = RSP_ObsNew (&obs, "SNR_HC",   param.samples_per_pulse, temp_int);
-    temp_int = (int)RNC_GetConfigDouble (CONFIG_FILE,"POW_H");
+    temp_int = (int)RNC_GetConfigDouble (config_file,"POW_H");
     POW_H    = RSP_ObsNew (&obs, "POW_H",    param.samples_per_pulse, temp_int);
-    temp_int = (int)RNC_GetConfigDouble (CONFIG_FILE,"POW_HX");
+    temp_int = (int)RNC_GetConfigDouble (config_file,"POW_HX");
     POW_HX   = RSP_ObsNew (&obs, "POW_HX",   param.samples_per_pulse, temp_int);
-    temp_int = (int)RNC_GetConfigDouble (CONFIG_FILE,"POW_V");
+    temp_int = (int)RNC_GetConfigDouble (config_file,"POW_V");
     POW_V    = RSP_ObsNew (&obs, "POW_V",    param.samples_per_pulse, temp_int);
-    temp_int = (int)RNC_GetConfigDouble (CONFIG_FILE,"POW_VX");
+    temp_int = (int)RNC_GetConfigDouble (config_file,"POW_VX");
     POW_VX   = RSP_ObsNew (&obs, "POW_VX",   param.samples_per_pulse, temp_int);
-    temp_int = (int)RNC_GetConfigDouble (CONFIG_FILE,"ZED_VC");
+    temp_int = (int)RNC_GetConfigDouble (config_file,"ZED_VC");
     ZED_VC   = RSP_ObsNew (&obs, "ZED_VC",   param.samples_per_pulse, temp_int);
-    temp_int = (int)RNC_GetConfigDouble (CONFIG_FILE,"SNR_VC");
+    temp_int = (int)RNC_GetConfigDouble (config_file,"SNR_VC");
     SNR_VC   = RSP_ObsNew (&obs, "SNR_VC",   param.samples_per_pulse, temp_int);
-    temp_int = (int)RNC_GetConfigDouble (CONFIG_FILE,"VEL_HC");
+    temp_int = (int)RNC_GetConfigDouble (config_file,"VEL_HC");
     VEL_HC   = RSP_ObsNew (&obs, "VEL_HC",   param.samples_per_pulse, temp_int);
-    temp_int = (int)RNC_GetConfigDouble (CONFIG_FILE,"VEL_VC");
+    temp_int = (int)RNC_GetConfigDouble (config_file,"VEL_VC");
     VEL_VC   = RSP_ObsNew (&obs, "VEL_VC",   param.samples_per_pulse, temp_int);
-    temp_int = (int)RNC_GetConfigDouble (CONFIG_FILE,"SPW_HC");
+    temp_int = (int)RNC_GetConfigDouble (config_file,"SPW_HC");
     SPW_HC   = RSP_ObsNew (&obs, "SPW_HC",   param.samples_per_pulse, temp_int);
-    temp_int = (int)RNC_GetConfigDouble (CONFIG_FILE,"SPW_VC");
+    temp_int = (int)RNC_GetConfigDouble (config_file,"SPW_VC");
     SPW_VC   = RSP_ObsNew (&obs, "SPW_VC",   param.samples_per_pulse, temp_int);
-    temp_int = (int)RNC_GetConfigDouble (CONFIG_FILE,"SNR_XHC");
+    temp_int = (int)RNC_GetConfigDouble (config_file,"SNR_XHC");
     SNR_XHC  = RSP_ObsNew (&obs, "SNR_XHC",  param.samples_per_pulse, temp_int);
-    temp_int = (int)RNC_GetConfigDouble (CONFIG_FILE,"ZED_XHC");
+    temp_int = (int)RNC_GetConfigDouble (config_file,"ZED_XHC");
     ZED_XHC  = RSP_ObsNew (&obs, "ZED_XHC",  param.samples_per_pulse, temp_int);
-    temp_int = (int)RNC_GetConfigDouble (CONFIG_FILE,"SNR_XVC");
+    temp_int = (int)RNC_GetConfigDouble (config_file,"SNR_XVC");
     SNR_XVC  = RSP_ObsNew (&obs, "SNR_XVC",  param.samples_per_pulse, temp_int);
-    temp_int = (int)RNC_GetConfigDouble (CONFIG_FILE,"ZED_XVC");
+    temp_int = (int)RNC_GetConfigDouble (config_file,"ZED_XVC");
     ZED_XVC  = RSP_ObsNew (&obs, "ZED_XVC",  param.samples_per_pulse, temp_int);
-    temp_int = (int)RNC_GetConfigDouble (CONFIG_FILE,"LDR_HC");
+    temp_int = (int)RNC_GetConfigDouble (config_file,"LDR_HC");
     LDR_HC   = RSP_ObsNew (&obs, "LDR_HC",   param.samples_per_pulse, temp_int);
-    temp_int = (int)RNC_GetConfigDouble (CONFIG_FILE,"LDR_VC");
+    temp_int = (int)RNC_GetConfigDouble (config_file,"LDR_VC");
     LDR_VC   = RSP_ObsNew (&obs, "LDR_VC",   param.samples_per_pulse, temp_int);
-    temp_int = (int)RNC_GetConfigDouble (CONFIG_FILE,"NPC_H");
+    temp_int = (int)RNC_GetConfigDouble (config_file,"NPC_H");
     NPC_H    = RSP_ObsNew (&obs, "NPC_H",    param.samples_per_pulse, temp_int);
-    temp_int = (int)RNC_GetConfigDouble (CONFIG_FILE,"NPC_V");
+    temp_int = (int)RNC_GetConfigDouble (config_file,"NPC_V");
     NPC_V    = RSP_ObsNew (&obs, "NPC_V",    param.samples_per_pulse, temp_int);
-    temp_int = (int)RNC_GetConfigDouble (CONFIG_FILE,"VEL_VD");
+    temp_int = (int)RNC_GetConfigDouble (config_file,"VEL_VD");
     VEL_VD   = RSP_ObsNew (&obs, "VEL_VD",   param.samples_per_pulse, temp_int);
-    temp_int = (int)RNC_GetConfigDouble (CONFIG_FILE,"VEL_FD");
+    temp_int = (int)RNC_GetConfigDouble (config_file,"VEL_FD");
     VEL_FD   = RSP_ObsNew (&obs, "VEL_FD",   param.samples_per_pulse, temp_int);
-    temp_int = (int)RNC_GetConfigDouble (CONFIG_FILE,"PHIDP_FD");
+    temp_int = (int)RNC_GetConfigDouble (config_file,"PHIDP_FD");
     PHIDP_FD = RSP_ObsNew (&obs, "PHIDP_FD", param.samples_per_pulse, temp_int);
-    temp_int = (int)RNC_GetConfigDouble (CONFIG_FILE,"PHIDP_VD");
+    temp_int = (int)RNC_GetConfigDouble (config_file,"PHIDP_VD");
     PHIDP_VD = RSP_ObsNew (&obs, "PHIDP_VD", param.samples_per_pulse, temp_int);
-    temp_int = (int)RNC_GetConfigDouble (CONFIG_FILE,"ZDR_C");
+    temp_int = (int)RNC_GetConfigDouble (config_file,"ZDR_C");
     ZDR_C    = RSP_ObsNew (&obs, "ZDR_C",    param.samples_per_pulse, temp_int);
-    temp_int = (int)RNC_GetConfigDouble (CONFIG_FILE,"RHO_FD");
+    temp_int = (int)RNC_GetConfigDouble (config_file,"RHO_FD");
     RHO_FD   = RSP_ObsNew (&obs, "RHO_FD",   param.samples_per_pulse, temp_int);
-    temp_int = (int)RNC_GetConfigDouble (CONFIG_FILE,"RHO_VD");
+    temp_int = (int)RNC_GetConfigDouble (config_file,"RHO_VD");
     RHO_VD   = RSP_ObsNew (&obs, "RHO_VD",   param.samples_per_pulse, temp_int);
-    temp_int = (int)RNC_GetConfigDouble (CONFIG_FILE,"RHO_FDS");
+    temp_int = (int)RNC_GetConfigDouble (config_file,"RHO_FDS");
     RHO_FDS  = RSP_ObsNew (&obs, "RHO_FDS",  param.samples_per_pulse, temp_int);
-    temp_int = (int)RNC_GetConfigDouble (CONFIG_FILE,"RHO_VDS");
+    temp_int = (int)RNC_GetConfigDouble (config_file,"RHO_VDS");
     RHO_VDS  = RSP_ObsNew (&obs, "RHO_VDS",  param.samples_per_pulse, temp_int);
 
     if (TX_1A    == NULL || TX_2A    == NULL || TX_1B    == NULL || TX_2B    == NULL ||
@@ -1473,6 +2729,34 @@ main (int    argc,
 	return 3;
     }
 
+    /* Accumulators and observables finalised at the end of each ray */
+    ray.sum_wi          = uncoded_sum_wi;
+    ray.VEL_HC_COS      = VEL_HC_COS;      ray.VEL_HC_SIN      = VEL_HC_SIN;
+    ray.VEL_VC_COS      = VEL_VC_COS;      ray.VEL_VC_SIN      = VEL_VC_SIN;
+    ray.VEL_VD_COS      = VEL_VD_COS;      ray.VEL_VD_SIN      = VEL_VD_SIN;
+    ray.VEL_FD_COS      = VEL_FD_COS;      ray.VEL_FD_SIN      = VEL_FD_SIN;
+    ray.VEL_VD_COS_even = VEL_VD_COS_even; ray.VEL_VD_SIN_even = VEL_VD_SIN_even;
+    ray.VEL_FD_COS_even = VEL_FD_COS_even; ray.VEL_FD_SIN_even = VEL_FD_SIN_even;
+    ray.VEL_VD_COS_odd  = VEL_VD_COS_odd;  ray.VEL_VD_SIN_odd  = VEL_VD_SIN_odd;
+    ray.VEL_FD_COS_odd  = VEL_FD_COS_odd;  ray.VEL_FD_SIN_odd  = VEL_FD_SIN_odd;
+    ray.PHIDP_FD_COS    = PHIDP_FD_COS;    ray.PHIDP_FD_SIN    = PHIDP_FD_SIN;
+    ray.PHIDP_VD_COS    = PHIDP_VD_COS;    ray.PHIDP_VD_SIN    = PHIDP_VD_SIN;
+    ray.PH_FD       = PH_FD;       ray.PV_FD       = PV_FD;
+    ray.PH_VD       = PH_VD;       ray.PV_VD       = PV_VD;
+    ray.PH_FD_even  = PH_FD_even;  ray.PV_FD_even  = PV_FD_even;
+    ray.PH_VD_even  = PH_VD_even;  ray.PV_VD_even  = PV_VD_even;
+    ray.PH_FD_odd   = PH_FD_odd;   ray.PV_FD_odd   = PV_FD_odd;
+    ray.PH_VD_odd   = PH_VD_odd;   ray.PV_VD_odd   = PV_VD_odd;
+    ray.PH0_FD_even = PH0_FD_even; ray.PV0_FD_odd  = PV0_FD_odd;
+    ray.SNR_HC   = SNR_HC;   ray.ZED_HC   = ZED_HC;   ray.SNR_XHC = SNR_XHC; ray.ZED_XHC = ZED_XHC;
+    ray.SNR_VC   = SNR_VC;   ray.ZED_VC   = ZED_VC;   ray.SNR_XVC = SNR_XVC; ray.ZED_XVC = ZED_XVC;
+    ray.SPW_HC   = SPW_HC;   ray.SPW_VC   = SPW_VC;
+    ray.POW_H    = POW_H;    ray.POW_HX   = POW_HX;   ray.POW_V   = POW_V;   ray.POW_VX  = POW_VX;
+    ray.VEL_HC   = VEL_HC;   ray.VEL_VC   = VEL_VC;   ray.VEL_VD  = VEL_VD;  ray.VEL_FD  = VEL_FD;
+    ray.PHIDP_FD = PHIDP_FD; ray.PHIDP_VD = PHIDP_VD;
+    ray.RHO_FD   = RHO_FD;   ray.RHO_VD   = RHO_VD;   ray.RHO_FDS = RHO_FDS; ray.RHO_VDS = RHO_VDS;
+    ray.LDR_HC   = LDR_HC;   ray.LDR_VC   = LDR_VC;   ray.ZDR_C   = ZDR_C;
+
     printf ("Recording observables:");
     for (i = 0; i < obs.n_obs; i++)
     {
@@ -1515,14 +2799,19 @@ main (int    argc,
      * Set initial mode                        *
      *-----------------------------------------*/
 
+    /* The DIO card is only there (and needed) with the acquisition hardware */
+    fd = -1;
 #ifndef NO_DIO
     /* Open PCI DIO card */
-    fd = open (device, O_RDWR);
-    if (fd < 0)
+    if (daq_backend->hardware)
     {
-	perror ("PCI DIO card not present\n");
-	printf ("PCI DIO card not present %s: %m\n", device);
-	return 2;
+	fd = open (device, O_RDWR);
+	if (fd < 0)
+	{
+	    perror ("PCI DIO card not present\n");
+	    printf ("PCI DIO card not present %s: %m\n", device);
+	    return 2;
+	}
     }
 #endif /* NO_DIO */
 
@@ -1533,7 +2822,7 @@ main (int    argc,
     bank_0.value = 0x07;
 
 #ifndef NO_DIO
-    if (ioctl (fd, IXPIO_WRITE_REG, &bank_0))
+    if (fd >= 0 && ioctl (fd, IXPIO_WRITE_REG, &bank_0))
     {
 	perror ("Can't set write mode for bank_0");
 	printf ("Can't set write mode for bank_0\n");
@@ -1543,7 +2832,12 @@ main (int    argc,
 #endif /* NO_DIO */
 
     /* Set inital mode to mode0 */
-    int new_mode = 0;
+    ModeSetup_t modes[2];
+    int         ray_mode  = 0;   /* of the ray being recorded */
+    int         next_mode = 0;   /* of the ray after it */
+    uint8_t     bank_dio[2];     /* bank C value each DMA bank was acquired with */
+
+    setup_modes (&param, wivern_mode, gate_offset, modes);
 
     /* Set port identifiers for output */
     bank_A.id = IXPIO_P0;
@@ -1553,87 +2847,188 @@ main (int    argc,
     /* Set bank structure values for writing */
     bank_A.value = pulse_offset_byte_a;
     bank_B.value = pulse_offset_byte_b;
-    bank_C.value = wivern_mode[new_mode];
-
-    {
-	mode             = (new_mode == 1) ? param.mode1 : param.mode0;
-	mode_gate_offset = (mode < PM_Double_H) ? param.samples_per_pulse : gate_offset;
+    bank_C.value = modes[ray_mode].dio;
 
-	/* Fixup param.num_tx_pol for mode */
-	switch (mode & 0x07)
-	{
-	case PM_Undefined0:
-	    param.num_tx_pol = 1;
-	    break;
-	case PM_Single_H:
-	case PM_Single_V:
-	case PM_Double_H:
-	case PM_Double_V:
-	    param.num_tx_pol = 1;
-	    break;
-	case PM_Single_HV:
-	case PM_Double_HV_VH:
-	case PM_Double_HV_HV:
-	    param.num_tx_pol = 2;
-	    break;
-	}
-	// /* Hard code to 2 as using 1 breaks ffts */
-	// param.num_tx_pol = 2;
-    }
+    mode             = modes[ray_mode].mode;
+    mode_gate_offset = modes[ray_mode].gate_offset;
+    mode_v_delay     = modes[ray_mode].v_delay;
+    param.num_tx_pol = modes[ray_mode].num_tx_pol;
 
 #ifndef NO_DIO
     /* Write out values to ports */
-    if (ioctl (fd, IXPIO_WRITE_REG, &bank_A))
-    {
-	perror ("Can't write bank_A");
-	printf ("Can't write bank_A value 0x%x\n", bank_A.value);
-    }
-    else
+    if (fd >= 0)
     {
-	printf ("Writing 0x%x to bank_A\n", bank_A.value);
-    }
+	if (ioctl (fd, IXPIO_WRITE_REG, &bank_A))
+	{
+	    perror ("Can't write bank_A");
+	    printf ("Can't write bank_A value 0x%x\n", bank_A.value);
+	}
+	else
+	{
+	    printf ("Writing 0x%x to bank_A\n", bank_A.value);
+	}
 
-    if (ioctl (fd, IXPIO_WRITE_REG, &bank_B))
-    {
-	perror ("Can't write bank_B");
-	printf ("Can't write bank_B value 0x%x\n", bank_B.value);
-    }
-    else
-    {
-	printf ("Writing 0x%x to bank_B\n", bank_B.value);
-    }
+	if (ioctl (fd, IXPIO_WRITE_REG, &bank_B))
+	{
+	    perror ("Can't write bank_B");
+	    printf ("Can't write bank_B value 0x%x\n", bank_B.value);
+	}
+	else
+	{
+	    printf ("Writing 0x%x to bank_B\n", bank_B.value);
+	}
 
-    if (ioctl (fd, IXPIO_WRITE_REG, &bank_C))
-    {
-	perror ("Can't write bank_C");
-	printf ("Can't write bank_C value 0x%x\n", bank_C.value);
-    }
-    else
-    {
-	printf ("Writing 0x%x to bank_C\n", bank_C.value);
+	if (ioctl (fd, IXPIO_WRITE_REG, &bank_C))
+	{
+	    perror ("Can't write bank_C");
+	    printf ("Can't write bank_C value 0x%x\n", bank_C.value);
+	}
+	else
+	{
+	    printf ("Writing 0x%x to bank_C\n", bank_C.value);
+	}
     }
 #endif /* NO_DIO */
 
-    new_mode = -1;
-
     /*-------------------------------------------*
      * Set up the data acquisition               *
      *-------------------------------------------*/
-    printf ("** Initialising ISACTRL...\n");
-    RDQ_InitialiseISACTRL (num_pulses * param.spectra_averaged, param.samples_per_pulse,
-			   param.clock_divfactor, param.delay_clocks);
+    make_dmux_table (param.ADC_channels, dmux_table);
 
-    printf ("** Initialising PCICARD...\n");
-    amcc_fd = RDQ_InitialisePCICARD_New (&dma_buffer, DMA_BUFFER_SIZE);
+    /* Demultiplex straight into the per-channel working arrays */
+    bank_samples = num_pulses * param.samples_per_pulse;
+    channel_offset[CHAN_Ic]      = dmux_table[swap_iq_channels ? SWAP_CHAN_Ic : CHAN_Ic];
+    channel_offset[CHAN_Qc]      = dmux_table[swap_iq_channels ? SWAP_CHAN_Qc : CHAN_Qc];
+    channel_offset[CHAN_Ix]      = dmux_table[swap_iq_channels ? SWAP_CHAN_Ix : CHAN_Ix];
+    channel_offset[CHAN_Qx]      = dmux_table[swap_iq_channels ? SWAP_CHAN_Qx : CHAN_Qx];
+    channel_offset[CHAN_T1]      = dmux_table[CHAN_T1];
+    channel_offset[CHAN_T2]      = dmux_table[CHAN_T2];
+    channel_offset[CHAN_INC]     = dmux_table[CHAN_INC];
+    channel_offset[CHAN_V_not_H] = dmux_table[CHAN_V_not_H];
+    channel_data[CHAN_Ic]        = I_uncoded_copolar_H;
+    channel_data[CHAN_Qc]        = Q_uncoded_copolar_H;
+    channel_data[CHAN_Ix]        = I_uncoded_crosspolar_H;
+    channel_data[CHAN_Qx]        = Q_uncoded_crosspolar_H;
+    channel_data[CHAN_T1]        = TX1data;
+    channel_data[CHAN_T2]        = TX2data;
+    channel_data[CHAN_INC]       = log_raw;
+    channel_data[CHAN_V_not_H]   = V_not_H;
+
+    /* The range window of the echoes; the TX monitors from the pulse */
+    for (i = 0; i < 8; i++)
+	channel_first[i] = param.first_gate;
+    channel_first[CHAN_T1]      = 0;
+    channel_first[CHAN_T2]      = 0;
+    channel_first[CHAN_V_not_H] = 0;
+
+    /* The backend writes banks in the same layout as the DMA */
+    daq_config.samples_per_pulse = param.samples_per_pulse_acquired;
+    daq_config.pulses            = num_pulses * param.spectra_averaged;
+    daq_config.channels          = param.ADC_channels;
+    daq_config.clock_divfactor   = param.clock_divfactor;
+    daq_config.delay_clocks      = param.delay_clocks;
+    daq_config.source            = daq_source;
+    daq_config.first_record      = replay_first;
+    daq_config.records           = replay_records;
+    daq_config.once              = offline;
+    memcpy (daq_config.offset, channel_offset, sizeof (daq_config.offset));
+
+    /* What the synthetic backend transmits; its PHIDP reads true after */
+    /* the processing removes phidp_offset                              */
+    daq_config.mode              = mode;
+    daq_config.prt               = param.prt;
+    daq_config.pulse_delay       = param.pulse_offset * 1e-6;
+    daq_config.delay_gates       = gate_offset;
+    daq_config.wavelength        = SPEED_LIGHT / (param.frequency * 1e9);
+    daq_config.system_phase      = -param.phidp_offset;
+
+    printf ("** Initialising %s acquisition...\n", daq_backend->name);
+    if (RDQ_Open (&daq, daq_backend, &daq_config) != 0)
+    {
+	return 2;
+    }
 
-    /* Initialise pointers to DMA banks */
-    dma_banks[ 0 ] = (uint16_t *) dma_buffer;
-    dma_banks[ 1 ] = (uint16_t *) (dma_buffer + (DMA_BUFFER_SIZE >> 1));
+    /* Offline files are named and dated by the first replayed ray */
+    if (offline && daq.start_time.tv_sec != 0)
+    {
+	gmtime_r (&daq.start_time.tv_sec, &tm);
+	strftime (scan.date, sizeof (scan.date), "%Y%m%d%H%M%S", &tm);
+	start_day = tm.tm_mday;
+    }
 
-    make_dmux_table (param.ADC_channels, dmux_table);
+    /* Everything is allocated: lock it, and move the ray loop to its core */
+    if (RRT_Setup (&rt_config, &rt_report) != 0)
+	RLG_LOG (RLG_WARN, "Real-time setup incomplete: %s\n", rt_report.summary);
+    else
+	RLG_LOG (RLG_INFO, "Real-time setup: %s\n", rt_report.summary);
+    param.realtime = rt_report.summary;
 
     printf ("** Starting acquisition...\n");
 
+next_scan:
+    /*-----------------------------------------------*
+     * -daemon: wait for the command of the next scan *
+     *-----------------------------------------------*/
+    if (control_fd >= 0)
+    {
+	snprintf (control_state, sizeof (control_state), "idle");
+	if (!control_poll (0) && bank_running)
+	{
+	    /* nothing to record: let the bank acquiring finish */
+	    RDQ_WaitBank (&daq, &bank_info);
+	    bank_running = false;
+	}
+	while (!exit_now && !control_poll (100))
+	    ;
+	if (exit_now)
+	    goto exit_daemon;
+	if (control_apply (argv[0], &param, &scan, &start_day, &scan_argc, &scan_argv) != 0)
+	    goto next_scan;
+
+	set_wivern_modes (&param, chip_length_n100ns, wivern_mode);
+	setup_modes (&param, wivern_mode, gate_offset, modes);
+	param.mode0 &= 0x07;
+	param.mode1 &= 0x07;
+	if (modes[0].num_tx_pol > run_tx_pol ||
+	    (param.alternate_modes != 0 && modes[1].num_tx_pol > run_tx_pol))
+	{
+	    RLG_LOG (RLG_ERROR, "The modes of the scan transmit H and V, not set up at the start: scan not recorded\n");
+	    goto next_scan;
+	}
+	if (!window_fits_modes (&param))
+	{
+	    RLG_LOG (RLG_ERROR, "The double pulse modes of the scan do not fit the range window: scan not recorded\n");
+	    goto next_scan;
+	}
+	/* start in mode0: the bank acquiring is dropped if not in it */
+	ray_mode         = 0;
+	param.num_tx_pol = modes[ray_mode].num_tx_pol;
+
+	scanEnd    = false;
+	scan_exits = -1;
+	obs.ray_number     = 0;
+	obs.PSD_ray_number = 0;
+	PSD_obs.ray_number     = 0;
+	PSD_obs.PSD_ray_number = 0;
+	PSD_obs.bin_ray_number = 0;
+	tsfid              = NULL;
+	ncidts             = -1;
+	spectra_ncid       = -1;
+	spectra_rapid_ncid = -1;
+
+	/* The bank acquiring is the first of the scan, unless the scan
+	 * waits for the dish: then a bank is started as it comes in */
+	if (bank_running && positionMessageAct && scan_axis (scan.scanType) >= 0)
+	{
+	    RDQ_WaitBank (&daq, &bank_info);
+	    bank_running = false;
+	}
+
+	snprintf (control_state, sizeof (control_state), "recording %s scan %d of %s",
+		  GetScanTypeName (scan.scanType), scan.scan_number, scan.date);
+	RLG_LOG (RLG_INFO, "Recording %s scan %d\n", GetScanTypeName (scan.scanType), scan.scan_number);
+    }
+
     /* load in current dish_time */
     if (positionMessageAct)
     {
@@ -1648,6 +3043,7 @@ main (int    argc,
 	obs.dish_minute      = position_msg.min;
 	obs.dish_second      = position_msg.sec;
 	obs.dish_centisecond = position_msg.centi_sec;
+	obs.dish_latency     = position_msg.latency;
     }
     else
     {
@@ -1667,120 +3063,31 @@ main (int    argc,
 	obs.elevation   = scan.min_angle;
     }
 
-    /* setup the netCDF file */
-    ncid = RNC_OpenNetcdfFile (GetRadarName (GALILEO),
-			       GetSpectraName (GALILEO),
-			       scan.date, host_ext,
-			       GetScanTypeName (scan.scanType),
-			       GetSpectraExtension (GALILEO), "raw");
-    printf ("Check 2\n");
-    RNC_SetupDimensions (ncid, &param, &dimensions);
-    printf ("Check 3\n");
-    RNC_SetupGlobalAttributes (ncid, GALILEO, &scan, &param, argc, argv);
-    file_stateid = RNC_SetupFile_State (ncid);
-    RNC_SetupStaticVariables (ncid, GALILEO, &param);
-    printf ("Check 4\n");
-    RNC_SetupRange (ncid, &param, &dimensions);
-    printf ("Check 5\n");
-    RNC_SetupDynamicVariables (ncid, GALILEO, &scan, &param, &dimensions, &obs);
-
-    /* change the mode of netCDF from define to data */
-    status = nc_enddef (ncid);
-    if (status != NC_NOERR) check_netcdf_handle_error (status);
-
-    /* Set up spectral dump file */
-    if (param.dump_spectra != 0)
-    {
-	spectra_ncid = RNC_OpenNetcdfFile
-	    (GetRadarName (GALILEO_SPECTRA), GetSpectraName (GALILEO_SPECTRA),
-	     scan.date, host_ext, GetScanTypeName (scan.scanType),
-	     GetSpectraExtension (GALILEO_SPECTRA), "raw");
-	RNC_SetupDimensions (spectra_ncid, &param, &dimensions);
-	RNC_SetupGlobalAttributes (spectra_ncid, GALILEO, &scan, &param, argc, argv);
-	RNC_SetupStaticVariables (spectra_ncid, GALILEO, &param);
-	RNC_SetupRange (spectra_ncid, &param, &dimensions);
-	RNC_SetupDynamicVariables (spectra_ncid, GALILEO_SPECTRA, &scan, &param, &dimensions, &PSD_obs);
-	RNC_SetupLogPSDVariables (spectra_ncid, GALILEO_SPECTRA, &param, &dimensions, PSD_varid);
-
-	/* change the mode of netCDF from define to data */
-	status = nc_enddef (spectra_ncid);
-	if (status != NC_NOERR) check_netcdf_handle_error (status);
-
-	/* set the time at which a spectra will be dumped */
-	time (&temp_time_t);
-	spectra_time = param.dump_spectra * (floorl (temp_time_t / param.dump_spectra) + 1.0);
-    }
-
-    if (param.dump_spectra_rapid != 0)
-    {
-	/* make sure bin_ray_number is 0 */
-	PSD_RAPID_obs.bin_ray_number = 0;
-	PSD_RAPID_obs.ray_number = 0;
-
-	spectra_rapid_ncid = RNC_OpenNetcdfFile
-	    (GetRadarName (GALILEO_SPECTRA_RAPID),
-	     GetSpectraName (GALILEO_SPECTRA_RAPID),
-	     scan.date, host_ext, GetScanTypeName (scan.scanType),
-	     GetSpectraExtension (GALILEO_SPECTRA_RAPID), "raw");
-	RNC_SetupRapidLogPSDDimensions (spectra_rapid_ncid, GALILEO_SPECTRA_RAPID, &param, &dimensions);
-	RNC_SetupGlobalAttributes (spectra_rapid_ncid, GALILEO, &scan, &param, argc, argv);
-	RNC_SetupStaticVariables (spectra_rapid_ncid, GALILEO, &param);
-	RNC_SetupRange (spectra_rapid_ncid, &param, &dimensions);
-	RNC_SetupDynamicVariables (spectra_rapid_ncid, GALILEO_SPECTRA_RAPID, &scan, &param, &dimensions, &PSD_RAPID_obs);
-	RNC_SetupLogPSDVariables (spectra_rapid_ncid, GALILEO_SPECTRA_RAPID, &param, &dimensions, PSD_rapid_varid);
-
-	/* change the mode of netCDF from define to data */
-	status = nc_enddef (spectra_rapid_ncid);
-	if (status != NC_NOERR) check_netcdf_handle_error (status);
-
-	/* set the time at which a spectra will be dumped */
-	time (&temp_time_t);
-	spectra_rapid_time = param.dump_spectra_rapid * (floorl (temp_time_t / param.dump_spectra_rapid) + 1.0);
-    }
-
-    if (tsdump)
-    {
-	if (TextTimeSeries)
-	{
-	    /* Setup the time-series dump file */
-	    tsfid = RTS_OpenTSFile (GetRadarName (GALILEO), scan.date, host_ext,
-				    GetScanTypeName (scan.scanType));
-
-	    if (tsfid == NULL)
-	    {
-		tsdump = false;
-		printf ("**** Can't open time series file: %m ****\n");
-		printf ("**** Time series recording off ****\n");
-	    }
-	    else
-	    {
-		fprintf (tsfid, "npulse: %d\n", num_pulses * param.spectra_averaged);
-		fprintf (tsfid, "nsample: %d\n", param.samples_per_pulse_ts);
-		fprintf (tsfid, "divfactor: %d\n", param.clock_divfactor);
-		fprintf (tsfid, "delayclocks: %d\n", param.delay_clocks);
-		fprintf (tsfid, "ADC_channels: %d\n", param.ADC_channels);
-	    }
-	}
-	else
-	{
-	    /* NetCDF Time series */
-	    RNC_DimensionStruct dimensionsts;
-
-	    memset (&dimensionsts, 0, sizeof (dimensionsts));
-	    ncidts = RNC_OpenNetcdfFile (GetRadarName (GALILEO), "ts",
-					 scan.date, host_ext,
-					 GetScanTypeName (scan.scanType),
-					 "", "ts");
-	    RNC_SetupDimensions (ncidts, &param, &dimensionsts);
-	    RNC_SetupGlobalAttributes (ncidts, GALILEO, &scan, &param, argc, argv);
-	    RNC_SetupStaticVariables (ncidts, GALILEO, &param);
-	    RNC_SetupRange (ncidts, &param, &dimensionsts);
-	    SetupTimeSeriesVariables (&tsobs, ncidts, &param, &scan, &dimensionsts, &obs);
-
-	    status = nc_enddef (ncidts);
-	    if (status != NC_NOERR) check_netcdf_handle_error (status);
-	}
-    }
+    /*------------------------------------------------------------*
+     * The files of the scan, made while the bank carried over is  *
+     * collected and the next started (see scan_files_wait)        *
+     *------------------------------------------------------------*/
+    scan_files.param         = param;
+    scan_files.scan          = scan;
+    scan_files.host_ext      = host_ext;
+    scan_files.argc          = scan_argc;
+    scan_files.argv          = scan_argv;
+    scan_files.num_pulses    = num_pulses;
+    scan_files.obs           = &obs;
+    scan_files.PSD_obs       = &PSD_obs;
+    scan_files.PSD_RAPID_obs = &PSD_RAPID_obs;
+    scan_files.tsobs         = &tsobs;
+    scan_files.ncid               = &ncid;
+    scan_files.file_stateid       = &file_stateid;
+    scan_files.spectra_ncid       = &spectra_ncid;
+    scan_files.spectra_rapid_ncid = &spectra_rapid_ncid;
+    scan_files.PSD_varid          = PSD_varid;
+    scan_files.PSD_rapid_varid    = PSD_rapid_varid;
+    scan_files.spectra_time       = &spectra_time;
+    scan_files.spectra_rapid_time = &spectra_rapid_time;
+    scan_files.tsfid              = &tsfid;
+    scan_files.ncidts             = &ncidts;
+    scan_files_ask ();
 
     /*---------------------*
      * Wait for scan start *
@@ -1788,36 +3095,43 @@ main (int    argc,
     if (positionMessageAct)
     {
 	wait_scan_start (scan.scanType, &position_msg,
-			 scan.min_angle, scan.max_angle);
-	if (exit_now)
+			 scan.min_angle, scan.max_angle, &scan_window);
+	if (exit_now || control_line[0] != '\0')
 	    goto exit_endacquisition;
+	if (scan_axis (scan.scanType) >= 0)
+	    scan_exits = scan_window.exits;
+    }
+
+    /* With -daemon the bank started as the last scan ended may still be
+     * acquiring: it is the first of this one */
+    if (!bank_running)
+    {
+	if (bank_C.value != modes[ray_mode].dio)
+	    switch_mode (fd, &bank_C, &daq, &modes[ray_mode]);
+	bank_dio[dma_bank] = bank_C.value;
+	RDQ_StartBank (&daq, dma_bank);
+	bank_running = true;
     }
 
-    RDQ_StartAcquisition (amcc_fd, dma_bank,
-			  (short *)(dma_banks[dma_bank]), tcount);
+#ifndef RST_NO_TIMING
+    timing_open (scan.date, GetScanTypeName (scan.scanType));
+#endif /* RST_NO_TIMING */
+    RST_RESTART (&timing);
 
     int ray_count = 0;
-    int remainder = -1;
 
     /*-----------------------------------------*
      * THIS IS THE START OF THE OUTER RAY LOOP *
      *-----------------------------------------*/
     while (!scanEnd && !exit_now)
     {
-	printf ("ray number: %d\n", obs.ray_number);
-	printf ("\n<< PRESS CTRL-C TO EXIT >>\n");
+	RLG_LOG (RLG_INFO, "ray number: %d\n", obs.ray_number);
+	RLG_LOG (RLG_DEBUG, "<< PRESS CTRL-C TO EXIT >>\n");
 
 	ray_count++;
 
 	/* Initialise observables to zero (Needed for moments averaging) */
-	for (i = 0; i < obs.n_obs; i++)
-	{
-	    printf ("Initialising %s\n", obs.name[i]);
-	    for (j = 0; j < obs.n_elements [i]; j++)
-	    {
-		obs.data[i][j] = 0.0f;
-	    }
-	}
+	RSP_ObsClear (&obs);
 
 	for (j = 0; j < param.samples_per_pulse; j++)
 	{
@@ -1860,71 +3174,44 @@ main (int    argc,
 	    PV0_FD_odd[j]       = 0.0f;
 	}
 
-	printf ("Done initialising variables...\n");
+	RLG_LOG (RLG_DEBUG, "Done initialising variables...\n");
+
+	/* The ray is processed as its mode, worked out in modes[] */
+	next_mode        = next_ray_mode (&param, ray_count);
+	mode             = modes[ray_mode].mode;
+	mode_gate_offset = modes[ray_mode].gate_offset;
+	mode_v_delay     = modes[ray_mode].v_delay;
+	param.num_tx_pol = modes[ray_mode].num_tx_pol;
 
-	/* This step should mean we discard data in proc bank at time of mode change */
-	if (new_mode >= 0)
+	/* The modes switch at the bank boundary before each ray (see the
+	 * moments loop), so the bank acquiring is in the ray's mode. Only at
+	 * the start of a -daemon scan in other modes is it not: it is then
+	 * discarded, and the ray starts with a bank acquired in its mode. */
+	if (bank_dio[dma_bank] != modes[ray_mode].dio)
 	{
-	    /* Wait for acquisition to complete before setting new mode */
-	    status = RDQ_WaitForAcquisitionToComplete (amcc_fd);
+	    RST_LAP (&timing, ST_SETUP);
+	    status = RDQ_WaitBank (&daq, &bank_info);
+	    RST_LAP (&timing, ST_WAIT_BANK);
+	    note_bank (&obs, &bank_info);
 	    if (status != 0)
-		printf ("There was a problem in WaitForAcquisitionToComplete\n");
+		RLG_LOG (RLG_ERROR, "There was a problem in WaitForAcquisitionToComplete (%d)\n", status);
 
 	    /* Swap around the areas used for storing datq and processing from */
 	    dma_bank  = 1 - dma_bank;
 	    proc_bank = 1 - proc_bank	;
 
-	    /* Set new mode */
-	    bank_C.id    = IXPIO_P2;
-	    bank_C.value = wivern_mode[new_mode];
-
-	    {
-		mode             = (new_mode == 1) ? param.mode1 : param.mode0;
-		mode_gate_offset = (mode < PM_Double_H) ? param.samples_per_pulse : gate_offset;
-
-		/* Fixup param.num_tx_pol for mode */
-		switch (mode & 0x07)
-		{
-		case PM_Undefined0:
-		    param.num_tx_pol = 1;
-		    break;
-		case PM_Single_H:
-		case PM_Single_V:
-		case PM_Double_H:
-		case PM_Double_V:
-		    param.num_tx_pol = 1;
-		    break;
-		case PM_Single_HV:
-		case PM_Double_HV_VH:
-		case PM_Double_HV_HV:
-		    param.num_tx_pol = 2;
-		    break;
-		}
-		// /* Hard code to 2 as using 1 breaks ffts */
-		// param.num_tx_pol = 2;
-	    }
-
-#ifndef NO_DIO
-	    if (ioctl (fd, IXPIO_WRITE_REG, &bank_C))
-	    {
-		perror ("Can't write bank_C");
-		printf ("Can't write bank_C value 0x%x\n", bank_C.value);
-	    }
-	    else
-	    {
-		printf ("Writing 0x%x to bank_C\n", bank_C.value);
-	    }
-#endif /* NO_DIO */
-	    new_mode = -1;
+	    switch_mode (fd, &bank_C, &daq, &modes[ray_mode]);
 
 	    /*---------------------------------------------------------------------*
 	     * Wait untill just before next H pulse to prevent HV timeout.         *
 	     *---------------------------------------------------------------------*/
-	    usleep (RetriggerDelayTime);
+	    if (daq_backend->hardware)
+		retrigger_wait (&bank_info, RetriggerDelayTime, param.prt);
 
-	    data = dma_banks[proc_bank];
-	    RDQ_StartAcquisition (amcc_fd, dma_bank,
-				  (short *)(dma_banks[dma_bank]), tcount);
+	    data = daq.banks[proc_bank];
+	    bank_dio[dma_bank] = bank_C.value;
+	    RDQ_StartBank (&daq, dma_bank);
+	    RST_LAP (&timing, ST_RETRIGGER);
 	}
 
         /*----------------------------------------------*
@@ -1948,44 +3235,106 @@ main (int    argc,
 	    }
 
 	    /* Wait for data acquisition to complete */
-	    status = RDQ_WaitForAcquisitionToComplete (amcc_fd);
+	    RST_LAP (&timing, ST_SETUP);
+	    status = RDQ_WaitBank (&daq, &bank_info);
+	    RST_LAP (&timing, ST_WAIT_BANK);
+	    note_bank (&obs, &bank_info);
+	    if (status == RDQ_STATUS_END)
+	    {
+		/* Replayed to the end: the incomplete ray is not written */
+		exit_now = true;
+		break;
+	    }
 	    if (status != 0)
-		printf ("There was a problem in WaitForAcquisitionToComplete\n");
+		RLG_LOG (RLG_ERROR, "There was a problem in WaitForAcquisitionToComplete (%d)\n", status);
 
 	    /* Swap around the areas used for storing daq and processing from */
 	    dma_bank  = 1 - dma_bank;
 	    proc_bank = 1 - proc_bank;
 
+	    /* The bank started after the last of the ray is the first of the
+	     * next: switch the mode now, at the bank boundary, and no bank is
+	     * lost to the switch */
+	    if (nm == param.moments_averaged - 1 && bank_C.value != modes[next_mode].dio)
+		switch_mode (fd, &bank_C, &daq, &modes[next_mode]);
+
 	    /*---------------------------------------------------------------------*
 	     * Wait untill just before next H pulse to prevent HV timeout.         *
 	     *---------------------------------------------------------------------*/
-	    usleep (RetriggerDelayTime);
+	    if (daq_backend->hardware)
+		retrigger_wait (&bank_info, RetriggerDelayTime, param.prt);
+
+	    data = daq.banks[proc_bank];
+	    bank_dio[dma_bank] = bank_C.value;
+	    RDQ_StartBank (&daq, dma_bank);
+	    RST_LAP (&timing, ST_RETRIGGER);
+
+	    /* The first bank is in, the next acquiring: the files of the
+	     * scan are wanted from here on */
+	    if (ray_count == 1 && nm == 0)
+		scan_files_wait ();
+
+	    /* The dish left the scan window before this bank started: the
+	     * last ray of the sweep ends with the banks before it (the
+	     * moments are normalised by the weights summed over the banks) */
+	    if (nm > 0 && scan_exits >= 0)
+	    {
+		const uint64_t bank_start_ns = (uint64_t)bank_info.completed.tv_sec * 1000000000u
+		                               + bank_info.completed.tv_nsec
+		                               - (uint64_t)(param.daq_time * 1e9);
 
-	    data = dma_banks[proc_bank];
-	    RDQ_StartAcquisition (amcc_fd, dma_bank,
-				  (short *)(dma_banks[dma_bank]), tcount);
+		RSM_WindowState (&scan_window);
+		if (scan_window.exits > scan_exits && scan_window.left_ns <= bank_start_ns)
+		{
+		    RLG_LOG (RLG_INFO, "Last ray trimmed to %d of %d banks at the scan end\n",
+			     nm, param.moments_averaged);
+		    break;
+		}
+	    }
 
-	    /* get timeofday */
-	    gettimeofday (&tv, NULL);
-	    gmtime_r (&tv.tv_sec, &tm);
+	    /* -daemon: a new command ends the scan here, and the bank just
+	     * started is the first of the next one */
+	    if (control_poll (0))
+	    {
+		if (nm > 0)
+		    RLG_LOG (RLG_INFO, "Ray trimmed to %d of %d banks for the next scan\n",
+			     nm, param.moments_averaged);
+		break;
+	    }
+
+	    /* time the bank completed */
+	    gmtime_r (&bank_info.time.tv_sec, &tm);
 	    obs.year        = tm.tm_year + 1900;
 	    obs.month       = tm.tm_mon  + 1;
 	    obs.day         = tm.tm_mday;
 	    obs.hour        = tm.tm_hour;
 	    obs.minute      = tm.tm_min;
 	    obs.second      = tm.tm_sec;
-	    obs.centisecond = (int)tv.tv_usec/10000;
-	    sprintf (datestring,"%04d/%02d/%02d %02d:%02d:%02d.%02d",
+	    obs.centisecond = (int)(bank_info.time.tv_nsec / 10000000);
+	    RLG_LOG (RLG_INFO, "Date time: %04d/%02d/%02d %02d:%02d:%02d.%02d\n",
 		     obs.year, obs.month,  obs.day,
 		     obs.hour, obs.minute, obs.second, obs.centisecond);
-	    printf ("Date time: %s\n",datestring);
 
 	    /* obtain dish time */
 	    if (positionMessageAct)
 	    {
+		const uint64_t bank_end_ns = (uint64_t)bank_info.completed.tv_sec * 1000000000u
+		                             + bank_info.completed.tv_nsec;
+		double         az, el;
+
+		if (nm == 0)
+		    ray_start_ns = bank_end_ns - (uint64_t)(param.daq_time * 1e9);
+
 		RSM_ReadPositionMessage (&position_msg);
 		obs.azimuth          = position_msg.az;
 		obs.elevation        = position_msg.el;
+
+		/* Rather the mean beam position over the banks of the ray so far */
+		if (RSM_PositionMean (ray_start_ns, bank_end_ns, &az, &el) == 0)
+		{
+		    obs.azimuth   = az;
+		    obs.elevation = el;
+		}
 		obs.dish_year        = position_msg.year;
 		obs.dish_month       = position_msg.month;
 		obs.dish_day         = position_msg.day;
@@ -1993,13 +3342,22 @@ main (int    argc,
 		obs.dish_minute      = position_msg.min;
 		obs.dish_second      = position_msg.sec;
 		obs.dish_centisecond = position_msg.centi_sec;
+		obs.dish_latency     = position_msg.latency;
 	    }
 	    else
 	    {
 		struct tm tm;
 		struct timeval tv;
 
-		gettimeofday (&tv, NULL);
+		if (offline)
+		{
+		    tv.tv_sec  = bank_info.time.tv_sec;
+		    tv.tv_usec = bank_info.time.tv_nsec / 1000;
+		}
+		else
+		{
+		    gettimeofday (&tv, NULL);
+		}
 		gmtime_r (&tv.tv_sec, &tm);
 		obs.dish_year        = tm.tm_year + 1900;
 		obs.dish_month       = tm.tm_mon + 1;
@@ -2011,16 +3369,28 @@ main (int    argc,
 
 		obs.azimuth     = scan.scan_angle;
 		obs.elevation   = scan.min_angle;
+
+		/* Replayed banks carry where the antenna pointed */
+		if (bank_info.positioned)
+		{
+		    obs.azimuth   = bank_info.azimuth - param.azimuth_offset;
+		    obs.elevation = bank_info.elevation;
+		}
 	    }
 
-	    PSD_obs.elevation       = obs.elevation;
-	    PSD_obs.azimuth         = obs.azimuth;
-	    PSD_RAPID_obs.elevation = obs.elevation;
-	    PSD_RAPID_obs.azimuth   = obs.azimuth;
+	    PSD_obs.elevation          = obs.elevation;
+	    PSD_obs.azimuth            = obs.azimuth;
+	    PSD_obs.dish_latency       = obs.dish_latency;
+	    PSD_RAPID_obs.elevation    = obs.elevation;
+	    PSD_RAPID_obs.azimuth      = obs.azimuth;
+	    PSD_RAPID_obs.dish_latency = obs.dish_latency;
 
 	    if (tsfid != NULL)
 	    {
 		/* time-series ray header */
+		sprintf (datestring,"%04d/%02d/%02d %02d:%02d:%02d.%02d",
+			 obs.year, obs.month,  obs.day,
+			 obs.hour, obs.minute, obs.second, obs.centisecond);
 		fprintf (tsfid, "Ray_number: %d, %d\n", obs.ray_number, nm);
 		fprintf (tsfid, "Date_time: %s\n", datestring);
 		fprintf (tsfid, "Az: %7.2f, El: %7.2f\n",
@@ -2050,44 +3420,37 @@ main (int    argc,
 		}
 	    }
 
+	    RST_LAP (&timing, ST_POSITION);
+
 	    for (idx = nspectra = 0; nspectra < param.spectra_averaged; nspectra++)
 	    {
 		/*----------------------------------------------------------------*
 		 * Extract data from DMA memory                                   *
 		 *----------------------------------------------------------------*/
-		for (i = 0; i < num_pulses; i++)
+		RSP_DemuxWindow (data, param.ADC_channels, num_pulses, param.samples_per_pulse_acquired,
+				 channel_first, param.samples_per_pulse, channel_offset, channel_data);
+		INC_POINTER (data, num_pulses * param.samples_per_pulse_acquired * param.ADC_channels);
+
+		/* keep the raw (undecoded) samples for the time series */
+		memcpy (tsobs.ICOH     + idx, I_uncoded_copolar_H,    bank_samples * sizeof (uint16_t));
+		memcpy (tsobs.QCOH     + idx, Q_uncoded_copolar_H,    bank_samples * sizeof (uint16_t));
+		memcpy (tsobs.ICXH     + idx, I_uncoded_crosspolar_H, bank_samples * sizeof (uint16_t));
+		memcpy (tsobs.QCXH     + idx, Q_uncoded_crosspolar_H, bank_samples * sizeof (uint16_t));
+		memcpy (tsobs.TxPower1 + idx, TX1data,                bank_samples * sizeof (uint16_t));
+		memcpy (tsobs.TxPower2 + idx, TX2data,                bank_samples * sizeof (uint16_t));
+		memcpy (tsobs.VnotH    + idx, V_not_H,                bank_samples * sizeof (uint16_t));
+		memcpy (tsobs.RawLog   + idx, log_raw,                bank_samples * sizeof (uint16_t));
+		idx += bank_samples;
+
+		if (tsfid != NULL)
 		{
-		    register int count_reg;
-
-		    for (j = 0; j < param.samples_per_pulse; j++)
+		    /* time-series dump */
+		    for (i = 0; i < num_pulses; i++)
 		    {
-			count_reg = (i * param.samples_per_pulse) + j;
-			if (swap_iq_channels)
-			{
-			    tsobs.ICOH[idx]   = I_uncoded_copolar_H[count_reg]    = GET_CHANNEL (data, SWAP_CHAN_Ic);
-			    tsobs.QCOH[idx]   = Q_uncoded_copolar_H[count_reg]    = GET_CHANNEL (data, SWAP_CHAN_Qc);
-			    tsobs.ICXH[idx]   = I_uncoded_crosspolar_H[count_reg] = GET_CHANNEL (data, SWAP_CHAN_Ix);
-			    tsobs.QCXH[idx]   = Q_uncoded_crosspolar_H[count_reg] = GET_CHANNEL (data, SWAP_CHAN_Qx);
-			}
-			else
+			for (j = 0; j < param.samples_per_pulse_ts && j < param.samples_per_pulse; j++)
 			{
-			    tsobs.ICOH[idx]   = I_uncoded_copolar_H[count_reg]    = GET_CHANNEL (data, CHAN_Ic);
-			    tsobs.QCOH[idx]   = Q_uncoded_copolar_H[count_reg]    = GET_CHANNEL (data, CHAN_Qc);
-			    tsobs.ICXH[idx]   = I_uncoded_crosspolar_H[count_reg] = GET_CHANNEL (data, CHAN_Ix);
-			    tsobs.QCXH[idx]   = Q_uncoded_crosspolar_H[count_reg] = GET_CHANNEL (data, CHAN_Qx);
-			}
-
-			tsobs.TxPower1[idx] = TX1data[count_reg] = GET_CHANNEL (data, CHAN_T1);
-			tsobs.TxPower2[idx] = TX2data[count_reg] = GET_CHANNEL (data, CHAN_T2);
-			tsobs.VnotH[idx]    = V_not_H[count_reg] = GET_CHANNEL (data, CHAN_V_not_H);
-			tsobs.RawLog[idx]   = log_raw[count_reg] = GET_CHANNEL (data, CHAN_INC);
+			    register int count_reg = (i * param.samples_per_pulse) + j;
 
-			INC_POINTER (data, param.ADC_channels);
-			idx++;
-
-			if (tsfid != NULL && (j < param.samples_per_pulse_ts))
-			{
-			    /* time-series dump */
 			    fprintf (tsfid, "%d %d %hu %hu %hu %hu %hu %hu %hu\n",
 				     i + (nspectra * num_pulses), j,
 				     I_uncoded_copolar_H[count_reg],
@@ -2101,6 +3464,30 @@ main (int    argc,
 		    }
 		}
 
+		RST_LAP (&timing, ST_DEMUX);
+
+		/*----------------------------------------------------------------*
+		 * The echoes for the processing, decoded if the pulses are      *
+		 * coded (time series and spectra dump keep the raw data)        *
+		 *----------------------------------------------------------------*/
+		if (param.code_length > 1)
+		{
+		    const int streams = param.num_tx_pol;
+
+		    RSP_PulseCompress (&pulse_compress, I_uncoded_copolar_H, Q_uncoded_copolar_H,
+				       I_copolar, Q_copolar, num_pulses, streams);
+		    RSP_PulseCompress (&pulse_compress, I_uncoded_crosspolar_H, Q_uncoded_crosspolar_H,
+				       I_crosspolar, Q_crosspolar, num_pulses, streams);
+		}
+		else
+		{
+		    RSP_ADCToFloat (I_uncoded_copolar_H,    I_copolar,    bank_samples);
+		    RSP_ADCToFloat (Q_uncoded_copolar_H,    Q_copolar,    bank_samples);
+		    RSP_ADCToFloat (I_uncoded_crosspolar_H, I_crosspolar, bank_samples);
+		    RSP_ADCToFloat (Q_uncoded_crosspolar_H, Q_crosspolar, bank_samples);
+		}
+		RST_LAP (&timing, ST_PULSE_COMPRESS);
+
 		// Create artificial IQ data to test code
 		// art_vel   = -2.0;
 		// art_phidp = 0.0 * PI / 180.0;
@@ -2161,7 +3548,7 @@ main (int    argc,
 		    {
 			for (j = 0; j < 20; j++)
 			{
-			    printf ("V_not_H = %d \n",V_not_H[j]);
+			    RLG_LOG (RLG_DEBUG, "V_not_H = %d \n", V_not_H[j]);
 			}
 		    }
 
@@ -2169,13 +3556,13 @@ main (int    argc,
 		    {
 			/* this means first pulse is horizontal */
 			horizontal_first = 1;
-			printf ("The first pulse is horizontal\n");
+			RLG_LOG (RLG_INFO, "The first pulse is horizontal\n");
 		    }
 		    else
 		    {
 			/* this means first pulse is vertical */
 			horizontal_first = 0;
-			printf ("The first pulse is vertical\n");
+			RLG_LOG (RLG_INFO, "The first pulse is vertical\n");
 		    }
 		}
 
@@ -2246,7 +3633,7 @@ main (int    argc,
 		*TX_2B *= 3000.0 / 4096.0;
 
 
-		if (mode < PM_Single_HV)
+		if (param.num_tx_pol == 1)
 		{
 		    for (sample = 0; sample < param.samples_per_pulse - mode_gate_offset; sample++)
 		    {
@@ -2256,23 +3643,23 @@ main (int    argc,
 			{
 			    idx = (ii * param.samples_per_pulse) + sample;
 
-			    if (mode == PM_Single_H)
+			    if (mode == PM_Single_H || mode == PM_Double_H)
 			    {
-				fftw_real_lv (H_odd[ii])  = I_uncoded_copolar_H   [idx];
-				fftw_imag_lv (H_odd[ii])  = Q_uncoded_copolar_H   [idx];
-				fftw_real_lv (V_odd[ii])  = I_uncoded_crosspolar_H[idx + mode_gate_offset];
-				fftw_imag_lv (V_odd[ii])  = Q_uncoded_crosspolar_H[idx + mode_gate_offset];
-				fftw_real_lv (V0_odd[ii]) = I_uncoded_crosspolar_H[idx];
-				fftw_imag_lv (V0_odd[ii]) = Q_uncoded_crosspolar_H[idx];
+				fftw_real_lv (H_odd[ii])  = I_copolar   [idx];
+				fftw_imag_lv (H_odd[ii])  = Q_copolar   [idx];
+				fftw_real_lv (V_odd[ii])  = I_crosspolar[idx + mode_gate_offset];
+				fftw_imag_lv (V_odd[ii])  = Q_crosspolar[idx + mode_gate_offset];
+				fftw_real_lv (V0_odd[ii]) = I_crosspolar[idx];
+				fftw_imag_lv (V0_odd[ii]) = Q_crosspolar[idx];
 			    }
 			    else
 			    {
-				fftw_real_lv (H_even[ii])  = I_uncoded_copolar_H   [idx + mode_gate_offset];
-				fftw_imag_lv (H_even[ii])  = Q_uncoded_copolar_H   [idx + mode_gate_offset];
-				fftw_real_lv (V_even[ii])  = I_uncoded_crosspolar_H[idx];
-				fftw_imag_lv (V_even[ii])  = Q_uncoded_crosspolar_H[idx];
-				fftw_real_lv (H0_even[ii]) = I_uncoded_copolar_H   [idx];
-				fftw_imag_lv (H0_even[ii]) = Q_uncoded_copolar_H   [idx];
+				fftw_real_lv (H_even[ii])  = I_copolar   [idx + mode_gate_offset];
+				fftw_imag_lv (H_even[ii])  = Q_copolar   [idx + mode_gate_offset];
+				fftw_real_lv (V_even[ii])  = I_crosspolar[idx];
+				fftw_imag_lv (V_even[ii])  = Q_crosspolar[idx];
+				fftw_real_lv (H0_even[ii]) = I_copolar   [idx];
+				fftw_imag_lv (H0_even[ii]) = Q_copolar   [idx];
 			    }
 			}
 
@@ -2283,20 +3670,16 @@ main (int    argc,
 			RSP_SubtractOffset_FFTW (H0_even, param.nfft);
 			RSP_SubtractOffset_FFTW (V0_odd , param.nfft);
 
-			for (ii = 0; ii < param.nfft; ii++)
-			{
-			    PH_VD[sample]       += (fftw_real (H_odd [ii]) * fftw_real (H_odd [ii]) + fftw_real (H_even[ii]) * fftw_real (H_even[ii]));
-			    PH_VD[sample]       += (fftw_imag (H_odd [ii]) * fftw_imag (H_odd [ii]) + fftw_imag (H_even[ii]) * fftw_imag (H_even[ii]));
-			    PV_VD[sample]       += (fftw_real (V_odd [ii]) * fftw_real (V_odd [ii]) + fftw_real (V_even[ii]) * fftw_real (V_even[ii]));
-			    PV_VD[sample]       += (fftw_imag (V_odd [ii]) * fftw_imag (V_odd [ii]) + fftw_imag (V_even[ii]) * fftw_imag (V_even[ii]));
-
-			    PH_VD_even[sample]  += (fftw_real (H_even[ii]) * fftw_real (H_even[ii]) + fftw_imag (H_even[ii]) * fftw_imag (H_even[ii]));
-			    PV_VD_even[sample]  += (fftw_real (V_even[ii]) * fftw_real (V_even[ii]) + fftw_imag (V_even[ii]) * fftw_imag (V_even[ii]));
-			    PH0_FD_even[sample] += (fftw_real (H0_even[ii]) * fftw_real (H0_even[ii]) + fftw_imag (H0_even[ii]) * fftw_imag (H0_even[ii]));
-			    PV0_FD_odd[sample]  += (fftw_real (V0_odd [ii]) * fftw_real (V0_odd [ii]) + fftw_imag (V0_odd [ii]) * fftw_imag (V0_odd [ii]));
-			    PH_VD_odd[sample]   += (fftw_real (H_odd [ii]) * fftw_real (H_odd [ii]) + fftw_imag (H_odd [ii]) * fftw_imag (H_odd [ii]));
-			    PV_VD_odd[sample]   += (fftw_real (V_odd [ii]) * fftw_real (V_odd [ii]) + fftw_imag (V_odd [ii]) * fftw_imag (V_odd [ii]));
-			}
+			RSP_PulsePairSums (H_odd, V_odd, H_even, V_even, H0_even, V0_odd, param.nfft, &pp);
+
+			PH_VD[sample]       += pp.PH;
+			PV_VD[sample]       += pp.PV;
+			PH_VD_even[sample]  += pp.PH_even;
+			PV_VD_even[sample]  += pp.PV_even;
+			PH0_FD_even[sample] += pp.PH0_even;
+			PV0_FD_odd[sample]  += pp.PV0_odd;
+			PH_VD_odd[sample]   += pp.PH_odd;
+			PV_VD_odd[sample]   += pp.PV_odd;
 		    }
 		}
 		else
@@ -2304,12 +3687,6 @@ main (int    argc,
 		    /* Calculate VEL_VD: velocity from variable delay pulse pair */
 		    for (sample = 0; sample < param.samples_per_pulse - mode_gate_offset; sample++)
 		    {
-			tempI_odd  = 0.0;
-			tempQ_odd  = 0.0;
-			tempI_even = 0.0;
-			tempQ_even = 0.0;
-			tempI_vel  = 0.0;
-			tempQ_vel  = 0.0;
 			register int ii, jj, idx;
 
 			for (ii = 0; ii < param.nfft * param.num_tx_pol; ii++)
@@ -2318,17 +3695,17 @@ main (int    argc,
 			    idx = (ii * param.samples_per_pulse) + sample;
 			    if ((ii + horizontal_first) % 2 == 1)
 			    {
-				fftw_real_lv (H_odd[jj]) = I_uncoded_copolar_H   [idx];
-				fftw_imag_lv (H_odd[jj]) = Q_uncoded_copolar_H   [idx];
-				fftw_real_lv (V_odd[jj]) = I_uncoded_crosspolar_H[idx + mode_gate_offset];
-				fftw_imag_lv (V_odd[jj]) = Q_uncoded_crosspolar_H[idx + mode_gate_offset];
+				fftw_real_lv (H_odd[jj]) = I_copolar   [idx];
+				fftw_imag_lv (H_odd[jj]) = Q_copolar   [idx];
+				fftw_real_lv (V_odd[jj]) = I_crosspolar[idx + mode_gate_offset];
+				fftw_imag_lv (V_odd[jj]) = Q_crosspolar[idx + mode_gate_offset];
 			    }
 			    else
 			    {
-				fftw_real_lv (H_even[jj]) = I_uncoded_copolar_H   [idx + mode_gate_offset];
-				fftw_imag_lv (H_even[jj]) = Q_uncoded_copolar_H   [idx + mode_gate_offset];
-				fftw_real_lv (V_even[jj]) = I_uncoded_crosspolar_H[idx];
-				fftw_imag_lv (V_even[jj]) = Q_uncoded_crosspolar_H[idx];
+				fftw_real_lv (H_even[jj]) = I_copolar   [idx + mode_gate_offset];
+				fftw_imag_lv (H_even[jj]) = Q_copolar   [idx + mode_gate_offset];
+				fftw_real_lv (V_even[jj]) = I_crosspolar[idx];
+				fftw_imag_lv (V_even[jj]) = Q_crosspolar[idx];
 			    }
 			}
 
@@ -2337,23 +3714,19 @@ main (int    argc,
 			RSP_SubtractOffset_FFTW (H_even, param.nfft);
 			RSP_SubtractOffset_FFTW (V_even, param.nfft);
 
-			for (ii = 0; ii < param.nfft; ii++)
-			{
-			    // VH is V x conj (H) == 1st pulse H, 2nd pulse V
-			    tempI_odd  += fftw_real (V_odd [ii]) * fftw_real (H_odd [ii]) + fftw_imag (V_odd [ii]) * fftw_imag (H_odd [ii]);
-			    tempQ_odd  += fftw_imag (V_odd [ii]) * fftw_real (H_odd [ii]) - fftw_real (V_odd [ii]) * fftw_imag (H_odd [ii]);
-			    tempI_even += fftw_real (V_even[ii]) * fftw_real (H_even[ii]) + fftw_imag (V_even[ii]) * fftw_imag (H_even[ii]);
-			    tempQ_even += fftw_imag (H_even[ii]) * fftw_real (V_even[ii]) - fftw_real (H_even[ii]) * fftw_imag (V_even[ii]);
-
-			    PH_VD[sample]      += (fftw_real (H_odd [ii]) * fftw_real (H_odd [ii]) + fftw_real (H_even[ii]) * fftw_real (H_even[ii]));
-			    PH_VD[sample]      += (fftw_imag (H_odd [ii]) * fftw_imag (H_odd [ii]) + fftw_imag (H_even[ii]) * fftw_imag (H_even[ii]));
-			    PV_VD[sample]      += (fftw_real (V_odd [ii]) * fftw_real (V_odd [ii]) + fftw_real (V_even[ii]) * fftw_real (V_even[ii]));
-			    PV_VD[sample]      += (fftw_imag (V_odd [ii]) * fftw_imag (V_odd [ii]) + fftw_imag (V_even[ii]) * fftw_imag (V_even[ii]));
-			    PH_VD_even[sample] += (fftw_real (H_even[ii]) * fftw_real (H_even[ii]) + fftw_imag (H_even[ii]) * fftw_imag (H_even[ii]));
-			    PV_VD_even[sample] += (fftw_real (V_even[ii]) * fftw_real (V_even[ii]) + fftw_imag (V_even[ii]) * fftw_imag (V_even[ii]));
-			    PH_VD_odd[sample]  += (fftw_real (H_odd [ii]) * fftw_real (H_odd [ii]) + fftw_imag (H_odd [ii]) * fftw_imag (H_odd [ii]));
-			    PV_VD_odd[sample]  += (fftw_real (V_odd [ii]) * fftw_real (V_odd [ii]) + fftw_imag (V_odd [ii]) * fftw_imag (V_odd [ii]));
-			}
+			RSP_PulsePairSums (H_odd, V_odd, H_even, V_even, NULL, NULL, param.nfft, &pp);
+
+			tempI_odd  = pp.I_odd;
+			tempQ_odd  = pp.Q_odd;
+			tempI_even = pp.I_even;
+			tempQ_even = pp.Q_even;
+
+			PH_VD[sample]      += pp.PH;
+			PV_VD[sample]      += pp.PV;
+			PH_VD_even[sample] += pp.PH_even;
+			PV_VD_even[sample] += pp.PV_even;
+			PH_VD_odd[sample]  += pp.PH_odd;
+			PV_VD_odd[sample]  += pp.PV_odd;
 
 			VEL_VD_COS_even[sample] += tempI_even;
 			VEL_VD_SIN_even[sample] += tempQ_even;
@@ -2363,22 +3736,21 @@ main (int    argc,
 			/* Subtract phi_offset from even (HV) and add to odd (VH) */
 			tempI      = tempI_even;
 			tempQ      = tempQ_even;
-			tempI_even = tempI * cos (param.phidp_offset) + tempQ * sin (param.phidp_offset);
-			tempQ_even = tempQ * cos (param.phidp_offset) - tempI * sin (param.phidp_offset);
+			tempI_even = tempI * param.phidp_offset_cos + tempQ * param.phidp_offset_sin;
+			tempQ_even = tempQ * param.phidp_offset_cos - tempI * param.phidp_offset_sin;
 			tempI      = tempI_odd;
 			tempQ      = tempQ_odd;
-			tempI_odd  = tempI * cos (param.phidp_offset) - tempQ * sin (param.phidp_offset);
-			tempQ_odd  = tempI * sin (param.phidp_offset) + tempQ * cos (param.phidp_offset);
+			tempI_odd  = tempI * param.phidp_offset_cos - tempQ * param.phidp_offset_sin;
+			tempQ_odd  = tempI * param.phidp_offset_sin + tempQ * param.phidp_offset_cos;
 
 			tempQ = -tempI_even * tempQ_odd  + tempI_odd * tempQ_even;
 			tempI =  tempI_odd  * tempI_even + tempQ_odd * tempQ_even;
-			phidp = atan2 (tempQ, tempI) / 2.0;
 
 			PHIDP_VD_COS[sample] += tempI;
 			PHIDP_VD_SIN[sample] += tempQ;
 
-			tempQ      = sin (phidp);
-			tempI      = cos (phidp);
+			/* rotate by phidp = atan2 (tempQ, tempI) / 2 */
+			half_angle_sincos (tempI, tempQ, &tempI, &tempQ);
 			tempQ_vel  = tempI * tempQ_odd + tempI_odd * tempQ;
 			tempI_vel  = tempI_odd * tempI - tempQ_odd * tempQ;
 			tempQ_vel += tempI * tempQ_even - tempI_even * tempQ;
@@ -2392,12 +3764,6 @@ main (int    argc,
 		    /* Calculate VEL_FD: velocity from fixed delay (160 us) pulse pair */
 		    for (sample = 0; sample < param.samples_per_pulse; sample++)
 		    {
-			tempI_odd  = 0.0;
-			tempQ_odd  = 0.0;
-			tempI_even = 0.0;
-			tempQ_even = 0.0;
-			tempI_vel  = 0.0;
-			tempQ_vel  = 0.0;
 			register int ii, jj, idx;
 
 			for (ii = 0; ii < (param.nfft - 1) * param.num_tx_pol; ii++)
@@ -2406,21 +3772,21 @@ main (int    argc,
 			    idx = (ii * param.samples_per_pulse) + sample;
 			    if ((ii + horizontal_first) % 2 == 1)
 			    {
-				fftw_real_lv (H_odd [jj]) = I_uncoded_copolar_H   [idx];
-				fftw_imag_lv (H_odd [jj]) = Q_uncoded_copolar_H   [idx];
-				fftw_real_lv (V_odd [jj]) = I_uncoded_crosspolar_H[idx + param.samples_per_pulse];
-				fftw_imag_lv (V_odd [jj]) = Q_uncoded_crosspolar_H[idx + param.samples_per_pulse];
-				fftw_real_lv (V0_odd[jj]) = I_uncoded_crosspolar_H[idx];
-				fftw_imag_lv (V0_odd[jj]) = Q_uncoded_crosspolar_H[idx];
+				fftw_real_lv (H_odd [jj]) = I_copolar   [idx];
+				fftw_imag_lv (H_odd [jj]) = Q_copolar   [idx];
+				fftw_real_lv (V_odd [jj]) = I_crosspolar[idx + param.samples_per_pulse];
+				fftw_imag_lv (V_odd [jj]) = Q_crosspolar[idx + param.samples_per_pulse];
+				fftw_real_lv (V0_odd[jj]) = I_crosspolar[idx];
+				fftw_imag_lv (V0_odd[jj]) = Q_crosspolar[idx];
 			    }
 			    else
 			    {
-				fftw_real_lv (H_even [jj]) = I_uncoded_copolar_H   [idx + param.samples_per_pulse];
-				fftw_imag_lv (H_even [jj]) = Q_uncoded_copolar_H   [idx + param.samples_per_pulse];
-				fftw_real_lv (V_even [jj]) = I_uncoded_crosspolar_H[idx];
-				fftw_imag_lv (V_even [jj]) = Q_uncoded_crosspolar_H[idx];
-				fftw_real_lv (H0_even[jj]) = I_uncoded_copolar_H   [idx];
-				fftw_imag_lv (H0_even[jj]) = Q_uncoded_copolar_H   [idx];
+				fftw_real_lv (H_even [jj]) = I_copolar   [idx + param.samples_per_pulse];
+				fftw_imag_lv (H_even [jj]) = Q_copolar   [idx + param.samples_per_pulse];
+				fftw_real_lv (V_even [jj]) = I_crosspolar[idx];
+				fftw_imag_lv (V_even [jj]) = Q_crosspolar[idx];
+				fftw_real_lv (H0_even[jj]) = I_copolar   [idx];
+				fftw_imag_lv (H0_even[jj]) = Q_copolar   [idx];
 			    }
 			}
 
@@ -2431,26 +3797,21 @@ main (int    argc,
 			RSP_SubtractOffset_FFTW (H0_even, param.nfft - 1);
 			RSP_SubtractOffset_FFTW (V0_odd , param.nfft - 1);
 
-			for (ii = 0; ii < round (param.nfft - 1); ii++)
-			{
-			    // VH is V x conj (H) == 1st pulse H, 2nd pulse V
-			    tempI_odd  += fftw_real (V_odd [ii]) * fftw_real (H_odd [ii]) + fftw_imag (V_odd [ii]) * fftw_imag (H_odd [ii]);
-			    tempQ_odd  += fftw_imag (V_odd [ii]) * fftw_real (H_odd [ii]) - fftw_real (V_odd [ii]) * fftw_imag (H_odd [ii]);
-			    tempI_even += fftw_real (V_even[ii]) * fftw_real (H_even[ii]) + fftw_imag (V_even[ii]) * fftw_imag (H_even[ii]);
-			    tempQ_even += fftw_imag (H_even[ii]) * fftw_real (V_even[ii]) - fftw_real (H_even[ii]) * fftw_imag (V_even[ii]);
-
-			    PH_FD[sample] += (fftw_real (H_odd[ii]) * fftw_real (H_odd[ii]) + fftw_real (H_even[ii]) * fftw_real (H_even[ii]));
-			    PH_FD[sample] += (fftw_imag (H_odd[ii]) * fftw_imag (H_odd[ii]) + fftw_imag (H_even[ii]) * fftw_imag (H_even[ii]));
-			    PV_FD[sample] += (fftw_real (V_odd[ii]) * fftw_real (V_odd[ii]) + fftw_real (V_even[ii]) * fftw_real (V_even[ii]));
-			    PV_FD[sample] += (fftw_imag (V_odd[ii]) * fftw_imag (V_odd[ii]) + fftw_imag (V_even[ii]) * fftw_imag (V_even[ii]));
-
-			    PH_FD_even[sample]  += (fftw_real (H_even [ii]) * fftw_real (H_even [ii]) + fftw_imag (H_even [ii]) * fftw_imag (H_even [ii]));
-			    PV_FD_even[sample]  += (fftw_real (V_even [ii]) * fftw_real (V_even [ii]) + fftw_imag (V_even [ii]) * fftw_imag (V_even [ii]));
-			    PH0_FD_even[sample] += (fftw_real (H0_even[ii]) * fftw_real (H0_even[ii]) + fftw_imag (H0_even[ii]) * fftw_imag (H0_even[ii]));
-			    PV0_FD_odd[sample]  += (fftw_real (V0_odd [ii]) * fftw_real (V0_odd [ii]) + fftw_imag (V0_odd [ii]) * fftw_imag (V0_odd [ii]));
-			    PH_FD_odd[sample]   += (fftw_real (H_odd  [ii]) * fftw_real (H_odd  [ii]) + fftw_imag (H_odd  [ii]) * fftw_imag (H_odd  [ii]));
-			    PV_FD_odd[sample]   += (fftw_real (V_odd  [ii]) * fftw_real (V_odd  [ii]) + fftw_imag (V_odd  [ii]) * fftw_imag (V_odd  [ii]));
-			}
+			RSP_PulsePairSums (H_odd, V_odd, H_even, V_even, H0_even, V0_odd, param.nfft - 1, &pp);
+
+			tempI_odd  = pp.I_odd;
+			tempQ_odd  = pp.Q_odd;
+			tempI_even = pp.I_even;
+			tempQ_even = pp.Q_even;
+
+			PH_FD[sample]       += pp.PH;
+			PV_FD[sample]       += pp.PV;
+			PH_FD_even[sample]  += pp.PH_even;
+			PV_FD_even[sample]  += pp.PV_even;
+			PH0_FD_even[sample] += pp.PH0_even;
+			PV0_FD_odd[sample]  += pp.PV0_odd;
+			PH_FD_odd[sample]   += pp.PH_odd;
+			PV_FD_odd[sample]   += pp.PV_odd;
 
 			VEL_FD_COS_even[sample] += tempI_even;
 			VEL_FD_SIN_even[sample] += tempQ_even;
@@ -2460,23 +3821,22 @@ main (int    argc,
 			/* Subtract phi_offset from even (HV) and add to odd (VH) */
 			tempI      = tempI_even;
 			tempQ      = tempQ_even;
-			tempI_even = tempI * cos (param.phidp_offset) + tempQ * sin (param.phidp_offset);
-			tempQ_even = tempQ * cos (param.phidp_offset) - tempI * sin (param.phidp_offset);
+			tempI_even = tempI * param.phidp_offset_cos + tempQ * param.phidp_offset_sin;
+			tempQ_even = tempQ * param.phidp_offset_cos - tempI * param.phidp_offset_sin;
 			tempI      = tempI_odd;
 			tempQ      = tempQ_odd;
-			tempI_odd  = tempI * cos (param.phidp_offset) - tempQ * sin (param.phidp_offset);
-			tempQ_odd  = tempI * sin (param.phidp_offset) + tempQ * cos (param.phidp_offset);
+			tempI_odd  = tempI * param.phidp_offset_cos - tempQ * param.phidp_offset_sin;
+			tempQ_odd  = tempI * param.phidp_offset_sin + tempQ * param.phidp_offset_cos;
 
 
 			tempQ = -tempI_even * tempQ_odd  + tempI_odd * tempQ_even;
 			tempI =  tempI_odd  * tempI_even + tempQ_odd * tempQ_even;
 
-			phidp = atan2 (tempQ, tempI) / 2.0;
 			PHIDP_FD_COS[sample] += tempI;
 			PHIDP_FD_SIN[sample] += tempQ;
 
-			tempQ      = sin (phidp);
-			tempI      = cos (phidp);
+			/* rotate by phidp = atan2 (tempQ, tempI) / 2 */
+			half_angle_sincos (tempI, tempQ, &tempI, &tempQ);
 			tempQ_vel  = tempI * tempQ_odd  + tempI_odd  * tempQ;
 			tempI_vel  = tempI_odd  * tempI - tempQ_odd  * tempQ;
 			tempQ_vel += tempI * tempQ_even - tempI_even * tempQ;
@@ -2487,73 +3847,88 @@ main (int    argc,
 		    }
 		}
 
+		RST_LAP (&timing, ST_PULSE_PAIR);
+
+		/*----------------------------------------------------------------*
+		 * Coherent integration: the spectra are of nfft pulses, each    *
+		 * the sum of num-coh-avg pulses of its transmit polarisation.   *
+		 * The sums are not scaled: the spectra have the power of those  *
+		 * of the single pulses, with num-coh-avg times less noise. The  *
+		 * pulse pairs above need consecutive pulses and are made before.*
+		 *----------------------------------------------------------------*/
+		if (param.pulses_coherently_averaged > 1)
+		{
+		    const int streams = param.num_tx_pol;
+		    const int pulses  = param.nfft * param.num_tx_pol;
+
+		    RSP_CoherentIntegrate (I_copolar,    param.samples_per_pulse, streams,
+					   param.pulses_coherently_averaged, pulses);
+		    RSP_CoherentIntegrate (Q_copolar,    param.samples_per_pulse, streams,
+					   param.pulses_coherently_averaged, pulses);
+		    RSP_CoherentIntegrate (I_crosspolar, param.samples_per_pulse, streams,
+					   param.pulses_coherently_averaged, pulses);
+		    RSP_CoherentIntegrate (Q_crosspolar, param.samples_per_pulse, streams,
+					   param.pulses_coherently_averaged, pulses);
+		}
+		RST_LAP (&timing, ST_COHERENT);
+
 		/* Calculate power spectra for each gate */
 		//printf ("** Calculating power spectra...\n");
 		//printf ("NFFT=%d\n",param.nfft);
-		/* Loop through gates */
+		/* Loop through gates. In PM_Double_HV_HV every PRT starts with H:
+		   the V echoes are those of the second pulse, mode_v_delay later,
+		   and the last mode_v_delay gates have none */
 		for (sample = 0; sample < param.samples_per_pulse; sample++)
 		{
 		    register int ii, jj, idx;
 
-		    if (mode == PM_Single_H)
+		    if (mode == PM_Single_H || mode == PM_Double_H)
 		    {
 			// 1) UNCODED H-COPOLAR SPECTRUM (HH)
 			for (ii = 0; ii < param.nfft; ii++)
 			{
 			    idx = (ii * param.samples_per_pulse) + sample;
-			    fftw_real_lv (in[ii]) = I_uncoded_copolar_H[idx];
-			    fftw_imag_lv (in[ii]) = Q_uncoded_copolar_H[idx];
+			    fftw_real_lv (in[ii]) = I_copolar[idx];
+			    fftw_imag_lv (in[ii]) = Q_copolar[idx];
 			}
 			RSP_SubtractOffset_FFTW (in, param.nfft);
 			RSP_CalcPSD_FFTW (in, param.nfft, p_uncoded, param.window, current_PSD, norm_uncoded);
-			for (ii = 0; ii < param.npsd; ii++)
-			{
-			    PSD[sample].HH[ii] += current_PSD[ii] / param.spectra_averaged;
-			}
+			RSP_Accumulate (PSD[sample].HH, current_PSD, 1.0 / param.spectra_averaged, param.npsd);
 
 			// 2) UNCODED H-CROSSPOLAR SPECTRUM (HV)
 			for (ii = 0; ii < param.nfft; ii++)
 			{
 			    idx = (ii * param.samples_per_pulse) + sample;
-			    fftw_real_lv (in[ii]) = I_uncoded_crosspolar_H[idx];
-			    fftw_imag_lv (in[ii]) = Q_uncoded_crosspolar_H[idx];
+			    fftw_real_lv (in[ii]) = I_crosspolar[idx];
+			    fftw_imag_lv (in[ii]) = Q_crosspolar[idx];
 			}
 			RSP_SubtractOffset_FFTW (in, param.nfft);
 			RSP_CalcPSD_FFTW (in, param.nfft, p_uncoded, param.window, current_PSD, norm_uncoded);
-			for (ii = 0; ii < param.npsd; ii++)
-			{
-			    PSD[sample].HV[ii] += current_PSD[ii] / param.spectra_averaged;
-			}
+			RSP_Accumulate (PSD[sample].HV, current_PSD, 1.0 / param.spectra_averaged, param.npsd);
 		    }
-		    else if (mode == PM_Single_V)
+		    else if (mode == PM_Single_V || mode == PM_Double_V)
 		    {
 			// 3) UNCODED V-COPOLAR SPECTRUM (VV)
 			for (ii = 0; ii < param.nfft; ii++)
 			{
 			    idx = (ii * param.samples_per_pulse) + sample;
-			    fftw_real_lv (in[ii]) = I_uncoded_crosspolar_H[idx];
-			    fftw_imag_lv (in[ii]) = Q_uncoded_crosspolar_H[idx];
+			    fftw_real_lv (in[ii]) = I_crosspolar[idx];
+			    fftw_imag_lv (in[ii]) = Q_crosspolar[idx];
 			}
 			RSP_SubtractOffset_FFTW (in, param.nfft);
 			RSP_CalcPSD_FFTW (in, param.nfft, p_uncoded, param.window, current_PSD, norm_uncoded);
-			for (ii = 0; ii < param.npsd; ii++)
-			{
-			    PSD[sample].VV[ii] += current_PSD[ii] / param.spectra_averaged;
-			}
+			RSP_Accumulate (PSD[sample].VV, current_PSD, 1.0 / param.spectra_averaged, param.npsd);
 
 			// 4) UNCODED V-CROSSPOLAR SPECTRUM (VH)
 			for (ii = 0; ii < param.nfft; ii++)
 			{
 				idx = (ii * param.samples_per_pulse) + sample;
-				fftw_real_lv (in[ii]) = I_uncoded_copolar_H[idx];
-				fftw_imag_lv (in[ii]) = Q_uncoded_copolar_H[idx];
+				fftw_real_lv (in[ii]) = I_copolar[idx];
+				fftw_imag_lv (in[ii]) = Q_copolar[idx];
 			}
 			RSP_SubtractOffset_FFTW (in, param.nfft);
 			RSP_CalcPSD_FFTW (in, param.nfft, p_uncoded, param.window, current_PSD, norm_uncoded);
-			for (ii = 0; ii < param.npsd; ii++)
-			{
-			    PSD[sample].VH[ii] += current_PSD[ii] / param.spectra_averaged;
-			}
+			RSP_Accumulate (PSD[sample].VH, current_PSD, 1.0 / param.spectra_averaged, param.npsd);
 		    }
 		    else
 		    {
@@ -2566,16 +3941,13 @@ main (int    argc,
 				{
 				    jj  = (ii / 2);
 				    idx = (ii * param.samples_per_pulse) + sample;
-				    fftw_real_lv (in[jj]) = I_uncoded_copolar_H[idx];
-				    fftw_imag_lv (in[jj]) = Q_uncoded_copolar_H[idx];
+				    fftw_real_lv (in[jj]) = I_copolar[idx];
+				    fftw_imag_lv (in[jj]) = Q_copolar[idx];
 				}
 			    }
 			    RSP_SubtractOffset_FFTW (in, param.nfft);
 			    RSP_CalcPSD_FFTW (in, param.nfft, p_uncoded, param.window, current_PSD, norm_uncoded);
-			    for (ii = 0; ii < param.npsd; ii++)
-			    {
-				PSD[sample].HH[ii] += current_PSD[ii] / param.spectra_averaged;
-			    }
+			    RSP_Accumulate (PSD[sample].HH, current_PSD, 1.0 / param.spectra_averaged, param.npsd);
 
 			    // 2) UNCODED H-CROSSPOLAR SPECTRUM (HV)
 			    for (ii = 0; ii < param.nfft * param.num_tx_pol; ii++)
@@ -2584,18 +3956,15 @@ main (int    argc,
 				{
 				    jj  = (ii / 2);
 				    idx = (ii * param.samples_per_pulse) + sample;
-				    fftw_real_lv (in[jj]) = I_uncoded_crosspolar_H[idx];
-				    fftw_imag_lv (in[jj]) = Q_uncoded_crosspolar_H[idx];
+				    fftw_real_lv (in[jj]) = I_crosspolar[idx];
+				    fftw_imag_lv (in[jj]) = Q_crosspolar[idx];
 				}
 			    }
 			    RSP_SubtractOffset_FFTW (in, param.nfft);
 			    RSP_CalcPSD_FFTW (in, param.nfft, p_uncoded, param.window, current_PSD, norm_uncoded);
-			    for (ii = 0; ii < param.npsd; ii++)
-			    {
-				PSD[sample].HV[ii] += current_PSD[ii] / param.spectra_averaged;
-			    }
+			    RSP_Accumulate (PSD[sample].HV, current_PSD, 1.0 / param.spectra_averaged, param.npsd);
 			}
-			if (mode != PM_Double_H)
+			if (mode != PM_Double_H && sample + mode_v_delay < param.samples_per_pulse)
 			{
 			    // 3) UNCODED V-COPOLAR SPECTRUM (VV)
 			    for (ii = 0; ii < param.nfft * param.num_tx_pol; ii++)
@@ -2603,17 +3972,14 @@ main (int    argc,
 				if ((ii+horizontal_first) % 2 == 0)
 				{
 				    jj  = (ii / 2);
-				    idx = (ii * param.samples_per_pulse) + sample;
-				    fftw_real_lv (in[jj]) = I_uncoded_crosspolar_H[idx];
-				    fftw_imag_lv (in[jj]) = Q_uncoded_crosspolar_H[idx];
+				    idx = (ii * param.samples_per_pulse) + sample + mode_v_delay;
+				    fftw_real_lv (in[jj]) = I_crosspolar[idx];
+				    fftw_imag_lv (in[jj]) = Q_crosspolar[idx];
 				}
 			    }
 			    RSP_SubtractOffset_FFTW (in, param.nfft);
 			    RSP_CalcPSD_FFTW (in, param.nfft, p_uncoded, param.window, current_PSD, norm_uncoded);
-			    for (ii = 0; ii < param.npsd; ii++)
-			    {
-				PSD[sample].VV[ii] += current_PSD[ii] / param.spectra_averaged;
-			    }
+			    RSP_Accumulate (PSD[sample].VV, current_PSD, 1.0 / param.spectra_averaged, param.npsd);
 
 			    // 4) UNCODED V-CROSSPOLAR SPECTRUM (VH)
 			    for (ii = 0; ii < param.nfft * param.num_tx_pol; ii++)
@@ -2621,29 +3987,29 @@ main (int    argc,
 				if ((ii+horizontal_first) % 2 == 0)
 				{
 				    jj  = (ii / 2);
-				    idx = (ii * param.samples_per_pulse) + sample;
-				    fftw_real_lv (in[jj]) = I_uncoded_copolar_H[idx];
-				    fftw_imag_lv (in[jj]) = Q_uncoded_copolar_H[idx];
+				    idx = (ii * param.samples_per_pulse) + sample + mode_v_delay;
+				    fftw_real_lv (in[jj]) = I_copolar[idx];
+				    fftw_imag_lv (in[jj]) = Q_copolar[idx];
 				}
 			    }
 			    RSP_SubtractOffset_FFTW (in, param.nfft);
 			    RSP_CalcPSD_FFTW (in, param.nfft, p_uncoded, param.window, current_PSD, norm_uncoded);
-			    for (ii = 0; ii < param.npsd; ii++)
-			    {
-				PSD[sample].VH[ii] += current_PSD[ii] / param.spectra_averaged;
-			    }
+			    RSP_Accumulate (PSD[sample].VH, current_PSD, 1.0 / param.spectra_averaged, param.npsd);
 			}
 		    }
 		}
 
+		RST_LAP (&timing, ST_FFT);
+
 		if (!exit_now && tsdump && !TextTimeSeries)
 		{
 		    /* Needs to happen first as WriteDynamicVariables increments ray number */
-		    printf ("Writing timeseries variables to NetCDF...\n");
+		    RLG_LOG (RLG_DEBUG, "Writing timeseries variables to NetCDF...\n");
 		    WriteOutTimeSeriesData (ncidts, &param, &obs, &tsobs, nm);
 		    status = nc_sync (ncidts);
 		    if (status != NC_NOERR) check_netcdf_handle_error (status);
 		}
+		RST_LAP (&timing, ST_TS_WRITE);
 	    }
 	    /*---------------------------*
 	     * END OF SPECTRAL AVERAGING *
@@ -2669,7 +4035,7 @@ main (int    argc,
 	    /* writing out rapid spectra */
 	    if ((collect_spectra_rapid_now == 1) && !exit_now)
 	    {
-		printf ("Writing Rapid PSD Variables... ***************************\n");
+		RLG_LOG (RLG_DEBUG, "Writing Rapid PSD Variables...\n");
 		RNC_WriteRapidLogPSDVariables (spectra_rapid_ncid, GALILEO_SPECTRA_RAPID, &param, &PSD_RAPID_obs, PSD, PSD_rapid_varid);
 		status = nc_sync (spectra_ncid);
 		if (status != NC_NOERR) check_netcdf_handle_error (status);
@@ -2679,7 +4045,7 @@ main (int    argc,
 	    /* write out normal spectra */
 	    if ((collect_spectra_now == 1) && !exit_now)
 	    {
-		printf ("Writing PSD Variables... ***************************\n");
+		RLG_LOG (RLG_DEBUG, "Writing PSD Variables...\n");
 		RNC_WriteLogPSDVariables (spectra_ncid, GALILEO_SPECTRA, &param, &PSD_obs, PSD, &IQStruct, PSD_varid);
 		status = nc_sync (spectra_ncid);
 		if (status != NC_NOERR) check_netcdf_handle_error (status);
@@ -2703,13 +4069,21 @@ main (int    argc,
 		crvmat ((float*)zmat, param.npsd, param.samples_per_pulse, 1, 1);
 		height (20);
 		title ();
-		printf ("x window updated\n");
+		RLG_LOG (RLG_DEBUG, "x window updated\n");
 	    }
 #endif /* HAVE_DISLIN */
 
-	    /* Calculate noise from upper range gates */
-	    noisegate1 = param.samples_per_pulse - 50;
+	    RST_LAP (&timing, ST_SPECTRA_WRITE);
+
+	    /* Calculate noise from upper range gates, or those configured */
+	    /* (checked to be within the range window by range_window)    */
+	    noisegate1 = param.samples_per_pulse - NoiseGates;
 	    noisegate2 = param.samples_per_pulse - 1;
+	    if (param.noise_gate_start >= 0)
+	    {
+		noisegate1 = param.noise_gate_start - param.first_gate;
+		noisegate2 = param.noise_gate_end   - param.first_gate;
+	    }
 	    count      = (noisegate2 - noisegate1) + 1;
 
 	    HH_noise_level = 0.0;
@@ -2721,13 +4095,16 @@ main (int    argc,
 	    {
 		if (mode != PM_Single_V && mode != PM_Double_V)
 		{ 
-		    HH_noise_level += median (PSD[i].HH, param.npsd);
-		    HV_noise_level += median (PSD[i].HV, param.npsd);
+		    HH_noise_level += RSP_Median (PSD[i].HH, param.npsd);
+		    HV_noise_level += RSP_Median (PSD[i].HV, param.npsd);
 		}
 		if (mode != PM_Single_H && mode != PM_Double_H)
 		{ 
-		    VV_noise_level += median (PSD[i].VV, param.npsd);
-		    VH_noise_level += median (PSD[i].VH, param.npsd);
+		    /* the V spectra of the samples of gate i */
+		    const int v = (i >= mode_v_delay) ? i - mode_v_delay : i;
+
+		    VV_noise_level += RSP_Median (PSD[v].VV, param.npsd);
+		    VH_noise_level += RSP_Median (PSD[v].VH, param.npsd);
 		}
 	    }
 	    HH_noise_level /= count;
@@ -2746,12 +4123,14 @@ main (int    argc,
 		NPC_V[0] += HV_noise_level;
 	    }
 
+	    RST_LAP (&timing, ST_NOISE);
+
 	    /* Now calculate the Doppler parameters */
-	    printf ("** Calculating Doppler parameters...\n");
+	    RLG_LOG (RLG_DEBUG, "** Calculating Doppler parameters...\n");
 	    /* Loop through all spectra and get parameters */
 	    for (i = 0; i < param.samples_per_pulse; i++)
 	    {
-		float noise_power, tempPower, tempVel, tempZED;
+		float noise_power, tempPower, tempVel;
 
 		// interpolate over clutter
 		if (mode != PM_Single_V && mode != PM_Double_V)
@@ -2813,10 +4192,10 @@ main (int    argc,
 		    /* COPOLAR */
 		    SNR_HC[i]     += tempPower/noise_power * wi;
 		    ZED_HC[i]     += tempPower * wi;
-		    tempZED        = 10.0 * log10 (tempPower);
 		    tempVel        = RSP_BinToVelocity (HH_moments[1], &param);
-		    VEL_HC_COS[i] += cos (tempVel / param.folding_velocity * PI) * wi;
-		    VEL_HC_SIN[i] += sin (tempVel / param.folding_velocity * PI) * wi;
+		    vel_sincos (tempVel / param.folding_velocity * PI, param.fast_math, &tempQ, &tempI);
+		    VEL_HC_COS[i] += tempI * wi;
+		    VEL_HC_SIN[i] += tempQ * wi;
 		    SPW_HC[i]     += HH_moments[2] * param.frequency_bin_width / param.hz_per_mps * wi;
 
 		    /* CROSSPOLAR */
@@ -2835,8 +4214,9 @@ main (int    argc,
                     SPW_VC[i]     += VV_moments[2] * param.frequency_bin_width / param.hz_per_mps * wi;
 
 		    tempVel        = RSP_BinToVelocity (VV_moments[1], &param);
-		    VEL_VC_COS[i] += cos (tempVel / param.folding_velocity * PI) * wi;
-		    VEL_VC_SIN[i] += sin (tempVel / param.folding_velocity * PI) * wi;
+		    vel_sincos (tempVel / param.folding_velocity * PI, param.fast_math, &tempQ, &tempI);
+		    VEL_VC_COS[i] += tempI * wi;
+		    VEL_VC_SIN[i] += tempQ * wi;
 
 		    /* V CROSSPOLAR */
 		    noise_power    = RSP_CalcNoisePower (VH_noise_level, VH_peaks, &param);
@@ -2845,130 +4225,42 @@ main (int    argc,
 		    ZED_XVC[i]    += tempPower * wi;
 		}
 	    }
+	    RST_LAP (&timing, ST_MOMENTS);
 	} // End of moments averaging loop
 
-	for (i = 0; i < param.samples_per_pulse; i++)
-	{
-	    /* COMPLETE THE WEIGHTED AVERAGING WITH DIVISION */
-	    SNR_HC[i]  /= uncoded_sum_wi[i];
-	    ZED_HC[i]  /= uncoded_sum_wi[i];
-	    SNR_VC[i]  /= uncoded_sum_wi[i];
-	    ZED_VC[i]  /= uncoded_sum_wi[i];
-	    SPW_HC[i]  /= uncoded_sum_wi[i];
-            SPW_VC[i]  /= uncoded_sum_wi[i];
-	    SNR_XHC[i] /= uncoded_sum_wi[i];
-	    ZED_XHC[i] /= uncoded_sum_wi[i];
-	    SNR_XVC[i] /= uncoded_sum_wi[i];
-	    ZED_XVC[i] /= uncoded_sum_wi[i];
-
-	    POW_H[i]   = PH_FD_odd[i];
-	    POW_HX[i]  = PV0_FD_odd[i];
-	    POW_V[i]   = PV_FD_even[i];
-	    POW_VX[i]  = PH0_FD_even[i];
-	    POW_H[i]  /= uncoded_sum_wi[i];
-	    POW_HX[i] /= uncoded_sum_wi[i];
-	    POW_V[i]  /= uncoded_sum_wi[i];
-	    POW_VX[i] /= uncoded_sum_wi[i];
-
-	    VEL_VD[i] = atan2 (VEL_VD_SIN[i], VEL_VD_COS[i]) * 0.299792458 / (4.0 * PI * param.pulse_offset * 1e-6 * param.frequency);
-	    VEL_FD[i] = atan2 (VEL_FD_SIN[i], VEL_FD_COS[i]) * 0.299792458 * (float)param.num_tx_pol / (4.0 * PI * param.prt * param.frequency);
-
-	    PHIDP_FD[i]  = atan2 (PHIDP_FD_SIN[i], PHIDP_FD_COS[i]) / 2.0;
-	    PHIDP_FD[i] *= (180.0 / PI);
-	    PHIDP_VD[i]  = atan2 (PHIDP_VD_SIN[i], PHIDP_VD_COS[i]) / 2.0;
-	    PHIDP_VD[i] *= (180.0 / PI);
-
-	    RHO_FD[i]  = VEL_FD_COS[i] * VEL_FD_COS[i] + VEL_FD_SIN[i] * VEL_FD_SIN[i];
-	    RHO_FD[i] /= PH_FD[i] * PV_FD[i];
-	    RHO_FD[i]  = sqrt (RHO_FD[i]);
-
-	    RHO_VD[i]  = VEL_VD_COS[i] * VEL_VD_COS[i] + VEL_VD_SIN[i] * VEL_VD_SIN[i];
-	    RHO_VD[i] /= PH_VD[i] * PV_VD[i];
-	    RHO_VD[i]  = sqrt (RHO_VD[i]);
-
-	    RHO_FDS[i ] = VEL_FD_COS_even[i] * VEL_FD_COS_even[i] + VEL_FD_SIN_even[i] * VEL_FD_SIN_even[i];
-	    RHO_FDS[i] /= PH_FD_even[i] * PV_FD_even[i];
-	    tmpRHO      = sqrt (RHO_FDS[i]);
-	    RHO_FDS[i]  = VEL_FD_COS_odd[i] * VEL_FD_COS_odd[i] + VEL_FD_SIN_odd[i] * VEL_FD_SIN_odd[i];
-	    RHO_FDS[i] /= PH_FD_odd[i] * PV_FD_odd[i];
-	    RHO_FDS[i]  = sqrt (RHO_FDS[i]);
-	    RHO_FDS[i]  = (RHO_FDS[i] + tmpRHO) / 2.0 ;
-
-	    RHO_VDS[i]  = VEL_VD_COS_even[i] * VEL_VD_COS_even[i] + VEL_VD_SIN_even[i] * VEL_VD_SIN_even[i];
-	    RHO_VDS[i] /= PH_VD_even[i] * PV_VD_even[i];
-	    tmpRHO      = sqrt (RHO_VDS[i]);
-	    RHO_VDS[i]  = VEL_VD_COS_odd[i] * VEL_VD_COS_odd[i] + VEL_VD_SIN_odd[i] * VEL_VD_SIN_odd[i];
-	    RHO_VDS[i] /= PH_VD_odd[i] * PV_VD_odd[i];
-	    RHO_VDS[i]  = sqrt (RHO_VDS[i]);
-	    RHO_VDS[i]  = (RHO_VDS[i] + tmpRHO) / 2.0 ;
-
-	    VEL_HC[i] = atan2 (VEL_HC_SIN[i], VEL_HC_COS[i]) / PI * param.folding_velocity;
-	    VEL_VC[i] = atan2 (VEL_VC_SIN[i], VEL_VC_COS[i]) / PI * param.folding_velocity;
-
-	    /* Convert SNRs and ZEDs to dB */
-	    SNR_HC[i]  = 10.0 * log10 (SNR_HC[i]);
-	    ZED_HC[i]  = 10.0 * log10 (ZED_HC[i]);
-	    SNR_XHC[i] = 10.0 * log10 (SNR_XHC[i]);
-	    ZED_XHC[i] = 10.0 * log10 (ZED_XHC[i]);
-	    SNR_VC[i]  = 10.0 * log10 (SNR_VC[i]);
-	    ZED_VC[i]  = 10.0 * log10 (ZED_VC[i]);
-	    SNR_XVC[i] = 10.0 * log10 (SNR_XVC[i]);
-	    ZED_XVC[i] = 10.0 * log10 (ZED_XVC[i]);
-	    POW_H[i]   = 10.0 * log10 (POW_H[i]);
-	    POW_HX[i]  = 10.0 * log10 (POW_HX[i]);
-	    POW_V[i]   = 10.0 * log10 (POW_V[i]);
-	    POW_VX[i]  = 10.0 * log10 (POW_VX[i]);
-
-	    /* Calculate LDR */
-	    LDR_HC[i] = ZED_XHC[i] - ZED_HC[i] + param.LDR_calibration_offset;
-	    LDR_VC[i] = ZED_XVC[i] - ZED_VC[i] + param.LDR_calibration_offset;
-
-	    /* Do range correction */
-	    ZED_HC[i]  += 10.0 * log10 (param.range[i] * param.range[i]) + param.ZED_calibration_offset;
-	    ZED_XHC[i] += 10.0 * log10 (param.range[i] * param.range[i]) + param.ZED_calibration_offset;
-	    ZED_VC[i]  += 10.0 * log10 (param.range[i] * param.range[i]) + param.ZED_calibration_offset;
-	    ZED_XVC[i] += 10.0 * log10 (param.range[i] * param.range[i]) + param.ZED_calibration_offset;
-
-	    /* Calculate ZDR */
-	    ZDR_C[i] = ZED_HC[i] - ZED_VC[i];
-	}
-
-	/* Range correct 2nd pulse, cross-pol ZDR */
-	for (i = mode_gate_offset; i < param.samples_per_pulse; i++)
-	{
-	    ZED_HC[i]  -= 10.0 * log10 (param.range[i                   ] * param.range[i                   ]);
-	    ZED_HC[i]  += 10.0 * log10 (param.range[i - mode_gate_offset] * param.range[i - mode_gate_offset]);
-	    ZED_XHC[i] -= 10.0 * log10 (param.range[i                   ] * param.range[i                   ]);
-	    ZED_XHC[i] += 10.0 * log10 (param.range[i - mode_gate_offset] * param.range[i - mode_gate_offset]);
-	    ZED_VC[i]  -= 10.0 * log10 (param.range[i                   ] * param.range[i                   ]);
-	    ZED_VC[i]  += 10.0 * log10 (param.range[i - mode_gate_offset] * param.range[i - mode_gate_offset]);
-	    ZED_XVC[i] -= 10.0 * log10 (param.range[i                   ] * param.range[i                   ]);
-	    ZED_XVC[i] += 10.0 * log10 (param.range[i - mode_gate_offset] * param.range[i - mode_gate_offset]);
-	}
+	/*-------------------------------------------------------------------*
+	 * Finalise the ray in a single pass over the gates. In dual pulse   *
+	 * modes the second pulse is delayed by gate_offset.                 *
+	 *-------------------------------------------------------------------*/
+	RSP_FinaliseRay (&param, &ray, mode_gate_offset < param.samples_per_pulse);
 
 	NPC_H[0] /= uncoded_sum_wi[0];
 	NPC_V[0] /= uncoded_sum_wi[0];
 	NPC_H[0]  = 10.0 * log10 (NPC_H[0]);
 	NPC_V[0]  = 10.0 * log10 (NPC_V[0]);
+	RST_LAP (&timing, ST_FINALISE);
 
-	/* Only write out variables to netCDF if we are not exiting the program */
-	if (!exit_now)
+	/* Only write out variables to netCDF if we are not exiting the program,
+	 * nor ending the scan before the first bank of the ray */
+	if (!exit_now && nm > 0)
 	{
-	    printf ("Writing dynamic variables to NetCDF...\n");
+	    RLG_LOG (RLG_DEBUG, "Writing dynamic variables to NetCDF...\n");
 	    RNC_WriteDynamicVariables (ncid, &param, &obs);
+	    RST_LAP (&timing, ST_NC_WRITE);
 	    status = nc_sync (ncid);
 	    if (status != NC_NOERR) check_netcdf_handle_error (status);
+	    RST_LAP (&timing, ST_NC_SYNC);
 	}
 
-	printf ("I have written dynamic variables to NetCDF\n");
+	RLG_LOG (RLG_DEBUG, "I have written dynamic variables to NetCDF\n");
 	/*--------------------------------------------------------------------*
 	 * check to see if we have started a new day                          *
 	 *--------------------------------------------------------------------*/
 	system_time = time (NULL);
 	gmtime_r (&system_time, &tm);
-	if (tm.tm_mday != start_day)
+	if (tm.tm_mday != start_day && !offline)
 	{
-	    printf ("***** New day rollover detected.\n");
+	    RLG_LOG (RLG_INFO, "***** New day rollover detected.\n");
 	    break; /* Exit loop */
 	}
 
@@ -2993,37 +4285,32 @@ main (int    argc,
 	    obs.dish_centisecond = tv.tv_usec / 10000U;
 	}
 
-	/* Test for end of scan */
-	if (positionMessageAct || scan.scanType == SCAN_SGL)
+	/* Test for end of scan (offline runs to the end of the records) */
+	if (!offline && scan_exits >= 0)
+	{
+	    RSM_WindowState (&scan_window);
+	    scanEnd = (scan_window.exits > scan_exits);
+	    if (scanEnd)
+		log_crossing ("Scan end", scan_window.left_ns);
+	}
+	else if (!offline && (positionMessageAct || scan.scanType == SCAN_SGL))
  	{
 	    scanEnd = scanEnd_test (scan.scanType, &position_msg,
 				    scan.min_angle, scan.max_angle);
 	}
 
-	/* Prepare for possible switch to new mode next ray */
-	if ((param.alternate_modes != 0) & (param.long_pulse_mode == 0))
-	{
-	    remainder = ray_count % (param.nrays_mode0 + param.nrays_mode1);
-	    printf ("remainder calculated\n");
-	    if (remainder == 0)
-	    {
-		new_mode  = 0;
-		ray_count = 0;
-	    }
-	    else if (remainder == param.nrays_mode0)
-	    {
-		new_mode = 1;
-	    }
-	    else
-	    {
-		new_mode = -1;
-	    }
-	}
-	else
-	{
-	    /* Don't alternate modes (remain in mode defined by mode0) */
-	    new_mode = -1;
-	}
+	/* -daemon: the next scan has been sent */
+	if (control_line[0] != '\0')
+	    scanEnd = true;
+
+	/* The next ray, in the mode its first bank was started in */
+	ray_mode = next_mode;
+
+	RST_LAP (&timing, ST_OTHER);
+	RST_END_RAY (&timing);
+#ifndef RST_NO_TIMING
+	timing_check (false);
+#endif /* RST_NO_TIMING */
     }
 
     /*-------------------------------------------------------------------------- *
@@ -3031,17 +4318,16 @@ main (int    argc,
      *========================================================================== */
 
 exit_endacquisition:
+    scan_files_wait ();
 
     /*------------*
      * Finish off *
      *------------*/
-    printf ("*** Closing PCICARD...\n");
-    RDQ_ClosePCICARD_New (amcc_fd, &dma_buffer, DMA_BUFFER_SIZE);
-#ifndef NO_DIO
-    printf ("*** Closing DIO card...\n");
-    close (fd);
-#endif /* NO_DIO */
-
+#ifndef RST_NO_TIMING
+    if (timing_file[0] != '\0')
+	timing_check (true);
+    timing_file[0] = '\0';
+#endif /* RST_NO_TIMING */
     if (tsfid != NULL)
     {
 	/* Close time-series file */
@@ -3079,76 +4365,48 @@ exit_endacquisition:
 	status = nc_close (ncidts);
 	printf ("Status = %d\n", status);
 	if (status != NC_NOERR) check_netcdf_handle_error (status);
-	free (tsobs.ICOH);
     }
 
+    /* -daemon: on to the next scan */
+    if (control_fd >= 0 && !exit_now)
+	goto next_scan;
+
+exit_daemon:
+    printf ("*** %lu banks: %lu missed their deadline of %.3f s, "
+	    "%lu DMA timeouts, %lu master aborts, %lu FIFO overflows, %lu HV timeouts\n",
+	    banks_waited, banks_missed, param.dwell_time,
+	    bank_errors[0], bank_errors[1], bank_errors[2], bank_errors[3]);
+    if (retrigger_jitter.count > 0)
+	printf ("*** %llu retriggers woke late by %.1f us median, %.1f us p99, %.1f us max\n",
+		(unsigned long long)retrigger_jitter.count,
+		1e-3 * RST_Percentile (&retrigger_jitter, 50.0),
+		1e-3 * RST_Percentile (&retrigger_jitter, 99.0),
+		1e-3 * retrigger_jitter.max_ns);
+    printf ("*** Closing %s acquisition...\n", daq_backend->name);
+    RDQ_Close (&daq);
+#ifndef NO_DIO
+    if (fd >= 0)
+    {
+	printf ("*** Closing DIO card...\n");
+	close (fd);
+    }
+#endif /* NO_DIO */
+
     /*---------------------------*
      * Unallocate all the memory *
      *---------------------------*/
     RSP_FreeMemory (&param);  // Free memory allocated by RSP package
     RSP_ObsFree (&obs);      // Free observables memory
-    free (timeseries);
-    free (current_PSD);
-
-    for (i = 0; i < param.samples_per_pulse; i++)
-    {
-	free (PSD[i].HH);
-	free (PSD[i].HV);
-    }
-
-    free (uncoded_mean_vsq);
-    free (uncoded_mean_Zsq);
-    free (uncoded_sum_wi);
-
-    free (IQStruct.I_uncoded_copolar_H);
-    free (IQStruct.Q_uncoded_copolar_H);
-    free (IQStruct.I_uncoded_crosspolar_H);
-    free (IQStruct.Q_uncoded_crosspolar_H);
-
-    free (VEL_HC_COS);
-    free (VEL_HC_SIN);
-    free (VEL_VC_COS);
-    free (VEL_VC_SIN);
-    free (VEL_VD_COS);
-    free (VEL_VD_SIN);
-    free (VEL_FD_COS);
-    free (VEL_FD_SIN);
-    free (VEL_VD_COS_even);
-    free (VEL_VD_SIN_even);
-    free (VEL_FD_COS_even);
-    free (VEL_FD_SIN_even);
-    free (VEL_VD_COS_odd);
-    free (VEL_VD_SIN_odd);
-    free (VEL_FD_COS_odd);
-    free (VEL_FD_SIN_odd);
-    free (PHIDP_FD_COS);
-    free (PHIDP_FD_SIN);
-    free (PHIDP_VD_COS);
-    free (PHIDP_VD_SIN);
-    free (PH_FD);
-    free (PV_FD);
-    free (PH_VD);
-    free (PV_VD);
-    free (PH_FD_even);
-    free (PV_FD_even);
-    free (PH_VD_even);
-    free (PV_VD_even);
-    free (PH_FD_odd);
-    free (PV_FD_odd);
-    free (PH_VD_odd);
-    free (PV_VD_odd);
-
     fftw_destroy_plan (p_uncoded);
-    fftw_free (V0_odd);
-    fftw_free (H0_even);
-    fftw_free (V_even);
-    fftw_free (H_even);
-    fftw_free (V_odd);
-    fftw_free (H_odd);
-    fftw_free (in);
+    if (param.code_length > 1)
+    {
+	RSP_PulseCompressFree (&pulse_compress);
+    }
+    RRT_ArenaClose (&run_arena);
 
     if (positionMessageAct)
 	RSM_ClosePositionMessage ();
+    control_close ();
 
     /*=========*
      * THE END *
@@ -20,6 +20,7 @@
 #define V_not_H_SAMPLE     0  /* Tx Pulse somewhere between gates 2 and 8             */
 #define PowerAvStartSample 20 /* Power monitor sample holds have settled by this gate */
 #define PowerAvEndSample   35
+#define NoiseGates         50 /* Noise estimated from the last gates processed        */
 //#define PowerAvStartSample 3 /* Power monitor sample holds have settled by this gate */
 //#define PowerAvEndSample   4
 
@@ -0,0 +1,606 @@
+/*****************************************************************
+ * radar-galileo-reprocess.c
+ * ---------------------------------------------------------------
+ * Offline reprocessing of time series (ts) files written by
+ * radar-galileo-rec -tsdump.
+ *
+ * The moments are made by radar-galileo-rec itself, run with
+ * -offline on the replay acquisition, so the processing chain is
+ * exactly the one used on the radar. Settings (pulses, averaging,
+ * noise gates, clutter bins, any other config key) are changed in
+ * a private copy of the config file. The ts files are cut into
+ * ranges of records which are processed by a pool of recorder
+ * processes, one per core by default. The ranges hold whole rays
+ * of both the recording and the processing, so the rays are those
+ * of the whole file even when the pulses or the averaging change. Every process holds one ts
+ * record at a time, so the memory used does not depend on the
+ * size of the files. The moments files are written in the usual
+ * RNC layout under -outdir.
+ *
+ * ---------------------------------------------------------------
+ * REVISION HISTORY
+ * ---------------------------------------------------------------
+ *
+ * 20261019     First version
+ *****************************************************************/
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include <netcdf.h>
+
+#include <radar.h> // Master header file for the Universal Radar Code
+#include <RNC.h>   // Include file for the RNC package
+
+#include "radar-galileo-rec.h"
+
+#define MAX_SETTINGS 32
+
+/* one range of rays of a ts file, processed by one recorder */
+typedef struct Job_st
+{
+    const char * file;
+    char         scan[3][32];   /* scan option and its angles */
+    char         extra[32];
+    int          first;         /* first record */
+    int          records;
+    pid_t        pid;
+} Job_st;
+
+typedef struct Setting_st
+{
+    const char * key;
+    const char * value;
+} Setting_st;
+
+static Setting_st settings[MAX_SETTINGS];
+static int        nsettings = 0;
+static bool       verbose   = false;
+
+
+static inline void
+disp_help (const char * prog)
+{
+    const char * pt = strrchr (prog, '/');
+
+    if (pt++ != NULL)
+	prog = pt;
+
+    printf ("Usage: %s [options] tsfile ...\n\n", prog);
+    printf ("Options:\n");
+    printf ("--------\n");
+    printf (" -j <n>                Run n recorders at once (default: one per core)\n");
+    printf (" -rays <n>             Rays per recorder (default: spread over the cores)\n");
+    printf (" -outdir path          Write the moments files under path (required)\n");
+    printf (" -config filename      Base config file (default %s)\n", CONFIG_FILE);
+    printf (" -calfile filename     Calibration file (default %s)\n", CAL_FILE);
+    printf (" -rec path             radar-galileo-rec to run (default: next to this program)\n");
+    printf (" -set <key> <value>    Override a config key\n");
+    printf (" -pulses <n>           Pulses per spectrum (nfft)     = -set pulses n\n");
+    printf (" -spec-avg <n>         Spectra averaged               = -set num-spec-avg n\n");
+    printf (" -mom-avg <n>          Moments averaged               = -set num-moments-avg n\n");
+    printf (" -clutter-bins <n>     Clutter bins interpolated over = -set reject-clutter-bins n\n");
+    printf (" -noise-gates <a> <b>  Gates the noise is estimated from\n");
+    printf (" -process-gates <a> <b> Gates processed, the range window\n");
+    printf (" -v                    Show the output of the recorders\n");
+    printf ("\n");
+}
+
+static void
+add_setting (const char * key, const char * value)
+{
+    int i;
+
+    for (i = 0; i < nsettings; i++)
+    {
+	if (!strcmp (settings[i].key, key))
+	{
+	    settings[i].value = value;
+	    return;
+	}
+    }
+    if (nsettings == MAX_SETTINGS)
+    {
+	printf ("Too many config settings\n");
+	exit (1);
+    }
+    settings[nsettings].key   = key;
+    settings[nsettings].value = value;
+    nsettings++;
+}
+
+/*
+ * Copy the base config file to a temporary file, with the keys
+ * set on the command line replaced.
+ */
+static int
+write_config (const char * base, char * tmpname)
+{
+    char   line[1024];
+    FILE * in;
+    FILE * out;
+    int    fd, i;
+
+    in = fopen (base, "r");
+    if (in == NULL)
+    {
+	printf ("Cannot open %s: %m\n", base);
+	return -1;
+    }
+
+    strcpy (tmpname, "/tmp/radar-galileo-reprocess.XXXXXX");
+    fd = mkstemp (tmpname);
+    if (fd < 0 || (out = fdopen (fd, "w")) == NULL)
+    {
+	printf ("Cannot create a config file: %m\n");
+	fclose (in);
+	return -1;
+    }
+
+    while (fgets (line, sizeof (line), in) != NULL)
+    {
+	size_t len = strcspn (line, " \t\r\n");
+
+	for (i = 0; i < nsettings; i++)
+	{
+	    if (line[0] != '#' && len == strlen (settings[i].key) &&
+		!strncmp (line, settings[i].key, len))
+		break;
+	}
+	if (i == nsettings)
+	    fputs (line, out);
+    }
+    fprintf (out, "\n# set by radar-galileo-reprocess\n");
+    for (i = 0; i < nsettings; i++)
+	fprintf (out, "%s %s\n", settings[i].key, settings[i].value);
+
+    fclose (in);
+    if (fclose (out) != 0)
+    {
+	printf ("Cannot write %s: %m\n", tmpname);
+	unlink (tmpname);
+	return -1;
+    }
+    return 0;
+}
+
+/* least common multiple */
+static long
+lcm (long a, long b)
+{
+    long x = a, y = b, t;
+
+    while (y != 0)
+    {
+	t = x % y;
+	x = y;
+	y = t;
+    }
+    return a / x * b;
+}
+
+/* mkdir -p */
+static int
+make_path (const char * path)
+{
+    char   dir[PATH_MAX];
+    char * p;
+
+    snprintf (dir, sizeof (dir), "%s", path);
+    for (p = dir + 1; ; p++)
+    {
+	if (*p == '/' || *p == '\0')
+	{
+	    const char c = *p;
+
+	    *p = '\0';
+	    if (mkdir (dir, 0755) != 0 && errno != EEXIST)
+	    {
+		printf ("Cannot create %s: %m\n", dir);
+		return -1;
+	    }
+	    *p = c;
+	    if (c == '\0')
+		break;
+	}
+    }
+    return 0;
+}
+
+/*
+ * Read the records, rays and scan of a ts file.
+ * Returns the number of records, or -1.
+ */
+static int
+read_ts_header (const char * file, Job_st * job, int * records_per_ray, int * pulses_per_record)
+{
+    char   scantype[32] = "";
+    float  min_angle = 0, max_angle = 0, scan_angle = 0;
+    size_t records, len;
+    int    ncid, dimid;
+
+    if (nc_open (file, NC_NOWRITE, &ncid) != NC_NOERR)
+    {
+	printf ("Cannot open %s\n", file);
+	return -1;
+    }
+    if (nc_inq_dimid (ncid, "time", &dimid) != NC_NOERR ||
+	nc_inq_dimlen (ncid, dimid, &records) != NC_NOERR ||
+	nc_inq_dimid (ncid, "pulses", &dimid) != NC_NOERR ||
+	nc_inq_dimlen (ncid, dimid, &len) != NC_NOERR || len < 1 ||
+	nc_inq_varid (ncid, "ICOH", &dimid) != NC_NOERR)
+    {
+	printf ("%s is not a time series file\n", file);
+	nc_close (ncid);
+	return -1;
+    }
+    *pulses_per_record = (int) len;
+    if (nc_get_att_int (ncid, NC_GLOBAL, "moments_averaged", records_per_ray) != NC_NOERR ||
+	*records_per_ray < 1)
+	*records_per_ray = 1;
+
+    if (nc_inq_attlen (ncid, NC_GLOBAL, "scantype", &len) == NC_NOERR && len < sizeof (scantype))
+	nc_get_att_text (ncid, NC_GLOBAL, "scantype", scantype);
+    nc_get_att_float (ncid, NC_GLOBAL, "min_angle",  &min_angle);
+    nc_get_att_float (ncid, NC_GLOBAL, "max_angle",  &max_angle);
+    nc_get_att_float (ncid, NC_GLOBAL, "scan_angle", &scan_angle);
+    nc_close (ncid);
+
+    /* the scan options of radar-galileo-rec that write this scantype */
+    if (!strcmp (scantype, "PPI") || !strcmp (scantype, "RHI") || !strcmp (scantype, "S-P"))
+    {
+	snprintf (job->scan[0], sizeof (job->scan[0]), "%s",
+		  !strcmp (scantype, "PPI") ? "-ppi" : !strcmp (scantype, "RHI") ? "-rhi" : "-csp");
+	snprintf (job->scan[1], sizeof (job->scan[1]), "%g", min_angle);
+	snprintf (job->scan[2], sizeof (job->scan[2]), "%g", max_angle);
+	snprintf (job->extra,   sizeof (job->extra),   "%g", scan_angle);
+    }
+    else if (!strcmp (scantype, "Calibration") || !strcmp (scantype, "Manual") ||
+	     !strcmp (scantype, "Tracking"))
+    {
+	snprintf (job->scan[0], sizeof (job->scan[0]), "%s", scantype[0] == 'C' ? "-cal" : "-man");
+	snprintf (job->scan[1], sizeof (job->scan[1]), "%g", scan_angle);
+	snprintf (job->scan[2], sizeof (job->scan[2]), "%g", min_angle);
+	job->extra[0] = '\0';
+    }
+    else
+    {
+	/* Fixed, or unknown: a dwell at the recorded position */
+	snprintf (job->scan[0], sizeof (job->scan[0]), "-fix");
+	snprintf (job->scan[1], sizeof (job->scan[1]), "%g", scan_angle);
+	snprintf (job->scan[2], sizeof (job->scan[2]), "%g", min_angle);
+	job->extra[0] = '\0';
+    }
+    return (int) records;
+}
+
+static pid_t
+start_job (Job_st * job, const char * rec, const char * config,
+	   const char * calfile, const char * outdir)
+{
+    char         first[16], records[16];
+    const char * argv[24];
+    int          argc = 0;
+    pid_t        pid;
+
+    snprintf (first,   sizeof (first),   "%d", job->first);
+    snprintf (records, sizeof (records), "%d", job->records);
+
+    argv[argc++] = rec;
+    argv[argc++] = "-offline";
+    argv[argc++] = "-replay";
+    argv[argc++] = job->file;
+    argv[argc++] = "-records";
+    argv[argc++] = first;
+    argv[argc++] = records;
+    argv[argc++] = "-config";
+    argv[argc++] = config;
+    if (calfile != NULL)
+    {
+	argv[argc++] = "-calfile";
+	argv[argc++] = calfile;
+    }
+    argv[argc++] = "-outdir";
+    argv[argc++] = outdir;
+    if (!strcmp (job->scan[0], "-fix"))
+    {
+	/* -fix n az el */
+	argv[argc++] = "-fix";
+	argv[argc++] = "0";
+	argv[argc++] = job->scan[1];
+	argv[argc++] = job->scan[2];
+    }
+    else
+    {
+	argv[argc++] = job->scan[0];
+	argv[argc++] = job->scan[1];
+	argv[argc++] = job->scan[2];
+    }
+    if (job->extra[0] != '\0')
+    {
+	argv[argc++] = "-scan_angle";
+	argv[argc++] = job->extra;
+    }
+    argv[argc] = NULL;
+
+    pid = fork ();
+    if (pid == 0)
+    {
+	if (!verbose)
+	{
+	    int fd = open ("/dev/null", O_WRONLY);
+
+	    if (fd >= 0)
+	    {
+		dup2 (fd, STDOUT_FILENO);
+		close (fd);
+	    }
+	}
+	execv (rec, (char * const *) argv);
+	fprintf (stderr, "Cannot run %s: %m\n", rec);
+	_exit (127);
+    }
+    if (pid < 0)
+	printf ("Cannot fork: %m\n");
+    return pid;
+}
+
+int
+main (int argc, char * argv[])
+{
+    const char * config_file = CONFIG_FILE;
+    const char * cal_file    = NULL;
+    const char * outdir      = NULL;
+    char         rec[PATH_MAX] = "";
+    char         tmpconf[64];
+    Job_st *     jobs = NULL;
+    int          njobs = 0, maxjobs = 0;
+    int          workers = sysconf (_SC_NPROCESSORS_ONLN);
+    int          rays_per_job = 0;
+    int          nfiles = 0, total_rays = 0, dropped = 0;
+    long         ray_pulses;
+    int          running, next, done, failed;
+    int          i, pass;
+
+    for (i = 1; i < argc && argv[i][0] == '-'; i++)
+    {
+	if (!strcmp (argv[i], "-j") && i + 1 < argc)
+	    workers = atoi (argv[++i]);
+	else if (!strcmp (argv[i], "-rays") && i + 1 < argc)
+	    rays_per_job = atoi (argv[++i]);
+	else if (!strcmp (argv[i], "-outdir") && i + 1 < argc)
+	    outdir = argv[++i];
+	else if (!strcmp (argv[i], "-config") && i + 1 < argc)
+	    config_file = argv[++i];
+	else if (!strcmp (argv[i], "-calfile") && i + 1 < argc)
+	    cal_file = argv[++i];
+	else if (!strcmp (argv[i], "-rec") && i + 1 < argc)
+	    snprintf (rec, sizeof (rec), "%s", argv[++i]);
+	else if (!strcmp (argv[i], "-set") && i + 2 < argc)
+	{
+	    add_setting (argv[i + 1], argv[i + 2]);
+	    i += 2;
+	}
+	else if (!strcmp (argv[i], "-pulses") && i + 1 < argc)
+	    add_setting ("pulses", argv[++i]);
+	else if (!strcmp (argv[i], "-spec-avg") && i + 1 < argc)
+	    add_setting ("num-spec-avg", argv[++i]);
+	else if (!strcmp (argv[i], "-mom-avg") && i + 1 < argc)
+	    add_setting ("num-moments-avg", argv[++i]);
+	else if (!strcmp (argv[i], "-clutter-bins") && i + 1 < argc)
+	    add_setting ("reject-clutter-bins", argv[++i]);
+	else if (!strcmp (argv[i], "-noise-gates") && i + 2 < argc)
+	{
+	    static char gates[32];
+
+	    snprintf (gates, sizeof (gates), "%d %d", atoi (argv[i + 1]), atoi (argv[i + 2]));
+	    add_setting ("noise-gates", gates);
+	    i += 2;
+	}
+	else if (!strcmp (argv[i], "-process-gates") && i + 2 < argc)
+	{
+	    static char gates[32];
+
+	    snprintf (gates, sizeof (gates), "%d %d", atoi (argv[i + 1]), atoi (argv[i + 2]));
+	    add_setting ("process-gates", gates);
+	    i += 2;
+	}
+	else if (!strcmp (argv[i], "-v"))
+	    verbose = true;
+	else
+	{
+	    disp_help (argv[0]);
+	    return 1;
+	}
+    }
+    nfiles = argc - i;
+    if (nfiles == 0 || outdir == NULL)
+    {
+	disp_help (argv[0]);
+	return 1;
+    }
+    if (workers < 1)
+	workers = 1;
+
+    /* by default the recorder installed with this program */
+    if (rec[0] == '\0')
+    {
+	ssize_t len = readlink ("/proc/self/exe", rec, sizeof (rec) - 1);
+	char *  pt;
+
+	rec[len > 0 ? len : 0] = '\0';
+	pt = strrchr (rec, '/');
+	snprintf (pt != NULL ? pt + 1 : rec, sizeof (rec) - (pt != NULL ? pt + 1 - rec : 0),
+		  "radar-galileo-rec");
+    }
+    if (access (rec, X_OK) != 0)
+    {
+	printf ("Cannot run %s: %m\n", rec);
+	return 1;
+    }
+
+    /* the recorders make the tree below it */
+    if (make_path (outdir) != 0)
+	return 1;
+
+    if (write_config (config_file, tmpconf) != 0)
+	return 1;
+
+    /* the pulses of a ray as the recorders will make them */
+    ray_pulses = (long) RNC_GetConfigDouble (tmpconf, "pulses") *
+	(long) RNC_GetConfigDouble (tmpconf, "num-spec-avg") *
+	(long) RNC_GetConfigDouble (tmpconf, "num-moments-avg");
+    if (ray_pulses < 1)
+    {
+	printf ("No pulses per ray in %s\n", config_file);
+	unlink (tmpconf);
+	return 1;
+    }
+
+    /*
+     * Cut the files into jobs of whole rays. A job starts at a record
+     * and its rays must be those of the whole file, so the cuts are at
+     * multiples of the rays of both the recording and the processing.
+     * The pulses after the last whole ray of a file are dropped. The
+     * first pass counts the rays, so that a few files are still spread
+     * over all the workers.
+     */
+    for (pass = 0; pass < 2; pass++)
+    {
+	for (; i < argc; i++)
+	{
+	    Job_st file_job;
+	    int    records, per_ray, per_record, rays, step, job_records, r;
+	    long   units;
+
+	    memset (&file_job, 0, sizeof (file_job));
+	    file_job.file = argv[i];
+	    records = read_ts_header (argv[i], &file_job, &per_ray, &per_record);
+	    if (records <= 0)
+		continue;
+	    rays = (int) ((long) records * per_record / ray_pulses);
+
+	    if (pass == 0)
+	    {
+		total_rays += rays;
+		dropped    += ((long) records * per_record % ray_pulses) != 0;
+		continue;
+	    }
+
+	    /* records from one cut to the next, and the cuts in a job */
+	    step  = (int) (lcm ((long) per_ray * per_record, ray_pulses) / per_record);
+	    units = ((long) rays_per_job * ray_pulses + (long) step * per_record - 1) /
+		((long) step * per_record);
+	    job_records = (units < records / step + 1) ? (int) units * step : records;
+
+	    for (r = 0; r < records; r += job_records)
+	    {
+		/* the end of the file, short of a ray */
+		if ((long) (records - r) * per_record < ray_pulses)
+		    break;
+		if (njobs == maxjobs)
+		{
+		    maxjobs = maxjobs ? 2 * maxjobs : 64;
+		    jobs = realloc (jobs, maxjobs * sizeof (Job_st));
+		    if (jobs == NULL)
+		    {
+			printf ("Memory allocation error: %m\n");
+			unlink (tmpconf);
+			return 1;
+		    }
+		}
+		jobs[njobs]         = file_job;
+		jobs[njobs].first   = r;
+		jobs[njobs].records = (r + job_records < records) ? job_records : records - r;
+		njobs++;
+	    }
+	}
+	i = argc - nfiles;
+
+	if (pass == 0 && rays_per_job <= 0)
+	{
+	    /* whole files when there are enough to keep the workers busy */
+	    if (nfiles >= workers)
+		rays_per_job = INT_MAX / 2;
+	    else
+		rays_per_job = (total_rays + workers - 1) / workers;
+	    if (rays_per_job < 1)
+		rays_per_job = 1;
+	}
+    }
+    if (njobs == 0)
+    {
+	printf ("No time series to reprocess\n");
+	unlink (tmpconf);
+	return 1;
+    }
+
+    printf ("Reprocessing %d ray(s) of %d file(s) in %d job(s) on %d worker(s)\n",
+	    total_rays, nfiles, njobs, workers);
+    if (dropped > 0)
+	printf ("%d partial ray(s) at the end of the files dropped\n", dropped);
+
+    /* a pool of recorders */
+    running = next = done = failed = 0;
+    while (done < njobs)
+    {
+	int   status;
+	pid_t pid;
+
+	while (running < workers && next < njobs)
+	{
+	    jobs[next].pid = start_job (&jobs[next], rec, tmpconf, cal_file, outdir);
+	    if (jobs[next].pid < 0)
+	    {
+		failed++;
+		done++;
+	    }
+	    else
+		running++;
+	    next++;
+	}
+	if (running == 0)
+	    continue;
+
+	pid = wait (&status);
+	if (pid < 0)
+	{
+	    if (errno == EINTR)
+		continue;
+	    break;
+	}
+	for (i = 0; i < njobs; i++)
+	{
+	    if (jobs[i].pid != pid)
+		continue;
+	    if (!WIFEXITED (status) || WEXITSTATUS (status) != 0)
+	    {
+		printf ("%s records %d-%d failed\n", jobs[i].file,
+			jobs[i].first, jobs[i].first + jobs[i].records - 1);
+		failed++;
+	    }
+	    else if (verbose)
+		printf ("%s records %d-%d done\n", jobs[i].file,
+			jobs[i].first, jobs[i].first + jobs[i].records - 1);
+	    jobs[i].pid = 0;
+	    running--;
+	    done++;
+	    break;
+	}
+    }
+
+    unlink (tmpconf);
+    free (jobs);
+
+    printf ("%d job(s) done, %d failed\n", njobs - failed, failed);
+    return failed ? 1 : 0;
+}
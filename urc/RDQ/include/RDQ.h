@@ -4,6 +4,7 @@
 #include <sys/types.h>
 #include <stdint.h>
 #include <string.h>
+#include <time.h>
 
 #define DMA_BUFFER_SIZE (32*1024*1024*4)
 
@@ -68,4 +69,176 @@ RDQ_StartAcquisition  (int         amcc_fd,
     RDQ_StartAcquisition2 (amcc_fd, dma_bank, tcount);
 }
 
+/*--------------------------------------------------------------------*
+ * Acquisition backends                                               *
+ *                                                                    *
+ * A backend fills two banks of interleaved ADC samples, laid out as  *
+ * the AMCC card writes them: config.pulses pulses of                 *
+ * samples_per_pulse samples of config.channels 16 bit words. The    *
+ * processing starts one bank, waits for it, starts the other and     *
+ * processes the first, exactly as with the hardware.                 *
+ *--------------------------------------------------------------------*/
+
+/* RDQ_WaitBank status */
+#define RDQ_STATUS_OK    0
+#define RDQ_STATUS_DMA_TIMEOUT   1  /* AMCC codes, see RDQ_WaitForAcquisitionToComplete */
+#define RDQ_STATUS_MASTER_ABORT  2
+#define RDQ_STATUS_FIFO_OVERFLOW 3
+#define RDQ_STATUS_HV_TIMEOUT    4
+#define RDQ_STATUS_END   5  /* replay file exhausted */
+#define RDQ_STATUS_ERROR 6  /* backend read or generate error */
+
+/* ADC mid-scale (12 bit converters) */
+#define RDQ_ADC_MIDSCALE 2048
+
+typedef struct
+{
+    int          samples_per_pulse;
+    int          pulses;            /* pulses per bank                      */
+    int          channels;          /* ADC channels, 4 or 8                 */
+    int          clock_divfactor;
+    int          delay_clocks;
+    int          offset[8];         /* word of logical channel c in a sample */
+    const char * source;            /* replay: ts netCDF file               */
+    int          first_record;      /* replay: first ts record              */
+    int          records;           /* replay: records to replay, 0 for all */
+    int          once;              /* replay: end instead of starting over */
+
+    /* Transmit sequence and radar, used by the synthetic backend */
+    int          mode;              /* PulseMode_en (radar-galileo-rec.h)   */
+    double       prt;               /* s, of each transmit polarisation     */
+    double       pulse_delay;       /* s, second pulse of a dual pulse PRT  */
+    int          delay_gates;       /* samples its echoes appear later      */
+    double       wavelength;        /* m                                    */
+    double       system_phase;      /* rad, V receiver phase relative to H  */
+} RDQ_ConfigStruct;
+
+/* Metadata of one completed bank */
+typedef struct
+{
+    unsigned long   sequence;       /* banks completed since RDQ_Open       */
+    int             bank;           /* 0 or 1                               */
+    int             status;         /* RDQ_STATUS_OK or an error code       */
+    size_t          bytes;          /* bytes acquired                       */
+    struct timespec time;           /* CLOCK_REALTIME at completion, or the */
+				    /* recorded time for replayed banks     */
+    int             positioned;     /* azimuth and elevation are recorded   */
+    float           azimuth;
+    float           elevation;
+    double          slack;          /* s from the wait starting to the bank */
+				    /* completing, negative when the        */
+				    /* processing of the last bank overran  */
+				    /* its deadline (see RDQ_WaitBank)      */
+    struct timespec completed;      /* CLOCK_MONOTONIC at completion, the   */
+				    /* card's pulse train for retriggering  */
+} RDQ_BankInfoStruct;
+
+typedef struct RDQ_DeviceStruct RDQ_DeviceStruct;
+
+typedef struct
+{
+    const char * name;
+    int          hardware;          /* needs the radar PC (and its DIO card) */
+    int  (*open)       (RDQ_DeviceStruct * dev);
+    void (*start_bank) (RDQ_DeviceStruct * dev, int bank);
+    int  (*wait_bank)  (RDQ_DeviceStruct * dev, int bank);
+    void (*close)      (RDQ_DeviceStruct * dev);
+} RDQ_BackendStruct;
+
+struct RDQ_DeviceStruct
+{
+    const RDQ_BackendStruct * backend;
+    RDQ_ConfigStruct          config;
+    uint16_t *                banks[2];
+    size_t                    bank_bytes;   /* bytes acquired into a bank   */
+    int                       active_bank;  /* bank being filled, or -1     */
+    unsigned long             sequence;
+    struct timespec           started;      /* CLOCK_MONOTONIC at RDQ_StartBank */
+    void *                    priv;         /* backend state                */
+
+    /* Set by backends that know when and where a bank was acquired */
+    struct timespec           start_time;   /* of the first bank, or 0      */
+    struct timespec           bank_time;    /* of the bank just waited for  */
+    int                       positioned;
+    float                     azimuth;
+    float                     elevation;
+};
+
+extern const RDQ_BackendStruct RDQ_Backend_amcc;
+extern const RDQ_BackendStruct RDQ_Backend_replay;
+extern const RDQ_BackendStruct RDQ_Backend_synthetic;
+
+
+const RDQ_BackendStruct * RDQ_FindBackend (const char * name);
+int  RDQ_Open      (RDQ_DeviceStruct * dev, const RDQ_BackendStruct * backend,
+		    const RDQ_ConfigStruct * config);
+void RDQ_StartBank (RDQ_DeviceStruct * dev, int bank);
+int  RDQ_WaitBank  (RDQ_DeviceStruct * dev, RDQ_BankInfoStruct * info);
+void RDQ_SetMode   (RDQ_DeviceStruct * dev, int mode);
+void RDQ_Close     (RDQ_DeviceStruct * dev);
+
+/*--------------------------------------------------------------------*
+ * Synthetic weather signals (RDQ_Weather.c)                          *
+ *                                                                    *
+ * Each gate holds a Gaussian Doppler spectrum of known power, mean   *
+ * velocity and width, with known ZDR, LDR, PHIDP and rho_hv, plus    *
+ * zero Doppler clutter. The H and V echoes are summed with receiver  *
+ * noise into the co- (H) and cross-polar (V) channels of a bank, in  *
+ * the DMA layout, following the transmit sequence of a PulseMode_en: *
+ * in the dual pulse modes the echoes of the second pulse appear      *
+ * config.delay_gates later in the same PRT. V_not_H flags PRTs whose *
+ * first pulse is V; the transmitter monitors T1 (H) and T2 (V) hold  *
+ * from the pulse onwards. As in radar-galileo-rec, config.prt is the *
+ * repetition time of each polarisation: the modes that alternate H   *
+ * and V start a PRT every config.prt / 2.                            *
+ *--------------------------------------------------------------------*/
+
+/* A gate component at or below this power (dB) is absent */
+#define RDQ_NO_SIGNAL -100.0f
+
+/* Ground truth of one gate */
+typedef struct
+{
+    float snr;                      /* H co-polar signal to noise, dB       */
+    float velocity;                 /* m/s, positive for positive Doppler   */
+    float width;                    /* spectral width, m/s                  */
+    float zdr;                      /* dB                                   */
+    float ldr;                      /* dB                                   */
+    float phidp;                    /* degrees, phase of H less that of V   */
+    float rhohv;
+    float cnr;                      /* zero Doppler clutter to noise, dB    */
+} RDQ_GateTruthStruct;
+
+/* Transmit sequence of a PulseMode_en, PRTs counted from the bank start */
+typedef struct
+{
+    int pulses;                     /* transmit pulses per PRT, 1 or 2      */
+    int v_first[2];                 /* first pulse is V, even and odd PRTs  */
+    int v_second[2];                /* second pulse is V, even and odd PRTs */
+    int tx_pol;                     /* polarisations transmitted: the PRTs  */
+                                    /* of a mode with 2 are config.prt / 2  */
+} RDQ_PulseSchemeStruct;
+
+typedef struct
+{
+    RDQ_ConfigStruct            config;
+    const RDQ_GateTruthStruct * truth;          /* samples_per_pulse gates   */
+    double                      noise;          /* counts^2 per channel      */
+    double                      clutter_width;  /* m/s                       */
+    unsigned int                seed;
+    void *                      priv;
+} RDQ_WeatherStruct;
+
+const RDQ_PulseSchemeStruct * RDQ_PulseScheme (int mode);
+void RDQ_WeatherProfile (RDQ_GateTruthStruct * truth, int gates);
+int  RDQ_WeatherInit    (RDQ_WeatherStruct * w, const RDQ_ConfigStruct * config,
+			 const RDQ_GateTruthStruct * truth, double noise);
+int  RDQ_WeatherBank    (RDQ_WeatherStruct * w, uint16_t * bank);
+void RDQ_WeatherFree    (RDQ_WeatherStruct * w);
+
+/* Receiver noise of the synthetic backend, counts^2 per channel */
+#define RDQ_SYNTHETIC_NOISE 32.0
+
+void RDQ_SyntheticProfile (RDQ_GateTruthStruct * truth, const RDQ_ConfigStruct * config);
+
 #endif /* !_RDQ_H */
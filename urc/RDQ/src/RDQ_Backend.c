@@ -0,0 +1,147 @@
+/*
+   Purpose: 	Hardware independent front end of the data acquisition. The
+		processing opens a backend by name and then only sees banks
+		of interleaved ADC samples and their metadata, so the same
+		chain runs on the AMCC card, on recorded time series or on
+		synthetic signals.
+
+   Created on:  19/10/2026
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <RDQ.h>
+
+static const RDQ_BackendStruct * const backends[] = {
+	&RDQ_Backend_amcc,
+	&RDQ_Backend_replay,
+	&RDQ_Backend_synthetic,
+};
+
+const RDQ_BackendStruct * RDQ_FindBackend(const char * name) {
+	/*
+	IN:     name  backend name, or NULL for the AMCC card
+	RETURN: the backend, or NULL if there is none of that name
+	 */
+	size_t i;
+
+	if (name == NULL || *name == '\0') return &RDQ_Backend_amcc;
+
+	for (i = 0; i < sizeof(backends) / sizeof(backends[0]); i++) {
+		if (strcmp(name, backends[i]->name) == 0) return backends[i];
+	}
+	return NULL;
+}
+
+int RDQ_Open(RDQ_DeviceStruct * dev, const RDQ_BackendStruct * backend, const RDQ_ConfigStruct * config) {
+	/*
+	IN:     backend, config
+	OUT:    dev  ready for RDQ_StartBank
+	RETURN: 0, or -1 if the backend could not be opened
+	 */
+	memset(dev, 0, sizeof(*dev));
+	dev->backend     = backend;
+	dev->config      = *config;
+	dev->bank_bytes  = (size_t) config->pulses * config->samples_per_pulse *
+			   config->channels * sizeof(uint16_t);
+	dev->active_bank = -1;
+
+	if (backend->open(dev) != 0) {
+		printf("Could not open %s acquisition\n", backend->name);
+		return -1;
+	}
+	return 0;
+}
+
+void RDQ_StartBank(RDQ_DeviceStruct * dev, int bank) {
+	/*
+	IN:  bank  the bank (0 or 1) to acquire into
+	 */
+	dev->active_bank = bank;
+	clock_gettime(CLOCK_MONOTONIC, &dev->started);
+	dev->backend->start_bank(dev, bank);
+}
+
+static double seconds_between(const struct timespec * from, const struct timespec * to) {
+	return (double) (to->tv_sec - from->tv_sec) + 1e-9 * (to->tv_nsec - from->tv_nsec);
+}
+
+/*
+   The processing of a bank has to be done before the bank acquired
+   meanwhile completes, config.pulses PRTs after it was started, or the
+   next bank starts late and pulses are lost. The slack is the time
+   from the wait starting to that completion. The card completes when a
+   wait that blocked returns, and at the nominal time when the wait did
+   not block, so an overrun gives a negative slack. Other backends fill
+   the bank inside the wait, so their banks are taken to complete at
+   the nominal time: the slack is then what live processing would have.
+ */
+#define BLOCKED 1e-3  /* s, a wait this long blocked on the card */
+
+static double bank_slack(const RDQ_DeviceStruct * dev, const struct timespec * entry,
+			 const struct timespec * done) {
+	const double cycle    = dev->config.pulses * dev->config.prt / RDQ_PulseScheme(dev->config.mode)->tx_pol;
+	const double deadline = seconds_between(entry, &dev->started) + cycle;
+	const double waited   = seconds_between(entry, done);
+
+	if (!dev->backend->hardware) return deadline;
+	if (waited >= BLOCKED) return waited;
+	return (deadline < waited) ? deadline : waited;
+}
+
+int RDQ_WaitBank(RDQ_DeviceStruct * dev, RDQ_BankInfoStruct * info) {
+	/*
+	OUT:    info  metadata of the bank just completed
+	RETURN: RDQ_STATUS_OK or an error code (see RDQ.h)
+	 */
+	int             bank = dev->active_bank;
+	struct timespec entry, done;
+
+	dev->bank_time.tv_sec = 0;
+	dev->positioned       = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &entry);
+	info->status = dev->backend->wait_bank(dev, bank);
+	clock_gettime(CLOCK_MONOTONIC, &done);
+	info->slack  = bank_slack(dev, &entry, &done);
+
+	/* the slack runs from the wait starting to the completion */
+	info->completed          = entry;
+	info->completed.tv_sec  += (time_t) info->slack;
+	info->completed.tv_nsec += (long) ((info->slack - (time_t) info->slack) * 1e9);
+	if (info->completed.tv_nsec >= 1000000000L) {
+		info->completed.tv_sec++;
+		info->completed.tv_nsec -= 1000000000L;
+	} else if (info->completed.tv_nsec < 0) {
+		info->completed.tv_sec--;
+		info->completed.tv_nsec += 1000000000L;
+	}
+	if (dev->bank_time.tv_sec != 0)
+		info->time = dev->bank_time;
+	else
+		clock_gettime(CLOCK_REALTIME, &info->time);
+	info->positioned = dev->positioned;
+	info->azimuth    = dev->azimuth;
+	info->elevation  = dev->elevation;
+	info->bank       = bank;
+	info->bytes      = dev->bank_bytes;
+	info->sequence   = dev->sequence++;
+
+	dev->active_bank = -1;
+	return info->status;
+}
+
+void RDQ_SetMode(RDQ_DeviceStruct * dev, int mode) {
+	/*
+	IN:  mode  PulseMode_en now transmitted. The hardware is switched
+		   through the DIO card; this only tells synthetic sources.
+	 */
+	dev->config.mode = mode;
+}
+
+void RDQ_Close(RDQ_DeviceStruct * dev) {
+	if (dev->backend != NULL) dev->backend->close(dev);
+	dev->backend = NULL;
+}
@@ -98,18 +98,76 @@ int RDQ_WaitForAcquisitionToComplete(int amcc_fd) {
 
 	ioctl(amcc_fd, AMCC_IO_WAIT_FOR_DMA, &ret_val);
 	switch(ret_val) {
-	case 1:
+	case RDQ_STATUS_DMA_TIMEOUT:
 		printf("FATAL ERROR: DMA timed out\n");
 		break;
-	case 2:
+	case RDQ_STATUS_MASTER_ABORT:
 		printf("FATAL ERROR: Master abort occured\n");
 		break;
-	case 3:
+	case RDQ_STATUS_FIFO_OVERFLOW:
 		printf("FATAL ERROR: FIFO overflow occured\n");
 		break;
-	case 4:
+	case RDQ_STATUS_HV_TIMEOUT:
 		printf("FATAL ERROR: PCICARD did not trigger (HV timeout)\n");
 		break;
 	}
 	return ret_val;
 }
+
+/*
+   The AMCC PCI card as an RDQ backend: both banks live in the mmapped
+   DMA buffer, one half each.
+ */
+struct amcc_state {
+	int    fd;
+	void * dma_buffer;
+};
+
+static int amcc_open(RDQ_DeviceStruct * dev) {
+	static struct amcc_state state;
+	const RDQ_ConfigStruct * cfg = &dev->config;
+
+	if (dev->bank_bytes > DMA_BUFFER_SIZE / 2) {
+		printf("Bank of %zu bytes does not fit the DMA buffer\n", dev->bank_bytes);
+		return -1;
+	}
+
+	RDQ_InitialiseISACTRL2(cfg->samples_per_pulse, cfg->clock_divfactor, cfg->delay_clocks);
+
+	state.fd = RDQ_InitialisePCICARD2(&state.dma_buffer, DMA_BUFFER_SIZE);
+	if (state.fd == -1 || state.dma_buffer == MAP_FAILED) return -1;
+
+	dev->banks[0] = (uint16_t *) state.dma_buffer;
+	dev->banks[1] = (uint16_t *) ((char *) state.dma_buffer + (DMA_BUFFER_SIZE >> 1));
+	dev->priv     = &state;
+	return 0;
+}
+
+static void amcc_start_bank(RDQ_DeviceStruct * dev, int bank) {
+	struct amcc_state * state = dev->priv;
+
+	/* poison the bank so that a short transfer shows up in the data */
+	memset(dev->banks[bank], -1, dev->bank_bytes);
+	RDQ_StartAcquisition2(state->fd, bank, dev->bank_bytes);
+}
+
+static int amcc_wait_bank(RDQ_DeviceStruct * dev, int bank __attribute__ ((__unused__))) {
+	struct amcc_state * state = dev->priv;
+
+	return RDQ_WaitForAcquisitionToComplete(state->fd);
+}
+
+static void amcc_close(RDQ_DeviceStruct * dev) {
+	struct amcc_state * state = dev->priv;
+
+	RDQ_ClosePCICARD2(state->fd, state->dma_buffer, DMA_BUFFER_SIZE);
+}
+
+const RDQ_BackendStruct RDQ_Backend_amcc = {
+	.name       = "amcc",
+	.hardware   = 1,
+	.open       = amcc_open,
+	.start_bank = amcc_start_bank,
+	.wait_bank  = amcc_wait_bank,
+	.close      = amcc_close,
+};
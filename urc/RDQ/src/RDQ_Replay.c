@@ -0,0 +1,286 @@
+/*
+   Purpose: 	Replay acquisition backend: feeds banks from a time series
+		(ts) netCDF file written by the recorder, re-interleaved
+		into the DMA layout. The records are streamed pulse by
+		pulse, so banks need not be the size of a record and the
+		processing can be rerun with other pulses or averaging;
+		only one record is held in memory. Records with fewer
+		gates than configured are padded with mid-scale, and
+		the echoes of a file recorded with a range window are
+		put back at the gates they were acquired at.
+		Each bank carries the recorded time and antenna position
+		of the ray its last pulse belongs to.
+		A range of records can be chosen. The file is replayed
+		from the start when it runs out, so the processing can be
+		run for as long as needed, unless config.once is set.
+
+   Created on:  19/10/2026
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <netcdf.h>
+
+#include <RDQ.h>
+
+/* ts variables in logical channel order (see CHAN_* in radar-galileo-rec.h) */
+static const char * const channel_names[8] = {
+	"ICOH", "QCOH", "ICXH", "QCXH", "TXP1", "TXP2", "LOG", "VnotH"
+};
+
+/* the channels recorded from the first gate of the range window */
+static const int channel_windowed[8] = { 1, 1, 1, 1, 0, 0, 1, 0 };
+
+struct replay_state {
+	int        ncid;
+	int        varid[8];
+	size_t     records;
+	size_t     first;       /* first record replayed */
+	size_t     end;         /* one past the last record replayed */
+	size_t     record;      /* next record to read */
+	size_t     pulse;       /* next pulse of the staged record */
+	size_t     pulses;      /* pulses in a file record */
+	size_t     samples;     /* samples in a file record */
+	size_t     first_gate;  /* gate acquired of the first echo sample */
+	int        staged;      /* a record is in staging */
+	short *    staging;     /* one record of every channel */
+	uint16_t * buffer;      /* both banks */
+
+	/* per ray of the file, when it was written with them */
+	int        moments_averaged;
+	size_t     rays;
+	time_t     midnight;
+	float *    time;
+	float *    azimuth;
+	float *    elevation;
+};
+
+/* Read a per ray variable, or leave it NULL */
+static float * read_rays(struct replay_state * state, const char * name) {
+	float * values;
+	int     varid;
+
+	if (nc_inq_varid(state->ncid, name, &varid) != NC_NOERR) return NULL;
+	values = malloc(state->rays * sizeof(float));
+	if (values != NULL && nc_get_var_float(state->ncid, varid, values) != NC_NOERR) {
+		free(values);
+		values = NULL;
+	}
+	return values;
+}
+
+/* Times are seconds since midnight of the day in the units of time */
+static int read_times(struct replay_state * state) {
+	char      units[80] = "";
+	struct tm tm;
+	size_t    len;
+	int       varid;
+
+	if (nc_inq_varid(state->ncid, "time", &varid) != NC_NOERR ||
+	    nc_inq_attlen(state->ncid, varid, "units", &len) != NC_NOERR ||
+	    len >= sizeof(units) ||
+	    nc_get_att_text(state->ncid, varid, "units", units) != NC_NOERR) return -1;
+
+	memset(&tm, 0, sizeof(tm));
+	if (sscanf(units, "seconds since %d-%d-%d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday) != 3) return -1;
+	tm.tm_year -= 1900;
+	tm.tm_mon  -= 1;
+	state->midnight = timegm(&tm);
+
+	state->time      = read_rays(state, "time");
+	state->azimuth   = read_rays(state, "azimuth");
+	state->elevation = read_rays(state, "elevation");
+	return (state->time == NULL) ? -1 : 0;
+}
+
+/* Recorded time and position of the ray a record belongs to */
+static void ray_of_record(struct replay_state * state, size_t record, RDQ_DeviceStruct * dev,
+			  struct timespec * when) {
+	const size_t ray = record / state->moments_averaged;
+	double       t;
+
+	if (state->time == NULL || ray >= state->rays) return;
+	t = state->time[ray];
+	if (t < 0.0 || t > 2.0 * 86400.0) return;   /* not written */
+
+	when->tv_sec  = state->midnight + (time_t) t;
+	when->tv_nsec = (long) ((t - (long) t) * 1e9);
+	if (state->azimuth != NULL && state->elevation != NULL && dev != NULL) {
+		dev->positioned = 1;
+		dev->azimuth    = state->azimuth[ray];
+		dev->elevation  = state->elevation[ray];
+	}
+}
+
+static void replay_free(struct replay_state * state) {
+	nc_close(state->ncid);
+	free(state->staging);
+	free(state->buffer);
+	free(state->time);
+	free(state->azimuth);
+	free(state->elevation);
+	free(state);
+}
+
+static int replay_open(RDQ_DeviceStruct * dev) {
+	const RDQ_ConfigStruct * cfg = &dev->config;
+	struct replay_state * state;
+	int    status, dimid, varid, first_gate, c;
+
+	if (cfg->source == NULL) {
+		printf("Replay acquisition needs a ts file\n");
+		return -1;
+	}
+
+	state = calloc(1, sizeof(*state));
+	if (state == NULL) return -1;
+
+	status = nc_open(cfg->source, NC_NOWRITE, &state->ncid);
+	if (status != NC_NOERR) {
+		printf("Could not open %s: %s\n", cfg->source, nc_strerror(status));
+		free(state);
+		return -1;
+	}
+
+	if (nc_inq_dimid(state->ncid, "time", &dimid) != NC_NOERR ||
+	    nc_inq_dimlen(state->ncid, dimid, &state->records) != NC_NOERR ||
+	    nc_inq_dimid(state->ncid, "pulses", &dimid) != NC_NOERR ||
+	    nc_inq_dimlen(state->ncid, dimid, &state->pulses) != NC_NOERR ||
+	    nc_inq_dimid(state->ncid, "samples", &dimid) != NC_NOERR ||
+	    nc_inq_dimlen(state->ncid, dimid, &state->samples) != NC_NOERR) {
+		printf("%s is not a time series file\n", cfg->source);
+		goto fail;
+	}
+	for (c = 0; c < 8; c++) {
+		if (nc_inq_varid(state->ncid, channel_names[c], &state->varid[c]) != NC_NOERR) {
+			printf("%s has no %s variable\n", cfg->source, channel_names[c]);
+			goto fail;
+		}
+	}
+
+	state->first = (cfg->first_record > 0) ? (size_t) cfg->first_record : 0;
+	state->end   = state->records;
+	if (cfg->records > 0 && state->first + cfg->records < state->end)
+		state->end = state->first + cfg->records;
+	if (state->first >= state->end || state->pulses == 0 || state->samples == 0) {
+		printf("%s holds no time series to replay\n", cfg->source);
+		goto fail;
+	}
+	state->record = state->first;
+
+	/* the range window of the recording, if it had one */
+	if (nc_inq_varid(state->ncid, "range", &varid) == NC_NOERR &&
+	    nc_get_att_int(state->ncid, varid, "first_gate", &first_gate) == NC_NOERR && first_gate > 0)
+		state->first_gate = first_gate;
+
+	/* ts files hold moments_averaged records per ray */
+	if (nc_get_att_int(state->ncid, NC_GLOBAL, "moments_averaged", &state->moments_averaged) != NC_NOERR ||
+	    state->moments_averaged < 1)
+		state->moments_averaged = 1;
+	state->rays = state->records;
+	if (read_times(state) != 0) printf("%s has no ray times; using the clock\n", cfg->source);
+	else ray_of_record(state, state->first, NULL, &dev->start_time);
+
+	state->staging = malloc(8 * state->pulses * state->samples * sizeof(short));
+	state->buffer  = malloc(2 * dev->bank_bytes);
+	if (state->staging == NULL || state->buffer == NULL) {
+		printf("Memory allocation error: %m\n");
+		goto fail;
+	}
+
+	printf("Replaying records %zu to %zu of %zu x %zu from %s\n",
+	       state->first, state->end - 1, state->pulses, state->samples, cfg->source);
+
+	dev->banks[0] = state->buffer;
+	dev->banks[1] = (uint16_t *) ((char *) state->buffer + dev->bank_bytes);
+	dev->priv     = state;
+	return 0;
+
+fail:
+	replay_free(state);
+	return -1;
+}
+
+static void replay_start_bank(RDQ_DeviceStruct * dev __attribute__ ((__unused__)),
+			      int bank __attribute__ ((__unused__))) {
+	/* the bank is filled in replay_wait_bank */
+}
+
+/* Read the next record of every channel into staging */
+static int stage_record(struct replay_state * state, const RDQ_ConfigStruct * cfg) {
+	const size_t n = state->pulses * state->samples;
+	size_t start[3], count[3];
+	int    c;
+
+	if (state->record == state->end) {
+		if (cfg->once) return RDQ_STATUS_END;
+		state->record = state->first;
+	}
+
+	start[0] = state->record;
+	start[1] = 0;
+	start[2] = 0;
+	count[0] = 1;
+	count[1] = state->pulses;
+	count[2] = state->samples;
+
+	for (c = 0; c < 8; c++) {
+		/* 4 channel systems fold channels 4..7 onto channel 3 */
+		if (cfg->channels == 4 && c > 3) continue;
+
+		if (nc_get_vara_short(state->ncid, state->varid[c], start, count, state->staging + c * n) != NC_NOERR)
+			return RDQ_STATUS_ERROR;
+	}
+	state->record++;
+	state->pulse  = 0;
+	state->staged = 1;
+	return RDQ_STATUS_OK;
+}
+
+static int replay_wait_bank(RDQ_DeviceStruct * dev, int bank) {
+	struct replay_state *    state = dev->priv;
+	const RDQ_ConfigStruct * cfg   = &dev->config;
+	const int                nch   = cfg->channels;
+	const size_t             n     = state->pulses * state->samples;
+	uint16_t *               out   = dev->banks[bank];
+	int    c, p, s, status;
+
+	for (p = 0; p < cfg->pulses; p++) {
+		if (!state->staged || state->pulse == state->pulses) {
+			status = stage_record(state, cfg);
+			if (status != RDQ_STATUS_OK) return status;
+		}
+
+		for (c = (nch == 4) ? 3 : 7; c >= 0; c--) {
+			const size_t  first = channel_windowed[c] ? state->first_gate : 0;
+			const short * in    = state->staging + c * n + state->pulse * state->samples;
+			uint16_t *    o     = out + cfg->offset[c];
+
+			for (s = 0; s < cfg->samples_per_pulse; s++, o += nch)
+				*o = ((size_t) s >= first && (size_t) s - first < state->samples) ?
+					(uint16_t) in[s - first] : RDQ_ADC_MIDSCALE;
+		}
+		out += (size_t) cfg->samples_per_pulse * nch;
+		state->pulse++;
+	}
+
+	ray_of_record(state, state->record - 1, dev, &dev->bank_time);
+	return RDQ_STATUS_OK;
+}
+
+static void replay_close(RDQ_DeviceStruct * dev) {
+	replay_free(dev->priv);
+}
+
+const RDQ_BackendStruct RDQ_Backend_replay = {
+	.name       = "replay",
+	.hardware   = 0,
+	.open       = replay_open,
+	.start_bank = replay_start_bank,
+	.wait_bank  = replay_wait_bank,
+	.close      = replay_close,
+};
@@ -0,0 +1,99 @@
+/*
+   Purpose: 	Synthetic acquisition backend: generates banks in the DMA
+		layout without any hardware, so that the processing can be
+		run, profiled and regression tested on any Linux machine.
+		The banks carry the weather of RDQ_SyntheticProfile in the
+		configured pulse mode, with receiver noise. The sequence is
+		the same on every run.
+
+   Created on:  19/10/2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <RDQ.h>
+
+struct synthetic_state {
+	RDQ_WeatherStruct     weather;
+	RDQ_GateTruthStruct * truth;
+	uint16_t *            buffer;     /* both banks */
+};
+
+void RDQ_SyntheticProfile(RDQ_GateTruthStruct * truth, const RDQ_ConfigStruct * config) {
+	/*
+	IN:     config  samples_per_pulse and delay_gates
+	OUT:    truth   samples_per_pulse gates: RDQ_WeatherProfile over
+			the gates whose second pulse echoes of the dual
+			pulse modes stay in the bank, then noise alone,
+			so that the last gates are free for the noise
+			estimate in every mode
+	 */
+	const int samples = config->samples_per_pulse;
+	int gates = samples - config->delay_gates;
+	int g;
+
+	if (config->delay_gates <= 0 || gates < samples / 2) gates = samples;
+	RDQ_WeatherProfile(truth, gates);
+	for (g = gates; g < samples; g++) truth[g] = truth[gates - 1];
+}
+
+static int synthetic_open(RDQ_DeviceStruct * dev) {
+	struct synthetic_state * state;
+
+	state = calloc(1, sizeof(*state));
+	if (state == NULL) return -1;
+	state->truth  = malloc(dev->config.samples_per_pulse * sizeof(RDQ_GateTruthStruct));
+	state->buffer = malloc(2 * dev->bank_bytes);
+	if (state->truth == NULL || state->buffer == NULL) {
+		printf("Memory allocation error: %m\n");
+		free(state->truth);
+		free(state->buffer);
+		free(state);
+		return -1;
+	}
+
+	RDQ_SyntheticProfile(state->truth, &dev->config);
+	if (RDQ_WeatherInit(&state->weather, &dev->config, state->truth, RDQ_SYNTHETIC_NOISE) != 0) {
+		free(state->truth);
+		free(state->buffer);
+		free(state);
+		return -1;
+	}
+
+	dev->banks[0] = state->buffer;
+	dev->banks[1] = (uint16_t *) ((char *) state->buffer + dev->bank_bytes);
+	dev->priv     = state;
+	return 0;
+}
+
+static void synthetic_start_bank(RDQ_DeviceStruct * dev __attribute__ ((__unused__)),
+				 int bank __attribute__ ((__unused__))) {
+	/* the bank is filled in synthetic_wait_bank */
+}
+
+static int synthetic_wait_bank(RDQ_DeviceStruct * dev, int bank) {
+	struct synthetic_state * state = dev->priv;
+
+	/* follow mode changes made since the last bank */
+	state->weather.config.mode = dev->config.mode;
+	return RDQ_WeatherBank(&state->weather, dev->banks[bank]);
+}
+
+static void synthetic_close(RDQ_DeviceStruct * dev) {
+	struct synthetic_state * state = dev->priv;
+
+	RDQ_WeatherFree(&state->weather);
+	free(state->truth);
+	free(state->buffer);
+	free(state);
+}
+
+const RDQ_BackendStruct RDQ_Backend_synthetic = {
+	.name       = "synthetic",
+	.hardware   = 0,
+	.open       = synthetic_open,
+	.start_bank = synthetic_start_bank,
+	.wait_bank  = synthetic_wait_bank,
+	.close      = synthetic_close,
+};
@@ -0,0 +1,330 @@
+/*
+   Purpose: 	Synthetic weather signals with known moments, written as
+		banks in the DMA layout (see RDQ.h). They drive the
+		synthetic acquisition backend, the throughput benchmarks
+		and the accuracy test, which compares moments estimated
+		from the banks with the ground truth.
+
+		Every gate is the sum of independent complex Gaussian
+		processes with a Gaussian power spectrum, synthesised in
+		the frequency domain: random complex amplitudes on the
+		1 / (pulses * PRT) grid, extended beyond the PRF so that
+		velocities fold exactly as the radar sees them, are summed
+		onto the PRF interval and inverse transformed. The second
+		pulse of a dual pulse PRT samples the same processes
+		pulse_delay later, which is a phase ramp on the unfolded
+		amplitudes. The co-polar echoes are s_hh = A a and
+		s_vv = A / zdr (rho a + sqrt(1 - rho^2) b) exp(-i phidp),
+		so that phidp is the phase of H less that of V as in the
+		recorder; the cross-polar echoes c and d are independent
+		of them.
+		Each bank is a new realisation.
+
+   Created on:  19/10/2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <complex.h>
+#include <fftw3.h>
+
+#include <RDQ.h>
+
+#define TX_COUNTS    950   /* transmitter monitor hold above mid-scale */
+#define FLAG_V       4095  /* V_not_H reading when the first pulse is V */
+#define MAX_FOLDS    16    /* widest spectrum synthesised, in PRFs */
+
+/* Weather a, b (co-polar), c, d (cross-polar) and clutter e */
+enum { PROC_A, PROC_B, PROC_C, PROC_D, PROC_E, N_PROC };
+
+struct weather_state {
+	fftw_plan        plan;
+	fftw_complex *   spec[2];          /* folded amplitudes, per delay */
+	fftw_complex *   series[N_PROC][2];/* time series, per delay */
+	double *         weight;           /* unfolded spectrum */
+	float complex *  rx_h;             /* summed echoes, pulses x samples */
+	float complex *  rx_v;
+};
+
+/* Transmit sequence of each PulseMode_en (radar-galileo-rec.h) */
+static const RDQ_PulseSchemeStruct schemes[8] = {
+	{ 1, { 0, 0 }, { 0, 0 }, 1 },  /* PM_Undefined0, transmits as Single_H */
+	{ 1, { 0, 0 }, { 0, 0 }, 1 },  /* PM_Single_H */
+	{ 1, { 1, 1 }, { 1, 1 }, 1 },  /* PM_Single_V */
+	{ 1, { 0, 1 }, { 0, 0 }, 2 },  /* PM_Single_HV */
+	{ 2, { 0, 0 }, { 0, 0 }, 1 },  /* PM_Double_H */
+	{ 2, { 1, 1 }, { 1, 1 }, 1 },  /* PM_Double_V */
+	{ 2, { 0, 1 }, { 1, 0 }, 2 },  /* PM_Double_HV_VH */
+	{ 2, { 0, 0 }, { 1, 1 }, 2 },  /* PM_Double_HV_HV */
+};
+
+const RDQ_PulseSchemeStruct * RDQ_PulseScheme(int mode) {
+	return &schemes[mode & 0x07];
+}
+
+/* Marsaglia xorshift: fast, and the same on every machine */
+static inline unsigned int xorshift(unsigned int * s) {
+	*s ^= *s << 13;
+	*s ^= *s >> 17;
+	*s ^= *s << 5;
+	return *s;
+}
+
+/* Circular complex Gaussian of unit power (Box-Muller) */
+static inline double complex cnoise(unsigned int * s) {
+	const double u = (xorshift(s) + 1.0) * (1.0 / 4294967296.0);
+	const double r = sqrt(-log(u));
+
+	return r * cexp(I * (2.0 * M_PI / 4294967296.0) * xorshift(s));
+}
+
+static inline uint16_t counts(double value) {
+	long v = lrint(value + RDQ_ADC_MIDSCALE);
+
+	return (uint16_t) (v < 0 ? 0 : v > 4095 ? 4095 : v);
+}
+
+void RDQ_WeatherProfile(RDQ_GateTruthStruct * truth, int gates) {
+	/*
+	IN:     gates
+	OUT:    truth  a profile for the synthetic backend: clutter in the
+		       first tenth of the gates, then a weather layer across
+		       the middle 70% whose velocity runs from -6 to +6 m/s
+		       (folding in the single pulse estimates) while the
+		       polarimetric variables ramp; noise beyond
+	 */
+	int g;
+
+	for (g = 0; g < gates; g++) {
+		const double x = (g - 0.15 * gates) / (0.7 * gates);
+		RDQ_GateTruthStruct * t = &truth[g];
+
+		memset(t, 0, sizeof(*t));
+		t->snr   = RDQ_NO_SIGNAL;
+		t->cnr   = (g >= 2 && g < gates / 10) ? 30.0f : RDQ_NO_SIGNAL;
+		t->rhohv = 1.0f;
+		if (x >= 0.0 && x < 1.0) {
+			t->snr      = 5.0 + 25.0 * sin(M_PI * x);
+			t->velocity = -6.0 + 12.0 * x;
+			t->width    = 0.3 + 0.7 * x;
+			t->zdr      = 3.0 * x;
+			t->ldr      = -25.0;
+			t->phidp    = 60.0 * x;
+			t->rhohv    = 0.99 - 0.04 * x;
+		}
+	}
+}
+
+int RDQ_WeatherInit(RDQ_WeatherStruct * w, const RDQ_ConfigStruct * config,
+		    const RDQ_GateTruthStruct * truth, double noise) {
+	/*
+	IN:     config  bank layout, radar and mode (config.mode may be
+			changed between banks)
+		truth   samples_per_pulse gates, kept by reference
+		noise   receiver noise power per channel, counts^2
+	OUT:    w
+	RETURN: 0, or 3 if out of memory
+	 */
+	struct weather_state * st;
+	const size_t n  = config->pulses;
+	const size_t ns = n * config->samples_per_pulse;
+	int p, d;
+
+	memset(w, 0, sizeof(*w));
+	w->config        = *config;
+	w->truth         = truth;
+	w->noise         = noise;
+	w->clutter_width = 0.05;
+	w->seed          = 2463534242u;
+
+	st = calloc(1, sizeof(*st));
+	if (st == NULL) return 3;
+	w->priv = st;
+
+	for (d = 0; d < 2; d++) {
+		st->spec[d] = fftw_malloc(n * sizeof(fftw_complex));
+		if (st->spec[d] == NULL) goto fail;
+		for (p = 0; p < N_PROC; p++) {
+			st->series[p][d] = fftw_malloc(n * sizeof(fftw_complex));
+			if (st->series[p][d] == NULL) goto fail;
+		}
+	}
+	st->weight = malloc(MAX_FOLDS * n * sizeof(double));
+	st->rx_h   = malloc(ns * sizeof(float complex));
+	st->rx_v   = malloc(ns * sizeof(float complex));
+	if (st->weight == NULL || st->rx_h == NULL || st->rx_v == NULL) goto fail;
+
+	st->plan = fftw_plan_dft_1d(n, st->spec[0], st->series[0][0], FFTW_BACKWARD, FFTW_ESTIMATE);
+	if (st->plan == NULL) goto fail;
+	return 0;
+
+fail:
+	fprintf(stderr, "Memory allocation error: %m\n");
+	RDQ_WeatherFree(w);
+	return 3;
+}
+
+/*
+ * One unit power process with a Gaussian spectrum at f0 (Hz) of width
+ * sigma (Hz), at PRTs dt apart and, for two delays, pulse_delay later.
+ */
+static void synthesise(RDQ_WeatherStruct * w, double f0, double sigma, double dt,
+		       int delays, fftw_complex ** out) {
+	struct weather_state * st = w->priv;
+	const int    n    = w->config.pulses;
+	const double df   = 1.0 / (n * dt);
+	const double half = 5.0 * sigma + df;
+	long   jlo, jhi, j;
+	double total = 0.0;
+	int    d;
+
+	if (sigma < 0.25 * df) sigma = 0.25 * df;
+	jlo = (long) floor((f0 - half) / df);
+	jhi = (long) ceil((f0 + half) / df);
+	if (jhi - jlo >= (long) MAX_FOLDS * n) {
+		jlo = lrint(f0 / df) - MAX_FOLDS * n / 2;
+		jhi = jlo + MAX_FOLDS * n - 1;
+	}
+
+	for (j = jlo; j <= jhi; j++) {
+		const double x = (j * df - f0) / sigma;
+
+		st->weight[j - jlo] = exp(-0.5 * x * x);
+		total              += st->weight[j - jlo];
+	}
+
+	for (d = 0; d < delays; d++) memset(st->spec[d], 0, n * sizeof(fftw_complex));
+	for (j = jlo; j <= jhi; j++) {
+		const double complex x = sqrt(st->weight[j - jlo] / total) * cnoise(&w->seed);
+		const long           m = ((j % n) + n) % n;
+
+		st->spec[0][m] += x;
+		if (delays > 1) st->spec[1][m] += x * cexp(I * 2.0 * M_PI * j * df * w->config.pulse_delay);
+	}
+	for (d = 0; d < delays; d++) fftw_execute_dft(st->plan, st->spec[d], out[d]);
+}
+
+int RDQ_WeatherBank(RDQ_WeatherStruct * w, uint16_t * bank) {
+	/*
+	IN:     w  (w->config.mode selects the transmit sequence)
+	OUT:    bank  config.pulses PRTs in the DMA layout
+	RETURN: RDQ_STATUS_OK
+	 */
+	struct weather_state *        st     = w->priv;
+	const RDQ_ConfigStruct *      cfg    = &w->config;
+	const RDQ_PulseSchemeStruct * scheme = RDQ_PulseScheme(cfg->mode);
+	const int    n       = cfg->pulses;
+	const int    samples = cfg->samples_per_pulse;
+	const int    nch     = cfg->channels;
+	const double hz_per_mps = 2.0 / cfg->wavelength;
+	const double dt      = cfg->prt / scheme->tx_pol;
+	const double complex rot_v = cexp(I * cfg->system_phase);
+	const double sigma_n = sqrt(w->noise);
+	uint16_t *   out     = bank;
+	int g, k, p, s, c;
+
+	memset(st->rx_h, 0, (size_t) n * samples * sizeof(float complex));
+	memset(st->rx_v, 0, (size_t) n * samples * sizeof(float complex));
+
+	for (g = 0; g < samples; g++) {
+		const RDQ_GateTruthStruct * t = &w->truth[g];
+		const int    weather = (t->snr > RDQ_NO_SIGNAL);
+		const int    clutter = (t->cnr > RDQ_NO_SIGNAL);
+		const double A   = weather ? sqrt(w->noise * pow(10.0, 0.1 * t->snr)) : 0.0;
+		const double C   = clutter ? sqrt(w->noise * pow(10.0, 0.1 * t->cnr)) : 0.0;
+		const double Avv = A * pow(10.0, -0.05 * t->zdr);
+		const double Ax  = A * pow(10.0, 0.05 * t->ldr);
+		const double rho = t->rhohv;
+		const double rho_c = sqrt(fmax(0.0, 1.0 - rho * rho));
+		const double complex rot_dp = cexp(-I * t->phidp * (M_PI / 180.0));
+
+		if (!weather && !clutter) continue;
+
+		if (weather) {
+			for (p = PROC_A; p <= PROC_D; p++)
+				synthesise(w, t->velocity * hz_per_mps, t->width * hz_per_mps, dt,
+					   scheme->pulses, st->series[p]);
+		}
+		if (clutter)
+			synthesise(w, 0.0, w->clutter_width * hz_per_mps, dt, scheme->pulses, st->series[PROC_E]);
+
+		for (p = 0; p < scheme->pulses; p++) {
+			const fftw_complex * a = st->series[PROC_A][p];
+			const fftw_complex * b = st->series[PROC_B][p];
+			const fftw_complex * xc = st->series[PROC_C][p];
+			const fftw_complex * xd = st->series[PROC_D][p];
+			const fftw_complex * e = st->series[PROC_E][p];
+
+			s = g + (p ? cfg->delay_gates : 0);
+			if (s >= samples) continue;
+
+			for (k = 0; k < n; k++) {
+				const int     v  = p ? scheme->v_second[k & 1] : scheme->v_first[k & 1];
+				const size_t  i  = (size_t) k * samples + s;
+				double complex h = 0.0, x = 0.0;
+
+				if (weather) {
+					/* co-polar echo and depolarised echo of this pulse */
+					h = v ? Avv * (rho * a[k] + rho_c * b[k]) * rot_dp : A * a[k];
+					x = Ax * (v ? xd[k] : xc[k]);
+				}
+				if (clutter) h += C * e[k];
+
+				if (v) {
+					st->rx_v[i] += h * rot_v;
+					st->rx_h[i] += x;
+				} else {
+					st->rx_h[i] += h;
+					st->rx_v[i] += x * rot_v;
+				}
+			}
+		}
+	}
+
+	for (k = 0; k < n; k++) {
+		const int v1 = scheme->v_first[k & 1];
+		const int v2 = scheme->v_second[k & 1];
+		const int s2 = (scheme->pulses > 1) ? cfg->delay_gates : samples;
+
+		for (s = 0; s < samples; s++, out += nch) {
+			const size_t         i = (size_t) k * samples + s;
+			const double complex h = st->rx_h[i] + sigma_n * cnoise(&w->seed);
+			const double complex x = st->rx_v[i] + sigma_n * cnoise(&w->seed);
+			const int            held_h = (!v1) || (s >= s2 && !v2);
+			const int            held_v = v1 || (s >= s2 && v2);
+			double ch[8];
+
+			ch[0] = creal(h);
+			ch[1] = cimag(h);
+			ch[2] = creal(x);
+			ch[3] = cimag(x);
+			ch[4] = held_h ? TX_COUNTS : 0.0;
+			ch[5] = held_v ? TX_COUNTS : 0.0;
+			ch[6] = 0.0;
+			ch[7] = v1 ? FLAG_V - RDQ_ADC_MIDSCALE : -RDQ_ADC_MIDSCALE;
+
+			/* 4 channel systems only carry channels 0..3 */
+			for (c = (nch == 4) ? 3 : 7; c >= 0; c--) out[cfg->offset[c]] = counts(ch[c]);
+		}
+	}
+	return RDQ_STATUS_OK;
+}
+
+void RDQ_WeatherFree(RDQ_WeatherStruct * w) {
+	struct weather_state * st = w->priv;
+	int p, d;
+
+	if (st == NULL) return;
+	if (st->plan != NULL) fftw_destroy_plan(st->plan);
+	for (d = 0; d < 2; d++) {
+		fftw_free(st->spec[d]);
+		for (p = 0; p < N_PROC; p++) fftw_free(st->series[p][d]);
+	}
+	free(st->weight);
+	free(st->rx_h);
+	free(st->rx_v);
+	free(st);
+	w->priv = NULL;
+}
@@ -0,0 +1,246 @@
+/*
+   Purpose: 	Accuracy test for RDQ_Weather.c. For every PulseMode_en,
+		generates banks of a weather layer of known moments and
+		estimates them back from the demultiplexed channels with
+		plain pulse pair estimators: co- and cross-polar powers,
+		velocity from same polarisation pulses, PHIDP and rho_hv
+		from H-V pairs, the V_not_H flag, and zero Doppler
+		clutter. Every estimate must match the truth within its
+		bound.
+
+   Created on:  19/10/2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <complex.h>
+
+#include <RDQ.h>
+
+#define SAMPLES      96
+#define DELAY_GATES  32       /* weather occupies gates [DELAY_GATES, 2 DELAY_GATES) */
+#define PULSES       1024
+#define BANKS        2
+#define NOISE        32.0
+#define PRT          320e-6   /* s, of each polarisation */
+#define WAVELENGTH   (299792458.0 / 94e9)
+
+static int failures = 0;
+
+/* Channel positions of an 8 channel system (make_dmux_table) */
+static const int dmux8[8] = { 0, 4, 1, 5, 2, 6, 3, 7 };
+
+static const RDQ_GateTruthStruct layer = {
+	.snr = 20.0, .velocity = 0.8, .width = 0.2, .zdr = 1.5,
+	.ldr = -20.0, .phidp = 30.0, .rhohv = 0.97, .cnr = RDQ_NO_SIGNAL
+};
+
+static void report(const char * mode, const char * name, double value, double truth, double bound) {
+	int fail = !(fabs(value - truth) <= bound);
+
+	printf("%-16s %-8s %9.3f truth %9.3f (bound %g) %s\n",
+	       mode, name, value, truth, bound, fail ? "FAIL" : "ok");
+	failures += fail;
+}
+
+/* complex sample of the co- (v = 0) or cross-polar (v = 1) receiver */
+static double complex rx(const uint16_t * bank, int k, int s, int v) {
+	const uint16_t * p = bank + 8 * ((size_t) k * SAMPLES + s);
+
+	return (p[dmux8[2 * v]] - (double) RDQ_ADC_MIDSCALE) +
+	       I * (p[dmux8[2 * v + 1]] - (double) RDQ_ADC_MIDSCALE);
+}
+
+static double wrap(double phase) {
+	return remainder(phase, 2.0 * M_PI);
+}
+
+static void test_mode(int mode, const char * name) {
+	const RDQ_PulseSchemeStruct * scheme = RDQ_PulseScheme(mode);
+	RDQ_GateTruthStruct truth[SAMPLES];
+	RDQ_ConfigStruct    cfg = { 0 };
+	RDQ_WeatherStruct   w;
+	uint16_t * bank;
+	/* noise plus the quantisation noise of I and Q */
+	const double noise = NOISE + 2.0 / 12.0;
+	const double hz_per_mps = 2.0 / WAVELENGTH;
+	/* the alternating modes start a PRT every cfg.prt / 2 */
+	const double prt = PRT / scheme->tx_pol;
+	double complex r_lag = 0.0, r_hv = 0.0, r_vh = 0.0;
+	double p_co[2] = { 0.0 }, p_x[2] = { 0.0 };
+	long   n_co[2] = { 0 }, flag_errors = 0;
+	int    lag, b, k, g, c, p;
+	double phi, psi;
+
+	for (g = 0; g < SAMPLES; g++) {
+		truth[g] = layer;
+		if (g < DELAY_GATES || g >= 2 * DELAY_GATES) truth[g].snr = RDQ_NO_SIGNAL;
+	}
+
+	cfg.samples_per_pulse = SAMPLES;
+	cfg.pulses            = PULSES;
+	cfg.channels          = 8;
+	for (c = 0; c < 8; c++) cfg.offset[c] = dmux8[c];
+	cfg.mode         = mode;
+	cfg.prt          = PRT;
+	cfg.pulse_delay  = 20e-6;
+	cfg.delay_gates  = DELAY_GATES;
+	cfg.wavelength   = WAVELENGTH;
+	cfg.system_phase = 0.4;
+
+	bank = malloc((size_t) PULSES * SAMPLES * 8 * sizeof(uint16_t));
+	if (bank == NULL || RDQ_WeatherInit(&w, &cfg, truth, NOISE) != 0) exit(3);
+
+	/* same polarisation pulses are one or two PRTs apart */
+	lag = (scheme->v_first[0] == scheme->v_first[1]) ? 1 : 2;
+
+	for (b = 0; b < BANKS; b++) {
+		RDQ_WeatherBank(&w, bank);
+
+		for (k = 0; k < PULSES; k++) {
+			const int v1 = scheme->v_first[k & 1];
+			const int v2 = scheme->v_second[k & 1];
+			const int flag = bank[8 * (size_t) k * SAMPLES + dmux8[7]];
+
+			flag_errors += ((flag >= RDQ_ADC_MIDSCALE) != v1);
+
+			for (g = DELAY_GATES; g < 2 * DELAY_GATES; g++) {
+				for (p = 0; p < scheme->pulses; p++) {
+					const int v = p ? v2 : v1;
+					const int s = g + p * DELAY_GATES;
+					const double complex co = rx(bank, k, s, v);
+					const double complex x  = rx(bank, k, s, !v);
+
+					p_co[v] += creal(co * conj(co));
+					p_x[v]  += creal(x * conj(x));
+					n_co[v]++;
+				}
+
+				/* first pulses lag PRTs apart */
+				if (k + lag < PULSES)
+					r_lag += rx(bank, k + lag, g, v1) * conj(rx(bank, k, g, v1));
+
+				/* H-V pairs: within the PRT, or over one PRT */
+				if (scheme->pulses == 2 && v1 != v2) {
+					const double complex pair = rx(bank, k, g + DELAY_GATES, v2) * conj(rx(bank, k, g, v1));
+
+					if (v1) r_vh += pair;
+					else    r_hv += pair;
+				} else if (lag == 2 && k + 1 < PULSES) {
+					const double complex pair = rx(bank, k + 1, g, !v1) * conj(rx(bank, k, g, v1));
+
+					if (v1) r_vh += pair;
+					else    r_hv += pair;
+				}
+			}
+		}
+	}
+
+	for (c = 0; c < 2; c++) {
+		if (n_co[c] == 0) continue;
+		p_co[c] = p_co[c] / n_co[c] - noise;
+		p_x[c]  = p_x[c]  / n_co[c] - noise;
+	}
+
+	report(name, "V_not_H", flag_errors, 0.0, 0.0);
+	if (n_co[0]) report(name, "SNR_H", 10.0 * log10(p_co[0] / NOISE), layer.snr, 0.3);
+	if (n_co[1]) report(name, "SNR_V", 10.0 * log10(p_co[1] / NOISE), layer.snr - layer.zdr, 0.3);
+	if (n_co[0]) report(name, "LDR_H", 10.0 * log10(p_x[0] / p_co[0]), layer.ldr, 0.5);
+	if (n_co[1]) report(name, "LDR_V", 10.0 * log10(p_x[1] / p_co[1]) - layer.zdr, layer.ldr, 0.5);
+	report(name, "VEL", carg(r_lag) / (2.0 * M_PI * lag * prt * hz_per_mps), layer.velocity, 0.05);
+
+	/* same polarisation pairs within the PRT see the Doppler phase alone */
+	if (scheme->pulses == 2 && scheme->v_first[0] == scheme->v_second[0]) {
+		double complex r = 0.0;
+
+		for (k = 0; k < PULSES; k++)
+			for (g = DELAY_GATES; g < 2 * DELAY_GATES; g++)
+				r += rx(bank, k, g + DELAY_GATES, scheme->v_first[0]) * conj(rx(bank, k, g, scheme->v_first[0]));
+		report(name, "VEL_D", carg(r) / (2.0 * M_PI * cfg.pulse_delay * hz_per_mps), layer.velocity, 0.5);
+	}
+
+	if (n_co[0] && n_co[1]) {
+		const double dt   = (scheme->pulses == 2) ? cfg.pulse_delay : prt;
+		const double rho_d = exp(-2.0 * pow(M_PI * layer.width * hz_per_mps * dt, 2.0));
+		/* the pairs are V times H*: phidp is H less V */
+		const double ph   = cfg.system_phase - layer.phidp * M_PI / 180.0;
+		const long   pairs = BANKS * (long) DELAY_GATES * (scheme->pulses == 2 ? PULSES : PULSES - 1);
+
+		psi = 2.0 * M_PI * layer.velocity * hz_per_mps * dt;
+		if (cabs(r_vh) > 0.0) {
+			/* H then V and V then H cancel the Doppler phase */
+			phi = 0.5 * wrap(carg(r_hv) - carg(r_vh));
+			report(name, "PHIDP", phi * 180.0 / M_PI, ph * 180.0 / M_PI, 2.0);
+			report(name, "RHO", cabs(r_hv + r_vh * cexp(2.0 * I * ph)) / pairs /
+			       sqrt(p_co[0] * p_co[1]), layer.rhohv * rho_d, 0.01);
+		} else {
+			phi = wrap(carg(r_hv) - psi);
+			report(name, "PHIDP", phi * 180.0 / M_PI, ph * 180.0 / M_PI, 2.0);
+			report(name, "RHO", cabs(r_hv) / pairs / sqrt(p_co[0] * p_co[1]),
+			       layer.rhohv * rho_d, 0.01);
+		}
+	}
+
+	RDQ_WeatherFree(&w);
+	free(bank);
+}
+
+/* Zero Doppler clutter alone */
+static void test_clutter(void) {
+	RDQ_GateTruthStruct truth[SAMPLES];
+	RDQ_ConfigStruct    cfg = { 0 };
+	RDQ_WeatherStruct   w;
+	uint16_t *     bank;
+	double complex r = 0.0;
+	double         pw = 0.0;
+	int k, g, c;
+
+	for (g = 0; g < SAMPLES; g++) {
+		truth[g]     = layer;
+		truth[g].snr = RDQ_NO_SIGNAL;
+		truth[g].cnr = 30.0;
+	}
+
+	cfg.samples_per_pulse = SAMPLES;
+	cfg.pulses            = PULSES;
+	cfg.channels          = 8;
+	for (c = 0; c < 8; c++) cfg.offset[c] = dmux8[c];
+	cfg.mode       = 1;
+	cfg.prt        = PRT;
+	cfg.wavelength = WAVELENGTH;
+
+	bank = malloc((size_t) PULSES * SAMPLES * 8 * sizeof(uint16_t));
+	if (bank == NULL || RDQ_WeatherInit(&w, &cfg, truth, NOISE) != 0) exit(3);
+	RDQ_WeatherBank(&w, bank);
+
+	for (k = 0; k < PULSES; k++) {
+		for (g = 0; g < SAMPLES; g++) {
+			const double complex h = rx(bank, k, g, 0);
+
+			pw += creal(h * conj(h));
+			if (k + 1 < PULSES) r += rx(bank, k + 1, g, 0) * conj(h);
+		}
+	}
+	pw = pw / ((double) PULSES * SAMPLES) - NOISE - 2.0 / 12.0;
+
+	report("clutter", "CNR", 10.0 * log10(pw / NOISE), 30.0, 0.5);
+	report("clutter", "VEL", carg(r) / (2.0 * M_PI * cfg.prt * 2.0 / WAVELENGTH), 0.0, 0.02);
+
+	RDQ_WeatherFree(&w);
+	free(bank);
+}
+
+int main(void) {
+	static const char * const names[8] = {
+		"Undefined0", "Single_H", "Single_V", "Single_HV",
+		"Double_H", "Double_V", "Double_HV_VH", "Double_HV_HV"
+	};
+	int mode;
+
+	for (mode = 0; mode < 8; mode++) test_mode(mode, names[mode]);
+	test_clutter();
+
+	printf("\n%s: %d failure(s)\n", failures ? "FAILED" : "PASSED", failures);
+	return failures ? 1 : 0;
+}
@@ -19,6 +19,7 @@
 #include <string.h>
 
 #include <REL.h>
+#include <RSM_SerialFrame.h>
 
 /* definitions */
 
@@ -28,14 +29,22 @@
 /* the length of the serial message footer */
 #define FOOTER_LENGTH        1
 
-/* the number of bytes to seach through when looking for the serial message footer */
-#define FOOTER_SEARCH_LENGTH 30
+/* the longest wait for bytes before the message is taken as lost (ms) */
+#define FRAME_TIMEOUT        500
+
+/* the serial message footer */
+static const unsigned char footer[ FOOTER_LENGTH ] = { 0x0A };
 
 /* global variables */
 
 /* file descriptor for the serial port */
 static int serialport_fd = -1;
 
+/* 'sm_frame' frames the messages out of the bytes of the serial port, for
+ * the read thread.
+ */
+static RSM_FrameStruct sm_frame;
+
 /* 'sm_buffer_semaphore' is a semaphore created during initialisation that is
  * used to control shared access to the receive buffer and its associated
  * valid flag. Access to this buffer and flag is shared by the main thread
@@ -64,80 +73,6 @@ static bool          sm_buffer_valid = true;
 static time_t        check_time      = -1;
 
 
-/* 'read_raw' read a serial message from the serial port
- * In: none
- * Out: 'valid' is updated to indicate if a message was successfully received
- *  TRUE for success, FALSE for failure
- * 'buffer' is updated with the message
- * Returns: void
- */
-static void
-read_raw (unsigned char * buffer,
-	  bool *          valid)
-{
-    int           rx_count     = 0;
-    int           footer_count = 0;
-    int           retval;
-    bool          footer_found = false;
-    unsigned char data = 'a';
-
-    /* flush tx and rx buffers */
-    tcflush (serialport_fd, TCIOFLUSH);
-
-    /* detect the serial message footer */
-    while (rx_count < FOOTER_SEARCH_LENGTH && !footer_found)
-    {
-	retval = read(serialport_fd, &data, 1);
-	if (retval == 0)
-	{
-	    continue;
-	}
-	else if (retval == -1)
-	{
-	    ; /* for some reason we cannot report this error */
-	}
-	else
-	{
-	    if (data == 0x0A)
-	    {
-		footer_count ++;
-	    }
-	    else
-	    {
-		footer_count = 0;
-	    }
-	    if (footer_count == FOOTER_LENGTH)
-	    {
-		footer_found = true;
-	    }
-	}
-    }
-
-    if (!footer_found)
-    {
-	*valid = false;
-    }
-
-    /* read the message */
-    while (rx_count < SERIALMESSAGE_LENGTH)
-    {
-	retval = read (serialport_fd, &data, 1);
-	if (retval == 0)
-	{
-	    continue;
-	}
-	else if (retval == -1)
-	{
-	    ; /* for some reason we cannot report this error */
-	}
-	else
-	{
-	    buffer[ rx_count ++ ] = data;
-	}
-    }
-    *valid = (footer_found) ? true : false;
-}
-
 void
 convert_buffer (unsigned char *           buffer,
 		REL_SerialMessageStruct * msg)
@@ -182,10 +117,17 @@ read_thread (void * arg)
     while (1)
     {
 	unsigned char rxbuffer [ SERIALMESSAGE_LENGTH ];
+	uint64_t      time_ns;
+	int           status;
 	bool          valid;
 
-	valid = false;
-	read_raw (rxbuffer, &valid);
+	/* the next message, or none within FRAME_TIMEOUT */
+	status = RSM_FrameRead (&sm_frame, rxbuffer, &time_ns, FRAME_TIMEOUT);
+	valid  = (status == 1);
+	if (status < 0)
+	{
+	    usleep (FRAME_TIMEOUT * 1000);
+	}
 
 	/* copy over the serial message, but first set the semaphore */
 	sem_wait (&sm_buffer_semaphore);
@@ -235,6 +177,8 @@ REL_InitialiseSerialMessage (const char * serialport)
 	return -1;
     }
 
+    RSM_FrameInit (&sm_frame, serialport_fd, SERIALMESSAGE_LENGTH, footer, FOOTER_LENGTH);
+
     /* create a semaphore to control shared access to the serial message buffer */
     if (sem_init (&sm_buffer_semaphore, 0, 1) == -1)
     {
@@ -289,7 +233,10 @@ void
 REL_CloseSerialMessage (void)
 {
     pthread_cancel (sm_read_thread);
+    pthread_join (sm_read_thread, NULL);
     sem_destroy (&sm_buffer_semaphore);
+    printf ("Serial messages: %lu framed, %lu framing errors, %lu bytes skipped\n",
+	    sm_frame.frames, sm_frame.errors, sm_frame.skipped);
     /* close serial port */
     close (serialport_fd);
 }
@@ -0,0 +1,58 @@
+#ifndef _RLG_H
+#define _RLG_H
+
+// RLG.h
+// Radar Logging package: leveled log messages that cost the calling thread
+// neither formatting nor I/O. RLG_LOG copies its format, which must be a
+// string literal, and its arguments into a fixed size record of a
+// lock-free ring. A background thread formats the records and writes them
+// out. Strings (%s) are copied, truncated to fit the record; '*' widths
+// and %n are not supported.
+//
+// A full ring drops records rather than blocking the caller. Each call
+// site is also limited to a number of records per second. Both kinds of
+// loss are reported in the log.
+//
+// Before RLG_Open, and after RLG_Close, messages are printed directly.
+
+#include <stdint.h>
+
+typedef enum
+{
+    RLG_ERROR,
+    RLG_WARN,
+    RLG_INFO,
+    RLG_DEBUG
+} RLG_Level_en;
+
+#define RLG_RECORD_SIZE  256    // bytes per record, of which the arguments
+#define RLG_RING_RECORDS 4096   // records in the ring, a power of two
+#define RLG_RATE         100    // default records per second per call site
+
+// One per RLG_LOG call site
+typedef struct
+{
+    const char *  fmt;
+    int           level;
+    uint64_t      window;       // start of the current second (ns)
+    unsigned int  count;        // records in the current second
+    unsigned long suppressed;   // since the last record that got through
+} RLG_SiteStruct;
+
+extern int RLG_level;           // messages above this level are ignored
+
+extern int          RLG_Open       (const char * filename, int level, int rate_limit);
+extern void         RLG_Close      (void);
+extern void         RLG_Write      (RLG_SiteStruct * site, ...);
+extern int          RLG_ParseLevel (const char * name);
+extern const char * RLG_LevelName  (int level);
+
+#define RLG_LOG(lvl, format, ...)					\
+    do									\
+    {									\
+	static RLG_SiteStruct rlg_site_ = { format, lvl, 0, 0, 0 };	\
+	if ((lvl) <= RLG_level)						\
+	    RLG_Write (&rlg_site_, ##__VA_ARGS__);			\
+    } while (0)
+
+#endif /* _RLG_H */
@@ -0,0 +1,478 @@
+// RLG_Log.c
+// ---------
+// Part of the Chilbolton Radar Logging Package
+//
+// Purpose: Lock-free ring of log records, and the thread that formats
+//          them and writes them out.
+//
+// Created on: 19/10/26
+// -------------------------------------------------------
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#include <RLG.h>
+
+// Arguments of a record, packed as their promoted types
+#define PAYLOAD_SIZE (RLG_RECORD_SIZE - 4 * 8 - 4)
+
+typedef struct
+{
+    uint64_t         sequence;      // ring position + 1 once written
+    uint64_t         time_ns;       // CLOCK_REALTIME
+    RLG_SiteStruct * site;
+    unsigned long    suppressed;    // by the rate limit before this record
+    unsigned short   size;          // payload bytes used
+    unsigned char    truncated;     // the arguments did not all fit
+    unsigned char    payload[PAYLOAD_SIZE];
+} RecordStruct;
+
+enum
+{
+    ARG_NONE, ARG_INT, ARG_LONG, ARG_LLONG, ARG_SIZE,
+    ARG_DOUBLE, ARG_LDOUBLE, ARG_STRING, ARG_POINTER
+};
+
+int RLG_level = RLG_INFO;
+
+static const char * const level_names[] = { "ERROR", "WARN", "INFO", "DEBUG" };
+
+static RecordStruct * ring;
+static uint64_t       head;         // next record to format (drain thread)
+static uint64_t       tail;         // next record to claim (callers)
+static unsigned long  dropped;      // ring full
+static int            running;
+static int            closing;
+static unsigned int   rate;
+static FILE *         out;
+static pthread_t      drain_thread;
+
+/*--------------------------------------------------------------------*
+ * conversion: parse the conversion specification starting at %       *
+ * OUT: arg  the ARG_ class of its argument                           *
+ * RETURNS: the first character after it, or NULL if unsupported      *
+ *--------------------------------------------------------------------*/
+static const char *
+conversion (const char * p,
+	    int *        arg)
+{
+    int length = 0;   // 'h', 'l', 'L' (ll), 'D' (long double), 'z'
+
+    p++;
+    if (*p == '%')
+    {
+	*arg = ARG_NONE;
+	return p + 1;
+    }
+
+    p += strspn (p, "-+ #0'");
+    p += strspn (p, "0123456789");
+    if (*p == '.')
+    {
+	p++;
+	p += strspn (p, "0123456789");
+    }
+
+    switch (*p)
+    {
+    case 'h':
+	length = 'h';
+	p += (p[1] == 'h') ? 2 : 1;
+	break;
+    case 'l':
+	length = (p[1] == 'l') ? 'L' : 'l';
+	p += (p[1] == 'l') ? 2 : 1;
+	break;
+    case 'q':
+    case 'j':
+	length = 'L';
+	p++;
+	break;
+    case 'L':
+	length = 'D';
+	p++;
+	break;
+    case 'z':
+    case 't':
+	length = 'z';
+	p++;
+	break;
+    }
+
+    switch (*p)
+    {
+    case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'c':
+	*arg = (length == 'l') ? ARG_LONG  :
+	       (length == 'L') ? ARG_LLONG :
+	       (length == 'z') ? ARG_SIZE  : ARG_INT;
+	break;
+    case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+	*arg = (length == 'D') ? ARG_LDOUBLE : ARG_DOUBLE;
+	break;
+    case 's':
+	*arg = ARG_STRING;
+	break;
+    case 'p':
+	*arg = ARG_POINTER;
+	break;
+    default:
+	return NULL;
+    }
+    return p + 1;
+}
+
+#define PUT(type)							\
+    {									\
+	type v = va_arg (ap, type);					\
+	if (n + sizeof (v) > PAYLOAD_SIZE)				\
+	    goto full;							\
+	memcpy (r->payload + n, &v, sizeof (v));			\
+	n += sizeof (v);						\
+    }									\
+    break
+
+// Copy the arguments of site->fmt into the record
+static void
+pack (RecordStruct *         r,
+      const RLG_SiteStruct * site,
+      va_list                ap)
+{
+    const char * p = site->fmt;
+    size_t       n = 0;
+    int          arg;
+
+    r->truncated = 0;
+    while ((p = strchr (p, '%')) != NULL && (p = conversion (p, &arg)) != NULL)
+    {
+	switch (arg)
+	{
+	case ARG_NONE:
+	    break;
+	case ARG_INT:     PUT (int);
+	case ARG_LONG:    PUT (long);
+	case ARG_LLONG:   PUT (long long);
+	case ARG_SIZE:    PUT (size_t);
+	case ARG_DOUBLE:  PUT (double);
+	case ARG_LDOUBLE: PUT (long double);
+	case ARG_POINTER: PUT (void *);
+	case ARG_STRING:
+	{
+	    const char * s = va_arg (ap, const char *);
+	    size_t       len;
+
+	    if (s == NULL)
+		s = "(null)";
+	    if (n >= PAYLOAD_SIZE)
+		goto full;
+	    len = strnlen (s, PAYLOAD_SIZE - n - 1);
+	    memcpy (r->payload + n, s, len);
+	    r->payload[n + len] = '\0';
+	    n += len + 1;
+	    break;
+	}
+	}
+    }
+    r->size = n;
+    return;
+
+full:
+    r->size      = n;
+    r->truncated = 1;
+}
+
+/*--------------------------------------------------------------------*
+ * RLG_Write: queue a message of an RLG_LOG call site. Does not block *
+ *--------------------------------------------------------------------*/
+void
+RLG_Write (RLG_SiteStruct * site,
+	   ...)
+{
+    struct timespec ts;
+    RecordStruct *  r;
+    uint64_t        now, pos;
+    int64_t         dif;
+    va_list         ap;
+
+    clock_gettime (CLOCK_REALTIME, &ts);
+    now = (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+
+    if (!__atomic_load_n (&running, __ATOMIC_ACQUIRE))
+    {
+	va_start (ap, site);
+	vprintf (site->fmt, ap);
+	va_end (ap);
+	return;
+    }
+
+    // The limit is approximate for a call site used by several threads
+    if (rate > 0)
+    {
+	if (now - site->window >= 1000000000u)
+	{
+	    site->window = now;
+	    site->count  = 0;
+	}
+	if (++site->count > rate)
+	{
+	    __atomic_fetch_add (&site->suppressed, 1, __ATOMIC_RELAXED);
+	    return;
+	}
+    }
+
+    // Claim a record: bounded ring of Vyukov, many writers, one reader
+    pos = __atomic_load_n (&tail, __ATOMIC_RELAXED);
+    for (;;)
+    {
+	r   = &ring[pos & (RLG_RING_RECORDS - 1)];
+	dif = (int64_t)(__atomic_load_n (&r->sequence, __ATOMIC_ACQUIRE) - pos);
+	if (dif == 0)
+	{
+	    if (__atomic_compare_exchange_n (&tail, &pos, pos + 1, 1,
+					     __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		break;
+	}
+	else if (dif < 0)
+	{
+	    __atomic_fetch_add (&dropped, 1, __ATOMIC_RELAXED);
+	    return;
+	}
+	else
+	{
+	    pos = __atomic_load_n (&tail, __ATOMIC_RELAXED);
+	}
+    }
+
+    r->time_ns    = now;
+    r->site       = site;
+    r->suppressed = 0;
+    if (__atomic_load_n (&site->suppressed, __ATOMIC_RELAXED) != 0)
+	r->suppressed = __atomic_exchange_n (&site->suppressed, 0, __ATOMIC_RELAXED);
+    va_start (ap, site);
+    pack (r, site, ap);
+    va_end (ap);
+    __atomic_store_n (&r->sequence, pos + 1, __ATOMIC_RELEASE);
+}
+
+#define GET(type)							\
+    {									\
+	type v;								\
+	memcpy (&v, r->payload + n, sizeof (v));			\
+	n += sizeof (v);						\
+	fprintf (out, spec, v);						\
+    }									\
+    break
+
+// Format a record as printf would have
+static void
+format (const RecordStruct * r)
+{
+    const char * p = r->site->fmt;
+    const char * q;
+    const char * end;
+    char         spec[32];
+    char         when[48];
+    time_t       sec = r->time_ns / 1000000000u;
+    struct tm    tm;
+    size_t       n = 0;
+    int          arg;
+
+    gmtime_r (&sec, &tm);
+    n = strftime (when, sizeof (when), "%Y-%m-%d %H:%M:%S", &tm);
+    snprintf (when + n, sizeof (when) - n, ".%03u %-5s ",
+	      (unsigned)(r->time_ns / 1000000u % 1000u), level_names[r->site->level]);
+    n = 0;
+
+    if (r->suppressed != 0)
+	fprintf (out, "%s(%lu messages like the next were suppressed)\n", when, r->suppressed);
+    fputs (when, out);
+
+    while ((q = strchr (p, '%')) != NULL)
+    {
+	fwrite (p, 1, q - p, out);
+	end = conversion (q, &arg);
+	if (end == NULL || (size_t)(end - q) >= sizeof (spec))
+	    break;
+	memcpy (spec, q, end - q);
+	spec[end - q] = '\0';
+	p = end;
+
+	if (arg != ARG_NONE && n >= r->size)
+	{
+	    fputs (" ...\n", out);
+	    return;
+	}
+
+	switch (arg)
+	{
+	case ARG_NONE:
+	    fputc ('%', out);
+	    break;
+	case ARG_INT:     GET (int);
+	case ARG_LONG:    GET (long);
+	case ARG_LLONG:   GET (long long);
+	case ARG_SIZE:    GET (size_t);
+	case ARG_DOUBLE:  GET (double);
+	case ARG_LDOUBLE: GET (long double);
+	case ARG_POINTER: GET (void *);
+	case ARG_STRING:
+	    fprintf (out, spec, (const char *)r->payload + n);
+	    n += strlen ((const char *)r->payload + n) + 1;
+	    break;
+	}
+    }
+    fputs ((q != NULL) ? q : p, out);
+}
+
+// Format the records written so far. RETURNS: how many
+static int
+drain (void)
+{
+    RecordStruct * r;
+    int            count = 0;
+
+    for (;;)
+    {
+	r = &ring[head & (RLG_RING_RECORDS - 1)];
+	if (__atomic_load_n (&r->sequence, __ATOMIC_ACQUIRE) != head + 1)
+	    break;
+
+	format (r);
+	__atomic_store_n (&r->sequence, head + RLG_RING_RECORDS, __ATOMIC_RELEASE);
+	head++;
+	count++;
+    }
+    return count;
+}
+
+static void *
+drain_loop (void * arg __attribute__ ((__unused__)))
+{
+    const struct timespec idle = { 0, 10000000 };   // 10 ms
+    unsigned long         lost;
+    int                   last;
+
+    for (;;)
+    {
+	last = __atomic_load_n (&closing, __ATOMIC_ACQUIRE);
+	if (drain () != 0)
+	    continue;
+
+	lost = __atomic_exchange_n (&dropped, 0, __ATOMIC_RELAXED);
+	if (lost != 0)
+	    fprintf (out, "RLG: log ring full, %lu messages dropped\n", lost);
+	fflush (out);
+
+	if (last)
+	    break;
+	nanosleep (&idle, NULL);
+    }
+    return NULL;
+}
+
+/*--------------------------------------------------------------------*
+ * RLG_Open: start logging through the ring                           *
+ * IN:  filename  file to append to, or NULL or "-" for stdout        *
+ *      level     highest RLG_Level_en logged                         *
+ *      rate      records per second per call site, 0 for no limit    *
+ * RETURNS: 0, or -1 if the file or the thread could not be opened    *
+ *--------------------------------------------------------------------*/
+int
+RLG_Open (const char * filename,
+	  int          level,
+	  int          rate_limit)
+{
+    uint64_t i;
+
+    if (running)
+	return 0;
+
+    out = stdout;
+    if (filename != NULL && strcmp (filename, "-") != 0)
+    {
+	out = fopen (filename, "a");
+	if (out == NULL)
+	{
+	    printf ("Could not open log file %s: %m\n", filename);
+	    out = stdout;
+	    return -1;
+	}
+    }
+
+    // Touch the whole ring now rather than on the first messages. It is
+    // kept after RLG_Close, for callers that passed the running check
+    if (ring == NULL &&
+	posix_memalign ((void **)&ring, 64, RLG_RING_RECORDS * sizeof (RecordStruct)) != 0)
+    {
+	ring = NULL;
+	goto fail;
+    }
+    memset (ring, 0, RLG_RING_RECORDS * sizeof (RecordStruct));
+    for (i = 0; i < RLG_RING_RECORDS; i++)
+	ring[i].sequence = i;
+
+    head      = tail = 0;
+    dropped   = 0;
+    closing   = 0;
+    rate      = (rate_limit > 0) ? rate_limit : 0;
+    RLG_level = level;
+
+    if (pthread_create (&drain_thread, NULL, drain_loop, NULL) != 0)
+	goto fail;
+
+    __atomic_store_n (&running, 1, __ATOMIC_RELEASE);
+    return 0;
+
+fail:
+    printf ("Could not start logging\n");
+    if (out != stdout)
+	fclose (out);
+    out = stdout;
+    return -1;
+}
+
+// Write out what is queued and stop the thread; later messages are printed
+void
+RLG_Close (void)
+{
+    if (!running)
+	return;
+
+    __atomic_store_n (&running, 0, __ATOMIC_RELEASE);
+    __atomic_store_n (&closing, 1, __ATOMIC_RELEASE);
+    pthread_join (drain_thread, NULL);
+
+    if (out != stdout)
+	fclose (out);
+    out = stdout;
+}
+
+/*--------------------------------------------------------------------*
+ * RLG_ParseLevel                                                     *
+ * IN:  name  error, warn, info or debug, or the level number         *
+ * RETURNS: the RLG_Level_en, or -1 if unknown                        *
+ *--------------------------------------------------------------------*/
+int
+RLG_ParseLevel (const char * name)
+{
+    int level;
+
+    for (level = RLG_ERROR; level <= RLG_DEBUG; level++)
+    {
+	if (strcasecmp (name, level_names[level]) == 0)
+	    return level;
+    }
+    if (name[0] >= '0' && name[0] <= '9' && name[1] == '\0' && name[0] - '0' <= RLG_DEBUG)
+	return name[0] - '0';
+    return -1;
+}
+
+const char *
+RLG_LevelName (int level)
+{
+    return (level >= RLG_ERROR && level <= RLG_DEBUG) ? level_names[level] : "?";
+}
@@ -0,0 +1,193 @@
+// RLG_LogTest.c
+// -------------
+// Part of the Chilbolton Radar Logging Package
+//
+// Purpose: Test of RLG_Log.c: messages must read as printf would have
+//          printed them, every message from several threads must be
+//          written or counted as dropped, and the rate limit must report
+//          what it suppressed.
+//
+// Created on: 19/10/26
+// -------------------------------------------------------
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <RLG.h>
+
+#define PREFIX   30       // "YYYY-MM-DD HH:MM:SS.mmm LEVEL "
+#define THREADS  4
+#define MESSAGES 20000    // per thread, more than the ring holds
+
+static int  failures = 0;
+static char logfile[] = "/tmp/RLG_LogTestXXXXXX";
+
+static void
+check (int ok, const char * what)
+{
+    printf ("%-56s %s\n", what, ok ? "ok" : "FAILED");
+    if (!ok)
+	failures++;
+}
+
+// Read the log back, without the time and level of each line
+static char *
+read_log (void)
+{
+    static char text[8 << 20];
+    char        line[1024];
+    size_t      n = 0;
+    FILE *      fp = fopen (logfile, "r");
+
+    text[0] = '\0';
+    if (fp == NULL)
+	return text;
+    while (fgets (line, sizeof (line), fp) != NULL && n + sizeof (line) < sizeof (text))
+    {
+	const char * msg = (strlen (line) > PREFIX) ? line + PREFIX : line;
+
+	n += sprintf (text + n, "%s", msg);
+    }
+    fclose (fp);
+    return text;
+}
+
+static void
+test_format (void)
+{
+    char        expect[1024];
+    char        word[16] = "mutable";
+    const char *text;
+    long        big = 1234567890123L;
+    size_t      size = 42;
+
+    truncate (logfile, 0);
+    RLG_Open (logfile, RLG_INFO, 0);
+    RLG_LOG (RLG_INFO, "ray number: %d\n", 17);
+    RLG_LOG (RLG_INFO, "%s %5.2f%% %-4c| %lu %zu %lld %x %e\n",
+	     word, 12.345, 'x', big, size, -5LL, 255u, 1e-7);
+    strcpy (word, "changed");  // the record holds a copy
+    RLG_LOG (RLG_DEBUG, "not logged above the level %d\n", RLG_INFO);
+    RLG_LOG (RLG_ERROR, "no arguments\n");
+    RLG_Close ();
+
+    snprintf (expect, sizeof (expect), "ray number: %d\n%s %5.2f%% %-4c| %lu %zu %lld %x %e\nno arguments\n",
+	      17, "mutable", 12.345, 'x', big, size, -5LL, 255u, 1e-7);
+    text = read_log ();
+    check (strcmp (text, expect) == 0, "messages read as printf prints them");
+    if (strcmp (text, expect) != 0)
+	printf ("got:\n%swanted:\n%s", text, expect);
+}
+
+static void *
+writer (void * arg)
+{
+    int t = (int)(long)arg;
+    int i;
+
+    for (i = 0; i < MESSAGES; i++)
+	RLG_LOG (RLG_INFO, "thread %d message %d\n", t, i);
+    return NULL;
+}
+
+static void
+test_threads (void)
+{
+    pthread_t    threads[THREADS];
+    int          next[THREADS] = { 0 };
+    long         t;
+    long         written = 0, dropped = 0, lost;
+    int          in_order = 1, garbled = 0;
+    char         line[1024];
+    FILE *       fp;
+
+    truncate (logfile, 0);
+    RLG_Open (logfile, RLG_INFO, 0);
+    for (t = 0; t < THREADS; t++)
+	pthread_create (&threads[t], NULL, writer, (void *)t);
+    for (t = 0; t < THREADS; t++)
+	pthread_join (threads[t], NULL);
+    RLG_Close ();
+
+    fp = fopen (logfile, "r");
+    while (fp != NULL && fgets (line, sizeof (line), fp) != NULL)
+    {
+	int th, i;
+
+	if (sscanf (line, "RLG: log ring full, %ld messages dropped", &lost) == 1)
+	    dropped += lost;
+	else if (strlen (line) > PREFIX &&
+		 sscanf (line + PREFIX, "thread %d message %d", &th, &i) == 2 &&
+		 th >= 0 && th < THREADS)
+	{
+	    if (i < next[th])
+		in_order = 0;
+	    next[th] = i + 1;
+	    written++;
+	}
+	else
+	{
+	    garbled++;
+	}
+    }
+    if (fp != NULL)
+	fclose (fp);
+
+    printf ("%ld written, %ld dropped\n", written, dropped);
+    check (written + dropped == (long)THREADS * MESSAGES, "every message written or counted as dropped");
+    check (in_order, "messages of a thread stay in order");
+    check (garbled == 0, "no garbled lines");
+}
+
+static void
+limited (void)
+{
+    RLG_LOG (RLG_WARN, "limited\n");
+}
+
+static void
+test_rate (void)
+{
+    const char * text;
+    const char * p;
+    int          i, lines = 0;
+
+    truncate (logfile, 0);
+    RLG_Open (logfile, RLG_INFO, 10);
+    for (i = 0; i < 100; i++)
+	limited ();
+    sleep (1);
+    limited ();
+    RLG_Close ();
+
+    text = read_log ();
+    for (p = text; (p = strstr (p, "limited\n")) != NULL; p++)
+	lines++;
+    check (lines == 11, "10 messages a second from a call site");
+    check (strstr (text, "(90 messages like the next were suppressed)") != NULL,
+	   "suppressed messages reported");
+}
+
+int
+main (void)
+{
+    int fd = mkstemp (logfile);
+
+    if (fd < 0)
+    {
+	perror ("mkstemp");
+	return 1;
+    }
+    close (fd);
+
+    test_format ();
+    test_threads ();
+    test_rate ();
+
+    unlink (logfile);
+    printf ("%s\n", failures ? "FAILED" : "PASSED");
+    return failures ? 1 : 0;
+}
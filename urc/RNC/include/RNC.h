@@ -56,6 +56,7 @@ typedef struct
     int spectra_number_dim;
 } RNC_DimensionStruct;
 
+extern void RNC_SetDataPath    (const char * path);
 extern int  RNC_OpenNetcdfFile (const char * radar_name,
 				const char * sectra_name,
 				const char * date,
@@ -116,5 +117,6 @@ extern double RNC_GetConfigDouble (const char * filename, const char * keyword);
 extern float  RNC_GetConfigFloat  (const char * filename, const char * keyword);
 extern int    RNC_GetConfig       (const char * filename, const char * keyword,
 				   char * value, size_t value_size);
+extern int    RNC_ReadCodeFile    (const char * filename, RSP_ParamStruct * param);
 
 #endif /* !_RNC_H */
@@ -47,6 +47,22 @@
 #include <RNC.h>
 #include <RSP.h>
 
+/* Root of the radar data tree the files are created in */
+static const char * data_path = RADAR_DATA_PATH;
+
+/*****************************************************************************
+ *                                                                           *
+ *****************************************************************************/
+void
+RNC_SetDataPath (const char * path)
+{
+    /*--------------------------------------------------------------------------*
+     * IN:  path : replaces RADAR_DATA_PATH, with a trailing '/'; must stay      *
+     *             valid while files are opened                                 *
+     *--------------------------------------------------------------------------*/
+    data_path = path;
+}
+
 /*****************************************************************************
  *                                                                           *
  *****************************************************************************/
@@ -73,7 +89,7 @@ RNC_OpenNetcdfFile (const char * radar_name,
 
     umask (mask);
 
-    size = strlen (RADAR_DATA_PATH) + 22;
+    size = strlen (data_path) + 22;
     size += strlen (radar_name) << 1;
     size += strlen (sectra_name);
     if (host_ext != NULL)
@@ -84,7 +100,7 @@ RNC_OpenNetcdfFile (const char * radar_name,
 	size += strlen (spectra_ext);
     netcdf_pathfile = alloca (size);
 
-    pt    = stpcpy (netcdf_pathfile, RADAR_DATA_PATH);
+    pt    = stpcpy (netcdf_pathfile, data_path);
     pt    = stpcpy (pt, radar_name);
     *pt++ = '/';
     pt    = stpcpy (pt, sectra_name);
@@ -93,6 +109,19 @@ RNC_OpenNetcdfFile (const char * radar_name,
     pt[8] = '\0';
     pt   += strlen (pt);
 
+    /* a data tree other than RADAR_DATA_PATH may not be there yet */
+    if (strcmp (data_path, RADAR_DATA_PATH))
+    {
+	char * dir;
+
+	for (dir = strchr (netcdf_pathfile + 1, '/'); dir != NULL && dir < pt; dir = strchr (dir + 1, '/'))
+	{
+	    *dir = '\0';
+	    mkdir (netcdf_pathfile, (S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH));
+	    *dir = '/';
+	}
+    }
+
     if (!mkdir (netcdf_pathfile, (S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH)))
     {
 	printf ("directory created : %s\n", netcdf_pathfile);
@@ -407,6 +436,26 @@ RNC_SetupGlobalAttributes (int                     ncid,
 			     NC_INT, 1, &temp);
     if (status != NC_NOERR) check_netcdf_handle_error (status);
 
+    /*--------------------------------------------------------------------------*
+     * instruction set of the signal processing kernels                         *
+     *--------------------------------------------------------------------------*/
+    if (param->kernel_isa != NULL)
+    {
+	status = nc_put_att_text (ncid, NC_GLOBAL, "processing_kernels",
+				  strlen (param->kernel_isa) + 1, param->kernel_isa);
+	if (status != NC_NOERR) check_netcdf_handle_error (status);
+    }
+
+    /*--------------------------------------------------------------------------*
+     * cores, scheduling and memory the recorder ran with                       *
+     *--------------------------------------------------------------------------*/
+    if (param->realtime != NULL)
+    {
+	status = nc_put_att_text (ncid, NC_GLOBAL, "realtime_setup",
+				  strlen (param->realtime) + 1, param->realtime);
+	if (status != NC_NOERR) check_netcdf_handle_error (status);
+    }
+
     if (radar != CAMRA)
     {
 	/* pulses_coherently_averaged */
@@ -1164,6 +1213,18 @@ RNC_SetupRange (int                         ncid,
 			       NC_FLOAT, 1, &param->range_gate_width);
     if (status != NC_NOERR) check_netcdf_handle_error (status);
 
+    /* the range window: the gates acquired, and the first of them in range */
+    if (param->samples_per_pulse_acquired > 0)
+    {
+	status = nc_put_att_int (ncid, rangeid, "gates_acquired",
+				 NC_INT, 1, &param->samples_per_pulse_acquired);
+	if (status != NC_NOERR) check_netcdf_handle_error (status);
+
+	status = nc_put_att_int (ncid, rangeid, "first_gate",
+				 NC_INT, 1, &param->first_gate);
+	if (status != NC_NOERR) check_netcdf_handle_error (status);
+    }
+
     /*--------------------------------------------------------------------------*
      * go from define to data                                                   *
      *--------------------------------------------------------------------------*/
@@ -1282,6 +1343,76 @@ ObservableTemplateScalar (int          ncid,
     return varid;
 }
 
+/* Per ray count of acquisition events */
+static int
+QualityCounter (int          ncid,
+		const int  * variable_shape,
+		const char * name,
+		const char * long_name)
+{
+    int          varid;
+    int          status;
+    const char * units = "1";
+
+    status = nc_def_var (ncid, name, NC_SHORT, 1, variable_shape, &varid);
+    if (status != NC_NOERR) check_netcdf_handle_error (status);
+
+    status = nc_put_att_text (ncid, varid, "long_name",
+			      strlen (long_name) + 1, long_name);
+    if (status != NC_NOERR) check_netcdf_handle_error (status);
+
+    status = nc_put_att_text (ncid, varid, "units",
+			      strlen (units) + 1, units);
+    if (status != NC_NOERR) check_netcdf_handle_error (status);
+    return varid;
+}
+
+/*--------------------------------------------------------------------------*
+ * Acquisition quality of each ray: a bank is processed while the next one  *
+ * is acquired, so it has dwell_time (the deadline) to be processed in      *
+ *--------------------------------------------------------------------------*/
+static void
+SetupQualityVariables (int                     ncid,
+		       const int *             variable_shape,
+		       const RSP_ParamStruct * param,
+		       RSP_ObservablesStruct * obs)
+{
+    static const char * const error_names[RSP_DAQ_ERRORS][2] = {
+	{ "dma_timeouts",      "banks of the ray whose DMA timed out" },
+	{ "dma_master_aborts", "banks of the ray with a PCI master abort" },
+	{ "fifo_overflows",    "banks of the ray with a FIFO overflow" },
+	{ "hv_timeouts",       "banks of the ray the card did not trigger for (HV timeout)" },
+    };
+    float temp_float = -999.0f;
+    int   status;
+    int   e;
+
+    obs->min_slackid = ObservableTemplateScalar (
+	ncid, "min_slack", variable_shape, NULL,
+	"least time to spare between processing a bank of the ray and the next bank completing",
+	"s");
+
+    status = nc_put_att_float (ncid, obs->min_slackid, "deadline",
+			       NC_FLOAT, 1, &param->dwell_time);
+    if (status != NC_NOERR) check_netcdf_handle_error (status);
+
+    status = nc_put_att_float (ncid, obs->min_slackid, "missing_value",
+			       NC_FLOAT, 1, &temp_float);
+    if (status != NC_NOERR) check_netcdf_handle_error (status);
+
+    status = nc_put_att_float (ncid, obs->min_slackid, "_FillValue",
+			       NC_FLOAT, 1, &temp_float);
+    if (status != NC_NOERR) check_netcdf_handle_error (status);
+
+    obs->missed_deadlinesid = QualityCounter (
+	ncid, variable_shape, "missed_deadlines",
+	"banks of the ray processed after the next bank completed");
+
+    for (e = 0; e < RSP_DAQ_ERRORS; e++)
+	obs->daq_errorsid[e] = QualityCounter (ncid, variable_shape,
+					       error_names[e][0], error_names[e][1]);
+}
+
 /*****************************************************************************
  *                                                                           *
  *****************************************************************************/
@@ -1364,6 +1495,22 @@ RNC_SetupDynamicVariables (int                         ncid,
 			      strlen (buffer) + 1, buffer);
     if (status != NC_NOERR) check_netcdf_handle_error (status);
 
+    /*--------------------------------------------------------------------------*
+     * dish_latency definition                                                  *
+     *--------------------------------------------------------------------------*/
+    obs->dish_latencyid = ObservableTemplateScalar (
+	ncid, "dish_latency", variable_shape, NULL,
+	"time from the dish position at dish_time to its message arriving",
+	"s");
+
+    status = nc_put_att_float (ncid, obs->dish_latencyid, "missing_value",
+			       NC_FLOAT, 1, &temp_float);
+    if (status != NC_NOERR) check_netcdf_handle_error (status);
+
+    status = nc_put_att_float (ncid, obs->dish_latencyid, "_FillValue",
+			       NC_FLOAT, 1, &temp_float);
+    if (status != NC_NOERR) check_netcdf_handle_error (status);
+
     /*--------------------------------------------------------------------------*
      * elevation definition                                                     *
      *--------------------------------------------------------------------------*/
@@ -2809,6 +2956,8 @@ RNC_SetupDynamicVariables (int                         ncid,
 				       NC_FLOAT, 1, &temp_float);
 	    if (status != NC_NOERR) check_netcdf_handle_error (status);
 	}
+
+	SetupQualityVariables (ncid, variable_shape, param, obs);
 	break;
     }
 }
@@ -3074,6 +3223,7 @@ RNC_WriteDynamicVariables (int                     ncid,
     int        status;
     int        n;
     float      temp_float;
+    const float * row;
 
     /*--------------------------------------------------------------------------*
      * write time                                                               *
@@ -3094,6 +3244,14 @@ RNC_WriteDynamicVariables (int                     ncid,
 				variable_start, &temp_float);
     if (status != NC_NOERR) check_netcdf_handle_error (status);
 
+    /*--------------------------------------------------------------------------*
+     * write dish_latency                                                       *
+     *--------------------------------------------------------------------------*/
+    temp_float = (obs->dish_latency >= 0.0f) ? obs->dish_latency : -999.0f;
+    status = nc_put_var1_float (ncid, obs->dish_latencyid,
+				variable_start, &temp_float);
+    if (status != NC_NOERR) check_netcdf_handle_error (status);
+
     /*--------------------------------------------------------------------------*
      * write elevation                                                          *
      *--------------------------------------------------------------------------*/
@@ -3110,20 +3268,41 @@ RNC_WriteDynamicVariables (int                     ncid,
     if (status != NC_NOERR) check_netcdf_handle_error (status);
 
     /*--------------------------------------------------------------------------*
-     * write radar observables                                                  *
+     * write acquisition quality                                                *
+     *--------------------------------------------------------------------------*/
+    temp_float = (obs->min_slack < HUGE_VALF) ? obs->min_slack : -999.0f;
+    status = nc_put_var1_float (ncid, obs->min_slackid,
+				variable_start, &temp_float);
+    if (status != NC_NOERR) check_netcdf_handle_error (status);
+
+    status = nc_put_var1_int (ncid, obs->missed_deadlinesid,
+			      variable_start, &obs->missed_deadlines);
+    if (status != NC_NOERR) check_netcdf_handle_error (status);
+
+    for (n = 0; n < RSP_DAQ_ERRORS; n++)
+    {
+	status = nc_put_var1_int (ncid, obs->daq_errorsid[n],
+				  variable_start, &obs->daq_errors[n]);
+	if (status != NC_NOERR) check_netcdf_handle_error (status);
+    }
+
+    /*--------------------------------------------------------------------------*
+     * write radar observables: the rows of obs->block, in order. Each is a     *
+     * variable of its own in the file, so it is still one put per row.         *
      *--------------------------------------------------------------------------*/
     variable_start[0] = obs->ray_number ;
     variable_start[1] = 0;
     variable_count[0] = 1;
     variable_count[1] = param->samples_per_pulse;
 
-    for (n = 0; n < obs->n_obs; n++)
+    row = obs->block;
+    for (n = 0; n < obs->n_obs; n++, row += obs->n_gates)
     {
 	if (!obs->record_observable[n])
 	    continue;
 
 	status = nc_put_vara_float (ncid, obs->varid[n], variable_start,
-				    variable_count, obs->data[n]);
+				    variable_count, row);
 	if (status != NC_NOERR) check_netcdf_handle_error (status);
     }
 
@@ -3188,6 +3367,14 @@ RNC_WriteLogPSDVariables (int                     ncid,
     if (status != NC_NOERR) check_netcdf_handle_error (status);
 #endif
 
+    /*--------------------------------------------------------------------------*
+     * write dish_latency                                                       *
+     *--------------------------------------------------------------------------*/
+    temp_float = (obs->dish_latency >= 0.0f) ? obs->dish_latency : -999.0f;
+    status = nc_put_var1_float (ncid, obs->dish_latencyid,
+				variable_start, &temp_float);
+    if (status != NC_NOERR) check_netcdf_handle_error (status);
+
     /*--------------------------------------------------------------------------*
      * write elevation                                                          *
      *--------------------------------------------------------------------------*/
@@ -3575,6 +3762,7 @@ RNC_WriteRapidLogPSDVariables (int                     ncid,
     int     status;
     int     n,j;
     float   timestamp;
+    float   dish_latency;
     float  azimuth;
     short int       *log_psd;
     short int *log_psd_coded;
@@ -3607,6 +3795,9 @@ RNC_WriteRapidLogPSDVariables (int                     ncid,
     timestamp = (((int)obs->hour * 3600) + ((int)obs->minute * 60) +
 		 obs->second + ((float)obs->centisecond / 100.0));
 
+    /* dish_latency, or its fill value */
+    dish_latency = (obs->dish_latency >= 0.0f) ? obs->dish_latency : -999.0f;
+
     /* obtain azimuth */
     azimuth = obs->azimuth + param->azimuth_offset;
 
@@ -3698,6 +3889,11 @@ RNC_WriteRapidLogPSDVariables (int                     ncid,
 					    variable_start, &timestamp);
 		if (status != NC_NOERR) check_netcdf_handle_error (status);
 
+		/* dish_latency */
+		status = nc_put_var1_float (ncid, obs->dish_latencyid,
+					    variable_start, &dish_latency);
+		if (status != NC_NOERR) check_netcdf_handle_error (status);
+
 		/* elevation */
 		status = nc_put_var1_float (ncid, obs->elevationid,
 					    variable_start, &obs->elevation);
@@ -117,3 +117,86 @@ RNC_GetConfig(const char *filename,
     fclose (fptr);
     return status;
 }
+
+
+int
+RNC_ReadCodeFile(const char *      filename,
+		 RSP_ParamStruct * param)
+{
+    /*-----------------------------------------------------------------------*
+     * Reads pulse compression codes from a space-delimited code file        *
+     *   code-name   <name>                                                  *
+     *   code-length <bits per code>                                         *
+     *   num-codes   <number of complementary codes>                         *
+     *   code-<n>    <bits of code n as 1/-1>                                *
+     * On any error the radar is left uncoded (code_length 1) and 1 is       *
+     * returned.                                                             *
+     *-----------------------------------------------------------------------*/
+    char   valuestr [255];
+    char   keyword [16];
+    short  codes [32][32];
+    char * p;
+    char * end;
+    FILE * fptr;
+    long   bit;
+    int    length, ncodes;
+    int    n, q;
+
+    param->code_length     = 1;
+    param->number_of_codes = 1;
+    param->codes[0][0]     = 1;
+    strcpy (param->code_name, "none");
+
+    fptr = fopen (filename, "r");
+    if (fptr == NULL)
+    {
+	printf ("** getcode: Unable to open %s: %m\n", filename);
+	return 1;
+    }
+    fclose (fptr);
+
+    length = (int)RNC_GetConfigDouble (filename, "code-length");
+    ncodes = (int)RNC_GetConfigDouble (filename, "num-codes");
+    if (length < 1 || length > 32 || ncodes < 1 || ncodes > 32)
+    {
+	printf ("** getcode: Bad code dimensions in %s.\n", filename);
+	return 1;
+    }
+
+    for (n = 0; n < ncodes; n++)
+    {
+	snprintf (keyword, sizeof (keyword), "code-%d", n);
+	if (RNC_GetConfig (filename, keyword, valuestr, sizeof (valuestr)))
+	{
+	    printf ("** getcode: Keyword %s not found.\n", keyword);
+	    return 1;
+	}
+
+	p = valuestr;
+	for (q = 0; q < length; q++)
+	{
+	    bit = strtol (p, &end, 10);
+	    if (end == p || (bit != 1 && bit != -1))
+	    {
+		printf ("** getcode: Bad value for Keyword %s.\n", keyword);
+		return 1;
+	    }
+	    codes[n][q] = bit;
+	    p = end;
+	}
+    }
+
+    for (n = 0; n < ncodes; n++)
+	memcpy (param->codes[n], codes[n], length * sizeof (short));
+    param->code_length     = length;
+    param->number_of_codes = ncodes;
+
+    if (RNC_GetConfig (filename, "code-name", valuestr, sizeof (valuestr)) == 0)
+    {
+	valuestr [strcspn (valuestr, "\r\n")] = '\0';
+	strncpy (param->code_name, valuestr, sizeof (param->code_name) - 1);
+	param->code_name [sizeof (param->code_name) - 1] = '\0';
+    }
+
+    return 0;
+}
@@ -0,0 +1,81 @@
+#ifndef _RRT_H
+#define _RRT_H
+
+// RRT.h
+// Radar Real-Time package: the setup that keeps the ray loop off the
+// page fault and scheduler paths. The ray loop thread is pinned to a core
+// of its own and run SCHED_FIFO, the other threads (position messages,
+// logging) to the remaining cores, and all memory is locked and faulted
+// in before the first bank.
+//
+// Large working buffers come from RRT_Map, which backs them with huge
+// pages when it can and touches every page before returning. A run arena
+// is one such mapping, carved into the buffers of a run: sized up front,
+// handed out in order, aligned to RRT_ALIGN, and emptied as a whole.
+//
+// Nothing here is fatal: each step that fails (no CAP_SYS_NICE, a low
+// RLIMIT_MEMLOCK, no huge pages reserved) is left out and shown in the
+// report, so the recorder runs as before, only less predictably.
+
+#include <stddef.h>
+
+typedef enum
+{
+    RRT_PAGES_NORMAL,               // 4 KiB pages
+    RRT_PAGES_THP,                  // anonymous, advised for transparent huge pages
+    RRT_PAGES_HUGETLB               // MAP_HUGETLB, falling back to RRT_PAGES_THP
+} RRT_Pages_en;
+
+#define RRT_MAX_MAPS      64
+#define RRT_STACK_PREFAULT (512 * 1024)  // bytes of stack touched by RRT_Setup
+
+typedef struct
+{
+    int  cpu;                       // core for the ray loop, -1 to leave it
+    char aux_cpus[80];              // cores for other threads, e.g. "0-1,3", "" to leave them
+    int  priority;                  // SCHED_FIFO priority of the ray loop, 0 for SCHED_OTHER
+    int  lock_memory;               // mlockall current and future memory
+    int  pages;                     // RRT_Pages_en for RRT_Map
+} RRT_ConfigStruct;
+
+#define RRT_CONFIG_NONE { -1, "", 0, 0, RRT_PAGES_NORMAL }   // changes nothing
+
+// What was actually achieved
+typedef struct
+{
+    int    cpu;                     // core of the ray loop, -1 if not pinned
+    int    aux_cpus;                // cores in the other threads' set, 0 if not set
+    int    priority;                // SCHED_FIFO priority, 0 if SCHED_OTHER
+    int    memory_locked;
+    size_t mapped;                  // bytes from RRT_Map
+    size_t hugetlb;                 // of which MAP_HUGETLB
+    size_t thp;                     // AnonHugePages of the process
+    char   summary[256];            // all of the above, for logs and files
+} RRT_ReportStruct;
+
+#define RRT_ALIGN 64                // bytes, a cache line and an AVX-512 vector
+
+// Bytes an arena takes for n elements of size
+#define RRT_ARENA_BYTES(n, size) \
+    (((size_t)(n) * (size) + RRT_ALIGN - 1) & ~(size_t)(RRT_ALIGN - 1))
+
+typedef struct
+{
+    char * base;
+    size_t size;                    // as asked for
+    size_t used;
+} RRT_ArenaStruct;
+
+extern int    RRT_SetAuxCpus (const RRT_ConfigStruct * config, RRT_ReportStruct * report);
+extern void * RRT_Map        (size_t size, const RRT_ConfigStruct * config, RRT_ReportStruct * report);
+extern void   RRT_Unmap      (void * p);
+extern int    RRT_Setup      (const RRT_ConfigStruct * config, RRT_ReportStruct * report);
+extern int    RRT_ParsePages (const char * name);
+
+extern int    RRT_ArenaOpen  (RRT_ArenaStruct * arena, size_t size,
+			      const RRT_ConfigStruct * config, RRT_ReportStruct * report);
+extern void * RRT_ArenaAlloc (RRT_ArenaStruct * arena, size_t n, size_t size);
+extern void   RRT_ArenaReset (RRT_ArenaStruct * arena);
+extern void   RRT_ArenaClose (RRT_ArenaStruct * arena);
+
+#endif /* _RRT_H */
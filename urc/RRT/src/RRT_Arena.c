@@ -0,0 +1,68 @@
+// RRT_Arena.c
+// -----------
+// Part of the Chilbolton Radar Real-Time Package
+//
+// Purpose: Run arena: one prefaulted mapping holding the working buffers
+//          of a run, handed out in order and emptied in one step.
+//
+// Created on: 19/10/26
+// -------------------------------------------------------
+
+#include <string.h>
+
+#include <RRT.h>
+
+/*--------------------------------------------------------------------*
+ * RRT_ArenaOpen                                                      *
+ * IN:  size    bytes, the sum of RRT_ARENA_BYTES of the buffers      *
+ *      config  pages to map it with (see RRT_Map)                    *
+ * RETURNS: 0, or -1 if it could not be mapped                        *
+ *--------------------------------------------------------------------*/
+int
+RRT_ArenaOpen (RRT_ArenaStruct *        arena,
+	       size_t                   size,
+	       const RRT_ConfigStruct * config,
+	       RRT_ReportStruct *       report)
+{
+    arena->base = RRT_Map (size, config, report);
+    arena->size = (arena->base != NULL) ? size : 0;
+    arena->used = 0;
+    return (arena->base != NULL) ? 0 : -1;
+}
+
+/*--------------------------------------------------------------------*
+ * RRT_ArenaAlloc: the next n elements of size, zeroed                *
+ * RETURNS: memory aligned to RRT_ALIGN, or NULL if the arena is full *
+ *--------------------------------------------------------------------*/
+void *
+RRT_ArenaAlloc (RRT_ArenaStruct * arena,
+		size_t            n,
+		size_t            size)
+{
+    const size_t bytes = RRT_ARENA_BYTES (n, size);
+    char *       p;
+
+    if (arena->base == NULL || bytes > arena->size - arena->used)
+	return NULL;
+
+    p            = arena->base + arena->used;
+    arena->used += bytes;
+    memset (p, 0, bytes);
+    return p;
+}
+
+/* Empty the arena for the buffers of a new configuration */
+void
+RRT_ArenaReset (RRT_ArenaStruct * arena)
+{
+    arena->used = 0;
+}
+
+void
+RRT_ArenaClose (RRT_ArenaStruct * arena)
+{
+    RRT_Unmap (arena->base);
+    arena->base = NULL;
+    arena->size = 0;
+    arena->used = 0;
+}
@@ -0,0 +1,347 @@
+// RRT_Setup.c
+// -----------
+// Part of the Chilbolton Radar Real-Time Package
+//
+// Purpose: Core pinning, real-time priority, locked memory and
+//          prefaulted huge page buffers for the recorder.
+//
+// Created on: 19/10/26
+// -------------------------------------------------------
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <RRT.h>
+
+#ifndef MAP_HUGETLB
+#define MAP_HUGETLB 0x40000
+#endif
+
+typedef struct
+{
+    void * p;                       // as returned
+    void * base;                    // of the mapping
+    size_t length;                  // of the mapping
+} MapStruct;
+
+static MapStruct maps[RRT_MAX_MAPS];
+static int       hugetlb_failed;
+
+static const char * const page_names[] = { "normal", "thp", "hugetlb" };
+
+/* RETURNS: the RRT_Pages_en called name, or -1 */
+int
+RRT_ParsePages (const char * name)
+{
+    int i;
+
+    for (i = 0; i < (int)(sizeof (page_names) / sizeof (page_names[0])); i++)
+    {
+	if (strcasecmp (name, page_names[i]) == 0)
+	    return i;
+    }
+    return -1;
+}
+
+/*--------------------------------------------------------------------*
+ * parse_cpus: a list of cores and ranges, as "0-1,3"                 *
+ * RETURNS: the number of cores in the set, or -1 for a bad list      *
+ *--------------------------------------------------------------------*/
+static int
+parse_cpus (const char * list,
+	    cpu_set_t *  set)
+{
+    const char * p = list;
+    char *       end;
+    long         first, last;
+
+    CPU_ZERO (set);
+    while (*p != '\0')
+    {
+	first = strtol (p, &end, 10);
+	if (end == p || first < 0)
+	    return -1;
+	last = first;
+	if (*end == '-')
+	{
+	    p    = end + 1;
+	    last = strtol (p, &end, 10);
+	    if (end == p || last < first)
+		return -1;
+	}
+	for (; first <= last && first < CPU_SETSIZE; first++)
+	    CPU_SET (first, set);
+	p = end;
+	if (*p == ',')
+	    p++;
+	else if (*p != '\0')
+	    return -1;
+    }
+    return CPU_COUNT (set);
+}
+
+/*--------------------------------------------------------------------*
+ * RRT_SetAuxCpus: restrict the calling thread to the aux_cpus, to be *
+ * called before any other thread is started: they inherit the set,   *
+ * and RRT_Setup later moves the caller to its own core               *
+ * RETURNS: 0, or -1 if the set could not be used                     *
+ *--------------------------------------------------------------------*/
+int
+RRT_SetAuxCpus (const RRT_ConfigStruct * config,
+		RRT_ReportStruct *       report)
+{
+    cpu_set_t set;
+    int       n, status;
+
+    if (config->aux_cpus[0] == '\0')
+	return 0;
+
+    n = parse_cpus (config->aux_cpus, &set);
+    if (n <= 0)
+    {
+	printf ("RRT: bad cpu list \"%s\"\n", config->aux_cpus);
+	return -1;
+    }
+    status = pthread_setaffinity_np (pthread_self (), sizeof (set), &set);
+    if (status != 0)
+    {
+	printf ("RRT: could not run on cpus %s: %s\n", config->aux_cpus, strerror (status));
+	return -1;
+    }
+    report->aux_cpus = n;
+    return 0;
+}
+
+static size_t
+huge_page_size (void)
+{
+    char   line[128];
+    size_t kb   = 2048;
+    FILE * fp   = fopen ("/proc/meminfo", "r");
+
+    while (fp != NULL && fgets (line, sizeof (line), fp) != NULL)
+    {
+	if (sscanf (line, "Hugepagesize: %zu kB", &kb) == 1)
+	    break;
+    }
+    if (fp != NULL)
+	fclose (fp);
+    return kb * 1024;
+}
+
+/*--------------------------------------------------------------------*
+ * RRT_Map: zeroed memory with every page faulted in                  *
+ * IN:  size    bytes                                                 *
+ *      config  pages to use: a MAP_HUGETLB mapping needs huge pages  *
+ *              reserved in /proc/sys/vm/nr_hugepages, and otherwise  *
+ *              THP gets a mapping aligned to a huge page and advised *
+ * RETURNS: the memory, aligned to at least a page, or NULL           *
+ *--------------------------------------------------------------------*/
+void *
+RRT_Map (size_t                   size,
+	 const RRT_ConfigStruct * config,
+	 RRT_ReportStruct *       report)
+{
+    const size_t page = sysconf (_SC_PAGESIZE);
+    const size_t huge = huge_page_size ();
+    MapStruct    map  = { MAP_FAILED, MAP_FAILED, 0 };
+    size_t       off;
+    int          i;
+
+    for (i = 0; i < RRT_MAX_MAPS && maps[i].p != NULL; i++)
+	;
+    if (i == RRT_MAX_MAPS || size == 0)
+	return NULL;
+
+    if (config->pages == RRT_PAGES_HUGETLB)
+    {
+	map.length = (size + huge - 1) / huge * huge;
+	map.base   = mmap (NULL, map.length, PROT_READ | PROT_WRITE,
+			   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+	if (map.base != MAP_FAILED)
+	    report->hugetlb += map.length;
+	else if (!hugetlb_failed++)
+	    printf ("RRT: no huge pages (vm.nr_hugepages), using THP: %s\n", strerror (errno));
+	map.p = map.base;
+    }
+
+    if (map.base == MAP_FAILED && config->pages != RRT_PAGES_NORMAL)
+    {
+	/* Over map, and trim to a mapping that starts on a huge page */
+	map.length = (size + huge - 1) / huge * huge;
+	map.base   = mmap (NULL, map.length + huge, PROT_READ | PROT_WRITE,
+			   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (map.base != MAP_FAILED)
+	{
+	    off = (huge - (uintptr_t)map.base % huge) % huge;
+	    if (off > 0)
+		munmap (map.base, off);
+	    munmap ((char *)map.base + off + map.length, huge - off);
+	    map.base = (char *)map.base + off;
+	    map.p    = map.base;
+	    madvise (map.base, map.length, MADV_HUGEPAGE);
+	}
+    }
+
+    if (map.base == MAP_FAILED)
+    {
+	map.length = (size + page - 1) / page * page;
+	map.base   = mmap (NULL, map.length, PROT_READ | PROT_WRITE,
+			   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (map.base == MAP_FAILED)
+	    return NULL;
+	map.p = map.base;
+    }
+
+    /* Fault in, so that the first bank does not */
+    for (off = 0; off < map.length; off += page)
+	((volatile char *)map.base)[off] = 0;
+
+    maps[i]         = map;
+    report->mapped += size;
+    return map.p;
+}
+
+void
+RRT_Unmap (void * p)
+{
+    int i;
+
+    if (p == NULL)
+	return;
+    for (i = 0; i < RRT_MAX_MAPS; i++)
+    {
+	if (maps[i].p == p)
+	{
+	    munmap (maps[i].base, maps[i].length);
+	    maps[i].p = NULL;
+	    return;
+	}
+    }
+}
+
+/* Grow the stack now rather than in the ray loop */
+static void __attribute__ ((noinline))
+prefault_stack (void)
+{
+    volatile char stack[RRT_STACK_PREFAULT];
+    size_t        i;
+
+    for (i = 0; i < sizeof (stack); i += 4096)
+	stack[i] = 0;
+}
+
+/* Transparent huge pages in use by the process, in bytes */
+static size_t
+anon_huge_pages (void)
+{
+    char   line[128];
+    size_t kb = 0;
+    FILE * fp = fopen ("/proc/self/smaps_rollup", "r");
+
+    while (fp != NULL && fgets (line, sizeof (line), fp) != NULL)
+    {
+	if (sscanf (line, "AnonHugePages: %zu kB", &kb) == 1)
+	    break;
+    }
+    if (fp != NULL)
+	fclose (fp);
+    return kb * 1024;
+}
+
+/*--------------------------------------------------------------------*
+ * RRT_Setup: lock memory, then pin the calling thread to its core    *
+ * and make it SCHED_FIFO, once the buffers are allocated and just    *
+ * before the ray loop                                                *
+ * RETURNS: 0 if everything asked for was achieved, otherwise -1 and  *
+ *          the report shows what was                                 *
+ *--------------------------------------------------------------------*/
+int
+RRT_Setup (const RRT_ConfigStruct * config,
+	   RRT_ReportStruct *       report)
+{
+    struct sched_param sp;
+    cpu_set_t          set;
+    int                status, result = 0;
+    int                n;
+
+    report->cpu = -1;
+    if (config->lock_memory)
+    {
+	/* MCL_CURRENT faults in everything mapped so far */
+	if (mlockall (MCL_CURRENT | MCL_FUTURE) == 0)
+	{
+	    report->memory_locked = 1;
+	}
+	else
+	{
+	    printf ("RRT: could not lock memory: %s\n", strerror (errno));
+	    result = -1;
+	}
+    }
+    prefault_stack ();
+
+    if (config->cpu >= 0)
+    {
+	CPU_ZERO (&set);
+	CPU_SET (config->cpu, &set);
+	status = pthread_setaffinity_np (pthread_self (), sizeof (set), &set);
+	if (status == 0)
+	{
+	    report->cpu = config->cpu;
+	}
+	else
+	{
+	    printf ("RRT: could not run on cpu %d: %s\n", config->cpu, strerror (status));
+	    result = -1;
+	}
+    }
+
+    if (config->priority > 0)
+    {
+	memset (&sp, 0, sizeof (sp));
+	sp.sched_priority = config->priority;
+	status = pthread_setschedparam (pthread_self (), SCHED_FIFO, &sp);
+	if (status == 0)
+	{
+	    report->priority = config->priority;
+	}
+	else
+	{
+	    printf ("RRT: could not run SCHED_FIFO %d: %s\n", config->priority, strerror (status));
+	    result = -1;
+	}
+    }
+
+    if (config->aux_cpus[0] != '\0' && report->aux_cpus == 0)
+	result = -1;
+    if (config->pages == RRT_PAGES_HUGETLB && report->hugetlb == 0 && report->mapped > 0)
+	result = -1;
+    report->thp = anon_huge_pages ();
+
+    n  = snprintf (report->summary, sizeof (report->summary), "ray loop ");
+    n += (report->cpu >= 0)
+	? snprintf (report->summary + n, sizeof (report->summary) - n, "on cpu %d", report->cpu)
+	: snprintf (report->summary + n, sizeof (report->summary) - n, "unpinned");
+    n += (report->priority > 0)
+	? snprintf (report->summary + n, sizeof (report->summary) - n, " SCHED_FIFO %d", report->priority)
+	: snprintf (report->summary + n, sizeof (report->summary) - n, " SCHED_OTHER");
+    n += (report->aux_cpus > 0)
+	? snprintf (report->summary + n, sizeof (report->summary) - n, ", other threads on cpus %s",
+		    config->aux_cpus)
+	: snprintf (report->summary + n, sizeof (report->summary) - n, ", other threads unpinned");
+    snprintf (report->summary + n, sizeof (report->summary) - n,
+	      ", memory %s, %.1f MiB buffers of which %.1f MiB hugetlb, %.1f MiB THP",
+	      report->memory_locked ? "locked" : "not locked",
+	      report->mapped / 1048576.0, report->hugetlb / 1048576.0, report->thp / 1048576.0);
+    return result;
+}
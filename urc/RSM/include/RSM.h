@@ -1,6 +1,8 @@
 #ifndef __RSM_H__
 #define __RSM_H__
 
+#include <stdint.h>
+
 #define USE_NETWORK_POSITION_MESSAGE
 
 /* data structure to hold a translated serial message */
@@ -15,8 +17,59 @@ typedef struct
     int     min;
     int     sec;
     int     centi_sec;
+    uint64_t time_ns;   /* CLOCK_MONOTONIC of the time above, 0 if unknown */
+    double   latency;   /* s from there to the message arriving, -1 if unknown */
 } RSM_PositionMessageStruct;
 
+/* the latest message, shared by a read thread and the main thread
+ * through a sequence count, so that neither waits for the other */
+typedef struct
+{
+    uint32_t                  sequence;   /* odd while being written */
+    int                       valid;
+    RSM_PositionMessageStruct msg;
+} RSM_LatestStruct;
+
+extern void RSM_LatestStore (RSM_LatestStruct * cell, const RSM_PositionMessageStruct * msg, int valid);
+extern int  RSM_LatestLoad  (const RSM_LatestStruct * cell, RSM_PositionMessageStruct * msg);
+
+/* where the antenna was at a time, kept by the read threads in a history */
+typedef struct
+{
+    uint64_t time_ns;   /* CLOCK_MONOTONIC when the antenna was there */
+    double   az;
+    double   el;
+    double   vel_az;    /* deg/s, 0 if the message carries no velocity */
+    double   vel_el;
+} RSM_PositionSampleStruct;
+
+#define RSM_HISTORY        256         /* samples, 5 s of 20 ms messages */
+#define RSM_EXTRAPOLATE_NS 100000000   /* how far past the newest sample */
+
+extern void RSM_PositionPush (const RSM_PositionSampleStruct * sample);
+extern int  RSM_PositionAt   (uint64_t t_ns, double * az, double * el);
+extern int  RSM_PositionMean (uint64_t t0_ns, uint64_t t1_ns, double * az, double * el);
+
+/* an angle window watched on the read thread, for the scan start and
+ * end: the main thread sleeps until the dish is inside or outside it,
+ * and the crossings are timed between the samples either side */
+#define RSM_AXIS_AZ 0
+#define RSM_AXIS_EL 1
+
+typedef struct
+{
+    int      inside;      /* 1 inside, 0 outside, -1 no sample yet */
+    int      entries;     /* crossings into the window since watched */
+    int      exits;       /* and out of it */
+    uint64_t entered_ns;  /* CLOCK_MONOTONIC of the last crossing into */
+    uint64_t left_ns;     /* and out of */
+} RSM_WindowStateStruct;
+
+extern void     RSM_WindowWatch  (int axis, double min_angle, double max_angle);
+extern uint32_t RSM_WindowState  (RSM_WindowStateStruct * state);
+extern int      RSM_WindowWait   (int inside, int timeout_ms, RSM_WindowStateStruct * state);
+extern void     RSM_WindowUpdate (const RSM_PositionSampleStruct * sample);
+
 extern int RSM_InitialiseSerialMessage (const char * serialport);
 extern int RSM_ReadSerialMessage (RSM_PositionMessageStruct * positionmessage);
 extern void RSM_CloseSerialMessage (void);
@@ -0,0 +1,74 @@
+#ifndef __RSM_NETWORKMESSAGE_H__
+#define __RSM_NETWORKMESSAGE_H__
+
+/*
+ * RSM_NetworkMessage.h
+ * The 20ms network position message of the antenna controller, as it is
+ * multicast, for the reader and for test senders.
+ */
+
+#include <stdint.h>
+
+#define RSM_NETWORK_PORT  12345
+#define RSM_NETWORK_GROUP "225.0.0.37"
+#define UDP_PADDING       12
+
+/* the message: the time is the controller's, azimuth in Chobs coordinates */
+typedef struct __attribute__ ((__packed__))
+{
+    char    header[UDP_PADDING];
+    int32_t type;
+    int32_t year;
+    int32_t month;
+    int32_t day;
+    int32_t hour;
+    int32_t min;
+    int32_t sec;
+    int32_t millisec;
+    double  az;
+    double  el;
+    char    status;
+    char    mode;
+    char    vel;
+    char    padding;
+    double  vel_az;
+    double  vel_el;
+    double  tg_pos_az;
+    double  tg_vel_az;
+    double  tg_acc_az;
+    int32_t tg_dem_mode_az;
+    int32_t tg_mode_az;
+    double  err_pos_az;
+    double  tg_pos_el;
+    double  tg_vel_el;
+    double  tg_acc_el;
+    int32_t tg_dem_mode_el;
+    int32_t tg_mode_el;
+    double  err_pos_el;
+    double  trq_m1;
+    double  trq_m2;
+    double  trq_m3;
+    double  trq_m4;
+    double  trq_m5;
+    double  trq_m6;
+    int32_t status_d1;
+    int32_t status_d2;
+    int32_t status_d3;
+    int32_t status_d4;
+    int32_t status_d5;
+    int32_t status_d6;
+    int32_t status_az;
+    int32_t status_el;
+    double  lim_soft_az_ccw;
+    double  lim_soft_az_cw;
+    double  lim_soft_el_low;
+    double  lim_soft_el_high;
+    double  vel_m1;
+    double  vel_m2;
+    double  vel_m3;
+    double  vel_m4;
+    double  vel_m5;
+    double  vel_m6;
+} RSM_NetworkPacketStruct;
+
+#endif /* !__RSM_NETWORKMESSAGE_H__ */
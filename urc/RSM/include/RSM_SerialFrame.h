@@ -0,0 +1,42 @@
+#ifndef __RSM_SERIALFRAME_H__
+#define __RSM_SERIALFRAME_H__
+
+/*
+ * RSM_SerialFrame.h
+ * Framed reader of a serial message stream, shared by RSM and REL: the
+ * messages are of a fixed length, each followed by a footer. Bytes are
+ * read many at a time into a ring, a message is taken as framed only
+ * between two footers, and after a bad frame the reader resynchronises on
+ * the next footer, without flushing what is buffered.
+ */
+
+#include <stdint.h>
+
+#define RSM_FRAME_RING   1024   /* bytes buffered, a power of 2 */
+#define RSM_FRAME_MAX    64     /* longest message */
+#define RSM_FRAME_FOOTER 4      /* longest footer */
+
+typedef struct
+{
+    int           fd;
+    int           length;                       /* of a message, without footer */
+    unsigned char footer[RSM_FRAME_FOOTER];
+    int           footer_length;
+
+    unsigned char ring[RSM_FRAME_RING];
+    uint64_t      head;                         /* bytes read */
+    uint64_t      tail;                         /* bytes parsed */
+    uint64_t      arrived_ns;                   /* CLOCK_MONOTONIC of the last read */
+    int           synced;                       /* tail is at a footer */
+
+    unsigned long frames;                       /* messages framed */
+    unsigned long errors;                       /* frames without a footer after them */
+    unsigned long skipped;                      /* bytes dropped to find a footer */
+} RSM_FrameStruct;
+
+extern void RSM_FrameInit (RSM_FrameStruct * frame, int fd, int length,
+			   const unsigned char * footer, int footer_length);
+extern int  RSM_FrameRead (RSM_FrameStruct * frame, unsigned char * message,
+			   uint64_t * time_ns, int timeout_ms);
+
+#endif /* !__RSM_SERIALFRAME_H__ */
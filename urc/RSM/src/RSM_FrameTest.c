@@ -0,0 +1,224 @@
+/*
+ * RSM_FrameTest.c
+ * Test of RSM_SerialFrame.c on a pseudo terminal: byte streams with
+ * leading noise, short and long messages and messages split across
+ * writes are replayed into the master side, and the frames read from the
+ * slave side must be the good messages, in order, with the bad ones
+ * counted. The serial position reader is then run on the same terminal.
+ *
+ *   RSM_FrameTest                        the built in streams
+ *   RSM_FrameTest file length footer     replay a captured stream, as
+ *                                        RSM_FrameTest capture 13 ffffff
+ * created on : 19/10/2026
+ */
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <RSM.h>
+#include <RSM_SerialFrame.h>
+
+#define LENGTH 13
+
+static const unsigned char footer[] = { 0xFF, 0xFF, 0xFF };
+
+static int failures = 0;
+
+static void
+check (const char * what,
+       long         value,
+       long         truth)
+{
+    printf ("%-40s %8ld truth %8ld %s\n", what, value, truth, (value == truth) ? "ok" : "FAIL");
+    failures += (value != truth);
+}
+
+/* the master and the raw slave of a new pseudo terminal */
+static int
+open_pty (int *  master,
+	  int *  slave,
+	  char * name)
+{
+    struct termios attributes;
+
+    *master = posix_openpt (O_RDWR | O_NOCTTY);
+    if (*master < 0 || grantpt (*master) != 0 || unlockpt (*master) != 0)
+	return -1;
+    strcpy (name, ptsname (*master));
+    *slave = open (name, O_RDWR | O_NOCTTY);
+    if (*slave < 0 || tcgetattr (*slave, &attributes) != 0)
+	return -1;
+    cfmakeraw (&attributes);
+    return tcsetattr (*slave, TCSANOW, &attributes);
+}
+
+/* a position message of the antenna, as the controller sends it */
+static void
+encode (unsigned char * m,
+	double          az,
+	double          el,
+	int             centi_sec)
+{
+    const unsigned int a = (unsigned int)((az + 90.0) * 480.0 + 0.5);
+    const unsigned int e = (unsigned int)((el < 0 ? -el : el) * 480.0 + 0.5);
+
+    m[0]  = (a >> 16) & 0x03;
+    m[1]  = (a >> 8) & 0xFF;
+    m[2]  = a & 0xFF;
+    m[3]  = ((e >> 16) & 0x03) | ((el < 0) ? 0x04 : 0);
+    m[4]  = (e >> 8) & 0xFF;
+    m[5]  = e & 0xFF;
+    m[6]  = 26;
+    m[7]  = 10;
+    m[8]  = 19;
+    m[9]  = 12;
+    m[10] = 0;
+    m[11] = 0;
+    m[12] = centi_sec;
+}
+
+static size_t
+append (unsigned char *       stream,
+	size_t                n,
+	const unsigned char * bytes,
+	size_t                count)
+{
+    memcpy (stream + n, bytes, count);
+    return n + count;
+}
+
+/* replay a captured stream and print its frames */
+static int
+replay (const char * file,
+	int          length,
+	const char * hex)
+{
+    unsigned char  foot[RSM_FRAME_FOOTER], message[RSM_FRAME_MAX], chunk[64];
+    RSM_FrameStruct frame;
+    char           name[64];
+    uint64_t       t, t0 = 0;
+    FILE *         fp;
+    size_t         n;
+    int            master, slave, nfoot, k;
+
+    for (nfoot = 0; nfoot < RSM_FRAME_FOOTER && sscanf (hex + 2 * nfoot, "%2hhx", &foot[nfoot]) == 1; nfoot++)
+	;
+    fp = fopen (file, "rb");
+    if (fp == NULL || nfoot == 0 || length <= 0 || length > RSM_FRAME_MAX ||
+	open_pty (&master, &slave, name) != 0)
+    {
+	printf ("Cannot replay %s\n", file);
+	return 1;
+    }
+    RSM_FrameInit (&frame, slave, length, foot, nfoot);
+    while ((n = fread (chunk, 1, sizeof (chunk), fp)) > 0)
+    {
+	if (write (master, chunk, n) != (ssize_t)n)
+	    break;
+	while (RSM_FrameRead (&frame, message, &t, 10) == 1)
+	{
+	    if (t0 == 0)
+		t0 = t;
+	    printf ("%10.6f", 1e-9 * (t - t0));
+	    for (k = 0; k < length; k++)
+		printf (" %02x", message[k]);
+	    printf ("\n");
+	}
+    }
+    printf ("%lu framed, %lu framing errors, %lu bytes skipped\n",
+	    frame.frames, frame.errors, frame.skipped);
+    fclose (fp);
+    return 0;
+}
+
+int
+main (int    argc,
+      char * argv[])
+{
+    unsigned char             stream[1024], m[LENGTH], message[LENGTH];
+    RSM_FrameStruct           frame;
+    RSM_PositionMessageStruct msg;
+    char                      name[64];
+    uint64_t                  t;
+    size_t                    n = 0, i;
+    int                       master, slave, k, good;
+
+    if (argc == 4)
+	return replay (argv[1], atoi (argv[2]), argv[3]);
+
+    if (open_pty (&master, &slave, name) != 0)
+    {
+	printf ("Cannot open a pseudo terminal\n");
+	return 1;
+    }
+
+    /* noise, a part of a message, then 3 good, a short one, 2 good,
+     * a long one and 2 good */
+    n = append (stream, n, (const unsigned char *)"\x12\xff\x34\xff\xff\x00", 6);
+    for (k = 0; k < 10; k++)
+    {
+	encode (m, 10.0 * k, 1.0 - 0.5 * k, k);
+	n = append (stream, n, footer, sizeof (footer));
+	if (k == 3)
+	    n = append (stream, n, m, LENGTH - 1);
+	else if (k == 6)
+	    n = append (stream, n, (const unsigned char *)"\x00", 1), n = append (stream, n, m, LENGTH);
+	else
+	    n = append (stream, n, m, LENGTH);
+    }
+    n = append (stream, n, footer, sizeof (footer));
+
+    /* one write, the stream was read as one */
+    RSM_FrameInit (&frame, slave, LENGTH, footer, sizeof (footer));
+    if (write (master, stream, n) != (ssize_t)n)
+	return 1;
+    for (good = k = 0; k < 10; k++)
+    {
+	if (k == 3 || k == 6)
+	    continue;
+	encode (m, 10.0 * k, 1.0 - 0.5 * k, k);
+	if (RSM_FrameRead (&frame, message, &t, 100) == 1 && memcmp (m, message, LENGTH) == 0)
+	    good++;
+    }
+    check ("good messages in one write", good, 8);
+    check ("framing errors", frame.errors, 2);
+    check ("no more messages", RSM_FrameRead (&frame, message, &t, 50), 0);
+
+    /* the same, a byte at a time */
+    RSM_FrameInit (&frame, slave, LENGTH, footer, sizeof (footer));
+    for (i = 0; i < n; i++)
+    {
+	if (write (master, &stream[i], 1) != 1)
+	    return 1;
+	while (RSM_FrameRead (&frame, message, &t, 0) == 1)
+	    ;
+    }
+    check ("good messages a byte at a time", frame.frames, 8);
+    check ("framing errors", frame.errors, 2);
+
+    /* the position reader on the terminal */
+    if (RSM_InitialiseSerialMessage (name) != 0)
+	return 1;
+    encode (m, 123.25, -2.5, 42);
+    n = append (stream, 0, footer, sizeof (footer));
+    n = append (stream, n, m, LENGTH);
+    n = append (stream, n, footer, sizeof (footer));
+    if (write (master, stream, n) != (ssize_t)n)
+	return 1;
+    usleep (50000);
+    check ("reader finds the message", RSM_ReadSerialMessage (&msg), 1);
+    check ("azimuth x 100", (long)(msg.az * 100.0 + 0.5), 12325);
+    check ("elevation x 100", (long)(msg.el * 100.0 - 0.5), -250);
+    check ("centiseconds", msg.centi_sec, 42);
+    usleep (200000);
+    check ("reader loses it without messages", RSM_ReadSerialMessage (&msg), 0);
+    RSM_CloseSerialMessage ();
+
+    printf ("%s\n", failures ? "FAILED" : "PASSED");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,172 @@
+/*
+ * RSM_HistoryTest.c
+ * Test of RSM_PositionHistory.c: a scan at a known rate is pushed as
+ * 20 ms messages, and the positions and means read back must follow it,
+ * across the 0/360 wrap, past the newest message, and while a thread
+ * keeps pushing. A window watched on the azimuth must time the scan's
+ * crossings of its edges, and wake a thread waiting for the dish.
+ * created on : 19/10/2026
+ */
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+
+#include <RSM.h>
+
+#define PERIOD_NS 20000000ull    /* between messages */
+#define RATE      12.0           /* deg/s of the scan */
+#define START_NS  1000000000000ull
+
+static int failures = 0;
+
+static void
+check (const char * what,
+       double       value,
+       double       truth,
+       double       bound)
+{
+    const int fail = !(fabs (value - truth) <= bound);
+
+    printf ("%-40s %10.4f truth %10.4f %s\n", what, value, truth, fail ? "FAIL" : "ok");
+    failures += fail;
+}
+
+/* azimuth of the scan at t, in [-90, 270) as the network message has it */
+static double
+scan_az (uint64_t t)
+{
+    return fmod (300.0 + RATE * 1e-9 * (double)(t - START_NS), 360.0) - 90.0;
+}
+
+static void
+push (int n)
+{
+    RSM_PositionSampleStruct s;
+
+    s.time_ns = START_NS + (uint64_t)n * PERIOD_NS;
+    s.az      = scan_az (s.time_ns);
+    s.el      = 5.0 + 0.01 * n;
+    s.vel_az  = RATE;
+    s.vel_el  = 0.01 / (1e-9 * PERIOD_NS);
+    RSM_PositionPush (&s);
+}
+
+static volatile int stop;
+static volatile int newest;
+
+static void *
+writer (void * arg)
+{
+    int n = *(int *)arg;
+
+    while (!stop)
+    {
+	push (n);
+	newest = n++;
+    }
+    return NULL;
+}
+
+int
+main (void)
+{
+    RSM_WindowStateStruct window;
+    double                az, el, truth;
+    uint64_t              t;
+    int                   n, i, bad, read;
+    pthread_t             thread;
+
+    /* nothing pushed yet */
+    check ("empty history fails", RSM_PositionAt (START_NS, &az, &el), -1, 0);
+
+    for (n = 0; n < 600; n++)
+	push (n);
+
+    /* the newest 256 of 600 are kept: n from 344 */
+    t = START_NS + 500 * PERIOD_NS + PERIOD_NS / 4;
+    RSM_PositionAt (t, &az, &el);
+    check ("az between messages", az, scan_az (t), 1e-6);
+    check ("el between messages", el, 5.0 + 0.01 * 500.25, 1e-6);
+
+    t = START_NS + 599 * PERIOD_NS + 50000000ull;
+    RSM_PositionAt (t, &az, &el);
+    check ("az 50 ms past the newest", az, scan_az (t), 1e-6);
+    check ("200 ms past the newest fails",
+	   RSM_PositionAt (t + 150000000ull, &az, &el), -1, 0);
+    check ("older than the history fails",
+	   RSM_PositionAt (START_NS + 300 * PERIOD_NS, &az, &el), -1, 0);
+
+    /* a message stamped 5 ms before the newest, as when the clock offset
+     * steps back, is kept after it: the path and means stay in order */
+    {
+	RSM_PositionSampleStruct s;
+
+	s.time_ns = START_NS + 599 * PERIOD_NS - 5000000ull;
+	s.az      = scan_az (START_NS + 599 * PERIOD_NS);
+	s.el      = 5.0 + 0.01 * 599;
+	s.vel_az  = RATE;
+	s.vel_el  = 0.01 / (1e-9 * PERIOD_NS);
+	RSM_PositionPush (&s);
+    }
+    t = START_NS + 598 * PERIOD_NS;
+    RSM_PositionMean (t, t + 2 * PERIOD_NS, &az, &el);
+    check ("mean az over an out of order push", az, scan_az (t + PERIOD_NS), 1e-6);
+    check ("mean el over an out of order push", el, 5.0 + 0.01 * 599.0, 1e-6);
+    t = START_NS + 599 * PERIOD_NS + PERIOD_NS / 2;
+    RSM_PositionAt (t, &az, &el);
+    check ("az past an out of order push", az, scan_az (t), 1e-6);
+
+    /* 300 + 12 * 0.02 n wraps at n = 250 and 1750: a mean across the
+     * second, and a window entered across it, at 270.1 = -89.9 */
+    for (; n < 1700; n++)
+	push (n);
+    RSM_WindowWatch (RSM_AXIS_AZ, -89.9, -60.0);
+    for (; n < 1800; n++)
+	push (n);
+    RSM_WindowState (&window);
+    check ("window entries across 0/360", window.entries, 1, 0);
+    check ("window entered across 0/360, s", 1e-9 * (window.entered_ns - START_NS),
+	   35.0 + 0.1 / RATE, 1e-6);
+    t = START_NS + 1740 * PERIOD_NS;
+    RSM_PositionMean (t, t + 1000000000ull, &az, &el);
+    truth = scan_az (t + 500000000ull);
+    check ("mean az over 1 s across 0/360", az, truth, 1e-6);
+    check ("mean el over 1 s", el, 5.0 + 0.01 * 1765.0, 1e-6);
+
+    /* 300 + 12 * 0.02 n reaches 90 at n = 2125 and 180 at n = 2500 */
+    RSM_WindowWatch (RSM_AXIS_AZ, 0.0, 90.0);
+    for (; n < 2600; n++)
+	push (n);
+    RSM_WindowState (&window);
+    check ("window entries", window.entries, 1, 0);
+    check ("window exits", window.exits, 1, 0);
+    check ("window entered at, s", 1e-9 * (window.entered_ns - START_NS), 42.5, 1e-6);
+    check ("window left at, s", 1e-9 * (window.left_ns - START_NS), 50.0, 1e-6);
+    check ("wait for outside", RSM_WindowWait (0, 0, &window), 1, 0);
+    check ("wait for inside times out", RSM_WindowWait (1, 50, &window), 0, 0);
+
+    /* a reader racing the writer sees a consistent path, once woken by
+     * the writer bringing the dish into the window again */
+    RSM_WindowWatch (RSM_AXIS_AZ, 0.0, 90.0);
+    pthread_create (&thread, NULL, writer, &n);
+    check ("woken inside the window", RSM_WindowWait (1, 5000, &window), 1, 0);
+    for (i = bad = read = 0; i < 100000; i++)
+    {
+	/* just inside the oldest end of the history, where it is overwritten */
+	t = START_NS + (uint64_t)(newest - RSM_HISTORY + 2) * PERIOD_NS + PERIOD_NS / 2;
+	if (RSM_PositionAt (t, &az, &el) == 0)
+	{
+	    read++;
+	    if (fabs (el - (5.0 + 1e-9 * (t - START_NS) / 2.0)) > 1e-6)
+		bad++;
+	}
+    }
+    stop = 1;
+    pthread_join (thread, NULL);
+    printf ("%d of 100000 reads inside the history\n", read);
+    check ("torn reads while pushing", bad, 0, 0);
+
+    printf ("%s\n", failures ? "FAILED" : "PASSED");
+    return failures ? 1 : 0;
+}
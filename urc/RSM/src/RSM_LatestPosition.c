@@ -0,0 +1,60 @@
+/*
+ * RSM_LatestPosition.c
+ * The latest position message, written by the message read thread and
+ * read by the main thread without either waiting for the other: the
+ * writer bumps a sequence count around each update, and a reader that
+ * sees the count odd or changed under it copies again.
+ * created on : 19/10/2026
+ */
+
+#include <string.h>
+
+#include <RSM.h>
+
+#if defined (__x86_64__) || defined (__i386__)
+#define cpu_relax() __builtin_ia32_pause ()
+#else
+#define cpu_relax() ((void) 0)
+#endif
+
+/*--------------------------------------------------------------------*
+ * RSM_LatestStore: from the one read thread only                     *
+ *--------------------------------------------------------------------*/
+void
+RSM_LatestStore (RSM_LatestStruct *                cell,
+		 const RSM_PositionMessageStruct * msg,
+		 int                               valid)
+{
+    const uint32_t seq = __atomic_load_n (&cell->sequence, __ATOMIC_RELAXED);
+
+    __atomic_store_n (&cell->sequence, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence (__ATOMIC_RELEASE);
+    memcpy (&cell->msg, msg, sizeof (*msg));
+    cell->valid = valid;
+    __atomic_store_n (&cell->sequence, seq + 2, __ATOMIC_RELEASE);
+}
+
+/*--------------------------------------------------------------------*
+ * RSM_LatestLoad: a consistent copy of the latest message            *
+ * OUT: msg  the message, also when it is not valid                   *
+ * RETURNS: 1 if the message is valid, 0 if not                       *
+ *--------------------------------------------------------------------*/
+int
+RSM_LatestLoad (const RSM_LatestStruct *    cell,
+		RSM_PositionMessageStruct * msg)
+{
+    uint32_t seq;
+    int      valid;
+
+    do
+    {
+	while ((seq = __atomic_load_n (&cell->sequence, __ATOMIC_ACQUIRE)) & 1)
+	    cpu_relax ();
+	memcpy (msg, &cell->msg, sizeof (*msg));
+	valid = cell->valid;
+	__atomic_thread_fence (__ATOMIC_ACQUIRE);
+    }
+    while (__atomic_load_n (&cell->sequence, __ATOMIC_RELAXED) != seq);
+
+    return valid;
+}
@@ -4,11 +4,19 @@
  * network message
  * created by : Owain Davies
  * created on : 15/04/2004
+ *
+ * The messages are received in batches, each with the time the kernel
+ * received it. The controller stamps each message with its own clock, so
+ * the least delay between the two over the last RSM_CLOCK_WINDOW messages
+ * gives the offset of that clock, taking the fastest message to have
+ * arrived RSM_LATENCY_NS after the antenna was where it says. A message
+ * is then timed by the controller's clock plus the offset, and its
+ * latency is from there to its arrival.
  */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <pthread.h>
-#include <semaphore.h>
 #include <termios.h>
 #include <fcntl.h>
 #include <unistd.h>
@@ -21,99 +29,158 @@
 #include <string.h>
 
 #include <RSM.h>
+#include <RSM_NetworkMessage.h>
 
 /* definitions */
-#define HELLO_PORT 12345
-#define HELLO_GROUP "225.0.0.37"
-#define UDP_PADDING 12
-
-/* data structure to hold a translated serial message */
-typedef struct __attribute__ ((__packed__))
-{
-    char    header[UDP_PADDING];
-    int32_t type;
-    int32_t year;
-    int32_t month;
-    int32_t day;
-    int32_t hour;
-    int32_t min;
-    int32_t sec;
-    int32_t millisec;
-    double  az;
-    double  el;
-    char    status;
-    char    mode;
-    char    vel;
-    char    padding;
-    double  vel_az;
-    double  vel_el;
-    double  tg_pos_az;
-    double  tg_vel_az;
-    double  tg_acc_az;
-    int32_t tg_dem_mode_az;
-    int32_t tg_mode_az;
-    double  err_pos_az;
-    double  tg_pos_el;
-    double  tg_vel_el;
-    double  tg_acc_el;
-    int32_t tg_dem_mode_el;
-    int32_t tg_mode_el;
-    double  err_pos_el;
-    double  trq_m1;
-    double  trq_m2;
-    double  trq_m3;
-    double  trq_m4;
-    double  trq_m5;
-    double  trq_m6;
-    int32_t status_d1;
-    int32_t status_d2;
-    int32_t status_d3;
-    int32_t status_d4;
-    int32_t status_d5;
-    int32_t status_d6;
-    int32_t status_az;
-    int32_t status_el;
-    double  lim_soft_az_ccw;
-    double  lim_soft_az_cw;
-    double  lim_soft_el_low;
-    double  lim_soft_el_high;
-    double  vel_m1;
-    double  vel_m2;
-    double  vel_m3;
-    double  vel_m4;
-    double  vel_m5;
-    double  vel_m6;
-} TY_SERIALMSG_MSG;
+#define HELLO_PORT RSM_NETWORK_PORT
+#define HELLO_GROUP RSM_NETWORK_GROUP
+#define RSM_LATENCY_NS 20000000 /* age of the fastest message when it arrives */
+#define RSM_BATCH 16            /* messages per recvmmsg */
+#define RSM_CLOCK_WINDOW 250    /* messages, 5 s, for the clock offset */
 
 /* global variables */
 
 /* file descriptor for the network port */
 static int	networkport_fd = -1;
 
-/* 'sm_buffer_semaphore' is a semaphore created during initialisation that is
- * used to control shared access to the receive buffer and its associated
- * valid flag. Access to this buffer and flag is shared by the main thread
- * and the read thread.
- */
-static sem_t	sm_buffer_semaphore;
-
 /* 'sm_read_thread' is a thread created during initialisation that continuously
  * reads the network message.
  */
 static pthread_t        sm_read_thread;
 
-/* 'sm_buffer' is the receive buffer that is used to store the network message
+/* 'sm_latest' is the latest network message, written by the read thread
+ * and read by the main thread without locking.
  */
-static TY_SERIALMSG_MSG sm_buffer;
+static RSM_LatestStruct sm_latest;
 
-/* 'sm_buffer_valid' is a flag that indicates if the receive buffer contains a
- * valid message.
- */
-static int             sm_buffer_valid = 0;
+/* the clock of the controller, kept by the read thread */
+static int64_t       delays[ RSM_CLOCK_WINDOW ];  /* kernel receive less controller time */
+static unsigned long n_delays;
+static int64_t       clock_offset_ns;             /* local less controller time */
+static unsigned long messages, batches, untimed;
+static double        latency_sum, latency_max;
+
+/* the kernel receive time of a message, CLOCK_REALTIME in ns */
+static int64_t receive_time(struct msghdr *hdr)
+{
+	struct cmsghdr *cmsg;
+	struct timespec ts;
+
+	for (cmsg = CMSG_FIRSTHDR (hdr); cmsg != NULL; cmsg = CMSG_NXTHDR (hdr, cmsg))
+	{
+		if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS)
+		{
+			memcpy (&ts, CMSG_DATA (cmsg), sizeof (ts));
+			return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+		}
+	}
+	/* no timestamp: now will do */
+	untimed++;
+	clock_gettime (CLOCK_REALTIME, &ts);
+	return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* the local time, CLOCK_REALTIME in ns, of the controller's sample, and
+ * its latency in s, -1 if the controller's clock cannot be used */
+static int64_t sample_time(const RSM_NetworkPacketStruct *packet, int64_t rx_ns,
+			   double *latency)
+{
+	struct tm tm;
+	int64_t ctrl_ns, delay, least;
+	unsigned long i, n;
+
+	memset (&tm, 0, sizeof (tm));
+	tm.tm_year = packet->year - 1900;
+	tm.tm_mon  = packet->month - 1;
+	tm.tm_mday = packet->day;
+	tm.tm_hour = packet->hour;
+	tm.tm_min  = packet->min;
+	tm.tm_sec  = packet->sec;
+	ctrl_ns = (int64_t)timegm (&tm) * 1000000000 + (int64_t)packet->millisec * 1000000;
+	delay   = rx_ns - ctrl_ns;
+	if (packet->year < 2000 || delay > 86400000000000LL || delay < -86400000000000LL)
+	{
+		/* as the messages were timed before */
+		*latency = -1.0;
+		return rx_ns - RSM_LATENCY_NS;
+	}
+
+	delays[n_delays++ % RSM_CLOCK_WINDOW] = delay;
+	n = (n_delays < RSM_CLOCK_WINDOW) ? n_delays : RSM_CLOCK_WINDOW;
+	for (least = delay, i = 0; i < n; i++)
+		if (delays[i] < least)
+			least = delays[i];
+	clock_offset_ns = least - RSM_LATENCY_NS;
+
+	*latency = 1e-9 * (double)(delay - clock_offset_ns);
+	latency_sum += *latency;
+	if (*latency > latency_max)
+		latency_max = *latency;
+	return ctrl_ns + clock_offset_ns;
+}
 
+/* keep a message received at rx_ns */
+static void receive(RSM_NetworkPacketStruct *rxbuffer, int64_t rx_ns)
+{
+	struct tm tm;
+	struct timespec mono, real;
+	int64_t sample_ns;
+	double latency;
+	time_t sec;
+	RSM_PositionSampleStruct sample;
+	RSM_PositionMessageStruct msg;
+
+	rxbuffer->az -= 90.0; /* Adjust from Chobs coordinates */
+	messages++;
+
+	sample_ns = sample_time (rxbuffer, rx_ns, &latency);
+	clock_gettime (CLOCK_MONOTONIC, &mono);
+	clock_gettime (CLOCK_REALTIME, &real);
+
+	/* Keep it in the history, on the monotonic clock */
+	sample.time_ns = (uint64_t)mono.tv_sec * 1000000000u + mono.tv_nsec
+		- ((int64_t)real.tv_sec * 1000000000 + real.tv_nsec - sample_ns);
+	sample.az      = rxbuffer->az;
+	sample.el      = rxbuffer->el;
+	sample.vel_az  = rxbuffer->vel_az;
+	sample.vel_el  = rxbuffer->vel_el;
+	RSM_PositionPush (&sample);
+
+	/* The time of the message is when the antenna was there */
+	sec = sample_ns / 1000000000;
+	gmtime_r (&sec, &tm);
+
+	msg.az        = rxbuffer->az;
+	msg.el        = rxbuffer->el;
+	msg.year      = tm.tm_year + 1900;
+	msg.month     = tm.tm_mon + 1;
+	msg.day       = tm.tm_mday;
+	msg.hour      = tm.tm_hour;
+	msg.min       = tm.tm_min;
+	msg.sec       = tm.tm_sec;
+	msg.centi_sec = sample_ns % 1000000000 / 10000000;
+	msg.time_ns   = sample.time_ns;
+	msg.latency   = latency;
+	RSM_LatestStore (&sm_latest, &msg, 1);
+}
 
 static void *read_thread(void *arg)
 {
+	RSM_NetworkPacketStruct rxbuffer[RSM_BATCH];
+	struct mmsghdr msgs[RSM_BATCH];
+	struct iovec iov[RSM_BATCH];
+	char control[RSM_BATCH][CMSG_SPACE (sizeof (struct timespec))];
+	int i;
+
+	memset (msgs, 0, sizeof (msgs));
+	for (i = 0; i < RSM_BATCH; i++) {
+		iov[i].iov_base = &rxbuffer[i];
+		iov[i].iov_len  = sizeof (rxbuffer[i]);
+		msgs[i].msg_hdr.msg_iov     = &iov[i];
+		msgs[i].msg_hdr.msg_iovlen  = 1;
+		msgs[i].msg_hdr.msg_control = control[i];
+	}
+
 	while (1) {
 		int status;
 		fd_set ipset;
@@ -128,38 +195,19 @@ static void *read_thread(void *arg)
 		if (status < 0) break;
 		if (status > 0 && FD_ISSET (networkport_fd, &ipset))
 		{
-			TY_SERIALMSG_MSG rxbuffer;
-
-			status = recv (networkport_fd, &rxbuffer, sizeof (rxbuffer), 0);
-			if (status == sizeof (rxbuffer) &&
-			    (rxbuffer.type == 0 || rxbuffer.type == 1) &&
-			    !strcmp (rxbuffer.header, "POSITION"))
+			/* all the messages waiting, oldest first */
+			for (i = 0; i < RSM_BATCH; i++)
+				msgs[i].msg_hdr.msg_controllen = sizeof (control[i]);
+			status = recvmmsg (networkport_fd, msgs, RSM_BATCH, MSG_DONTWAIT, NULL);
+			if (status <= 0) continue;
+			batches++;
+
+			for (i = 0; i < status; i++)
 			{
-				struct tm tm;
-				struct timeval tv;
-				struct timeval tvl = { 0U, 20000U };
-				struct timeval tva;
-
-				rxbuffer.az -= 90.0; /* Adjust from Chobs coordinates */
-
-				/* Fixup time because PLC time is not good */
-				gettimeofday (&tv, NULL);
-				timersub (&tv, &tvl, &tva); /* Adjust for 20ms latency */
-				gmtime_r (&tva.tv_sec, &tm);
-
-				rxbuffer.year     = tm.tm_year + 1900;
-				rxbuffer.month    = tm.tm_mon + 1;
-				rxbuffer.day      = tm.tm_mday;
-				rxbuffer.hour     = tm.tm_hour;
-				rxbuffer.min      = tm.tm_min;
-				rxbuffer.sec      = tm.tm_sec;
-				rxbuffer.millisec = tva.tv_usec / 1000U;
-
-				/* copy over the network message, but first set the semaphore */
-				sem_wait( &sm_buffer_semaphore );
-				memcpy (&sm_buffer, &rxbuffer, sizeof (rxbuffer));
-				sm_buffer_valid = 1;
-				sem_post( &sm_buffer_semaphore );
+				if (msgs[i].msg_len == sizeof (rxbuffer[i]) &&
+				    (rxbuffer[i].type == 0 || rxbuffer[i].type == 1) &&
+				    !strcmp (rxbuffer[i].header, "POSITION"))
+					receive (&rxbuffer[i], receive_time (&msgs[i].msg_hdr));
 			}
 		}
 	}
@@ -173,7 +221,9 @@ int RSM_InitialiseNetworkMessage(void)
 	struct ip_mreqn mreq;
 	u_int yes=1;
 
-	memset (&sm_buffer, 0, sizeof (sm_buffer));
+	memset (&sm_latest, 0, sizeof (sm_latest));
+	n_delays = messages = batches = untimed = 0;
+	latency_sum = latency_max = 0.0;
 
 	printf("Opening network port: %s:%u\n", HELLO_GROUP, HELLO_PORT);
 	networkport_fd = socket(AF_INET,SOCK_DGRAM,0);
@@ -204,6 +254,12 @@ int RSM_InitialiseNetworkMessage(void)
 	    return -1;
 	}
 
+	/* the kernel's receive time with every message */
+	if (setsockopt(networkport_fd,SOL_SOCKET,SO_TIMESTAMPNS,&yes,sizeof(yes)) < 0)
+	{
+	    perror("Receive timestamps failed");
+	}
+
 	/* use setsockopt() to request that the kernel join a multicast group */
 	mreq.imr_multiaddr.s_addr=inet_addr(HELLO_GROUP);
 	mreq.imr_address.s_addr=htonl(INADDR_ANY);
@@ -214,14 +270,6 @@ int RSM_InitialiseNetworkMessage(void)
 	    return -1;
 	}
 
-	/* create a semaphore to control shared access to the network message buffer */
-	if ( sem_init(&sm_buffer_semaphore, 0, 1) == -1){
-		printf("There has been a problem creating the network message buffer semaphore\n");
-		setsockopt(networkport_fd,IPPROTO_IP,IP_DROP_MEMBERSHIP,&mreq,sizeof(mreq));
-		close( networkport_fd);
-		return (-1);
-	}
-
 	/* create a new thread that continuously reads network messages */
 	if ( pthread_create( &sm_read_thread, NULL, read_thread, NULL)) {
 		printf("There has been a problem with creating the read_thread thread\n");
@@ -234,30 +282,13 @@ int RSM_InitialiseNetworkMessage(void)
 
 int RSM_ReadNetworkMessage ( RSM_PositionMessageStruct *networkmessage)
 {
-	int valid;
-
-	/* read the networkmessage buffer, but first set the semaphore */
-	sem_wait(&sm_buffer_semaphore);
-	valid = sm_buffer_valid;
-	if (valid)
-	{
-	    networkmessage->az        = sm_buffer.az;
-	    networkmessage->el        = sm_buffer.el;
-	    networkmessage->year      = sm_buffer.year;
-	    networkmessage->month     = sm_buffer.month;
-	    networkmessage->day       = sm_buffer.day;
-	    networkmessage->hour      = sm_buffer.hour;
-	    networkmessage->min       = sm_buffer.min;
-	    networkmessage->sec       = sm_buffer.sec;
-	    networkmessage->centi_sec = sm_buffer.millisec / 10;
-	}
-	else
+	/* read the latest network message, without waiting for the read thread */
+	if (!RSM_LatestLoad (&sm_latest, networkmessage))
 	{
 	    memset (networkmessage, 0, sizeof (RSM_PositionMessageStruct));
+	    return 0;
 	}
-	sem_post(&sm_buffer_semaphore);
-
-	return valid ? 1 : 0;
+	return 1;
 }
 
 void RSM_CloseNetworkMessage (void)
@@ -265,7 +296,12 @@ void RSM_CloseNetworkMessage (void)
 	struct ip_mreqn mreq;
 
 	pthread_cancel( sm_read_thread );
-	sem_destroy( &sm_buffer_semaphore );
+	pthread_join( sm_read_thread, NULL );
+	printf("Network messages: %lu in %lu batches, %lu without a receive time\n",
+	       messages, batches, untimed);
+	if (n_delays > 0)
+		printf("Controller clock %+.3f s from ours, latency mean %.1f ms, max %.1f ms\n",
+		       -1e-9 * clock_offset_ns, 1e3 * latency_sum / n_delays, 1e3 * latency_max);
 
 	/* use setsockopt() to request that the kernel leave a multicast group */
 	mreq.imr_multiaddr.s_addr=inet_addr(HELLO_GROUP);
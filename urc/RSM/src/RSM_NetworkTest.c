@@ -0,0 +1,233 @@
+/*
+ * RSM_NetworkTest.c
+ * Test of RSM_NetworkMessage.c on the loopback: a thread multicasts
+ * position messages stamped by a controller clock that is off from ours,
+ * each sent a jittered time after its sample, and the times the reader
+ * gives the messages must be those of the samples, with the latencies of
+ * the sends as measured by the sender.
+ *
+ *   RSM_NetworkTest                        the test
+ *   RSM_NetworkTest -send rate az0 seconds send a scan for the recorder,
+ *                                          at rate deg/s from az0
+ * created on : 19/10/2026
+ */
+
+#define _GNU_SOURCE
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <RSM.h>
+#include <RSM_NetworkMessage.h>
+
+#define MESSAGES  60
+#define PERIOD_NS 40000000ll     /* between samples of the test */
+#define SKEW_NS   -2345000000ll  /* controller less our clock */
+#define LATENCY_NS 20000000ll    /* least of the sends */
+
+static int failures = 0;
+
+/* the sender's */
+static int64_t sampled_ns[ MESSAGES ];   /* CLOCK_MONOTONIC of the samples */
+static int64_t jitter_ns[ MESSAGES ];    /* sent after LATENCY_NS more */
+static int64_t sent_ns[ MESSAGES ];      /* CLOCK_MONOTONIC of the sends */
+
+static void
+check (const char * what,
+       double       value,
+       double       truth,
+       double       bound)
+{
+    const int fail = !(fabs (value - truth) <= bound);
+
+    printf ("%-40s %10.4f truth %10.4f %s\n", what, value, truth, fail ? "FAIL" : "ok");
+    failures += fail;
+}
+
+static int64_t
+now_ns (clockid_t clock)
+{
+    struct timespec ts;
+
+    clock_gettime (clock, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void
+sleep_ns (int64_t ns)
+{
+    struct timespec ts;
+
+    if (ns <= 0)
+	return;
+    ts.tv_sec  = ns / 1000000000;
+    ts.tv_nsec = ns % 1000000000;
+    nanosleep (&ts, NULL);
+}
+
+/* a message of the antenna at az, el, stamped with the controller time */
+static void
+encode (RSM_NetworkPacketStruct * p,
+	double                    az,
+	double                    el,
+	double                    rate,
+	int64_t                   ctrl_ns)
+{
+    const time_t sec = ctrl_ns / 1000000000;
+    struct tm    tm;
+
+    gmtime_r (&sec, &tm);
+    memset (p, 0, sizeof (*p));
+    strcpy (p->header, "POSITION");
+    p->year     = tm.tm_year + 1900;
+    p->month    = tm.tm_mon + 1;
+    p->day      = tm.tm_mday;
+    p->hour     = tm.tm_hour;
+    p->min      = tm.tm_min;
+    p->sec      = tm.tm_sec;
+    p->millisec = ctrl_ns % 1000000000 / 1000000;
+    p->az       = az + 90.0;        /* to Chobs coordinates */
+    p->el       = el;
+    p->vel_az   = rate;
+}
+
+static int
+open_sender (struct sockaddr_in * addr)
+{
+    unsigned char ttl = 1, loop = 1;
+    int           fd  = socket (AF_INET, SOCK_DGRAM, 0);
+
+    if (fd < 0)
+	return -1;
+    setsockopt (fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof (ttl));
+    setsockopt (fd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof (loop));
+    memset (addr, 0, sizeof (*addr));
+    addr->sin_family      = AF_INET;
+    addr->sin_addr.s_addr = inet_addr (RSM_NETWORK_GROUP);
+    addr->sin_port        = htons (RSM_NETWORK_PORT);
+    return fd;
+}
+
+/* the controller: message k is at azimuth k, sent late by its jitter */
+static void *
+sender (void * arg)
+{
+    RSM_NetworkPacketStruct p;
+    struct sockaddr_in      addr;
+    int64_t                 start, ctrl;
+    int                     fd = open_sender (&addr), k;
+
+    (void)arg;
+    if (fd < 0)
+	return NULL;
+    start = now_ns (CLOCK_MONOTONIC);
+    for (k = 0; k < MESSAGES; k++)
+    {
+	sleep_ns (start + k * PERIOD_NS - now_ns (CLOCK_MONOTONIC));
+	sampled_ns[k] = now_ns (CLOCK_MONOTONIC);
+	ctrl          = now_ns (CLOCK_REALTIME) + SKEW_NS;
+	encode (&p, k, 1.0, 0.0, ctrl);
+
+	/* every fifth message as fast as the controller can be */
+	jitter_ns[k] = (k % 5 == 0) ? 0 : (k * 7919 % 13) * 1000000ll;
+	sleep_ns (sampled_ns[k] + LATENCY_NS + jitter_ns[k] - now_ns (CLOCK_MONOTONIC));
+	sent_ns[k] = now_ns (CLOCK_MONOTONIC);
+	sendto (fd, &p, sizeof (p), 0, (struct sockaddr *)&addr, sizeof (addr));
+    }
+    close (fd);
+    return NULL;
+}
+
+/* a scan for the recorder, stamped by our clock, every 20 ms */
+static int
+send_scan (double rate,
+	   double az0,
+	   double seconds)
+{
+    RSM_NetworkPacketStruct p;
+    struct sockaddr_in      addr;
+    const int64_t           start = now_ns (CLOCK_MONOTONIC);
+    int64_t                 t;
+    int                     fd = open_sender (&addr), k;
+
+    if (fd < 0)
+    {
+	perror ("socket");
+	return 1;
+    }
+    for (k = 0; (t = k * 20000000ll) < (int64_t)(seconds * 1e9); k++)
+    {
+	sleep_ns (start + t - now_ns (CLOCK_MONOTONIC));
+	encode (&p, fmod (az0 + rate * 1e-9 * t + 450.0, 360.0) - 90.0, 1.0, rate,
+		now_ns (CLOCK_REALTIME));
+	sendto (fd, &p, sizeof (p), 0, (struct sockaddr *)&addr, sizeof (addr));
+    }
+    close (fd);
+    return 0;
+}
+
+int
+main (int    argc,
+      char * argv[])
+{
+    RSM_PositionMessageStruct msg;
+    pthread_t                 thread;
+    uint64_t                  timed[ MESSAGES ];
+    double                    latency[ MESSAGES ], error, worst_error = 0.0, worst_latency = 0.0;
+    int64_t                   end;
+    int                       k, seen = 0;
+
+    if (argc == 5 && strcmp (argv[1], "-send") == 0)
+	return send_scan (atof (argv[2]), atof (argv[3]), atof (argv[4]));
+
+    if (RSM_InitialiseNetworkMessage () != 0)
+	return 1;
+    memset (timed, 0, sizeof (timed));
+    pthread_create (&thread, NULL, sender, NULL);
+
+    /* the reader's time of each message, by its azimuth */
+    end = now_ns (CLOCK_MONOTONIC) + MESSAGES * PERIOD_NS + 500000000ll;
+    while (now_ns (CLOCK_MONOTONIC) < end)
+    {
+	if (RSM_ReadNetworkMessage (&msg) == 1)
+	{
+	    k = (int)floor (msg.az + 0.5);
+	    if (k >= 0 && k < MESSAGES && timed[k] == 0)
+	    {
+		timed[k]   = msg.time_ns;
+		latency[k] = msg.latency;
+		seen++;
+	    }
+	}
+	usleep (1000);
+    }
+    pthread_join (thread, NULL);
+    RSM_CloseNetworkMessage ();
+
+    check ("messages read", seen, MESSAGES, 2);
+    for (k = 0; k < MESSAGES; k++)
+    {
+	if (timed[k] == 0)
+	    continue;
+	error = 1e-9 * ((int64_t)timed[k] - sampled_ns[k]);
+	if (fabs (error) > fabs (worst_error))
+	    worst_error = error;
+	error = latency[k] - 1e-9 * (sent_ns[k] - sampled_ns[k]);
+	if (fabs (error) > fabs (worst_latency))
+	    worst_latency = error;
+    }
+
+    /* the sleeps of the sender and the millisecond of the stamp */
+    check ("worst error of the sample time (ms)", 1e3 * worst_error, 0.0, 3.0);
+    check ("worst error of the latency (ms)", 1e3 * worst_latency, 0.0, 3.0);
+
+    printf ("%s\n", failures ? "FAILED" : "PASSED");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,209 @@
+/*
+ * RSM_PositionHistory.c
+ * Ring of the recent antenna positions, written by the message read
+ * thread and read without locks: where the antenna was at any time of
+ * the last RSM_HISTORY messages, and its mean position over an interval.
+ * created on : 19/10/2026
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include <RSM.h>
+
+/* a slot is being written while its sequence is odd */
+typedef struct
+{
+    uint32_t                 sequence;
+    RSM_PositionSampleStruct sample;
+} SlotStruct;
+
+static SlotStruct ring[RSM_HISTORY];
+static uint64_t   pushed;      /* samples written, the newest is pushed - 1 */
+
+/* difference of two angles in (-180, 180] */
+static double
+wrap180 (double d)
+{
+    d = fmod (d, 360.0);
+    if (d > 180.0)
+	d -= 360.0;
+    else if (d <= -180.0)
+	d += 360.0;
+    return d;
+}
+
+/*--------------------------------------------------------------------*
+ * RSM_PositionPush: add a sample, from the one read thread only, and *
+ * test it against the window watched. The times are kept strictly    *
+ * increasing: a sample stamped at or before the newest (the clock    *
+ * offset of the network messages stepping back) is moved to 1 ns     *
+ * after it, as the readers take differences of the unsigned times    *
+ *--------------------------------------------------------------------*/
+void
+RSM_PositionPush (const RSM_PositionSampleStruct * sample)
+{
+    const uint64_t           n    = __atomic_load_n (&pushed, __ATOMIC_RELAXED);
+    SlotStruct *             slot = &ring[n % RSM_HISTORY];
+    RSM_PositionSampleStruct s    = *sample;
+
+    /* the newest is only written by this thread */
+    if (n > 0 && s.time_ns <= ring[(n - 1) % RSM_HISTORY].sample.time_ns)
+	s.time_ns = ring[(n - 1) % RSM_HISTORY].sample.time_ns + 1;
+
+    __atomic_store_n (&slot->sequence, slot->sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence (__ATOMIC_RELEASE);
+    memcpy (&slot->sample, &s, sizeof (s));
+    __atomic_store_n (&slot->sequence, slot->sequence + 1, __ATOMIC_RELEASE);
+    __atomic_store_n (&pushed, n + 1, __ATOMIC_RELEASE);
+
+    RSM_WindowUpdate (&s);
+}
+
+/*--------------------------------------------------------------------*
+ * snapshot: copy the samples back to the first before t0, oldest     *
+ * first, with the azimuth unwrapped back from the newest, so that it *
+ * is continuous                                                      *
+ * RETURNS: the number of samples copied                              *
+ *--------------------------------------------------------------------*/
+static int
+snapshot (uint64_t                   t0,
+	  RSM_PositionSampleStruct * out)
+{
+    const uint64_t n     = __atomic_load_n (&pushed, __ATOMIC_ACQUIRE);
+    const uint64_t first = (n > RSM_HISTORY) ? n - RSM_HISTORY : 0;
+    uint64_t       i;
+    uint32_t       seq;
+    int            count = 0;
+    int            k;
+
+    for (i = n; i > first; i--)
+    {
+	const SlotStruct * slot = &ring[(i - 1) % RSM_HISTORY];
+
+	seq = __atomic_load_n (&slot->sequence, __ATOMIC_ACQUIRE);
+	if (seq & 1)
+	    break;                              /* being overwritten */
+	memcpy (&out[RSM_HISTORY - 1 - count], &slot->sample, sizeof (*out));
+	__atomic_thread_fence (__ATOMIC_ACQUIRE);
+	if (__atomic_load_n (&slot->sequence, __ATOMIC_RELAXED) != seq)
+	    break;
+	count++;
+	if (out[RSM_HISTORY - count].time_ns <= t0)
+	    break;
+    }
+
+    /* oldest first, at the start of out */
+    memmove (out, &out[RSM_HISTORY - count], count * sizeof (*out));
+    for (k = count - 2; k >= 0; k--)
+	out[k].az = out[k + 1].az + wrap180 (out[k].az - out[k + 1].az);
+    return count;
+}
+
+/* position at t of count samples, extrapolated a little past the newest */
+static int
+interpolate (const RSM_PositionSampleStruct * s,
+	     int                              count,
+	     uint64_t                         t,
+	     double *                         az,
+	     double *                         el)
+{
+    double f, dt;
+    int    k;
+
+    if (count == 0 || t < s[0].time_ns)
+	return -1;
+
+    if (t >= s[count - 1].time_ns)
+    {
+	dt = 1e-9 * (double)(t - s[count - 1].time_ns);
+	if (dt > 1e-9 * RSM_EXTRAPOLATE_NS)
+	    return -1;
+	*az = s[count - 1].az + s[count - 1].vel_az * dt;
+	*el = s[count - 1].el + s[count - 1].vel_el * dt;
+	return 0;
+    }
+
+    for (k = count - 1; k > 0 && s[k - 1].time_ns > t; k--)
+	;
+    /* s[k - 1].time_ns <= t < s[k].time_ns */
+    f   = (double)(t - s[k - 1].time_ns) / (double)(s[k].time_ns - s[k - 1].time_ns);
+    *az = s[k - 1].az + f * (s[k].az - s[k - 1].az);
+    *el = s[k - 1].el + f * (s[k].el - s[k - 1].el);
+    return 0;
+}
+
+/* back into the range of the latest message */
+static double
+rewrap (double az,
+	const RSM_PositionSampleStruct * s,
+	int                              count)
+{
+    return s[count - 1].az + wrap180 (az - s[count - 1].az);
+}
+
+/*--------------------------------------------------------------------*
+ * RSM_PositionAt                                                     *
+ * IN:  t  CLOCK_MONOTONIC in ns                                      *
+ * OUT: az, el  where the antenna pointed at t, in degrees            *
+ * RETURNS: 0, or -1 if t is not covered by the history               *
+ *--------------------------------------------------------------------*/
+int
+RSM_PositionAt (uint64_t t,
+		double * az,
+		double * el)
+{
+    RSM_PositionSampleStruct s[RSM_HISTORY];
+    const int                count = snapshot (t, s);
+
+    if (interpolate (s, count, t, az, el) != 0)
+	return -1;
+    *az = rewrap (*az, s, count);
+    return 0;
+}
+
+/*--------------------------------------------------------------------*
+ * RSM_PositionMean: mean position over [t0, t1], integrating the      *
+ * piecewise linear path through the samples                          *
+ * IN:  t0, t1  CLOCK_MONOTONIC in ns                                 *
+ * OUT: az, el  in degrees                                            *
+ * RETURNS: 0, or -1 if the interval is not covered by the history    *
+ *--------------------------------------------------------------------*/
+int
+RSM_PositionMean (uint64_t t0,
+		  uint64_t t1,
+		  double * az,
+		  double * el)
+{
+    RSM_PositionSampleStruct s[RSM_HISTORY];
+    const int                count = snapshot (t0, s);
+    double                   a0, e0, a1, e1;
+    double                   sum_az = 0.0, sum_el = 0.0;
+    uint64_t                 t = t0;
+    int                      k;
+
+    if (t1 <= t0)
+	return RSM_PositionAt (t0, az, el);
+
+    if (interpolate (s, count, t0, &a0, &e0) != 0 ||
+	interpolate (s, count, t1, &a1, &e1) != 0)
+	return -1;
+
+    /* trapezoids between t0, the samples inside the interval, and t1 */
+    for (k = 0; k < count && s[k].time_ns < t1; k++)
+    {
+	if (s[k].time_ns <= t0)
+	    continue;
+	sum_az += 0.5 * (a0 + s[k].az) * (double)(s[k].time_ns - t);
+	sum_el += 0.5 * (e0 + s[k].el) * (double)(s[k].time_ns - t);
+	t  = s[k].time_ns;
+	a0 = s[k].az;
+	e0 = s[k].el;
+    }
+    sum_az += 0.5 * (a0 + a1) * (double)(t1 - t);
+    sum_el += 0.5 * (e0 + e1) * (double)(t1 - t);
+
+    *az = rewrap (sum_az / (double)(t1 - t0), s, count);
+    *el = sum_el / (double)(t1 - t0);
+    return 0;
+}
@@ -0,0 +1,238 @@
+/*
+ * RSM_ScanWindow.c
+ * An angle window watched on the message read thread: every sample
+ * pushed to the history is tested against it, and a crossing of its
+ * edge is timed between the two samples either side and wakes the
+ * threads waiting in RSM_WindowWait, so that they need not poll the
+ * position message while the dish slews.
+ * created on : 19/10/2026
+ */
+
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include <RSM.h>
+
+/* the window, set by RSM_WindowWatch: 'armed' is its number, and 0
+ * while it is being changed */
+static int    axis = -1;
+static double min_angle, max_angle;
+static int    armed;
+static int    windows;      /* RSM_WindowWatch calls, for the number */
+
+/* the state, written by the read thread only and published through its
+ * sequence count, which is also the futex waited on */
+typedef struct
+{
+    int                   window;   /* the number of the window it is of */
+    RSM_WindowStateStruct state;
+} PublishedStruct;
+
+static uint32_t        sequence;
+static PublishedStruct published;
+
+/* the read thread's own */
+static RSM_PositionSampleStruct last;
+
+static double
+angle_of (const RSM_PositionSampleStruct * s,
+	  int                              a)
+{
+    return (a == RSM_AXIS_AZ) ? s->az : s->el;
+}
+
+/* time at which the path from last to s crossed into the window [lo, hi],
+ * or out of it: the edge is the one it was moving towards, which for the
+ * azimuth may be a turn away, across the wrap of the angles */
+static uint64_t
+crossing_time (const RSM_PositionSampleStruct * s,
+	       int                              a,
+	       int                              entering,
+	       double                           lo,
+	       double                           hi)
+{
+    const double a0 = angle_of (&last, a);
+    double       a1 = angle_of (s, a);
+    double       edge, f;
+
+    if (a == RSM_AXIS_AZ)
+    {
+	/* the short way round */
+	double d = fmod (a1 - a0, 360.0);
+
+	if (d > 180.0)
+	    d -= 360.0;
+	else if (d <= -180.0)
+	    d += 360.0;
+	a1 = a0 + d;
+    }
+    edge = (entering == (a1 > a0)) ? lo : hi;
+    if (a == RSM_AXIS_AZ)
+	edge -= 360.0 * floor ((edge - a0 + 180.0) / 360.0);
+    f = (a1 != a0) ? (edge - a0) / (a1 - a0) : 1.0;
+    if (!(f >= 0.0))
+	f = 0.0;
+    else if (f > 1.0)
+	f = 1.0;
+    return last.time_ns + (uint64_t)(f * (double)(s->time_ns - last.time_ns));
+}
+
+static void
+publish (const PublishedStruct * next)
+{
+    const uint32_t seq = __atomic_load_n (&sequence, __ATOMIC_RELAXED);
+
+    __atomic_store_n (&sequence, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence (__ATOMIC_RELEASE);
+    memcpy (&published, next, sizeof (*next));
+    __atomic_store_n (&sequence, seq + 2, __ATOMIC_RELEASE);
+    syscall (SYS_futex, &sequence, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
+
+/*--------------------------------------------------------------------*
+ * RSM_WindowUpdate: test a sample against the window, on the read    *
+ * thread, from RSM_PositionPush                                      *
+ *--------------------------------------------------------------------*/
+void
+RSM_WindowUpdate (const RSM_PositionSampleStruct * s)
+{
+    const int       window = __atomic_load_n (&armed, __ATOMIC_ACQUIRE);
+    PublishedStruct next;
+    double          a1, lo, hi;
+    int             a, in;
+
+    if (window == 0)
+	return;
+    a  = axis;
+    lo = min_angle;
+    hi = max_angle;
+    __atomic_thread_fence (__ATOMIC_ACQUIRE);
+    if (__atomic_load_n (&armed, __ATOMIC_RELAXED) != window || a < 0)
+	return;                                 /* being changed */
+
+    a1 = angle_of (s, a);
+    in = (a1 >= lo && a1 <= hi);
+    if (window != published.window)
+    {
+	/* the first sample of a window only tells where the dish is */
+	memset (&next, 0, sizeof (next));
+	next.window       = window;
+	next.state.inside = in;
+	publish (&next);
+    }
+    else if (in != published.state.inside)
+    {
+	next = published;
+	next.state.inside = in;
+	if (in)
+	{
+	    next.state.entries++;
+	    next.state.entered_ns = crossing_time (s, a, 1, lo, hi);
+	}
+	else
+	{
+	    next.state.exits++;
+	    next.state.left_ns = crossing_time (s, a, 0, lo, hi);
+	}
+	publish (&next);
+    }
+    last = *s;
+}
+
+/*--------------------------------------------------------------------*
+ * RSM_WindowWatch: watch [min, max] of an axis from the next sample  *
+ * IN:  a  RSM_AXIS_AZ or RSM_AXIS_EL, in the angles of the messages  *
+ *--------------------------------------------------------------------*/
+void
+RSM_WindowWatch (int    a,
+		 double min,
+		 double max)
+{
+    __atomic_store_n (&armed, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence (__ATOMIC_RELEASE);
+    axis      = a;
+    min_angle = min;
+    max_angle = max;
+    __atomic_store_n (&armed, ++windows, __ATOMIC_RELEASE);
+}
+
+/*--------------------------------------------------------------------*
+ * RSM_WindowState: a consistent copy of the state of the window     *
+ * watched, with inside -1 until a sample has been tested against it  *
+ * RETURNS: the sequence count of the copy                            *
+ *--------------------------------------------------------------------*/
+uint32_t
+RSM_WindowState (RSM_WindowStateStruct * out)
+{
+    uint32_t seq;
+    int      window;
+
+    do
+    {
+	while ((seq = __atomic_load_n (&sequence, __ATOMIC_ACQUIRE)) & 1)
+	    ;
+	window = published.window;
+	memcpy (out, &published.state, sizeof (*out));
+	__atomic_thread_fence (__ATOMIC_ACQUIRE);
+    }
+    while (__atomic_load_n (&sequence, __ATOMIC_RELAXED) != seq);
+
+    if (window != windows)
+    {
+	memset (out, 0, sizeof (*out));
+	out->inside = -1;
+    }
+    return seq;
+}
+
+/*--------------------------------------------------------------------*
+ * RSM_WindowWait: sleep until the dish is inside the window, or      *
+ * outside it                                                         *
+ * IN:  inside      1 to wait for inside, 0 for outside               *
+ *      timeout_ms  longest to wait                                   *
+ * OUT: out        the state                                          *
+ * RETURNS: 1 if the dish is where asked, 0 if not by the timeout     *
+ *--------------------------------------------------------------------*/
+int
+RSM_WindowWait (int                     inside,
+		int                     timeout_ms,
+		RSM_WindowStateStruct * out)
+{
+    struct timespec now, end, left;
+    uint32_t        seq;
+
+    clock_gettime (CLOCK_MONOTONIC, &end);
+    end.tv_sec  += timeout_ms / 1000;
+    end.tv_nsec += (timeout_ms % 1000) * 1000000L;
+    if (end.tv_nsec >= 1000000000L)
+    {
+	end.tv_sec++;
+	end.tv_nsec -= 1000000000L;
+    }
+
+    while (1)
+    {
+	seq = RSM_WindowState (out);
+	if (out->inside == inside)
+	    return 1;
+
+	clock_gettime (CLOCK_MONOTONIC, &now);
+	left.tv_sec  = end.tv_sec  - now.tv_sec;
+	left.tv_nsec = end.tv_nsec - now.tv_nsec;
+	if (left.tv_nsec < 0)
+	{
+	    left.tv_sec--;
+	    left.tv_nsec += 1000000000L;
+	}
+	if (left.tv_sec < 0)
+	    return 0;
+
+	/* sleeps only while the sequence is still seq */
+	syscall (SYS_futex, &sequence, FUTEX_WAIT_PRIVATE, seq, &left, NULL, 0);
+    }
+}
@@ -0,0 +1,155 @@
+/*
+ * RSM_SerialFrame.c
+ * Framed reader of the serial message streams: the antenna position
+ * message (13 bytes and 0xFF 0xFF 0xFF) and the clinometer of REL
+ * (9 bytes and a line feed).
+ * created on : 19/10/2026
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <RSM_SerialFrame.h>
+
+#define MASK (RSM_FRAME_RING - 1)
+
+static inline unsigned char
+at (const RSM_FrameStruct * f,
+    uint64_t                i)
+{
+    return f->ring[i & MASK];
+}
+
+/* is there a footer at i */
+static int
+footer_at (const RSM_FrameStruct * f,
+	   uint64_t                i)
+{
+    int k;
+
+    for (k = 0; k < f->footer_length; k++)
+    {
+	if (at (f, i + k) != f->footer[k])
+	    return 0;
+    }
+    return 1;
+}
+
+/*--------------------------------------------------------------------*
+ * parse: take the next message out of what is buffered               *
+ * RETURNS: 1 with the message copied, 0 if more bytes are needed     *
+ *--------------------------------------------------------------------*/
+static int
+parse (RSM_FrameStruct * f,
+       unsigned char *   message)
+{
+    const int frame = f->footer_length + f->length + f->footer_length;
+    int       k;
+
+    while (1)
+    {
+	if (!f->synced)
+	{
+	    /* up to the next footer */
+	    while (f->head - f->tail >= (uint64_t)f->footer_length && !footer_at (f, f->tail))
+	    {
+		f->tail++;
+		f->skipped++;
+	    }
+	    if (f->head - f->tail < (uint64_t)f->footer_length)
+		return 0;
+	    f->synced = 1;
+	}
+
+	if (f->head - f->tail < (uint64_t)frame)
+	    return 0;
+
+	if (footer_at (f, f->tail + f->footer_length + f->length))
+	{
+	    for (k = 0; k < f->length; k++)
+		message[k] = at (f, f->tail + f->footer_length + k);
+	    /* the footer after is the one before the next */
+	    f->tail += f->footer_length + f->length;
+	    f->frames++;
+	    return 1;
+	}
+
+	/* a short or long message: find the next footer after this one */
+	f->errors++;
+	f->synced = 0;
+	f->tail++;
+	f->skipped++;
+    }
+}
+
+/*--------------------------------------------------------------------*
+ * RSM_FrameInit                                                      *
+ * IN:  fd      the open serial port                                  *
+ *      length  bytes of a message, without the footer                *
+ *      footer  the bytes after every message                         *
+ *--------------------------------------------------------------------*/
+void
+RSM_FrameInit (RSM_FrameStruct *     frame,
+	       int                   fd,
+	       int                   length,
+	       const unsigned char * footer,
+	       int                   footer_length)
+{
+    memset (frame, 0, sizeof (*frame));
+    frame->fd            = fd;
+    frame->length        = (length < RSM_FRAME_MAX) ? length : RSM_FRAME_MAX;
+    frame->footer_length = (footer_length < RSM_FRAME_FOOTER) ? footer_length : RSM_FRAME_FOOTER;
+    memcpy (frame->footer, footer, frame->footer_length);
+}
+
+/*--------------------------------------------------------------------*
+ * RSM_FrameRead: the next message of the stream                      *
+ * IN:  timeout_ms  longest to wait for more bytes, -1 for ever       *
+ * OUT: message     frame->length bytes                               *
+ *      time_ns     CLOCK_MONOTONIC when its last byte was read       *
+ * RETURNS: 1 for a message, 0 at the timeout, -1 if the port failed  *
+ *          or closed                                                 *
+ *--------------------------------------------------------------------*/
+int
+RSM_FrameRead (RSM_FrameStruct * frame,
+	       unsigned char *   message,
+	       uint64_t *        time_ns,
+	       int               timeout_ms)
+{
+    struct pollfd   pfd;
+    struct timespec now;
+    ssize_t         n;
+    size_t          space;
+
+    while (!parse (frame, message))
+    {
+	pfd.fd     = frame->fd;
+	pfd.events = POLLIN;
+	n = poll (&pfd, 1, timeout_ms);
+	if (n < 0 && errno == EINTR)
+	    continue;
+	if (n < 0)
+	    return -1;
+	if (n == 0)
+	    return 0;
+
+	/* the ring is never full: parse leaves less than a frame */
+	space = RSM_FRAME_RING - (frame->head - frame->tail);
+	if (space > RSM_FRAME_RING - (frame->head & MASK))
+	    space = RSM_FRAME_RING - (frame->head & MASK);
+	n = read (frame->fd, &frame->ring[frame->head & MASK], space);
+	if (n < 0 && (errno == EINTR || errno == EAGAIN))
+	    continue;
+	if (n <= 0)
+	    return -1;
+
+	clock_gettime (CLOCK_MONOTONIC, &now);
+	frame->arrived_ns = (uint64_t)now.tv_sec * 1000000000u + now.tv_nsec;
+	frame->head      += n;
+    }
+    *time_ns = frame->arrived_ns;
+    return 1;
+}
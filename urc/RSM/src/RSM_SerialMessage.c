@@ -9,13 +9,13 @@
 #include <stdio.h>
 #include <string.h>
 #include <pthread.h>
-#include <semaphore.h>
 #include <termios.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <time.h>
 
 #include <RSM.h>
+#include <RSM_SerialFrame.h>
 
 /* definitions */
 
@@ -25,114 +25,36 @@
 /* the length of the serial message footer */
 #define FOOTER_LENGTH         3
 
-/* the number of bytes to seach through when looking for the serial message footer */
-#define FOOTER_SEARCH_LENGTH 30
+/* the longest wait for bytes before the message is taken as lost (ms) */
+#define FRAME_TIMEOUT        100
+
+/* the serial message footer */
+static const unsigned char footer[ FOOTER_LENGTH ] = { 0xFF, 0xFF, 0xFF };
 
 /* global variables */
 
 /* file descriptor for the serial port */
 static int serialport_fd = -1;
 
-/* 'sm_buffer_semaphore' is a semaphore created during initialisation that is
- * used to control shared access to the receive buffer and its associated
- * valid flag. Access to this buffer and flag is shared by the main thread
- * and the read thread.
+/* 'sm_frame' frames the messages out of the bytes of the serial port, for
+ * the read thread.
  */
-static sem_t sm_buffer_semaphore;
+static RSM_FrameStruct sm_frame;
 
 /* 'sm_read_thread' is a thread created during initialisation that continuously
  * reads the serial message.
  */
 static pthread_t     sm_read_thread;
 
-/* 'sm_buffer' is the receive buffer that is used to store the serial message
- */
-static unsigned char sm_buffer[ SERIALMESSAGE_LENGTH ];
-
-/* 'sm_buffer_valid' is a flag that indicates if the receive buffer contains a
- * valid message.
- * NOTE: currently this flag is initialised to TRUE to handle the case where
- * application code is trying to read the latest message before a message
- * has been received by the read thread. It might be wiser to handle this
- * situation by returning a non-fatal error indicating that the first message
- * is currently being processed.
- */
-static int           sm_buffer_valid = 1;
-
-/* 'read_raw' read a serial message from the serial port
- * In: none
- * Out: 'valid' is updated to indicate if a message was successfully received
- *  TRUE for success, FALSE for failure
- * 'buffer' is updated with the message
- * Returns: void
+/* 'sm_latest' is the latest serial message, converted by the read thread
+ * and read by the main thread without locking.
+ * NOTE: currently this is initialised to a valid message of zeroes to
+ * handle the case where application code is trying to read the latest
+ * message before a message has been received by the read thread. It might
+ * be wiser to handle this situation by returning a non-fatal error
+ * indicating that the first message is currently being processed.
  */
-static void
-read_raw (unsigned char * buffer,
-	  int *           valid)
-{
-    int           rx_count     = 0;
-    int           footer_count = 0;
-    int           retval;
-    int           footer_found = 0;
-    unsigned char data;
-
-    /* flush tx and rx buffers */
-    tcflush (serialport_fd, TCIOFLUSH);
-
-    /* detect the serial message footer */
-    while (rx_count < FOOTER_SEARCH_LENGTH && !footer_found)
-    {
-	retval = read (serialport_fd, &data, 1);
-	if (retval == 0)
-	{
-	    continue;
-	}
-	else if (retval == -1)
-	{
-	    ; /* for some reason we cannot report this error */
-	}
-	else
-	{
-	    if (data == 0xFF)
-	    {
-		footer_count ++;
-	    }
-	    else
-	    {
-		footer_count = 0;
-	    }
-	    if (footer_count == FOOTER_LENGTH)
-	    {
-		footer_found = 1;
-	    }
-	}
-    }
-
-    if (!footer_found)
-    {
-	*valid = 0;
-    }
-
-    /* read the message */
-    while (rx_count < SERIALMESSAGE_LENGTH)
-    {
-	retval = read (serialport_fd, &data, 1);
-	if (retval == 0)
-	{
-	    continue;
-	}
-	else if (retval == -1)
-	{
-	    ; /* for some reason we cannot report this error */
-	}
-	else
-	{
-	    buffer[ rx_count ++ ] = data;
-	}
-    }
-
-    *valid = 1;
-}
+static RSM_LatestStruct sm_latest;
 
 static void
 convert_buffer (unsigned char *             buffer,
@@ -168,25 +90,45 @@ convert_buffer (unsigned char *             buffer,
     time (&now);
     gmtime_r (&now, &gmt);
     msg->year = gmt.tm_year + 1900;
+
+    /* the time of arrival is set by the reader, the latency is not known */
+    msg->time_ns = 0;
+    msg->latency = -1.0;
 }
 
 static void *
 read_thread (void * arg)
 {
-    unsigned char rxbuffer [ SERIALMESSAGE_LENGTH ];
-    int           valid;
+    unsigned char             rxbuffer [ SERIALMESSAGE_LENGTH ];
+    RSM_PositionMessageStruct msg;
+    uint64_t                  time_ns;
+    int                       status;
 
+    /* an invalid message keeps the last one, as sm_latest starts */
+    RSM_LatestLoad (&sm_latest, &msg);
     while (1)
     {
-	read_raw (rxbuffer, &valid);
-	/* copy over the serial message, but first set the semaphore */
-	sem_wait (&sm_buffer_semaphore);
-	if (valid)
+	/* the next message, or none within FRAME_TIMEOUT */
+	status = RSM_FrameRead (&sm_frame, rxbuffer, &time_ns, FRAME_TIMEOUT);
+	if (status == 1)
+	{
+	    RSM_PositionSampleStruct sample;
+
+	    /* Keep it in the history, as it arrived: the message has no velocities */
+	    convert_buffer (rxbuffer, &msg);
+	    msg.time_ns    = time_ns;
+	    sample.time_ns = time_ns;
+	    sample.az      = msg.az;
+	    sample.el      = msg.el;
+	    sample.vel_az  = 0.0;
+	    sample.vel_el  = 0.0;
+	    RSM_PositionPush (&sample);
+	}
+	else if (status < 0)
 	{
-	    memcpy (sm_buffer, rxbuffer, SERIALMESSAGE_LENGTH);
+	    usleep (FRAME_TIMEOUT * 1000);
 	}
-	sm_buffer_valid = valid;
-	sem_post (&sm_buffer_semaphore);
+	RSM_LatestStore (&sm_latest, &msg, status == 1);
     }
     return NULL;
 }
@@ -196,7 +138,9 @@ read_thread (void * arg)
 int
 RSM_InitialiseSerialMessage (const char * serialport)
 {
-    struct termios attributes;
+    unsigned char             rxbuffer [ SERIALMESSAGE_LENGTH ];
+    RSM_PositionMessageStruct msg;
+    struct termios            attributes;
 
     printf ("Opening serial port: %s\n", serialport);
     serialport_fd = open (serialport, O_RDONLY);
@@ -227,13 +171,12 @@ RSM_InitialiseSerialMessage (const char * serialport)
 	return -1;
     }
 
-    /* create a semaphore to control shared access to the serial message buffer */
-    if (sem_init (&sm_buffer_semaphore, 0, 1) == -1)
-    {
-	printf ("There has been a problem creating the serial message buffer semaphore\n");
-	close (serialport_fd);
-	return -1;
-    }
+    RSM_FrameInit (&sm_frame, serialport_fd, SERIALMESSAGE_LENGTH, footer, FOOTER_LENGTH);
+
+    /* no message yet: see sm_latest */
+    memset (rxbuffer, 0, sizeof (rxbuffer));
+    convert_buffer (rxbuffer, &msg);
+    RSM_LatestStore (&sm_latest, &msg, 1);
 
     /* create a new thread that continuously reads serial messages */
     if (pthread_create (&sm_read_thread, NULL, read_thread, NULL))
@@ -248,25 +191,14 @@ RSM_InitialiseSerialMessage (const char * serialport)
 int
 RSM_ReadSerialMessage (RSM_PositionMessageStruct * serialmessage)
 {
-    unsigned char buffer [ SERIALMESSAGE_LENGTH ];
-    int           valid;
+    RSM_PositionMessageStruct msg;
 
-    /* read the serialmessage buffer, but first set the semaphore */
-    sem_wait (&sm_buffer_semaphore);
-    valid = sm_buffer_valid;
-    if (valid)
-    {
-	memcpy (buffer, sm_buffer, SERIALMESSAGE_LENGTH);
-    }
-    sem_post (&sm_buffer_semaphore);
-
-    if (!valid)
+    /* read the latest serial message, without waiting for the read thread */
+    if (!RSM_LatestLoad (&sm_latest, &msg))
     {
 	return 0;
     }
-
-    /* interpret the data in the buffer */
-    convert_buffer (buffer, serialmessage);
+    *serialmessage = msg;
 
     return 1;
 }
@@ -275,7 +207,9 @@ void
 RSM_CloseSerialMessage (void)
 {
     pthread_cancel (sm_read_thread);
-    sem_destroy (&sm_buffer_semaphore);
+    pthread_join (sm_read_thread, NULL);
+    printf ("Serial messages: %lu framed, %lu framing errors, %lu bytes skipped\n",
+	    sm_frame.frames, sm_frame.errors, sm_frame.skipped);
     /* close serial port */
     close (serialport_fd);
 }
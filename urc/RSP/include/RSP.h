@@ -43,9 +43,18 @@
 // Blackman Window
 #define BLACKMAN_WINDOW(j,N) (0.42 - 0.5 * cos (TWOPI * (j)/(N)) + 0.08 * cos (2.0 * TWOPI * (j)/(N)))
 
+// ADC mid-scale (12 bit converters), removed before pulse compression
+#define RSP_ADC_OFFSET 2048
+
+// Oversampled code length at which pulse compression switches from direct
+// correlation to overlap-save FFT convolution
+#define RSP_PC_FFT_CODE_LENGTH 32
+
 #define MAX_OBSERVABLES 100
 #define MAX_NAME_LENGTH 15
+#define RSP_OBS_HASH_SIZE 256              // power of two, > 2 * MAX_OBSERVABLES
 #define RSP_MAX_MOMENTS 5
+#define RSP_DAQ_ERRORS 4                   // acquisition error codes 1..4 (RDQ_STATUS_*)
 #define RSP_MIN_MOMENTS 3
 
 // The RSP_PeakStruct type definition defines the structure used to store
@@ -69,7 +78,9 @@ typedef struct
     float   prt;                                          //   Pulse repetition time (s)
     float   pulse_period;                                 // + Duration of TX pulse or subpulse (nanosec)
     int     pulses_per_daq_cycle;                         // + Number of pulses collected by ADC per ray
-    int     samples_per_pulse;                            // + Number of samples collected per pulse
+    int     samples_per_pulse;                            // + Number of samples processed per pulse
+    int     samples_per_pulse_acquired;                   // + Number of samples collected per pulse
+    int     first_gate;                                   // + First sample processed of those collected
     int     samples_per_pulse_ts;                         // + Number of samples collected per pulse to record
     int     clock_divfactor;                              // + The sample clock divide factor
     int     delay_clocks;                                 // + The number of ADC delay clock cycles
@@ -139,6 +150,11 @@ typedef struct
     float    LDR_VCP_calibration_offset;   // LDR_VCP
 
     float *  range_correction;             //   Range correction factor
+    float *  range_correction_dB;          //   10 log10 (range^2) + ZED calibration offset (dB)
+    float *  range_correction_dB_delayed;  //   As above for the delayed pulse of a pulse pair
+    int      pulse_offset_gates;           //   Delay between HV pulse pairs (gates)
+    float    phidp_offset_cos;             //   cos (phidp_offset) for the pulse pair rotation
+    float    phidp_offset_sin;             //   sin (phidp_offset) for the pulse pair rotation
     float    azimuth_offset;               // + Beam azimuth offset relative to prime focus beam
     char     code_name [255];              //   The name of the code
     float    transmit_power;               // + TX power (Watts)
@@ -154,12 +170,23 @@ typedef struct
     int      num_tx_pol;                   // + number of TX polarisations used
     float    mod_pulse_length;             //   the length of the mod pulse (for copernicus only);
     int      real_time_spectra_display;    // denotes if real time spectra is to be displayed
+    int      fast_math;                    // + Use RSP_FastMath.h functions rather than libm
+    int      noise_gate_start;             // + First and last gates acquired of the noise
+    int      noise_gate_end;               //   estimate, -1 for the last 50 gates processed
+    const char * kernel_isa;               //   Instruction set of the RSP kernels in use
+    const char * realtime;                 //   Real-time setup achieved by the recorder, or NULL
 } RSP_ParamStruct;
 
 
 // The RSP_ObservablesStruct structure is used to store the measured parameters
 // for each ray. The pointers and tags should be defined using the
-// RSP_ObsNew function.
+// RSP_ObsNew function. The data of all observables live in one block of
+// MAX_OBSERVABLES rows of n_gates floats, allocated by RSP_ObsInit, so a ray
+// is cleared with RSP_ObsClear and data[i] == block + i * n_gates. Names are
+// found through a hash table (index + 1, 0 for an empty slot).
+// Moments files also carry the acquisition quality of every ray: the least
+// slack of its banks against their deadline, the deadlines missed and the
+// banks with each acquisition error.
 typedef struct
 {
     float   azimuth;
@@ -184,6 +211,8 @@ typedef struct
     int     dish_minute;
     int     dish_second;
     int     dish_centisecond;
+    float   dish_latency;                  // s, age of the position message on arrival, -1 if unknown
+    int     dish_latencyid;
     /* */
     int     ts;
     int     tsid;
@@ -191,6 +220,14 @@ typedef struct
     int     ray_number;
     int     PSD_ray_number;
     int     bin_ray_number;
+    /* acquisition quality of the ray, reset by RSP_ObsClear */
+    float   min_slack;                     // s
+    int     min_slackid;
+    int     missed_deadlines;
+    int     missed_deadlinesid;
+    int     daq_errors        [RSP_DAQ_ERRORS];
+    int     daq_errorsid      [RSP_DAQ_ERRORS];
+    /* */
     int     n_obs;
     /* FIXME: Make a structure */
     int     n_elements        [MAX_OBSERVABLES];
@@ -198,9 +235,109 @@ typedef struct
     char    name              [MAX_OBSERVABLES][MAX_NAME_LENGTH];
     float * data              [MAX_OBSERVABLES];
     int     record_observable [MAX_OBSERVABLES];
+    int     n_gates;                       // row length of block
+    float * block;                         // [MAX_OBSERVABLES][n_gates]
+    short   hash              [RSP_OBS_HASH_SIZE];
 } RSP_ObservablesStruct;
 
 
+// The RSP_PulseCompressStruct holds the decoder set up by
+// RSP_PulseCompressInit for a given code set and pulse geometry.
+typedef struct
+{
+    int            samples;         // Samples per pulse
+    int            max_pulses;      // Maximum number of pulses per call
+    int            code_length;     // Code length in samples (after oversampling)
+    int            number_of_codes; // Number of complementary codes
+    float          scale;           // Output scaling (keeps noise level unchanged)
+    float *        codes;           // Oversampled codes [number_of_codes][code_length]
+    float *        work;            // Direct correlation work space
+    int            use_fft;         // Use overlap-save FFT convolution
+    int            fft_length;      // Overlap-save block length
+    int            fft_step;        // Valid output samples per block
+    int            segments;        // Blocks per pulse
+    fftw_complex * code_spectra;    // Conjugate code spectra [number_of_codes][fft_length]
+    fftw_complex * fft_work;        // Blocks for a whole bank [max_pulses][segments][fft_length]
+    fftw_plan      forward;
+    fftw_plan      inverse;
+} RSP_PulseCompressStruct;
+
+
+// The RSP_RayStruct holds the per-gate pulse pair sums accumulated over a
+// ray and the observables they are finalised into by RSP_FinaliseRay.
+// On entry the observables hold the accumulated linear values.
+typedef struct
+{
+    /* accumulated sums */
+    const float * sum_wi;
+    const float * VEL_HC_COS, * VEL_HC_SIN;
+    const float * VEL_VC_COS, * VEL_VC_SIN;
+    const float * VEL_VD_COS, * VEL_VD_SIN;
+    const float * VEL_FD_COS, * VEL_FD_SIN;
+    const float * VEL_VD_COS_even, * VEL_VD_SIN_even;
+    const float * VEL_FD_COS_even, * VEL_FD_SIN_even;
+    const float * VEL_VD_COS_odd,  * VEL_VD_SIN_odd;
+    const float * VEL_FD_COS_odd,  * VEL_FD_SIN_odd;
+    const float * PHIDP_FD_COS, * PHIDP_FD_SIN;
+    const float * PHIDP_VD_COS, * PHIDP_VD_SIN;
+    const float * PH_FD, * PV_FD, * PH_VD, * PV_VD;
+    const float * PH_FD_even, * PV_FD_even, * PH_VD_even, * PV_VD_even;
+    const float * PH_FD_odd,  * PV_FD_odd,  * PH_VD_odd,  * PV_VD_odd;
+    const float * PH0_FD_even, * PV0_FD_odd;
+    /* observables */
+    float * SNR_HC, * ZED_HC, * SNR_XHC, * ZED_XHC;
+    float * SNR_VC, * ZED_VC, * SNR_XVC, * ZED_XVC;
+    float * SPW_HC, * SPW_VC;
+    float * POW_H, * POW_HX, * POW_V, * POW_VX;
+    float * VEL_HC, * VEL_VC, * VEL_VD, * VEL_FD;
+    float * PHIDP_FD, * PHIDP_VD;
+    float * RHO_FD, * RHO_VD, * RHO_FDS, * RHO_VDS;
+    float * LDR_HC, * LDR_VC, * ZDR_C;
+} RSP_RayStruct;
+
+
+// The RSP_PulsePairStruct holds the lag products and powers of one gate,
+// summed over the pulse pairs of a DAQ cycle by RSP_PulsePairSums.
+typedef struct
+{
+    float   I_odd,  Q_odd;      // V x conj (H), H pulse first
+    float   I_even, Q_even;     // H x conj (V), V pulse first
+    float   PH, PV;             // H and V power over all pulses
+    float   PH_even, PV_even;   // H and V power, V pulse first
+    float   PH_odd,  PV_odd;    // H and V power, H pulse first
+    float   PH0_even, PV0_odd;  // Undelayed H and V power (if requested)
+} RSP_PulsePairStruct;
+
+
+// The RSP_KernelStruct holds one instruction set variant of the hot
+// processing loops. RSP_Kernels.c is compiled once per variant and
+// RSP_SelectKernels (called from RSP_InitialiseParams) points RSP_Kernel
+// at the widest one the CPU supports.
+typedef struct
+{
+    const char * name;
+    void  (*demux)           (const uint16_t * data, int channels, int n, const int * offset, uint16_t * const * out);
+    void  (*adc_to_float)    (const uint16_t * in, float * out, int n);
+    void  (*coherent_sum)    (float * data, int gates, int streams, int n, int pulses);
+    void  (*subtract_offset) (fftw_complex * IQ, int nfft);
+    void  (*apply_window)    (fftw_complex * IQ, const float * window, int nfft);
+    void  (*power_spectrum)  (const fftw_complex * data, float * PSD, int nfft, float norm);
+    void  (*accumulate)      (float * sum, const float * data, float scale, int n);
+    void  (*pulse_pair_sums) (const fftw_complex * H_odd, const fftw_complex * V_odd,
+			      const fftw_complex * H_even, const fftw_complex * V_even,
+			      const fftw_complex * H0_even, const fftw_complex * V0_odd,
+			      int n, RSP_PulsePairStruct * pp);
+    int   (*calc_spec_mom)   (const float * psd, int nBins, const RSP_PeakStruct * peak,
+			      float noiseLevel, float * moments, size_t num_moments);
+    float (*median)          (const float * data, int n);
+} RSP_KernelStruct;
+
+extern const RSP_KernelStruct * RSP_Kernel;
+extern const RSP_KernelStruct   RSP_Kernels_sse2;
+extern const RSP_KernelStruct   RSP_Kernels_avx2;
+extern const RSP_KernelStruct   RSP_Kernels_avx512;
+
+
 // Define a complex number type (tried C99 complex.h method, but wouldn't compile)
 typedef struct
 {
@@ -229,18 +366,37 @@ extern void    RSP_FFT2PowerSpec (const float * data, float * PSD, int nfft, flo
 extern void    RSP_FFT2PowerSpec_FFTW (fftw_complex * data, float * PSD, int nfft, float norm);
 
 extern void    RSP_Correlate (const uint16_t * data, const short * code, int samples, int bits, long int * corr);
+extern void    RSP_CorrelateFloat (const float * data, const float * code, int samples, int bits, float * corr);
 extern void    RSP_Oversample (const short * code, short * newcode, int numel, int n);
 
+extern int     RSP_PulseCompressInit (RSP_PulseCompressStruct * pc, const RSP_ParamStruct * param, int samples, int max_pulses);
+extern int     RSP_PulseCompress (RSP_PulseCompressStruct * pc, const uint16_t * idata, const uint16_t * qdata, float * iout, float * qout, int pulses, int streams);
+extern void    RSP_PulseCompressFree (RSP_PulseCompressStruct * pc);
+
 extern void    RSP_ClutterInterp (float * PSD, int nBins, int nInterp);
 
 extern void    RSP_CalcPhase (const RSP_ComplexType * IQ, float * phi, float * sdphi, int nfft);
 
-extern void    RSP_ObsInit (RSP_ObservablesStruct * obs);
+extern int     RSP_ObsInit (RSP_ObservablesStruct * obs, int n_gates);
 extern float * RSP_ObsNew (RSP_ObservablesStruct * obs, const char * name, int n_elements, int record_observable);
+extern void    RSP_ObsClear (RSP_ObservablesStruct * obs);
 extern void    RSP_ObsFree (RSP_ObservablesStruct * obs);
 extern float * RSP_ObsGet (const RSP_ObservablesStruct * obs, const char * name);
 extern int     RSP_ObsIndex (const RSP_ObservablesStruct * obs, const char * name);
 
 extern void    RSP_DisplayParams (const RSP_ParamStruct * param);
 
+extern void    RSP_FinaliseRay (const RSP_ParamStruct * param, const RSP_RayStruct * ray, int delayed_pulse);
+
+extern const char * RSP_SelectKernels (const char * name);
+extern void    RSP_Demux (const uint16_t * data, int channels, int n, const int * offset, uint16_t * const * out);
+extern void    RSP_ADCToFloat (const uint16_t * in, float * out, int n);
+extern void    RSP_CoherentIntegrate (float * data, int gates, int streams, int n, int pulses);
+extern void    RSP_DemuxWindow (const uint16_t * data, int channels, int pulses, int stride, const int * first, int n, const int * offset, uint16_t * const * out);
+extern void    RSP_Accumulate (float * sum, const float * data, float scale, int n);
+extern void    RSP_PulsePairSums (const fftw_complex * H_odd, const fftw_complex * V_odd, const fftw_complex * H_even, const fftw_complex * V_even, const fftw_complex * H0_even, const fftw_complex * V0_odd, int n, RSP_PulsePairStruct * pp);
+extern float   RSP_Median (const float * data, int n);
+
+#include <RSP_FastMath.h>
+
 #endif /* !__RSP_H */
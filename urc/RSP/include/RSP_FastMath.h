@@ -0,0 +1,144 @@
+#ifndef __RSP_FASTMATH_H
+#define __RSP_FASTMATH_H
+
+// RSP_FastMath.h
+// Fast single precision log10, atan2, sincos and sqrt for the moment
+// calculation and ray finalisation. The functions are branch free and
+// inline so that loops calling them can be vectorised by the compiler.
+//
+// Maximum errors against double precision libm, as measured by the
+// RSP test program (make -C urc/RSP test) with the package CFLAGS:
+//
+//   RSP_FastLog10f  x > 0          3 ULP, or 1e-7 absolute near x = 1
+//   RSP_FastAtan2f  all finite     3.5 ULP
+//   RSP_FastSincosf |x| <= 8192    2e-7 absolute
+//   RSP_FastSqrtf   x >= 0         0.5 ULP (hardware square root)
+//
+// log10 returns -HUGE_VALF for x = 0 and NaN for x < 0, as libm does.
+//
+// Compile with -DRSP_NO_FAST_MATH to map them all onto double precision
+// libm, as used with fast-math = 0.
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#ifndef RSP_NO_FAST_MATH
+
+static inline float
+RSP_FastLog10f (float x)
+{
+    const float SQRTH = 0.70710678118654752440;
+    float    m, t, z, r;
+    int32_t  bits;
+    int32_t  e;
+    int      sub;
+
+    /* scale subnormals into the normal range */
+    sub = (x < 1.17549435e-38f);
+    x   = sub ? x * 8388608.0f : x;
+
+    /* x = 2^e * m, with m in [sqrt (0.5), sqrt (2)) */
+    memcpy (&bits, &x, sizeof (bits));
+    e    = ((bits >> 23) & 0xff) - 126;
+    bits = (bits & 0x807fffff) | 0x3f000000;
+    memcpy (&m, &bits, sizeof (m));
+    e   -= (m < SQRTH) ? 1 : 0;
+    m    = (m < SQRTH) ? m + m : m;
+    e   -= sub ? 23 : 0;
+
+    /* ln (m) = 2 atanh (t), t = (m - 1) / (m + 1), |t| < 0.1716 */
+    t = (m - 1.0f) / (m + 1.0f);
+    z = t * t;
+    r = 2.0f * t * (1.0f + z * (0.33333333f + z * (0.2f + z * (0.14285715f + z * 0.11111111f))));
+
+    r = (r + (float)e * 0.69314718055994530942f) * 0.43429448190325182765f;
+
+    r = (x == 0.0f) ? -HUGE_VALF : r;
+    r = (x < 0.0f)  ? NAN        : r;
+    return r;
+}
+
+static inline float
+RSP_FastAtan2f (float y,
+		float x)
+{
+    const float PIO4     = 0.78539816339744830962f;
+    const float PIO2     = 1.57079632679489661923f;
+    const float PI_F     = 3.14159265358979323846f;
+    const float TANPIO8  = 0.41421356237309504880f;
+    float ax, ay, mn, mx, a, z, r, base;
+    int   reduce;
+
+    ax = fabsf (x);
+    ay = fabsf (y);
+    mn = fminf (ax, ay);
+    mx = fmaxf (ax, ay);
+    a  = mn / ((mx > 0.0f) ? mx : 1.0f);
+
+    /* atan (a) for a in [0, 1], reduced to |a| <= tan (pi/8) */
+    reduce = (a > TANPIO8);
+    base   = reduce ? PIO4 : 0.0f;
+    a      = reduce ? (a - 1.0f) / (a + 1.0f) : a;
+    z      = a * a;
+    r      = base + a + a * z * (-3.33329491539e-1f + z * (1.99777106478e-1f +
+		       z * (-1.38776856032e-1f + z * 8.05374449538e-2f)));
+
+    /* back to the full circle */
+    r = (ay > ax)   ? PIO2 - r : r;
+    r = (x < 0.0f)  ? PI_F - r : r;
+    return copysignf (r, y);
+}
+
+static inline void
+RSP_FastSincosf (float   x,
+		 float * s,
+		 float * c)
+{
+    const float  TWOOPI = 0.63661977236758134308f;
+    const double PIO2   = 1.57079632679489661923;
+    float   k, r, z, sr, cr;
+    int32_t q;
+
+    /* r = x - k pi/2, |r| <= pi/4. The reduction is done in double */
+    /* precision: a split-constant (Cody-Waite) float reduction is   */
+    /* reassociated away by -ffast-math.                             */
+    k = rintf (x * TWOOPI);
+    q = (int32_t)k;
+    r = (float)((double)x - (double)k * PIO2);
+    z = r * r;
+
+    sr = r + r * z * (-1.6666654611e-1f + z * (8.3321608736e-3f + z * -1.9515295891e-4f));
+    cr = 1.0f - 0.5f * z + z * z * (4.166664568298827e-2f + z * (-1.388731625493765e-3f +
+				    z * 2.443315711809948e-5f));
+
+    /* quadrant */
+    *s = (q & 1) ? cr : sr;
+    *c = (q & 1) ? sr : cr;
+    *s = (q & 2)       ? -*s : *s;
+    *c = ((q + 1) & 2) ? -*c : *c;
+}
+
+static inline float
+RSP_FastSqrtf (float x)
+{
+    return sqrtf (x);
+}
+
+#else /* RSP_NO_FAST_MATH */
+
+static inline float RSP_FastLog10f (float x)          { return log10 (x); }
+static inline float RSP_FastAtan2f (float y, float x) { return atan2 (y, x); }
+static inline float RSP_FastSqrtf (float x)           { return sqrt (x); }
+static inline void
+RSP_FastSincosf (float   x,
+		 float * s,
+		 float * c)
+{
+    *s = sin (x);
+    *c = cos (x);
+}
+
+#endif /* RSP_NO_FAST_MATH */
+
+#endif /* !__RSP_FASTMATH_H */
@@ -51,24 +51,14 @@ RSP_CalcPSD_FFTW (fftw_complex *  in,
 		  float *         psd,
 		  float           norm)
 {
-    register int i;
-
     // Multiply by window
-    for (i = 0; i < nfft; i++)
-    {
-#ifdef fftw_is_complex
-	in[i] *= window[i];
-#else
-	fftw_real (in[i]) *= window[i];
-	fftw_imag (in[i]) *= window[i];
-#endif
-    }
+    RSP_Kernel->apply_window (in, window, nfft);
 
     // Do FFT
     fftw_execute (p);
 
     // Calculate PSD
-    RSP_FFT2PowerSpec_FFTW (in, psd, nfft, norm);
+    RSP_Kernel->power_spectrum (in, psd, nfft, norm);
 }
 
 void
@@ -99,24 +89,7 @@ void
 RSP_SubtractOffset_FFTW (fftw_complex * IQ,
 			 int            nfft)
 {
-    register int i;
-    float Imean = 0.0f, Qmean = 0.0f;
-
-    // Calculate DC offsets
-    for (i = 0; i < nfft; i++)
-    {
-	Imean += fftw_real (IQ[i]);
-	Qmean += fftw_imag (IQ[i]);
-    }
-    Imean /= nfft;
-    Qmean /= nfft;
-
-    // Subtract offsets
-    for (i = 0; i < nfft; i++)
-    {
-	fftw_real_lv (IQ[i]) -= Imean;
-	fftw_imag_lv (IQ[i]) -= Qmean;
-    }
+    RSP_Kernel->subtract_offset (IQ, nfft);
 }
 
 //-------------------------------------------------------------------
@@ -225,28 +198,5 @@ RSP_FFT2PowerSpec_FFTW (fftw_complex * data,
 			float          norm)
 /* Calculates power spectrum from complex FFT output */
 {
-    int i, j, nn;
-    float * PP;
-
-    PP = malloc (sizeof (float) * nfft);
-
-    for (i = 0; i < nfft; i++)
-    {
-        PP[i] = (fftw_real (data[i]) * fftw_real (data[i]) +
-		 fftw_imag (data[i]) * fftw_imag (data[i]));
-    }
-
-    j  = 0;
-    nn = nfft >> 1;
-    for (i = nn + 1; i < nfft; i++)
-    {
-        PSD[j] = PP[i] * norm;
-        j++;
-    }
-    for (i = 0; i <= nn; i++)
-    {
-        PSD[j] = PP[i] * norm;
-        j++;
-    }
-    free (PP);
+    RSP_Kernel->power_spectrum (data, PSD, nfft, norm);
 }
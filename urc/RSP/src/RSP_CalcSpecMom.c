@@ -30,69 +30,7 @@ RSP_CalcSpecMom (const float *          psd,
 		 float *                moments,
 		 size_t                 num_moments)
 {
-
-    register int k, j;
-    int b2;
-
-    if (num_moments < 3)
-	return -1;
-
-    if (peak->leftBin > peak->rightBin) // Folded spectrum
-    {
-	b2 = peak->rightBin + nBins;
-    }
-    else
-    {
-	b2 = peak->rightBin;
-    }
-
-    moments[0] = 0.0f;
-    moments[1] = 0.0f;
-    moments[2] = 0.0f;
-
-    for (k = peak->leftBin; k <= b2; k++)
-    {
-	float pxx;
-
-	j   = k % nBins;
-	pxx = psd[j] - noiseLevel;
-	moments[0] += pxx;
-	moments[1] += k * pxx;
-	moments[2] += k * k * pxx;
-    }
-
-    moments[1] = moments[1] / moments[0];
-    moments[2] = sqrt (moments[2] / moments[0] - moments[1] * moments[1]);
-
-    // Deal with case of folding from -ve to +ve frequency
-    if (peak->leftBin > peak->rightBin && peak->peakBin < peak->leftBin)
-    {
-	moments[1] -= nBins;
-    }
-
-    if (num_moments < 5)
-	return 0;
-
-    moments[3] = 0.0f;
-    moments[4] = 0.0f;
-
-    for (k = peak->leftBin; k <= b2; k++)
-    {
-	float pxx;
-
-        j   = k % nBins;
-        pxx = psd[j] - noiseLevel;
-        moments[3] += pxx * (k - moments[1]) * (k - moments[1]) * (k - moments[1]);
-        moments[4] += pxx * (k - moments[1]) * (k - moments[1]) * (k - moments[1]) * (k - moments[1]);
-    }
-
-    moments[3] = (moments[3] / moments[0]);
-    moments[3] = moments[3] / (moments[2] * moments[2] * moments[2]);
-    moments[4] = (moments[4] / moments[0]);
-    moments[4] = moments[4] / (moments[2] * moments[2] * moments[2] * moments[2]);
-    moments[4] = moments[4] - 3.0;
-
-    return 0;
+    return RSP_Kernel->calc_spec_mom (psd, nBins, peak, noiseLevel, moments, num_moments);
 }
 
 
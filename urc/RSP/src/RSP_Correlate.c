@@ -53,6 +53,36 @@ RSP_Correlate (const uint16_t * data,
     }
 }
 
+/* Float correlation of data against a +/-1 code, written so that the   */
+/* inner loop has no branches and can be vectorised by the compiler.    */
+/* Produces samples - bits + 1 output samples in corr.                 */
+void
+RSP_CorrelateFloat (const float * restrict data,
+		    const float * restrict code,
+		    int                    samples,
+		    int                    bits,
+		    float * restrict       corr)
+{
+    int nmax;
+    int j, i;
+
+    nmax = samples - bits + 1;
+
+    for (i = 0; i < nmax; i++)
+	corr [i] = 0.0;
+
+    for (j = 0; j < bits; j++)
+    {
+	const float   c = code [j];
+	const float * d = data + j;
+
+	for (i = 0; i < nmax; i++)
+	{
+	    corr[i] += c * d[i];
+	}
+    }
+}
+
 void
 RSP_Oversample (const short * code,
 		short *       newcode,
@@ -0,0 +1,228 @@
+// RSP_Dispatch.c
+// --------------
+// Part of the Chilbolton Radar Signal Processing Package
+//
+// Purpose: Selects the instruction set variant of the RSP kernels
+//          (RSP_Kernels.c) for the CPU we are running on, once, from
+//          RSP_InitialiseParams, and provides the public entry points
+//          that call through the selected variant.
+//
+//          The choice can be forced with the RSP_KERNELS environment
+//          variable (sse2, avx2 or avx512), e.g. for benchmarking; a
+//          variant the CPU cannot run is never selected.
+//
+// Created on: 19/10/26
+// -------------------------------------------------------
+
+#include <stdio.h>
+#include <string.h>
+
+#include <RSP.h>
+
+/* Baseline until RSP_SelectKernels has run */
+const RSP_KernelStruct * RSP_Kernel = &RSP_Kernels_sse2;
+
+static int
+cpu_supports (const RSP_KernelStruct * kernels)
+{
+#if defined (__x86_64__) || defined (__i386__)
+    __builtin_cpu_init ();
+
+    if (kernels == &RSP_Kernels_avx512)
+	return __builtin_cpu_supports ("avx512f")  && __builtin_cpu_supports ("avx512dq") &&
+	       __builtin_cpu_supports ("avx512bw") && __builtin_cpu_supports ("avx512vl") &&
+	       __builtin_cpu_supports ("fma");
+    if (kernels == &RSP_Kernels_avx2)
+	return __builtin_cpu_supports ("avx2") && __builtin_cpu_supports ("fma");
+    return __builtin_cpu_supports ("sse2");
+#else
+    return kernels == &RSP_Kernels_sse2;
+#endif
+}
+
+/*--------------------------------------------------------------------*
+ * RSP_SelectKernels: choose the kernel variant                       *
+ * IN:  name  variant to use, or NULL for the widest supported one    *
+ * RETURNS: name of the selected variant                              *
+ *--------------------------------------------------------------------*/
+const char *
+RSP_SelectKernels (const char * name)
+{
+    const RSP_KernelStruct * variants[] =
+    {
+	&RSP_Kernels_avx512, &RSP_Kernels_avx2, &RSP_Kernels_sse2
+    };
+    const int n_variants = sizeof (variants) / sizeof (variants[0]);
+    int       i;
+
+    if (name != NULL && *name != '\0')
+    {
+	for (i = 0; i < n_variants; i++)
+	{
+	    if (strcmp (name, variants[i]->name) == 0)
+		break;
+	}
+	if (i == n_variants)
+	{
+	    fprintf (stderr, "RSP: unknown kernel variant %s\n", name);
+	}
+	else if (!cpu_supports (variants[i]))
+	{
+	    fprintf (stderr, "RSP: CPU does not support %s kernels\n", name);
+	}
+	else
+	{
+	    RSP_Kernel = variants[i];
+	    return RSP_Kernel->name;
+	}
+    }
+
+    for (i = 0; i < n_variants - 1; i++)
+    {
+	if (cpu_supports (variants[i]))
+	    break;
+    }
+    RSP_Kernel = variants[i];
+
+    return RSP_Kernel->name;
+}
+
+/*--------------------------------------------------------------------*
+ * RSP_Demux: split interleaved DMA samples into channels             *
+ * IN:  data      n samples of channels interleaved words             *
+ *      channels  number of ADC channels (4 or 8)                     *
+ *      offset    offset[c] is the position of channel c in a sample  *
+ * OUT: out[c]    the n values of channel c (c = 0..7), or NULL       *
+ *--------------------------------------------------------------------*/
+void
+RSP_Demux (const uint16_t *   data,
+	   int                channels,
+	   int                n,
+	   const int *        offset,
+	   uint16_t * const * out)
+{
+    RSP_Kernel->demux (data, channels, n, offset, out);
+}
+
+/*--------------------------------------------------------------------*
+ * RSP_ADCToFloat: ADC counts less RSP_ADC_OFFSET, as floats          *
+ *--------------------------------------------------------------------*/
+void
+RSP_ADCToFloat (const uint16_t * in,
+		float *          out,
+		int              n)
+{
+    RSP_Kernel->adc_to_float (in, out, n);
+}
+
+/*--------------------------------------------------------------------*
+ * RSP_CoherentIntegrate: coherent integration of pulses, in place    *
+ * IN:  data     pulses of gates I or Q, of streams interleaved pulse *
+ *               by pulse (the transmit polarisations of the          *
+ *               alternating modes)                                   *
+ *      n        pulses of a stream summed into each output pulse     *
+ *      pulses   output pulses, at most the input pulses / n          *
+ * OUT: data     output pulse q is the sum of the n pulses of stream  *
+ *               q % streams in block q / streams                     *
+ *--------------------------------------------------------------------*/
+void
+RSP_CoherentIntegrate (float * data,
+		       int     gates,
+		       int     streams,
+		       int     n,
+		       int     pulses)
+{
+    RSP_Kernel->coherent_sum (data, gates, streams, n, pulses);
+}
+
+/*--------------------------------------------------------------------*
+ * RSP_DemuxWindow: RSP_Demux of a window of the gates of each pulse  *
+ * IN:  data      pulses of stride samples of channels words          *
+ *      first     first[c] is the first gate of channel c taken       *
+ *      n         gates taken from each pulse                         *
+ * OUT: out[c]    n values a pulse of channel c (c = 0..7), or NULL   *
+ *--------------------------------------------------------------------*/
+void
+RSP_DemuxWindow (const uint16_t *   data,
+		 int                channels,
+		 int                pulses,
+		 int                stride,
+		 const int *        first,
+		 int                n,
+		 const int *        offset,
+		 uint16_t * const * out)
+{
+    uint16_t * part[8];
+    int        p, c, k, done = 0;
+
+    /* the whole pulse of every channel: the bank in one pass */
+    for (c = 0; c < 8 && first[c] == 0; c++)
+	;
+    if (c == 8 && n == stride)
+    {
+	RSP_Kernel->demux (data, channels, pulses * n, offset, out);
+	return;
+    }
+
+    /* else the channels starting at each gate, a pulse at a time */
+    for (k = 0; k < 8; k++)
+    {
+	if (out[k] == NULL || (done & (1 << k)))
+	    continue;
+	for (c = 0; c < 8; c++)
+	{
+	    part[c] = (first[c] == first[k] && out[c] != NULL) ? out[c] : NULL;
+	    if (part[c] != NULL)
+		done |= 1 << c;
+	}
+	for (p = 0; p < pulses; p++)
+	{
+	    RSP_Kernel->demux (data + ((size_t)p * stride + first[k]) * channels,
+			       channels, n, offset, part);
+	    for (c = 0; c < 8; c++)
+	    {
+		if (part[c] != NULL)
+		    part[c] += n;
+	    }
+	}
+    }
+}
+
+/* sum[i] += data[i] * scale */
+void
+RSP_Accumulate (float *       sum,
+		const float * data,
+		float         scale,
+		int           n)
+{
+    RSP_Kernel->accumulate (sum, data, scale, n);
+}
+
+/*--------------------------------------------------------------------*
+ * RSP_PulsePairSums: lag products and powers of one gate             *
+ * IN:  H_odd, V_odd    pulses of the pairs with H transmitted first  *
+ *      H_even, V_even  pulses of the pairs with V transmitted first  *
+ *      H0_even, V0_odd undelayed pulses, or NULL                     *
+ *      n               number of pulse pairs                         *
+ * OUT: pp              sums over the n pairs                         *
+ *--------------------------------------------------------------------*/
+void
+RSP_PulsePairSums (const fftw_complex *  H_odd,
+		   const fftw_complex *  V_odd,
+		   const fftw_complex *  H_even,
+		   const fftw_complex *  V_even,
+		   const fftw_complex *  H0_even,
+		   const fftw_complex *  V0_odd,
+		   int                   n,
+		   RSP_PulsePairStruct * pp)
+{
+    RSP_Kernel->pulse_pair_sums (H_odd, V_odd, H_even, V_even, H0_even, V0_odd, n, pp);
+}
+
+/* Median of n values; the data are not reordered */
+float
+RSP_Median (const float * data,
+	    int           n)
+{
+    return RSP_Kernel->median (data, n);
+}
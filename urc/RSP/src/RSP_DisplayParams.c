@@ -73,6 +73,9 @@ RSP_DisplayParams (const RSP_ParamStruct * param)
     printf ("Pulses per DAQ cycle       : %d\n",     param->pulses_per_daq_cycle);
     printf ("DAQ cycle time             : %f sec\n", param->daq_time);
     printf ("Number of range gates      : %d\n",     param->samples_per_pulse);
+    if (param->samples_per_pulse_acquired > param->samples_per_pulse)
+	printf ("Range gates acquired       : %d, from gate %d processed\n",
+		param->samples_per_pulse_acquired, param->first_gate);
     printf ("Number of range gates (ts) : %d\n",     param->samples_per_pulse_ts);
     printf ("Range gate width           : %f m\n",   param->range_gate_width);
     printf ("Maximum sampled range      : %f km\n",  param->range[param->samples_per_pulse - 1] / 1000.0);
@@ -96,6 +99,7 @@ RSP_DisplayParams (const RSP_ParamStruct * param)
     printf ("Folding frequency          : %f Hz\n",   param->folding_frequency);
     printf ("Clutter interpolation      : %d bins\n", param->fft_bins_interpolated);
     printf ("Number of peaks processed  : %d\n",      param->num_peaks);
+    printf ("Processing kernels         : %s\n",      param->kernel_isa);
     printf ("\n");
     printf ("CALIBRATION PARAMETERS\n");
     printf ("---------------------------------------------\n");
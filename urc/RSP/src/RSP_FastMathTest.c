@@ -0,0 +1,272 @@
+// RSP_FastMathTest.c
+// ------------------
+// Part of the Chilbolton Radar Signal Processing Package
+//
+// Purpose: Accuracy test for RSP_FastMath.h. Sweeps each function
+//          against double precision libm and checks the documented
+//          error bounds, then finalises a synthetic ray with
+//          RSP_FinaliseRay using the fast functions and double
+//          precision libm (fast-math = 0) and compares every
+//          observable.
+//
+// Created on: 19/10/26
+// -------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <RSP.h>
+
+#define NTEST    2000000
+#define NGATES   350
+
+static int failures = 0;
+
+/* uniform random number in [lo, hi) */
+static double
+uniform (double lo,
+	 double hi)
+{
+    return lo + (hi - lo) * (rand () / (RAND_MAX + 1.0));
+}
+
+/* error of a float result in units of the last place of the reference */
+static double
+ulp_error (float  value,
+	   double reference)
+{
+    float ref = (float)reference;
+    float ulp = nextafterf (fabsf (ref), HUGE_VALF) - fabsf (ref);
+
+    return fabs (value - reference) / ulp;
+}
+
+static void
+report (const char * name,
+	double       error,
+	double       bound,
+	const char * units)
+{
+    int fail = !(error <= bound);
+
+    printf ("%-18s max error %10.3g %-4s (bound %g) %s\n",
+	    name, error, units, bound, fail ? "FAIL" : "ok");
+    failures += fail;
+}
+
+static void
+test_functions (void)
+{
+    double log10_ulp = 0.0, log10_abs = 0.0;
+    double atan2_ulp = 0.0;
+    double sincos_abs = 0.0;
+    double sqrt_ulp = 0.0;
+    int    n;
+
+    for (n = 0; n < NTEST; n++)
+    {
+	float  x, y, s, c, v;
+	double ref;
+
+	/* log10 over the full float range, and near 1 */
+	x   = (n & 1) ? (float)pow (10.0, uniform (-37.0, 38.0)) : (float)uniform (0.5, 2.0);
+	v   = RSP_FastLog10f (x);
+	ref = log10 ((double)x);
+	if (fabs (ref) < 0.5)
+	    log10_abs = fmax (log10_abs, fabs (v - ref));
+	else
+	    log10_ulp = fmax (log10_ulp, ulp_error (v, ref));
+
+	/* atan2 over all quadrants and a wide range of magnitudes */
+	x   = (float)(uniform (-1.0, 1.0) * pow (10.0, uniform (-6.0, 6.0)));
+	y   = (float)(uniform (-1.0, 1.0) * pow (10.0, uniform (-6.0, 6.0)));
+	v   = RSP_FastAtan2f (y, x);
+	ref = atan2 ((double)y, (double)x);
+	atan2_ulp = fmax (atan2_ulp, ulp_error (v, ref));
+
+	/* sincos, mostly over the Doppler phase range */
+	x = (n & 3) ? (float)uniform (-PI, PI) : (float)uniform (-8192.0, 8192.0);
+	RSP_FastSincosf (x, &s, &c);
+	sincos_abs = fmax (sincos_abs, fabs (s - sin ((double)x)));
+	sincos_abs = fmax (sincos_abs, fabs (c - cos ((double)x)));
+
+	/* sqrt */
+	x   = (float)pow (10.0, uniform (-37.0, 38.0));
+	v   = RSP_FastSqrtf (x);
+	ref = sqrt ((double)x);
+	sqrt_ulp = fmax (sqrt_ulp, ulp_error (v, ref));
+    }
+
+    printf ("Function accuracy against double precision libm (%d samples)\n", NTEST);
+    report ("RSP_FastLog10f", log10_ulp,  3.0,  "ULP");
+    report ("RSP_FastLog10f", log10_abs,  1e-7, "abs");
+    report ("RSP_FastAtan2f", atan2_ulp,  3.5,  "ULP");
+    report ("RSP_FastSincosf", sincos_abs, 2e-7, "abs");
+    report ("RSP_FastSqrtf",  sqrt_ulp,   0.5,  "ULP");
+
+    /* special values */
+    if (!(RSP_FastLog10f (0.0) < -3.0e38))
+    {
+	printf ("RSP_FastLog10f (0) is not -HUGE_VALF FAIL\n");
+	failures++;
+    }
+    if (RSP_FastAtan2f (0.0, 0.0) != 0.0 || fabsf (RSP_FastAtan2f (0.0, -1.0) - PI) > 1e-6)
+    {
+	printf ("RSP_FastAtan2f on the axes FAIL\n");
+	failures++;
+    }
+    printf ("\n");
+}
+
+/*--------------------------------------------------------------------*
+ * Ray test: fill the accumulators with random but consistent sums,   *
+ * finalise twice and compare each observable                         *
+ *--------------------------------------------------------------------*/
+#define NSUMS 35
+#define NOBS  27
+
+static const char * obs_names[NOBS] =
+{
+    "SNR_HC", "ZED_HC", "SNR_XHC", "ZED_XHC", "SNR_VC", "ZED_VC", "SNR_XVC",
+    "ZED_XVC", "SPW_HC", "SPW_VC", "POW_H", "POW_HX", "POW_V", "POW_VX",
+    "VEL_HC", "VEL_VC", "VEL_VD", "VEL_FD", "PHIDP_FD", "PHIDP_VD",
+    "RHO_FD", "RHO_VD", "RHO_FDS", "RHO_VDS", "LDR_HC", "LDR_VC", "ZDR_C"
+};
+
+/* allowed difference from libm, in the units of each observable */
+static const float obs_bounds[NOBS] =
+{
+    1e-4, 1e-4, 1e-4, 1e-4, 1e-4, 1e-4, 1e-4,       // dB
+    1e-4, 1e-6, 1e-6, 1e-4, 1e-4, 1e-4, 1e-4,       // dB, m/s, dB
+    1e-4, 1e-4, 1e-4, 1e-4, 1e-3, 1e-3,             // m/s, degrees
+    1e-6, 1e-6, 1e-6, 1e-6, 1e-4, 1e-4, 1e-4        // -, dB
+};
+
+static void
+setup_ray (RSP_RayStruct * ray,
+	   float *         sums,
+	   float *         obs)
+{
+    const float ** s = (const float **)&ray->sum_wi;
+    float **       o = &ray->SNR_HC;
+    int            n;
+
+    /* RSP_RayStruct is a list of NSUMS input then NOBS output arrays */
+    for (n = 0; n < NSUMS; n++)
+	s[n] = sums + n * NGATES;
+    for (n = 0; n < NOBS; n++)
+	o[n] = obs + n * NGATES;
+}
+
+static void
+fill_ray (RSP_RayStruct * ray,
+	  float *         sums,
+	  float *         obs)
+{
+    int i, n;
+
+    for (i = 0; i < NGATES; i++)
+    {
+	/* powers, then pulse pair products no larger than the powers allow */
+	for (n = 0; n < NSUMS; n++)
+	    sums[n * NGATES + i] = pow (10.0, uniform (-1.0, 8.0));
+	sums[i] = uniform (1.0, 10.0);   /* sum_wi */
+	for (n = 1; n <= 20; n++)
+	    sums[n * NGATES + i] = uniform (-1.0, 1.0) * pow (10.0, uniform (-1.0, 6.0));
+
+	for (n = 0; n < NOBS; n++)
+	    obs[n * NGATES + i] = pow (10.0, uniform (-3.0, 9.0));
+    }
+}
+
+static void
+test_ray (void)
+{
+    RSP_ParamStruct param;
+    RSP_RayStruct   fast_ray, libm_ray;
+    float *         sums;
+    float *         fast_obs;
+    float *         libm_obs;
+    int             n, i, delayed;
+
+    memset (&param, 0, sizeof (param));
+    param.frequency                  = 94;
+    param.prf                        = 3125;
+    param.pulses_per_daq_cycle       = 512;
+    param.samples_per_pulse          = NGATES;
+    param.clock_divfactor            = 2;
+    param.delay_clocks               = 2;
+    param.clock                      = 5000000;
+    param.pulse_period               = 500;
+    param.pulses_coherently_averaged = 1;
+    param.spectra_averaged           = 4;
+    param.code_length                = 1;
+    param.number_of_codes            = 1;
+    param.num_interleave             = 1;
+    param.num_tx_pol                 = 2;
+    param.pulse_offset               = 60;
+    param.phidp_offset               = -90.0;
+    param.ZED_calibration_offset     = -146.8;
+    param.LDR_calibration_offset     = 0.5;
+    RSP_InitialiseParams (&param);
+
+    sums     = malloc (NSUMS * NGATES * sizeof (float));
+    fast_obs = malloc (NOBS * NGATES * sizeof (float));
+    libm_obs = malloc (NOBS * NGATES * sizeof (float));
+    if (sums == NULL || fast_obs == NULL || libm_obs == NULL)
+    {
+	fprintf (stderr, "Memory allocation error: %m\n");
+	exit (3);
+    }
+
+    setup_ray (&fast_ray, sums, fast_obs);
+    setup_ray (&libm_ray, sums, libm_obs);
+
+    printf ("Ray finalisation, fast maths against libm (%d gates)\n", NGATES);
+    for (delayed = 0; delayed < 2; delayed++)
+    {
+	float max_diff[NOBS] = { 0 };
+
+	fill_ray (&fast_ray, sums, fast_obs);
+	memcpy (libm_obs, fast_obs, NOBS * NGATES * sizeof (float));
+
+	param.fast_math = 1;
+	RSP_FinaliseRay (&param, &fast_ray, delayed);
+	param.fast_math = 0;
+	RSP_FinaliseRay (&param, &libm_ray, delayed);
+
+	for (n = 0; n < NOBS; n++)
+	    for (i = 0; i < NGATES; i++)
+		max_diff[n] = fmaxf (max_diff[n], fabsf (fast_obs[n * NGATES + i] - libm_obs[n * NGATES + i]));
+
+	for (n = 0; n < NOBS; n++)
+	{
+	    char name[32];
+
+	    snprintf (name, sizeof (name), "%s%s", obs_names[n], delayed ? " (dp)" : "");
+	    report (name, max_diff[n], obs_bounds[n], "");
+	}
+    }
+
+    free (sums);
+    free (fast_obs);
+    free (libm_obs);
+    RSP_FreeMemory (&param);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+#ifdef RSP_NO_FAST_MATH
+    printf ("Built with RSP_NO_FAST_MATH: the fast functions are libm\n\n");
+#endif
+    srand (1);
+    test_functions ();
+    test_ray ();
+
+    printf ("\n%s: %d failure(s)\n", failures ? "FAILED" : "PASSED", failures);
+    return failures ? 1 : 0;
+}
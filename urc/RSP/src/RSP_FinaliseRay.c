@@ -0,0 +1,133 @@
+// RSP_FinaliseRay.c
+// -----------------
+// Part of the Chilbolton Radar Signal Processing Package
+//
+// Purpose: Turns the per-gate sums accumulated over a ray into the
+//          final observables in a single pass over the gates:
+//          averaging, velocity/phase/correlation estimates, dB
+//          conversion, calibration and range correction.
+//
+//          The gate loop is instantiated twice, with the functions
+//          from RSP_FastMath.h and with double precision libm,
+//          selected by param->fast_math.
+//
+// Created on: 19/10/26
+// -------------------------------------------------------
+
+#include <math.h>
+
+#include <RSP.h>
+
+#define FAST_LOG10(x)    (fast ? RSP_FastLog10f (x)    : log10 (x))
+#define FAST_ATAN2(y, x) (fast ? RSP_FastAtan2f (y, x) : atan2 (y, x))
+#define FAST_SQRT(x)     (fast ? RSP_FastSqrtf (x)     : sqrt (x))
+
+static inline __attribute__ ((always_inline)) void
+finalise_gates (const RSP_ParamStruct * param,
+		const RSP_RayStruct *   r,
+		const float *           zed_range_dB,
+		const int               fast)
+{
+    const float vel_vd_scale = 0.299792458 / (4.0 * PI * param->pulse_offset * 1e-6 * param->frequency);
+    const float vel_fd_scale = 0.299792458 * (float)param->num_tx_pol / (4.0 * PI * param->prt * param->frequency);
+    const float vel_c_scale  = param->folding_velocity / PI;
+    const float phidp_scale  = 0.5 * RAD2DEG;
+    const float ldr_offset   = param->LDR_calibration_offset;
+    int         i;
+
+    for (i = 0; i < param->samples_per_pulse; i++)
+    {
+	const float inv_wi = 1.0 / r->sum_wi[i];
+	float       rho_even, rho_odd;
+
+	/* Complete the weighted averaging */
+	r->SNR_HC[i]  *= inv_wi;
+	r->ZED_HC[i]  *= inv_wi;
+	r->SNR_VC[i]  *= inv_wi;
+	r->ZED_VC[i]  *= inv_wi;
+	r->SPW_HC[i]  *= inv_wi;
+	r->SPW_VC[i]  *= inv_wi;
+	r->SNR_XHC[i] *= inv_wi;
+	r->ZED_XHC[i] *= inv_wi;
+	r->SNR_XVC[i] *= inv_wi;
+	r->ZED_XVC[i] *= inv_wi;
+
+	/* Velocities and differential phase */
+	r->VEL_VD[i]   = FAST_ATAN2 (r->VEL_VD_SIN[i],   r->VEL_VD_COS[i])   * vel_vd_scale;
+	r->VEL_FD[i]   = FAST_ATAN2 (r->VEL_FD_SIN[i],   r->VEL_FD_COS[i])   * vel_fd_scale;
+	r->PHIDP_FD[i] = FAST_ATAN2 (r->PHIDP_FD_SIN[i], r->PHIDP_FD_COS[i]) * phidp_scale;
+	r->PHIDP_VD[i] = FAST_ATAN2 (r->PHIDP_VD_SIN[i], r->PHIDP_VD_COS[i]) * phidp_scale;
+	r->VEL_HC[i]   = FAST_ATAN2 (r->VEL_HC_SIN[i],   r->VEL_HC_COS[i])   * vel_c_scale;
+	r->VEL_VC[i]   = FAST_ATAN2 (r->VEL_VC_SIN[i],   r->VEL_VC_COS[i])   * vel_c_scale;
+
+	/* Copolar correlation */
+	r->RHO_FD[i] = FAST_SQRT ((r->VEL_FD_COS[i] * r->VEL_FD_COS[i] + r->VEL_FD_SIN[i] * r->VEL_FD_SIN[i]) /
+				  (r->PH_FD[i] * r->PV_FD[i]));
+	r->RHO_VD[i] = FAST_SQRT ((r->VEL_VD_COS[i] * r->VEL_VD_COS[i] + r->VEL_VD_SIN[i] * r->VEL_VD_SIN[i]) /
+				  (r->PH_VD[i] * r->PV_VD[i]));
+
+	rho_even = FAST_SQRT ((r->VEL_FD_COS_even[i] * r->VEL_FD_COS_even[i] + r->VEL_FD_SIN_even[i] * r->VEL_FD_SIN_even[i]) /
+			      (r->PH_FD_even[i] * r->PV_FD_even[i]));
+	rho_odd  = FAST_SQRT ((r->VEL_FD_COS_odd[i] * r->VEL_FD_COS_odd[i] + r->VEL_FD_SIN_odd[i] * r->VEL_FD_SIN_odd[i]) /
+			      (r->PH_FD_odd[i] * r->PV_FD_odd[i]));
+	r->RHO_FDS[i] = (rho_even + rho_odd) * 0.5;
+
+	rho_even = FAST_SQRT ((r->VEL_VD_COS_even[i] * r->VEL_VD_COS_even[i] + r->VEL_VD_SIN_even[i] * r->VEL_VD_SIN_even[i]) /
+			      (r->PH_VD_even[i] * r->PV_VD_even[i]));
+	rho_odd  = FAST_SQRT ((r->VEL_VD_COS_odd[i] * r->VEL_VD_COS_odd[i] + r->VEL_VD_SIN_odd[i] * r->VEL_VD_SIN_odd[i]) /
+			      (r->PH_VD_odd[i] * r->PV_VD_odd[i]));
+	r->RHO_VDS[i] = (rho_even + rho_odd) * 0.5;
+
+	/* Convert SNRs, ZEDs and powers to dB */
+	r->SNR_HC[i]  = 10.0 * FAST_LOG10 (r->SNR_HC[i]);
+	r->ZED_HC[i]  = 10.0 * FAST_LOG10 (r->ZED_HC[i]);
+	r->SNR_XHC[i] = 10.0 * FAST_LOG10 (r->SNR_XHC[i]);
+	r->ZED_XHC[i] = 10.0 * FAST_LOG10 (r->ZED_XHC[i]);
+	r->SNR_VC[i]  = 10.0 * FAST_LOG10 (r->SNR_VC[i]);
+	r->ZED_VC[i]  = 10.0 * FAST_LOG10 (r->ZED_VC[i]);
+	r->SNR_XVC[i] = 10.0 * FAST_LOG10 (r->SNR_XVC[i]);
+	r->ZED_XVC[i] = 10.0 * FAST_LOG10 (r->ZED_XVC[i]);
+	r->POW_H[i]   = 10.0 * FAST_LOG10 (r->PH_FD_odd[i]   * inv_wi);
+	r->POW_HX[i]  = 10.0 * FAST_LOG10 (r->PV0_FD_odd[i]  * inv_wi);
+	r->POW_V[i]   = 10.0 * FAST_LOG10 (r->PV_FD_even[i]  * inv_wi);
+	r->POW_VX[i]  = 10.0 * FAST_LOG10 (r->PH0_FD_even[i] * inv_wi);
+
+	/* LDR and ZDR (the range correction cancels) */
+	r->LDR_HC[i] = r->ZED_XHC[i] - r->ZED_HC[i] + ldr_offset;
+	r->LDR_VC[i] = r->ZED_XVC[i] - r->ZED_VC[i] + ldr_offset;
+	r->ZDR_C[i]  = r->ZED_HC[i]  - r->ZED_VC[i];
+
+	/* Range correction and calibration */
+	r->ZED_HC[i]  += zed_range_dB[i];
+	r->ZED_XHC[i] += zed_range_dB[i];
+	r->ZED_VC[i]  += zed_range_dB[i];
+	r->ZED_XVC[i] += zed_range_dB[i];
+    }
+}
+
+/*--------------------------------------------------------------------*
+ * RSP_FinaliseRay: finalise the observables of a ray                 *
+ * IN:  param          radar parameters (RSP_InitialiseParams)        *
+ *      ray            accumulated sums and observables               *
+ *      delayed_pulse  non-zero in dual pulse modes, where the second *
+ *                     pulse is delayed by param->pulse_offset_gates  *
+ *--------------------------------------------------------------------*/
+void
+RSP_FinaliseRay (const RSP_ParamStruct * param,
+		 const RSP_RayStruct *   ray,
+		 int                     delayed_pulse)
+{
+    const float * zed_range_dB;
+
+    if (delayed_pulse)
+	zed_range_dB = param->range_correction_dB_delayed;
+    else
+	zed_range_dB = param->range_correction_dB;
+
+#ifndef RSP_NO_FAST_MATH
+    if (param->fast_math)
+	finalise_gates (param, ray, zed_range_dB, 1);
+    else
+#endif /* RSP_NO_FAST_MATH */
+	finalise_gates (param, ray, zed_range_dB, 0);
+}
@@ -17,7 +17,7 @@ void
 RSP_FreeMemory (RSP_ParamStruct * param)
 {
     // Free memory blocks
-    free (param->range);          // also frees parm->range_correction
+    free (param->range);          // also frees parm->range_correction(_dB)
     free (param->frequency_axis); // also frees parm->velocity_axis
     free (param->window);
 }
@@ -22,6 +22,10 @@ RSP_InitialiseParams (RSP_ParamStruct * param)
 
     tot_avg = param->pulses_coherently_averaged * param->number_of_codes;
 
+    // Pick the widest kernel variant this CPU runs (RSP_KERNELS overrides)
+    param->kernel_isa = RSP_SelectKernels (getenv ("RSP_KERNELS"));
+    param->realtime   = NULL;
+
     // Calculate radar operating parameters
     // See RSP.h for explanations
     param->prt              = 1.0 / param->prf;
@@ -41,8 +45,10 @@ RSP_InitialiseParams (RSP_ParamStruct * param)
     param->oversample_ratio    = (int) (param->pulse_period * 1e-9 * param->sample_frequency);
 
     // Allocate memory blocks. Allocate as single blocks where size is the same.
-    param->range            = malloc ((param->samples_per_pulse << 1) * sizeof (float));
-    param->range_correction = param->range + param->samples_per_pulse;
+    param->range                       = malloc ((param->samples_per_pulse << 2) * sizeof (float));
+    param->range_correction            = param->range + param->samples_per_pulse;
+    param->range_correction_dB         = param->range_correction + param->samples_per_pulse;
+    param->range_correction_dB_delayed = param->range_correction_dB + param->samples_per_pulse;
     param->frequency_axis   = malloc ((param->npsd  << 1) * sizeof (float));
     param->velocity_axis    = param->frequency_axis + param->npsd;
     param->window           = malloc (param->nfft * sizeof (float));
@@ -61,10 +67,31 @@ RSP_InitialiseParams (RSP_ParamStruct * param)
 	// Original 	param->range[i] = i * param->range_gate_width + param->range_offset;
 	// New	 	param->range[i] = (i + param->delay_clocks/param->clock_divfactor) * param->range_gate_width + param->range_offset;
 
-  	param->range            [i] = (i + param->delay_clocks / param->clock_divfactor) * param->range_gate_width + param->range_offset;
+  	param->range            [i] = (i + param->first_gate + param->delay_clocks / param->clock_divfactor) * param->range_gate_width + param->range_offset;
   	param->range_correction [i]= (param->range [i] / 1000.0) * (param->range[i] / 1000.0);
+	param->range_correction_dB [i] = 10.0 * log10 (param->range[i] * param->range[i]) + param->ZED_calibration_offset;
     }
 
+    // The second pulse of a pulse pair is delayed by pulse_offset, so its
+    // echoes appear pulse_offset_gates later than their true range (which
+    // may be before the first gate processed)
+    param->pulse_offset_gates = (int) (0.5 + (param->pulse_offset * 1e-6) / param->sample_period);
+    for (i = 0; i < param->samples_per_pulse; i++)
+    {
+	const float true_range = param->range[i] - param->pulse_offset_gates * param->range_gate_width;
+
+	if (i >= param->pulse_offset_gates)
+	    param->range_correction_dB_delayed [i] = param->range_correction_dB [i - param->pulse_offset_gates];
+	else if (i + param->first_gate >= param->pulse_offset_gates)
+	    param->range_correction_dB_delayed [i] = 10.0 * log10 (true_range * true_range) + param->ZED_calibration_offset;
+	else
+	    param->range_correction_dB_delayed [i] = param->range_correction_dB [i];
+    }
+
+    // Rotation used to remove the phidp offset from the pulse pair products
+    param->phidp_offset_cos = cos (param->phidp_offset);
+    param->phidp_offset_sin = sin (param->phidp_offset);
+
     param->Wss = 0;
     for (i = 0; i < param->nfft; i++)
     {
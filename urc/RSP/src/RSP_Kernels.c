@@ -0,0 +1,429 @@
+// RSP_Kernels.c
+// -------------
+// Part of the Chilbolton Radar Signal Processing Package
+//
+// Purpose: The hot inner loops of the signal processing: channel
+//          de-multiplexing, ADC counts to floats, coherent
+//          integration of pulses, offset removal and windowing before
+//          the FFT, power spectra, spectral averaging, pulse pair sums,
+//          spectral moments and medians.
+//
+//          This file is compiled once for each instruction set
+//          (see the Makefile), with RSP_KERNEL_ISA set to the variant
+//          name. Each compilation exports one RSP_KernelStruct,
+//          RSP_Kernels_<isa>; everything else is static. The loops
+//          are written so that the compiler can vectorise them for
+//          the target; keep them free of calls and data dependent
+//          branches.
+//
+// Created on: 19/10/26
+// -------------------------------------------------------
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <RSP.h>
+
+#ifndef RSP_KERNEL_ISA
+#define RSP_KERNEL_ISA sse2
+#endif
+
+#define KERNEL_STRING_(isa) #isa
+#define KERNEL_STRING(isa)  KERNEL_STRING_(isa)
+#define KERNEL_TABLE_(isa)  RSP_Kernels_ ## isa
+#define KERNEL_TABLE(isa)   KERNEL_TABLE_(isa)
+
+/*--------------------------------------------------------------------*
+ * demux: split n interleaved samples of a DMA bank into channels     *
+ * IN:  data     interleaved samples, channels per sample             *
+ *      offset   position of output channel c within a sample         *
+ * OUT: out[c]   n samples of output channel c (c = 0..7)             *
+ *--------------------------------------------------------------------*/
+static void
+demux (const uint16_t * restrict data,
+       int                       channels,
+       int                       n,
+       const int *               offset,
+       uint16_t * const *        out)
+{
+    int k, c;
+
+    if (channels == 8)
+    {
+	uint16_t * raw[8] = { NULL };
+	int        seen   = 0;
+
+	/* The 8 channel table is a permutation: read whole samples in */
+	/* order and store each word to the channel it belongs to      */
+	for (c = 0; c < 8; c++)
+	{
+	    raw[offset[c] & 7] = out[c];
+	    if (out[c] != NULL)
+		seen |= 1 << offset[c];
+	}
+	if (seen == 0xff)
+	{
+	    uint16_t * restrict r0 = raw[0];
+	    uint16_t * restrict r1 = raw[1];
+	    uint16_t * restrict r2 = raw[2];
+	    uint16_t * restrict r3 = raw[3];
+	    uint16_t * restrict r4 = raw[4];
+	    uint16_t * restrict r5 = raw[5];
+	    uint16_t * restrict r6 = raw[6];
+	    uint16_t * restrict r7 = raw[7];
+
+	    for (k = 0; k < n; k++)
+	    {
+		r0[k] = data[8 * k + 0];
+		r1[k] = data[8 * k + 1];
+		r2[k] = data[8 * k + 2];
+		r3[k] = data[8 * k + 3];
+		r4[k] = data[8 * k + 4];
+		r5[k] = data[8 * k + 5];
+		r6[k] = data[8 * k + 6];
+		r7[k] = data[8 * k + 7];
+	    }
+	    return;
+	}
+    }
+
+    /* 4 channel systems map the missing channels onto channel 3 */
+    for (c = 0; c < 8; c++)
+    {
+	uint16_t * restrict o = out[c];
+	const uint16_t *    d = data + offset[c];
+
+	if (o == NULL)
+	    continue;
+	for (k = 0; k < n; k++)
+	    o[k] = d[k * channels];
+    }
+}
+
+/* ADC counts to floats about zero */
+static void
+adc_to_float (const uint16_t * restrict in,
+	      float * restrict          out,
+	      int                       n)
+{
+    int i;
+
+    for (i = 0; i < n; i++)
+	out[i] = (float)in[i] - RSP_ADC_OFFSET;
+}
+
+/*--------------------------------------------------------------------*
+ * coherent_sum: see RSP_CoherentIntegrate. The pulses are summed     *
+ * GATE_BLOCK gates at a time, and each output pulse is written only  *
+ * after all of its inputs have been read.                            *
+ *--------------------------------------------------------------------*/
+#define GATE_BLOCK 256
+
+static void
+coherent_sum (float * data,
+	      int     gates,
+	      int     streams,
+	      int     n,
+	      int     pulses)
+{
+    float acc[GATE_BLOCK];
+    int   q, k, g0, g, len;
+
+    for (q = 0; q < pulses; q++)
+    {
+	float *       out   = data + (size_t)q * gates;
+	const float * first = data + ((size_t)(q / streams) * n * streams + q % streams) * gates;
+
+	for (g0 = 0; g0 < gates; g0 += GATE_BLOCK)
+	{
+	    len = (gates - g0 < GATE_BLOCK) ? gates - g0 : GATE_BLOCK;
+
+	    for (g = 0; g < len; g++)
+		acc[g] = first[g0 + g];
+	    for (k = 1; k < n; k++)
+	    {
+		const float * restrict in = first + (size_t)k * streams * gates + g0;
+
+		for (g = 0; g < len; g++)
+		    acc[g] += in[g];
+	    }
+	    memcpy (out + g0, acc, len * sizeof (float));
+	}
+    }
+}
+
+static void
+subtract_offset (fftw_complex * restrict IQ,
+		 int                     nfft)
+{
+    double Imean = 0.0, Qmean = 0.0;
+    int    i;
+
+    for (i = 0; i < nfft; i++)
+    {
+	Imean += fftw_real (IQ[i]);
+	Qmean += fftw_imag (IQ[i]);
+    }
+    Imean /= nfft;
+    Qmean /= nfft;
+
+    for (i = 0; i < nfft; i++)
+    {
+	fftw_real_lv (IQ[i]) -= Imean;
+	fftw_imag_lv (IQ[i]) -= Qmean;
+    }
+}
+
+static void
+apply_window (fftw_complex * restrict IQ,
+	      const float * restrict  window,
+	      int                     nfft)
+{
+    int i;
+
+    for (i = 0; i < nfft; i++)
+    {
+	fftw_real_lv (IQ[i]) *= window[i];
+	fftw_imag_lv (IQ[i]) *= window[i];
+    }
+}
+
+/* Power spectrum with zero frequency moved to bin nfft/2 - 1 */
+static void
+power_spectrum (const fftw_complex * restrict data,
+		float * restrict              PSD,
+		int                           nfft,
+		float                         norm)
+{
+    const int nn    = nfft >> 1;
+    const int shift = nfft - nn - 1;
+    int       i;
+
+    for (i = nn + 1; i < nfft; i++)
+    {
+	PSD[i - nn - 1] = (fftw_real (data[i]) * fftw_real (data[i]) +
+			   fftw_imag (data[i]) * fftw_imag (data[i])) * norm;
+    }
+    for (i = 0; i <= nn; i++)
+    {
+	PSD[i + shift] = (fftw_real (data[i]) * fftw_real (data[i]) +
+			  fftw_imag (data[i]) * fftw_imag (data[i])) * norm;
+    }
+}
+
+static void
+accumulate (float * restrict       sum,
+	    const float * restrict data,
+	    float                  scale,
+	    int                    n)
+{
+    int i;
+
+    for (i = 0; i < n; i++)
+	sum[i] += data[i] * scale;
+}
+
+static void
+pulse_pair_sums (const fftw_complex * restrict H_odd,
+		 const fftw_complex * restrict V_odd,
+		 const fftw_complex * restrict H_even,
+		 const fftw_complex * restrict V_even,
+		 const fftw_complex * restrict H0_even,
+		 const fftw_complex * restrict V0_odd,
+		 int                           n,
+		 RSP_PulsePairStruct *         pp)
+{
+    double I_odd = 0.0, Q_odd = 0.0, I_even = 0.0, Q_even = 0.0;
+    double PH_even = 0.0, PV_even = 0.0, PH_odd = 0.0, PV_odd = 0.0;
+    double PH0_even = 0.0, PV0_odd = 0.0;
+    int    i;
+
+    for (i = 0; i < n; i++)
+    {
+	const double ho_r = fftw_real (H_odd[i]),  ho_i = fftw_imag (H_odd[i]);
+	const double vo_r = fftw_real (V_odd[i]),  vo_i = fftw_imag (V_odd[i]);
+	const double he_r = fftw_real (H_even[i]), he_i = fftw_imag (H_even[i]);
+	const double ve_r = fftw_real (V_even[i]), ve_i = fftw_imag (V_even[i]);
+
+	// VH is V x conj (H) == 1st pulse H, 2nd pulse V
+	I_odd  += vo_r * ho_r + vo_i * ho_i;
+	Q_odd  += vo_i * ho_r - vo_r * ho_i;
+	I_even += ve_r * he_r + ve_i * he_i;
+	Q_even += he_i * ve_r - he_r * ve_i;
+
+	PH_even += he_r * he_r + he_i * he_i;
+	PV_even += ve_r * ve_r + ve_i * ve_i;
+	PH_odd  += ho_r * ho_r + ho_i * ho_i;
+	PV_odd  += vo_r * vo_r + vo_i * vo_i;
+    }
+
+    if (H0_even != NULL && V0_odd != NULL)
+    {
+	for (i = 0; i < n; i++)
+	{
+	    PH0_even += fftw_real (H0_even[i]) * fftw_real (H0_even[i]) + fftw_imag (H0_even[i]) * fftw_imag (H0_even[i]);
+	    PV0_odd  += fftw_real (V0_odd[i])  * fftw_real (V0_odd[i])  + fftw_imag (V0_odd[i])  * fftw_imag (V0_odd[i]);
+	}
+    }
+
+    pp->I_odd    = I_odd;
+    pp->Q_odd    = Q_odd;
+    pp->I_even   = I_even;
+    pp->Q_even   = Q_even;
+    pp->PH       = PH_odd + PH_even;
+    pp->PV       = PV_odd + PV_even;
+    pp->PH_even  = PH_even;
+    pp->PV_even  = PV_even;
+    pp->PH_odd   = PH_odd;
+    pp->PV_odd   = PV_odd;
+    pp->PH0_even = PH0_even;
+    pp->PV0_odd  = PV0_odd;
+}
+
+/*--------------------------------------------------------------------*
+ * calc_spec_mom: see RSP_CalcSpecMom. A folded peak is summed as two *
+ * unfolded runs of bins so that the loops carry no modulo.           *
+ *--------------------------------------------------------------------*/
+static int
+calc_spec_mom (const float * restrict psd,
+	       int                    nBins,
+	       const RSP_PeakStruct * peak,
+	       float                  noiseLevel,
+	       float *                moments,
+	       size_t                 num_moments)
+{
+    float m0 = 0.0f, m1 = 0.0f, m2 = 0.0f, m3 = 0.0f, m4 = 0.0f;
+    int   k, b2, split;
+
+    if (num_moments < 3)
+	return -1;
+
+    if (peak->leftBin > peak->rightBin) // Folded spectrum
+	b2 = peak->rightBin + nBins;
+    else
+	b2 = peak->rightBin;
+    split = (b2 < nBins - 1) ? b2 : nBins - 1;
+
+    for (k = peak->leftBin; k <= split; k++)
+    {
+	const float pxx = psd[k] - noiseLevel;
+
+	m0 += pxx;
+	m1 += k * pxx;
+	m2 += k * k * pxx;
+    }
+    for (k = nBins; k <= b2; k++)
+    {
+	const float pxx = psd[k - nBins] - noiseLevel;
+
+	m0 += pxx;
+	m1 += k * pxx;
+	m2 += k * k * pxx;
+    }
+
+    moments[0] = m0;
+    moments[1] = m1 / m0;
+    moments[2] = sqrtf (m2 / m0 - moments[1] * moments[1]);
+
+    // Deal with case of folding from -ve to +ve frequency
+    if (peak->leftBin > peak->rightBin && peak->peakBin < peak->leftBin)
+    {
+	moments[1] -= nBins;
+    }
+
+    if (num_moments < 5)
+	return 0;
+
+    for (k = peak->leftBin; k <= split; k++)
+    {
+	const float pxx = psd[k] - noiseLevel;
+	const float d   = k - moments[1];
+
+	m3 += pxx * d * d * d;
+	m4 += pxx * d * d * d * d;
+    }
+    for (k = nBins; k <= b2; k++)
+    {
+	const float pxx = psd[k - nBins] - noiseLevel;
+	const float d   = k - moments[1];
+
+	m3 += pxx * d * d * d;
+	m4 += pxx * d * d * d * d;
+    }
+
+    moments[3] = (m3 / moments[0]);
+    moments[3] = moments[3] / (moments[2] * moments[2] * moments[2]);
+    moments[4] = (m4 / moments[0]);
+    moments[4] = moments[4] / (moments[2] * moments[2] * moments[2] * moments[2]);
+    moments[4] = moments[4] - 3.0;
+
+    return 0;
+}
+
+/*--------------------------------------------------------------------*
+ * median: Torben Mogensen's algorithm, which does not reorder the    *
+ * data. The counting pass is branch free so that it vectorises.      *
+ *--------------------------------------------------------------------*/
+static float
+median (const float * restrict m,
+	int                    n)
+{
+    float min, max, guess, maxltguess, mingtguess;
+    int   i, less, greater, equal;
+
+    min = max = m[0];
+    for (i = 1; i < n; i++)
+    {
+	min = fminf (min, m[i]);
+	max = fmaxf (max, m[i]);
+    }
+
+    while (1)
+    {
+	guess      = (min + max) / 2;
+	less       = 0;
+	greater    = 0;
+	maxltguess = min;
+	mingtguess = max;
+	for (i = 0; i < n; i++)
+	{
+	    const int lt = (m[i] < guess);
+	    const int gt = (m[i] > guess);
+
+	    less      += lt;
+	    greater   += gt;
+	    maxltguess = fmaxf (maxltguess, lt ? m[i] : min);
+	    mingtguess = fminf (mingtguess, gt ? m[i] : max);
+	}
+	equal = n - less - greater;
+	if (less <= (n + 1) / 2 && greater <= (n + 1) / 2)
+	    break;
+	else if (less > greater)
+	    max = maxltguess;
+	else
+	    min = mingtguess;
+    }
+
+    if (less >= (n + 1) / 2)
+	return maxltguess;
+    else if (less + equal >= (n + 1) / 2)
+	return guess;
+    else
+	return mingtguess;
+}
+
+const RSP_KernelStruct KERNEL_TABLE (RSP_KERNEL_ISA) =
+{
+    .name            = KERNEL_STRING (RSP_KERNEL_ISA),
+    .demux           = demux,
+    .adc_to_float    = adc_to_float,
+    .coherent_sum    = coherent_sum,
+    .subtract_offset = subtract_offset,
+    .apply_window    = apply_window,
+    .power_spectrum  = power_spectrum,
+    .accumulate      = accumulate,
+    .pulse_pair_sums = pulse_pair_sums,
+    .calc_spec_mom   = calc_spec_mom,
+    .median          = median
+};
@@ -1,5 +1,5 @@
-// RSP_Correlate.c
-// -----------------
+// RSP_Observables.c
+// -------------------
 // Part of the Chilbolton Radar Signal Processing Package
 //
 // Purpose: Manages RSP_Observables structures
@@ -20,48 +20,97 @@
 
 #include <RSP.h>
 
-// Initialise observables structure
-void
-RSP_ObsInit (RSP_ObservablesStruct * obs)
+/* FNV-1a, reduced to a slot of the observable hash table */
+static unsigned int
+obs_hash (const char * name)
+{
+    unsigned int h = 2166136261u;
+
+    while (*name)
+    {
+	h ^= (unsigned char)*name++;
+	h *= 16777619u;
+    }
+    return h & (RSP_OBS_HASH_SIZE - 1);
+}
+
+// Initialise observables structure. Space for MAX_OBSERVABLES observables of
+// up to n_gates elements is allocated here, as one block; n_gates may be 0
+// for a structure that only carries the ray position and time.
+// Returns 0, or 3 if the allocation fails.
+int
+RSP_ObsInit (RSP_ObservablesStruct * obs,
+	     int                     n_gates)
 {
     obs->n_obs          = 0;
     obs->ray_number     = 0;
     obs->PSD_ray_number = 0;
+    obs->n_gates        = n_gates;
+    obs->block          = NULL;
+    memset (obs->hash, 0, sizeof (obs->hash));
+
+    if (n_gates > 0)
+    {
+	obs->block = malloc (sizeof (float) * MAX_OBSERVABLES * n_gates);
+	if (obs->block == NULL)
+	    return 3;
+    }
+    return 0;
 }
 
 
-// Initialise a new observable
+// Initialise a new observable. Returns NULL if the name is already in use,
+// too long, or there is no room left in the block.
 float *
 RSP_ObsNew (RSP_ObservablesStruct * obs,
 	    const char *            name,
 	    int                     n_elements,
 	    int                     record_observable)
 {
-    float * data;
+    unsigned int h;
+
+    if (obs->block == NULL || obs->n_obs >= MAX_OBSERVABLES ||
+	n_elements > obs->n_gates || strlen (name) >= MAX_NAME_LENGTH)
+	return NULL;
 
-    data = malloc (sizeof (float) * n_elements);
-    if (data != NULL)
+    for (h = obs_hash (name); obs->hash [h] != 0; h = (h + 1) & (RSP_OBS_HASH_SIZE - 1))
     {
-	strcpy (obs->name [obs->n_obs], name);
-	obs->data              [obs->n_obs] = data;
-	obs->n_elements        [obs->n_obs] = n_elements;
-	obs->record_observable [obs->n_obs] = record_observable;
-	obs->n_obs++;
+	if (!strcmp (obs->name [obs->hash [h] - 1], name))
+	    return NULL;
     }
-    return data;
+    obs->hash [h] = obs->n_obs + 1;
+
+    strcpy (obs->name [obs->n_obs], name);
+    obs->data              [obs->n_obs] = obs->block + (size_t)obs->n_obs * obs->n_gates;
+    obs->n_elements        [obs->n_obs] = n_elements;
+    obs->record_observable [obs->n_obs] = record_observable;
+    obs->n_obs++;
+
+    return obs->data [obs->n_obs - 1];
+}
+
+// Zero the data of every observable and the acquisition quality, and
+// forget the dish latency (start of each ray)
+void
+RSP_ObsClear (RSP_ObservablesStruct * obs)
+{
+    if (obs->block != NULL)
+	memset (obs->block, 0, sizeof (float) * obs->n_obs * obs->n_gates);
+
+    obs->min_slack        = HUGE_VALF;
+    obs->missed_deadlines = 0;
+    obs->dish_latency     = -1.0f;
+    memset (obs->daq_errors, 0, sizeof (obs->daq_errors));
 }
 
 // Free all the memory
 void
 RSP_ObsFree (RSP_ObservablesStruct * obs)
 {
-    int i;
-
-    for (i = 0; i < obs->n_obs; i++)
-    {
-	free (obs->data [i]);
-    }
+    free (obs->block);
+    obs->block = NULL;
     obs->n_obs = 0;
+    memset (obs->hash, 0, sizeof (obs->hash));
 }
 
 
@@ -72,13 +121,11 @@ RSP_ObsGet (const RSP_ObservablesStruct * obs,
 {
     int i;
 
-    for (i = 0; i < obs->n_obs; i++)
-    {
-	if (!strcmp (obs->name [i], name))
-	    return obs->data [i];
-    }
+    i = RSP_ObsIndex (obs, name);
+    if (i < 0)
+	return (NULL);
 
-    return (NULL);
+    return obs->data [i];
 }
 
 // Return index corresponding to a given name
@@ -86,12 +133,12 @@ int
 RSP_ObsIndex (const RSP_ObservablesStruct * obs,
 	      const char *                  name)
 {
-    int i;
+    unsigned int h;
 
-    for (i = 0; i < obs->n_obs; i++)
+    for (h = obs_hash (name); obs->hash [h] != 0; h = (h + 1) & (RSP_OBS_HASH_SIZE - 1))
     {
-	if (!strcmp (obs->name [i], name))
-	    return i;
+	if (!strcmp (obs->name [obs->hash [h] - 1], name))
+	    return obs->hash [h] - 1;
     }
     return -1;
 }
@@ -0,0 +1,353 @@
+// RSP_PulseCompress.c
+// -------------------
+// Part of the Chilbolton Radar Signal Processing Package
+//
+// Purpose: Pulse compression decoder. Each pulse of a DMA bank is
+//          correlated against its (oversampled) binary code and
+//          complementary codes are summed coherently.
+//
+//          Short codes use direct correlation (RSP_CorrelateFloat);
+//          long codes use overlap-save FFT convolution, with the
+//          blocks of all pulses in a bank transformed in one batch.
+//
+//          The pulses are in streams interleaved pulse by pulse (the
+//          transmit polarisations of the alternating modes), and each
+//          stream steps through the codes: pulse p is decoded with
+//          code (p / streams) % number_of_codes, and the pulses of a
+//          stream in a group of number_of_codes * streams are summed
+//          into one output pulse, which keeps the interleave. Decoded
+//          I and Q are written as floats without the ADC offset,
+//          scaled so that the noise level is unchanged.
+//
+// Created on: 19/10/26
+// -------------------------------------------------------
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <RSP.h>
+
+static inline int
+next_power_of_two (int n)
+{
+    int p = 1;
+
+    while (p < n)
+	p <<= 1;
+    return p;
+}
+
+/*--------------------------------------------------------------------*
+ * RSP_PulseCompressInit: set up a decoder for the codes in param     *
+ * IN:  param       code_length, number_of_codes, codes and           *
+ *                  oversample_ratio                                  *
+ *      samples     samples per pulse                                 *
+ *      max_pulses  largest number of pulses passed in one call       *
+ * OUT: pc          decoder                                           *
+ * RETURNS: 0 on success, 1 on memory allocation failure              *
+ *--------------------------------------------------------------------*/
+int
+RSP_PulseCompressInit (RSP_PulseCompressStruct * pc,
+		       const RSP_ParamStruct *   param,
+		       int                       samples,
+		       int                       max_pulses)
+{
+    short   oversampled [32 * 32];
+    int     ratio;
+    int     n, j, nc, length;
+
+    memset (pc, 0, sizeof (*pc));
+
+    ratio = param->oversample_ratio > 1 ? param->oversample_ratio : 1;
+    if (ratio * param->code_length > 32 * 32)
+	ratio = (32 * 32) / param->code_length;
+
+    nc     = param->number_of_codes > 1 ? param->number_of_codes : 1;
+    length = param->code_length * ratio;
+    if (length > samples)
+	length = samples;
+
+    pc->samples         = samples;
+    pc->max_pulses      = max_pulses;
+    pc->code_length     = length;
+    pc->number_of_codes = nc;
+    pc->scale           = 1.0 / sqrt ((float)(length * nc));
+    pc->use_fft         = (length >= RSP_PC_FFT_CODE_LENGTH);
+
+    pc->codes = malloc (nc * length * sizeof (float));
+    if (pc->codes == NULL)
+	return 1;
+
+    for (n = 0; n < nc; n++)
+    {
+	RSP_Oversample (param->codes[n], oversampled, param->code_length, ratio);
+	for (j = 0; j < length; j++)
+	    pc->codes[n * length + j] = (oversampled[j] == -1) ? -1.0 : 1.0;
+    }
+
+    if (!pc->use_fft)
+    {
+	/* padded I and Q input, correlation output and group sums */
+	pc->work = calloc (2 * (samples + length) + 4 * samples, sizeof (float));
+	if (pc->work == NULL)
+	{
+	    RSP_PulseCompressFree (pc);
+	    return 1;
+	}
+	return 0;
+    }
+
+    /* Block length: at least four code lengths, but no longer than */
+    /* needed to cover a whole pulse in one block                   */
+    pc->fft_length = next_power_of_two (4 * length);
+    if (pc->fft_length > next_power_of_two (samples + length - 1))
+	pc->fft_length = next_power_of_two (samples + length - 1);
+    pc->fft_step   = pc->fft_length - length + 1;
+    pc->segments   = (samples + pc->fft_step - 1) / pc->fft_step;
+
+    pc->code_spectra = fftw_malloc (sizeof (fftw_complex) * nc * pc->fft_length);
+    pc->fft_work     = fftw_malloc (sizeof (fftw_complex) * max_pulses * pc->segments * pc->fft_length);
+    if (pc->code_spectra == NULL || pc->fft_work == NULL)
+    {
+	RSP_PulseCompressFree (pc);
+	return 1;
+    }
+
+    /* Code spectra, conjugated so that multiplication correlates */
+    for (n = 0; n < nc; n++)
+    {
+	fftw_complex * C = pc->code_spectra + n * pc->fft_length;
+	fftw_plan      p;
+
+	for (j = 0; j < pc->fft_length; j++)
+	{
+	    fftw_cassign (C[j], (j < length) ? pc->codes[n * length + j] : 0.0, 0.0);
+	}
+	p = fftw_plan_dft_1d (pc->fft_length, C, C, FFTW_FORWARD, FFTW_ESTIMATE);
+	fftw_execute (p);
+	fftw_destroy_plan (p);
+	for (j = 0; j < pc->fft_length; j++)
+	{
+	    fftw_imag_lv (C[j]) = -fftw_imag (C[j]);
+	}
+    }
+
+    pc->forward = fftw_plan_many_dft (1, &pc->fft_length, max_pulses * pc->segments,
+				      pc->fft_work, NULL, 1, pc->fft_length,
+				      pc->fft_work, NULL, 1, pc->fft_length,
+				      FFTW_FORWARD, FFTW_ESTIMATE);
+    pc->inverse = fftw_plan_many_dft (1, &pc->fft_length, max_pulses * pc->segments,
+				      pc->fft_work, NULL, 1, pc->fft_length,
+				      pc->fft_work, NULL, 1, pc->fft_length,
+				      FFTW_BACKWARD, FFTW_ESTIMATE);
+    if (pc->forward == NULL || pc->inverse == NULL)
+    {
+	RSP_PulseCompressFree (pc);
+	return 1;
+    }
+
+    /* FFTW does not normalise the inverse transform */
+    pc->scale /= pc->fft_length;
+
+    return 0;
+}
+
+/* the first input pulse of output pulse g, the others every streams */
+static inline int
+first_pulse (int g,
+	     int nc,
+	     int streams)
+{
+    return (g / streams) * nc * streams + g % streams;
+}
+
+static int
+compress_direct (RSP_PulseCompressStruct * pc,
+		 const uint16_t *          idata,
+		 const uint16_t *          qdata,
+		 float *                   iout,
+		 float *                   qout,
+		 int                       pulses,
+		 int                       streams)
+{
+    const int S  = pc->samples;
+    const int L  = pc->code_length;
+    const int nc = pc->number_of_codes;
+    float *   xI    = pc->work;
+    float *   xQ    = xI + S + L;
+    float *   corrI = xQ + S + L;
+    float *   corrQ = corrI + S;
+    float *   sumI  = corrQ + S;
+    float *   sumQ  = sumI + S;
+    int       c, s, g;
+
+    for (g = 0; g < pulses / nc; g++)
+    {
+	memset (sumI, 0, 2 * S * sizeof (float));
+
+	for (c = 0; c < nc; c++)
+	{
+	    const int        p    = first_pulse (g, nc, streams) + c * streams;
+	    const float *    code = pc->codes + c * L;
+	    const uint16_t * i_in = idata + (size_t)p * S;
+	    const uint16_t * q_in = qdata + (size_t)p * S;
+
+	    /* tail of xI/xQ stays zero so every gate gets an output */
+	    for (s = 0; s < S; s++)
+	    {
+		xI[s] = (float)i_in[s] - RSP_ADC_OFFSET;
+		xQ[s] = (float)q_in[s] - RSP_ADC_OFFSET;
+	    }
+
+	    RSP_CorrelateFloat (xI, code, S + L - 1, L, corrI);
+	    RSP_CorrelateFloat (xQ, code, S + L - 1, L, corrQ);
+
+	    for (s = 0; s < S; s++)
+	    {
+		sumI[s] += corrI[s];
+		sumQ[s] += corrQ[s];
+	    }
+	}
+
+	for (s = 0; s < S; s++)
+	{
+	    iout[(size_t)g * S + s] = sumI[s] * pc->scale;
+	    qout[(size_t)g * S + s] = sumQ[s] * pc->scale;
+	}
+    }
+
+    return pulses / nc;
+}
+
+static int
+compress_fft (RSP_PulseCompressStruct * pc,
+	      const uint16_t *          idata,
+	      const uint16_t *          qdata,
+	      float *                   iout,
+	      float *                   qout,
+	      int                       pulses,
+	      int                       streams)
+{
+    const int S  = pc->samples;
+    const int N  = pc->fft_length;
+    const int M  = pc->fft_step;
+    const int nc = pc->number_of_codes;
+    int       p, b, s, g, j, c;
+
+    /* Load overlapping blocks for every pulse in the bank */
+    for (p = 0; p < pulses; p++)
+    {
+	for (b = 0; b < pc->segments; b++)
+	{
+	    fftw_complex * X  = pc->fft_work + (p * pc->segments + b) * N;
+	    const int      s0 = b * M;
+	    const int      n  = (S - s0 < N) ? S - s0 : N;
+
+	    for (j = 0; j < n; j++)
+	    {
+		fftw_cassign (X[j],
+			      (float)idata[p * S + s0 + j] - RSP_ADC_OFFSET,
+			      (float)qdata[p * S + s0 + j] - RSP_ADC_OFFSET);
+	    }
+	    for (; j < N; j++)
+	    {
+		fftw_cassign (X[j], 0.0, 0.0);
+	    }
+	}
+    }
+
+    fftw_execute (pc->forward);
+
+    for (p = 0; p < pulses; p++)
+    {
+	const fftw_complex * C = pc->code_spectra + ((p / streams) % nc) * N;
+
+	for (b = 0; b < pc->segments; b++)
+	{
+	    fftw_complex * X = pc->fft_work + (p * pc->segments + b) * N;
+
+	    for (j = 0; j < N; j++)
+	    {
+		const double re = fftw_real (X[j]) * fftw_real (C[j]) - fftw_imag (X[j]) * fftw_imag (C[j]);
+		const double im = fftw_real (X[j]) * fftw_imag (C[j]) + fftw_imag (X[j]) * fftw_real (C[j]);
+
+		fftw_cassign (X[j], re, im);
+	    }
+	}
+    }
+
+    fftw_execute (pc->inverse);
+
+    /* The first fft_step points of each block are the valid        */
+    /* correlation lags; sum complementary pulses                   */
+    for (g = 0; g < pulses / nc; g++)
+    {
+	for (s = 0; s < S; s++)
+	{
+	    double sumI = 0.0;
+	    double sumQ = 0.0;
+
+	    b = s / M;
+	    j = s - b * M;
+	    for (c = 0; c < nc; c++)
+	    {
+		const fftw_complex * X;
+
+		p = first_pulse (g, nc, streams) + c * streams;
+		X = pc->fft_work + ((size_t)p * pc->segments + b) * N;
+
+		sumI += fftw_real (X[j]);
+		sumQ += fftw_imag (X[j]);
+	    }
+	    iout[(size_t)g * S + s] = sumI * pc->scale;
+	    qout[(size_t)g * S + s] = sumQ * pc->scale;
+	}
+    }
+
+    return pulses / nc;
+}
+
+/*--------------------------------------------------------------------*
+ * RSP_PulseCompress: decode a bank of pulses                         *
+ * IN:  idata, qdata  [pulses][samples] I and Q ADC counts            *
+ *      pulses        number of pulses (at most pc->max_pulses)       *
+ *      streams       pulses interleaved, 2 in the alternating modes  *
+ * OUT: iout, qout    [pulses/number_of_codes][samples] decoded I     *
+ *                    and Q, without the ADC offset                   *
+ * RETURNS: number of decoded pulses                                  *
+ *--------------------------------------------------------------------*/
+int
+RSP_PulseCompress (RSP_PulseCompressStruct * pc,
+		   const uint16_t *          idata,
+		   const uint16_t *          qdata,
+		   float *                   iout,
+		   float *                   qout,
+		   int                       pulses,
+		   int                       streams)
+{
+    if (pulses > pc->max_pulses)
+	pulses = pc->max_pulses;
+
+    /* whole groups of the codes of every stream */
+    pulses -= pulses % (pc->number_of_codes * streams);
+
+    if (pc->use_fft)
+	return compress_fft (pc, idata, qdata, iout, qout, pulses, streams);
+    else
+	return compress_direct (pc, idata, qdata, iout, qout, pulses, streams);
+}
+
+void
+RSP_PulseCompressFree (RSP_PulseCompressStruct * pc)
+{
+    if (pc->forward != NULL)
+	fftw_destroy_plan (pc->forward);
+    if (pc->inverse != NULL)
+	fftw_destroy_plan (pc->inverse);
+    fftw_free (pc->fft_work);
+    fftw_free (pc->code_spectra);
+    free (pc->work);
+    free (pc->codes);
+    memset (pc, 0, sizeof (*pc));
+}
@@ -0,0 +1,330 @@
+// RSP_PulseCompressTest.c
+// -----------------------
+// Part of the Chilbolton Radar Signal Processing Package
+//
+// Purpose: Test for RSP_PulseCompress.c. Decodes random banks
+//          against a reference built with RSP_Correlate, and point
+//          targets with a Barker code and a complementary (Golay)
+//          pair, on both the direct and the FFT paths, with and
+//          without oversampling and with one or two interleaved
+//          streams. Checks the scaling, the pulse grouping, the
+//          peak gate and the sidelobe level.
+//
+// Created on: 19/10/26
+// -------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <RSP.h>
+
+#define NGATES   350
+#define NPULSES  16
+
+static int failures = 0;
+
+static const short barker13[13] = { 1, 1, 1, 1, 1, -1, -1, 1, 1, -1, 1, -1, 1 };
+static const short golay8a[8]   = { 1, 1, 1, -1, 1, 1, -1, 1 };
+static const short golay8b[8]   = { 1, 1, 1, -1, -1, -1, 1, -1 };
+
+typedef struct
+{
+    const char *  name;
+    const short * codes[2];
+    int           code_length;
+    int           number_of_codes;
+    int           oversample_ratio;
+    float         sidelobe_bound;     // largest sidelobe / peak
+} TestCase;
+
+static const TestCase cases[] =
+{
+    { "Barker 13",     { barker13, NULL },    13, 1, 1, 1.0 / 13 },
+    { "Barker 13 x3",  { barker13, NULL },    13, 1, 3, 1.0 / 13 },
+    { "Golay 8 pair",  { golay8a, golay8b },   8, 2, 1, 1e-6 },
+    { "Golay 8 pair x4", { golay8a, golay8b }, 8, 2, 4, 1e-6 }
+};
+
+static void
+report (const char * name,
+	const char * check,
+	int          fail)
+{
+    printf ("%-16s %-44s %s\n", name, check, fail ? "FAIL" : "ok");
+    failures += fail;
+}
+
+static void
+setup (const TestCase *          tc,
+       RSP_ParamStruct *         param,
+       RSP_PulseCompressStruct * pc)
+{
+    int n;
+
+    memset (param, 0, sizeof (*param));
+    param->code_length      = tc->code_length;
+    param->number_of_codes  = tc->number_of_codes;
+    param->oversample_ratio = tc->oversample_ratio;
+    for (n = 0; n < tc->number_of_codes; n++)
+	memcpy (param->codes[n], tc->codes[n], tc->code_length * sizeof (short));
+
+    if (RSP_PulseCompressInit (pc, param, NGATES, NPULSES) != 0)
+    {
+	fprintf (stderr, "Memory allocation error: %m\n");
+	exit (3);
+    }
+}
+
+/* scaling and choice of path follow the oversampled code length */
+static void
+test_setup (const TestCase * tc)
+{
+    RSP_ParamStruct         param;
+    RSP_PulseCompressStruct pc;
+    const int               length = tc->code_length * tc->oversample_ratio;
+    double                  scale;
+    char                    check[64];
+
+    setup (tc, &param, &pc);
+
+    scale = 1.0 / sqrt ((double)length * tc->number_of_codes);
+    if (pc.use_fft)
+	scale /= pc.fft_length;
+
+    snprintf (check, sizeof (check), "%s path, length %d", pc.use_fft ? "FFT" : "direct", length);
+    report (tc->name, check,
+	    pc.code_length != length ||
+	    pc.use_fft != (length >= RSP_PC_FFT_CODE_LENGTH));
+    report (tc->name, "scale 1/sqrt(length*codes)[/fft_length]",
+	    fabs (pc.scale - scale) > 1e-6 * scale);
+
+    RSP_PulseCompressFree (&pc);
+}
+
+/*--------------------------------------------------------------------*
+ * Random banks against RSP_Correlate. Pulse p carries code           *
+ * (p / streams) % codes, and output pulse g sums the codes of        *
+ * stream g % streams in group g / streams                            *
+ *--------------------------------------------------------------------*/
+static void
+test_reference (const TestCase * tc,
+		int              streams)
+{
+    RSP_ParamStruct         param;
+    RSP_PulseCompressStruct pc;
+    const int               nc = tc->number_of_codes;
+    uint16_t *              idata;
+    uint16_t *              qdata;
+    uint16_t *              padded;
+    long int *              corr;
+    float *                 iout;
+    float *                 qout;
+    double *                ref;
+    short                   code[32 * 32];
+    double                  max_ref = 0.0, max_err = 0.0;
+    int                     L, n, decoded, g, c, s, j, iq;
+    char                    check[64];
+
+    setup (tc, &param, &pc);
+    L = pc.code_length;
+
+    idata  = malloc (NPULSES * NGATES * sizeof (uint16_t));
+    qdata  = malloc (NPULSES * NGATES * sizeof (uint16_t));
+    padded = malloc ((NGATES + L - 1) * sizeof (uint16_t));
+    corr   = malloc (NGATES * sizeof (long int));
+    iout   = malloc (NPULSES * NGATES * sizeof (float));
+    qout   = malloc (NPULSES * NGATES * sizeof (float));
+    ref    = malloc (2 * NGATES * sizeof (double));
+    if (idata == NULL || qdata == NULL || padded == NULL || corr == NULL ||
+	iout == NULL || qout == NULL || ref == NULL)
+    {
+	fprintf (stderr, "Memory allocation error: %m\n");
+	exit (3);
+    }
+
+    for (n = 0; n < NPULSES * NGATES; n++)
+    {
+	idata[n] = RSP_ADC_OFFSET + rand () % 4000 - 2000;
+	qdata[n] = RSP_ADC_OFFSET + rand () % 4000 - 2000;
+    }
+
+    /* an incomplete group at the end of the bank is not decoded */
+    decoded = RSP_PulseCompress (&pc, idata, qdata, iout, qout, NPULSES - 1, streams);
+    snprintf (check, sizeof (check), "streams %d: decoded pulses", streams);
+    report (tc->name, check, decoded != (NPULSES / (nc * streams) - 1) * streams);
+
+    for (g = 0; g < decoded; g++)
+    {
+	memset (ref, 0, 2 * NGATES * sizeof (double));
+	for (c = 0; c < nc; c++)
+	{
+	    const int p = (g / streams) * nc * streams + g % streams + c * streams;
+	    long int  code_sum = 0;
+
+	    RSP_Oversample (param.codes[c], code, param.code_length, tc->oversample_ratio);
+	    for (j = 0; j < L; j++)
+		code_sum += code[j];
+
+	    /* samples past the end of the pulse are at the ADC offset */
+	    for (iq = 0; iq < 2; iq++)
+	    {
+		const uint16_t * data = (iq == 0 ? idata : qdata) + p * NGATES;
+
+		memcpy (padded, data, NGATES * sizeof (uint16_t));
+		for (s = NGATES; s < NGATES + L - 1; s++)
+		    padded[s] = RSP_ADC_OFFSET;
+		RSP_Correlate (padded, code, NGATES + L - 1, L, corr);
+		for (s = 0; s < NGATES; s++)
+		    ref[iq * NGATES + s] += corr[s] - (long int)RSP_ADC_OFFSET * code_sum;
+	    }
+	}
+
+	for (s = 0; s < 2 * NGATES; s++)
+	{
+	    const double r = ref[s] / sqrt ((double)L * nc);
+	    const float  o = (s < NGATES) ? iout[g * NGATES + s] : qout[g * NGATES + s - NGATES];
+
+	    max_ref = fmax (max_ref, fabs (r));
+	    max_err = fmax (max_err, fabs (o - r));
+	}
+    }
+
+    snprintf (check, sizeof (check), "streams %d: against RSP_Correlate %.2g", streams, max_err / max_ref);
+    report (tc->name, check, !(max_err <= 1e-5 * max_ref));
+
+    free (idata);
+    free (qdata);
+    free (padded);
+    free (corr);
+    free (iout);
+    free (qout);
+    free (ref);
+    RSP_PulseCompressFree (&pc);
+}
+
+/*--------------------------------------------------------------------*
+ * Point targets: stream t echoes its code at gate 100 + 50 t with    *
+ * amplitude 400 + 200 t in I and half that, negated, in Q. The       *
+ * decoded peak is amplitude * sqrt(length * codes) at the target     *
+ * gate; the oversampled chips widen it to +/- (ratio - 1) gates      *
+ *--------------------------------------------------------------------*/
+static void
+test_point_target (const TestCase * tc,
+		   int              streams)
+{
+    RSP_ParamStruct         param;
+    RSP_PulseCompressStruct pc;
+    const int               nc = tc->number_of_codes;
+    const int               r  = tc->oversample_ratio;
+    uint16_t *              idata;
+    uint16_t *              qdata;
+    float *                 iout;
+    float *                 qout;
+    short                   code[2][32 * 32];
+    double                  peak_err = 0.0, sidelobe = 0.0;
+    int                     L, n, p, g, s, j, decoded;
+    int                     wrong_gate = 0;
+    char                    check[64];
+
+    setup (tc, &param, &pc);
+    L = pc.code_length;
+
+    idata = malloc (NPULSES * NGATES * sizeof (uint16_t));
+    qdata = malloc (NPULSES * NGATES * sizeof (uint16_t));
+    iout  = malloc (NPULSES * NGATES * sizeof (float));
+    qout  = malloc (NPULSES * NGATES * sizeof (float));
+    if (idata == NULL || qdata == NULL || iout == NULL || qout == NULL)
+    {
+	fprintf (stderr, "Memory allocation error: %m\n");
+	exit (3);
+    }
+
+    for (n = 0; n < nc; n++)
+	RSP_Oversample (param.codes[n], code[n], param.code_length, r);
+
+    for (p = 0; p < NPULSES; p++)
+    {
+	const int     t    = p % streams;
+	const int     gate = 100 + 50 * t;
+	const int     amp  = 400 + 200 * t;
+	const short * chip = code[(p / streams) % nc];
+
+	for (s = 0; s < NGATES; s++)
+	{
+	    idata[p * NGATES + s] = RSP_ADC_OFFSET;
+	    qdata[p * NGATES + s] = RSP_ADC_OFFSET;
+	}
+	for (j = 0; j < L; j++)
+	{
+	    idata[p * NGATES + gate + j] += chip[j] * amp;
+	    qdata[p * NGATES + gate + j] -= chip[j] * amp / 2;
+	}
+    }
+
+    decoded = RSP_PulseCompress (&pc, idata, qdata, iout, qout, NPULSES, streams);
+
+    for (g = 0; g < decoded; g++)
+    {
+	const int    t    = g % streams;
+	const int    gate = 100 + 50 * t;
+	const double peak = (400 + 200 * t) * sqrt ((double)L * nc);
+	int          max_gate = 0;
+	double       max_pow  = -1.0;
+
+	for (s = 0; s < NGATES; s++)
+	{
+	    const double i   = iout[g * NGATES + s];
+	    const double q   = qout[g * NGATES + s];
+	    const double power = i * i + q * q;
+
+	    if (power > max_pow)
+	    {
+		max_pow  = power;
+		max_gate = s;
+	    }
+	    if (abs (s - gate) >= r)
+		sidelobe = fmax (sidelobe, sqrt (power) / (peak * sqrt (1.25)));
+	}
+
+	wrong_gate += (max_gate != gate);
+	peak_err = fmax (peak_err, fabs (iout[g * NGATES + gate] - peak) / peak);
+	peak_err = fmax (peak_err, fabs (qout[g * NGATES + gate] + peak / 2) / peak);
+    }
+
+    snprintf (check, sizeof (check), "streams %d: peak gate", streams);
+    report (tc->name, check, decoded != NPULSES / nc || wrong_gate != 0);
+    snprintf (check, sizeof (check), "streams %d: peak amplitude %.2g", streams, peak_err);
+    report (tc->name, check, !(peak_err <= 1e-5));
+    snprintf (check, sizeof (check), "streams %d: sidelobes %.2g (bound %.2g)",
+	      streams, sidelobe, tc->sidelobe_bound);
+    report (tc->name, check, !(sidelobe <= tc->sidelobe_bound + 1e-6));
+
+    free (idata);
+    free (qdata);
+    free (iout);
+    free (qout);
+    RSP_PulseCompressFree (&pc);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+    int n, streams;
+
+    srand (1);
+    for (n = 0; n < sizeof (cases) / sizeof (cases[0]); n++)
+    {
+	test_setup (&cases[n]);
+	for (streams = 1; streams <= 2; streams++)
+	{
+	    test_reference (&cases[n], streams);
+	    test_point_target (&cases[n], streams);
+	}
+    }
+
+    printf ("\n%s: %d failure(s)\n", failures ? "FAILED" : "PASSED", failures);
+    return failures ? 1 : 0;
+}
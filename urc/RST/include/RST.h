@@ -0,0 +1,83 @@
+#ifndef _RST_H
+#define _RST_H
+
+// RST.h
+// Radar Stage Timing package: time spent in each stage of the ray loop,
+// summed over a ray and kept as a histogram of per ray times for every
+// stage. The histograms have RST_SUB_BUCKETS logarithmic buckets per
+// power of two nanoseconds, so percentiles are good to 19 %.
+//
+// Times come from CLOCK_MONOTONIC, which the vDSO serves in about
+// 20 ns, so a lap costs one clock read.
+//
+// Compile the users with -DRST_NO_TIMING and RST_LAP, RST_END_RAY and
+// RST_RESTART cost nothing.
+
+#include <stdint.h>
+#include <time.h>
+
+#define RST_MAX_STAGES  24
+#define RST_MAX_EXTRA   4        // histograms kept outside the ray loop
+#define RST_SUB_BUCKETS 4
+#define RST_BUCKETS     (RST_SUB_BUCKETS * 40)   // up to 2^41 ns, about 36 minutes
+
+typedef struct
+{
+    uint64_t count;                  // rays
+    uint64_t total_ns;
+    uint64_t max_ns;
+    uint64_t bucket[RST_BUCKETS];
+} RST_HistStruct;
+
+typedef struct
+{
+    int                  n_stages;
+    const char * const * names;
+    uint64_t             lap;                    // time of the last lap
+    uint64_t             ray_ns[RST_MAX_STAGES]; // this ray so far
+    RST_HistStruct       stage[RST_MAX_STAGES];
+    RST_HistStruct       ray;                    // sum of all stages
+    struct timespec      since;                  // start of the histograms
+    int                  n_extra;
+    const char *         extra_names[RST_MAX_EXTRA];
+    const RST_HistStruct * extra[RST_MAX_EXTRA]; // written after the stages
+} RST_TimingStruct;
+
+static inline uint64_t
+RST_Now (void)
+{
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+// Charge the time since the last lap to stage
+static inline void
+RST_Lap (RST_TimingStruct * t, int stage)
+{
+    const uint64_t now = RST_Now ();
+
+    t->ray_ns[stage] += now - t->lap;
+    t->lap            = now;
+}
+
+extern int    RST_Init    (RST_TimingStruct * t, const char * const * names, int n_stages);
+extern void   RST_Restart (RST_TimingStruct * t);
+extern void   RST_EndRay  (RST_TimingStruct * t);
+extern void   RST_Add     (RST_HistStruct * h, uint64_t ns);
+extern double RST_Percentile (const RST_HistStruct * h, double p);
+extern int    RST_Attach  (RST_TimingStruct * t, const char * name, const RST_HistStruct * h);
+extern int    RST_Write   (const RST_TimingStruct * t, const char * filename);
+
+#ifndef RST_NO_TIMING
+#define RST_LAP(t, stage) RST_Lap (t, stage)
+#define RST_END_RAY(t)    RST_EndRay (t)
+#define RST_RESTART(t)    RST_Restart (t)
+#else
+#define RST_LAP(t, stage) ((void)0)
+#define RST_END_RAY(t)    ((void)0)
+#define RST_RESTART(t)    ((void)0)
+#endif
+
+#endif /* _RST_H */
@@ -0,0 +1,208 @@
+// RST_Timing.c
+// ------------
+// Part of the Chilbolton Radar Stage Timing Package
+//
+// Purpose: Per stage histograms of the time spent per ray, and the
+//          stats file they are written to.
+//
+// Created on: 19/10/26
+// -------------------------------------------------------
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <RST.h>
+
+/*--------------------------------------------------------------------*
+ * RST_Init: start empty histograms                                   *
+ * IN:  names     stage names, in the order of the stage numbers      *
+ *      n_stages  up to RST_MAX_STAGES                                *
+ * RETURNS: 0, or -1 for too many stages                              *
+ *--------------------------------------------------------------------*/
+int
+RST_Init (RST_TimingStruct *   t,
+	  const char * const * names,
+	  int                  n_stages)
+{
+    memset (t, 0, sizeof (*t));
+    if (n_stages > RST_MAX_STAGES)
+	return -1;
+
+    t->n_stages = n_stages;
+    t->names    = names;
+    clock_gettime (CLOCK_REALTIME, &t->since);
+    t->lap      = RST_Now ();
+    return 0;
+}
+
+/* Start timing a ray: the time since the last lap is not charged */
+void
+RST_Restart (RST_TimingStruct * t)
+{
+    memset (t->ray_ns, 0, sizeof (t->ray_ns));
+    t->lap = RST_Now ();
+}
+
+static int
+bucket_of (uint64_t ns)
+{
+    int k, b;
+
+    if (ns < RST_SUB_BUCKETS)
+	return ns;
+
+    /* 2^k <= ns < 2^(k+1), split into RST_SUB_BUCKETS */
+    k = 63 - __builtin_clzll (ns);
+    b = RST_SUB_BUCKETS * (k - 1) + (int)((ns >> (k - 2)) & (RST_SUB_BUCKETS - 1));
+    return (b < RST_BUCKETS) ? b : RST_BUCKETS - 1;
+}
+
+/* lowest time in bucket b */
+static double
+bucket_start (int b)
+{
+    if (b < RST_SUB_BUCKETS)
+	return b;
+    return (double)(RST_SUB_BUCKETS + b % RST_SUB_BUCKETS) * (double)(1ull << (b / RST_SUB_BUCKETS - 1));
+}
+
+void
+RST_Add (RST_HistStruct * h,
+	 uint64_t         ns)
+{
+    h->count++;
+    h->total_ns += ns;
+    if (ns > h->max_ns)
+	h->max_ns = ns;
+    h->bucket[bucket_of (ns)]++;
+}
+
+/* Add the stage times of the ray to the histograms */
+void
+RST_EndRay (RST_TimingStruct * t)
+{
+    uint64_t total = 0;
+    int      s;
+
+    for (s = 0; s < t->n_stages; s++)
+    {
+	RST_Add (&t->stage[s], t->ray_ns[s]);
+	total += t->ray_ns[s];
+    }
+    RST_Add (&t->ray, total);
+    RST_Restart (t);
+}
+
+/*--------------------------------------------------------------------*
+ * RST_Attach: write a histogram the caller keeps, of times that are  *
+ * not ray stages, to the stats file with the stages                  *
+ * RETURNS: 0, or -1 for more than RST_MAX_EXTRA                      *
+ *--------------------------------------------------------------------*/
+int
+RST_Attach (RST_TimingStruct *     t,
+	    const char *           name,
+	    const RST_HistStruct * h)
+{
+    if (t->n_extra >= RST_MAX_EXTRA)
+	return -1;
+
+    t->extra_names[t->n_extra] = name;
+    t->extra[t->n_extra]       = h;
+    t->n_extra++;
+    return 0;
+}
+
+/*--------------------------------------------------------------------*
+ * RST_Percentile                                                     *
+ * IN:  p  0 to 100                                                   *
+ * RETURNS: the upper edge of the bucket holding the p-th percentile  *
+ *          in ns, at most the maximum, or 0 for an empty histogram   *
+ *--------------------------------------------------------------------*/
+double
+RST_Percentile (const RST_HistStruct * h,
+		double                 p)
+{
+    uint64_t sum = 0;
+    double   rank;
+    int      b;
+
+    if (h->count == 0)
+	return 0.0;
+
+    rank = p / 100.0 * h->count;
+    for (b = 0; b < RST_BUCKETS; b++)
+    {
+	sum += h->bucket[b];
+	if (sum >= rank && sum > 0)
+	    break;
+    }
+    if (b >= RST_BUCKETS - 1 || bucket_start (b + 1) > h->max_ns)
+	return h->max_ns;
+    return bucket_start (b + 1);
+}
+
+static void
+write_hist (FILE *                 fp,
+	    const char *           name,
+	    const RST_HistStruct * h)
+{
+    int b;
+
+    fprintf (fp, "%-16s %8llu %11.3f %11.3f %11.3f %11.3f %11.3f %11.3f  ", name,
+	     (unsigned long long)h->count,
+	     h->count ? 1e-6 * h->total_ns / h->count : 0.0,
+	     1e-6 * RST_Percentile (h, 50.0), 1e-6 * RST_Percentile (h, 90.0),
+	     1e-6 * RST_Percentile (h, 99.0), 1e-6 * RST_Percentile (h, 99.9),
+	     1e-6 * h->max_ns);
+
+    /* non-empty buckets as start_ns:count */
+    for (b = 0; b < RST_BUCKETS; b++)
+    {
+	if (h->bucket[b] != 0)
+	    fprintf (fp, " %.0f:%llu", bucket_start (b), (unsigned long long)h->bucket[b]);
+    }
+    fprintf (fp, "\n");
+}
+
+/*--------------------------------------------------------------------*
+ * RST_Write: write the histograms to a stats file, replacing it      *
+ * as a whole so that readers never see half a file                   *
+ * RETURNS: 0, or -1 if the file could not be written                 *
+ *--------------------------------------------------------------------*/
+int
+RST_Write (const RST_TimingStruct * t,
+	   const char *             filename)
+{
+    char      tmpname[512];
+    char      since[32];
+    struct tm tm;
+    FILE *    fp;
+    int       s;
+
+    snprintf (tmpname, sizeof (tmpname), "%s.tmp", filename);
+    fp = fopen (tmpname, "w");
+    if (fp == NULL)
+	return -1;
+
+    gmtime_r (&t->since.tv_sec, &tm);
+    strftime (since, sizeof (since), "%Y-%m-%d %H:%M:%S", &tm);
+    fprintf (fp, "# Time per ray in each stage since %s UTC, in ms\n", since);
+    fprintf (fp, "# Histogram buckets are start_ns:rays\n");
+    fprintf (fp, "# %-14s %8s %11s %11s %11s %11s %11s %11s   histogram\n",
+	     "stage", "rays", "mean", "p50", "p90", "p99", "p99.9", "max");
+    for (s = 0; s < t->n_stages; s++)
+	write_hist (fp, t->names[s], &t->stage[s]);
+    write_hist (fp, "ray", &t->ray);
+    if (t->n_extra > 0)
+	fprintf (fp, "# Other times, per event\n");
+    for (s = 0; s < t->n_extra; s++)
+	write_hist (fp, t->extra_names[s], t->extra[s]);
+
+    if (fclose (fp) != 0 || rename (tmpname, filename) != 0)
+    {
+	unlink (tmpname);
+	return -1;
+    }
+    return 0;
+}